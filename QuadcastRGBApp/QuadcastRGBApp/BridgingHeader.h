@@ -1,2 +1,3 @@
 #include "qc2s_bridge.h"
 #include "qc2s_tcc_macos.h"
+#include "qc2s_effects.h"
@@ -74,7 +74,11 @@ private struct DetailView: View {
     @State private var delay: Double = 10
 
     private var maxColors: Int {
-        dm.mode == .solid ? 1 : 10
+        switch dm.mode {
+        case .solid: return 1
+        case .gradient, .chase: return 2 // from and to, head and background
+        default: return 10
+        }
     }
 
     var body: some View {
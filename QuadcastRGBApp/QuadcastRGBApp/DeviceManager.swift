@@ -90,18 +90,31 @@ final class DeviceManager: ObservableObject {
     }
 
     private func workerLoop() {
+        var leds = [UInt8](repeating: 0, count: FrameGenerator.ledFrameSize)
         while running {
             lock.lock()
             let currentCtx = ctx
             lock.unlock()
 
             if let c = currentCtx {
-                let frame = generator.nextFrame()
-                let res = qc2s_set_frame(
-                    c,
-                    frame.upper.r, frame.upper.g, frame.upper.b,
-                    frame.lower.r, frame.lower.g, frame.lower.b
-                )
+                let res: Int32
+                if let interval = generator.nextLEDs(into: &leds) {
+                    // Each LED slot of a group report gets its own color;
+                    // the writer sends the newest, 0 once it failed
+                    let seq = leds.withUnsafeBytes { raw in
+                        qc2s_post_leds(c, UnsafePointer(OpaquePointer(raw.baseAddress!)))
+                    }
+                    res = seq == 0 ? -1 : 0
+                    if res >= 0 {
+                        Thread.sleep(forTimeInterval: interval)
+                    }
+                } else {
+                    // The bridge holds each frame its time
+                    let batch = generator.nextBatch(FrameGenerator.batchSize)
+                    res = batch.withUnsafeBufferPointer { buf in
+                        qc2s_submit_frames(c, buf.baseAddress, Int32(buf.count))
+                    }
+                }
                 if res < 0 {
                     lock.lock()
                     qc2s_close(c)
@@ -124,7 +137,12 @@ final class DeviceManager: ObservableObject {
                 }
 
                 let newCtx = qc2s_open()
-                if let c = newCtx {
+                if let c = newCtx, qc2s_start_writer(c) != 0 {
+                    // Frames go through the writer thread or not at all
+                    qc2s_close(c)
+                    consecutiveFailures += 1
+                    Thread.sleep(forTimeInterval: 2.0)
+                } else if let c = newCtx {
                     lock.lock()
                     ctx = c
                     lock.unlock()
@@ -1,8 +1,21 @@
 import Foundation
 
 final class FrameGenerator: @unchecked Sendable {
+    /// Bytes of a per-LED frame: every LED slot of every group
+    static let ledFrameSize = Int(QC2S_GROUP_COUNT) *
+        (Int(QC2S_PACKET_SIZE) - Int(QC2S_RGB_OFFSET)) / 3 * 3
+
+    /// How long a frame of the other modes stays, as FRAME_PERIOD of
+    /// the command line tool
+    static let frameInterval: TimeInterval = 0.055
+    /// Frames handed to qc2s_submit_frames at once, about half a second
+    static let batchSize = 8
+
     private var frames: [AnimationFrame] = []
     private var index: Int = 0
+    private var effect: qc2s_effect?
+    private var step: UInt = 0
+    private var stepInterval: TimeInterval = 0
     private let lock = NSLock()
 
     init(mode: LightingMode, colors: [RGB], speed: Int, delay: Int, brightness: Int) {
@@ -18,9 +31,42 @@ final class FrameGenerator: @unchecked Sendable {
         return frame
     }
 
+    /// The next count frames, each held frameInterval
+    func nextBatch(_ count: Int) -> [qc2s_timed_frame] {
+        (0..<count).map { _ in
+            let frame = nextFrame()
+            var timed = qc2s_timed_frame()
+            withUnsafeMutableBytes(of: &timed.rgb) { raw in
+                for g in 0..<Int(QC2S_GROUP_COUNT) {
+                    let c = g < Int(QC2S_UPPER_GROUPS) ? frame.upper : frame.lower
+                    raw[g * 3] = c.r
+                    raw[g * 3 + 1] = c.g
+                    raw[g * 3 + 2] = c.b
+                }
+            }
+            timed.duration_ms = UInt32(FrameGenerator.frameInterval * 1000)
+            return timed
+        }
+    }
+
+    /// The next frame of a per-LED mode, rendered into leds
+    /// (ledFrameSize bytes). Returns how long it stays, nil for the
+    /// other modes.
+    func nextLEDs(into leds: inout [UInt8]) -> TimeInterval? {
+        lock.lock()
+        defer { lock.unlock() }
+        guard var e = effect else { return nil }
+        leds.withUnsafeMutableBytes { raw in
+            qc2s_effect_render(&e, step, UnsafeMutablePointer(OpaquePointer(raw.baseAddress!)))
+        }
+        step &+= 1
+        return stepInterval
+    }
+
     func regenerate(mode: LightingMode, colors: [RGB], speed: Int, delay: Int, brightness: Int) {
         let scaled = colors.map { $0.scaled(brightness: brightness) }
-        let newFrames: [AnimationFrame]
+        var newFrames: [AnimationFrame] = []
+        var newEffect: qc2s_effect?
         switch mode {
         case .solid:
             newFrames = generateSolid(colors: scaled)
@@ -34,13 +80,39 @@ final class FrameGenerator: @unchecked Sendable {
             newFrames = generateLightning(colors: scaled, speed: speed, synchronous: false)
         case .pulse:
             newFrames = generateLightning(colors: scaled, speed: speed, synchronous: true)
+        case .gradient, .chase, .rainbow:
+            newEffect = makeEffect(mode: mode, colors: scaled)
         }
         lock.lock()
         frames = newFrames.isEmpty ? [AnimationFrame(upper: .black, lower: .black)] : newFrames
         index = 0
+        effect = newEffect
+        step = 0
+        // A step moves the effect one LED on
+        stepInterval = TimeInterval(speedRange(min: 15, max: 150, speed: speed)) / 1000
         lock.unlock()
     }
 
+    // MARK: - Per-LED effects
+
+    private func makeEffect(mode: LightingMode, colors: [RGB]) -> qc2s_effect {
+        var e = qc2s_effect()
+        let first = colors.first ?? .black
+        let second = colors.count > 1 ? colors[1] : .black
+        switch mode {
+        case .gradient:
+            e.kind = Int32(QC2S_EFFECT_GRADIENT.rawValue)
+        case .chase:
+            e.kind = Int32(QC2S_EFFECT_CHASE.rawValue)
+            e.tail = 4
+        default:
+            e.kind = Int32(QC2S_EFFECT_RAINBOW.rawValue)
+        }
+        e.from = (first.r, first.g, first.b)
+        e.to = (second.r, second.g, second.b)
+        return e
+    }
+
     // MARK: - Solid
 
     private func generateSolid(colors: [RGB]) -> [AnimationFrame] {
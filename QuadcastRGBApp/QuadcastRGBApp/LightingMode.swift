@@ -40,10 +40,13 @@ struct AnimationFrame {
 
 enum LightingMode: String, CaseIterable, Codable {
     case solid, blink, cycle, wave, lightning, pulse
+    case gradient, chase, rainbow
 
     var label: String { rawValue.capitalized }
     var hasSpeed: Bool { self != .solid }
     var hasDelay: Bool { self == .blink }
+    /// Rendered per LED by qc2s_effects inside each group
+    var perLED: Bool { self == .gradient || self == .chase || self == .rainbow }
 
     var icon: String {
         switch self {
@@ -53,6 +56,9 @@ enum LightingMode: String, CaseIterable, Codable {
         case .wave: return "water.waves"
         case .lightning: return "bolt.fill"
         case .pulse: return "waveform.path"
+        case .gradient: return "slider.horizontal.below.rectangle"
+        case .chase: return "circle.dotted"
+        case .rainbow: return "rainbow"
         }
     }
 
@@ -64,6 +70,9 @@ enum LightingMode: String, CaseIterable, Codable {
         case .wave: return "Offset upper and lower zones"
         case .lightning: return "Random flash effects"
         case .pulse: return "Synchronized breathing"
+        case .gradient: return "Two colors sweeping across each group"
+        case .chase: return "A lit LED running around each group"
+        case .rainbow: return "The hue wheel spinning in each group"
         }
     }
 }
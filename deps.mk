@@ -3,6 +3,51 @@ argparser.o: modules/argparser.c modules/argparser.h \
 devio.o: modules/devio.c modules/devio.h \
   /opt/homebrew/Cellar/libusb/1.0.29/include/libusb-1.0/libusb.h \
   modules/locale_macros.h modules/rgbmodes.h modules/argparser.h \
-  modules/qc2s_protocol.h
+  modules/frameclock.h modules/rtsched.h modules/evloop.h \
+  modules/ctlsock.h modules/framering.h modules/framestream.h \
+  modules/netrecv.h modules/orgbsrv.h modules/transport.h \
+  modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h modules/usbdev.h
 rgbmodes.o: modules/rgbmodes.c modules/rgbmodes.h modules/argparser.h \
   modules/locale_macros.h
+frameclock.o: modules/frameclock.c modules/frameclock.h
+rtsched.o: modules/rtsched.c modules/rtsched.h modules/locale_macros.h \
+  modules/frameclock.h
+evloop.o: modules/evloop.c modules/evloop.h modules/frameclock.h
+ctlsock.o: modules/ctlsock.c modules/ctlsock.h modules/locale_macros.h \
+  modules/argparser.h modules/rgbmodes.h modules/frameclock.h
+framering.o: modules/framering.c modules/framering.h \
+  modules/locale_macros.h modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h
+framestream.o: modules/framestream.c modules/framestream.h \
+  modules/locale_macros.h modules/argparser.h modules/framering.h \
+  modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h
+netrecv.o: modules/netrecv.c modules/netrecv.h modules/locale_macros.h \
+  modules/argparser.h modules/framering.h modules/frameclock.h \
+  modules/qc2s_protocol.h modules/qc2s_pace.h
+orgbsrv.o: modules/orgbsrv.c modules/orgbsrv.h modules/locale_macros.h \
+  modules/framering.h modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h
+transport.o: modules/transport.c modules/transport.h modules/rgbmodes.h \
+  modules/argparser.h modules/framering.h modules/locale_macros.h \
+  modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h
+usbdev.o: modules/usbdev.c modules/usbdev.h \
+  /opt/homebrew/Cellar/libusb/1.0.29/include/libusb-1.0/libusb.h \
+  modules/locale_macros.h modules/frameclock.h modules/transport.h \
+  modules/rgbmodes.h modules/argparser.h modules/framering.h \
+  modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h
+qc1_usb.o: modules/qc1_usb.c modules/qc1_usb.h modules/transport.h \
+  modules/rgbmodes.h modules/argparser.h modules/framering.h \
+  modules/locale_macros.h modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h \
+  modules/usbdev.h \
+  /opt/homebrew/Cellar/libusb/1.0.29/include/libusb-1.0/libusb.h
+qc2s_usb.o: modules/qc2s_usb.c modules/qc2s_usb.h modules/transport.h \
+  modules/rgbmodes.h modules/argparser.h modules/framering.h \
+  modules/locale_macros.h modules/frameclock.h modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h \
+  modules/usbdev.h \
+  /opt/homebrew/Cellar/libusb/1.0.29/include/libusb-1.0/libusb.h
+qc2s_hidraw.o: modules/qc2s_hidraw.c modules/qc2s_hidraw.h \
+  modules/transport.h modules/rgbmodes.h modules/argparser.h \
+  modules/framering.h modules/locale_macros.h modules/frameclock.h \
+  modules/qc2s_protocol.h modules/qc2s_pace.h modules/qc2s_encode.h modules/qc2s_usb.h modules/usbdev.h \
+  /opt/homebrew/Cellar/libusb/1.0.29/include/libusb-1.0/libusb.h
+qc2s_pace.o: modules/qc2s_pace.c modules/qc2s_pace.h
+qc2s_encode.o: modules/qc2s_encode.c modules/qc2s_encode.h \
+  modules/qc2s_protocol.h
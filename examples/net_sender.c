@@ -0,0 +1,105 @@
+/* net_sender - drive `quadcastrgb --e131 N` or `--ddp` over UDP.
+ * Build: make examples
+ * Usage: ./examples/net_sender [-d] [-u universe] [-a host] [-p port]
+ *                              [-f fps] [-t seconds] [-l]
+ *
+ * Sends six RGB pixels running through the rainbow, from channel 1. With
+ * -l it listens on the port itself and measures how long each frame
+ * takes from sendto() until the receiver has parsed it, which is the
+ * daemon's path up to the USB transfer.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <arpa/inet.h> /* for inet_addr */
+
+#include "../modules/netrecv.h"
+
+static void rainbow(unsigned long i, uint8_t *ch)
+{
+    int px, phase;
+    for(px = 0; px < QC2S_GROUP_COUNT; px++) {
+        phase = (int)((i*4 + px*42) % 255);
+        ch[3*px] = (uint8_t)(255 - phase);
+        ch[3*px+1] = (uint8_t)phase;
+        ch[3*px+2] = (uint8_t)(phase/2);
+    }
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    struct sockaddr_in to;
+    struct frame_clock clock;
+    struct pollfd pfd;
+    uint8_t ch[3*QC2S_GROUP_COUNT], pkt[E131_MAX_DATAGRAM];
+    const char *host = "127.0.0.1";
+    int proto = net_e131, universe = 1, port = 0, fps = 40, seconds = 5;
+    int loopback = 0, opt, fd, len;
+    unsigned long i, frames, got = 0;
+    long long *lat = NULL, sent_ns;
+    while((opt = getopt(argc, argv, "du:a:p:f:t:l")) != -1) {
+        switch(opt) {
+        case 'd': proto = net_ddp; break;
+        case 'u': universe = atoi(optarg); break;
+        case 'a': host = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'f': fps = atoi(optarg); break;
+        case 't': seconds = atoi(optarg); break;
+        case 'l': loopback = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-d] [-u universe] [-a host] "
+                    "[-p port] [-f fps] [-t seconds] [-l]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(fps <= 0 || seconds <= 0)
+        return 1;
+    if(!port)
+        port = (proto == net_e131) ? E131_PORT : DDP_PORT;
+    frames = (unsigned long)fps * seconds;
+    if(loopback) {
+        if(net_open(&nr, proto, port, universe, 1, QC2S_GROUP_COUNT)) {
+            perror("bind");
+            return 1;
+        }
+        host = "127.0.0.1";
+        lat = malloc(frames * sizeof(*lat));
+        pfd.fd = nr.fd;
+        pfd.events = POLLIN;
+    }
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = inet_addr(host);
+    frame_clock_start(&clock, 1000 / fps);
+    for(i = 0; i < frames; i++) {
+        rainbow(i, ch);
+        len = net_build(proto, universe, (uint8_t)i, ch, sizeof(ch), pkt);
+        sent_ns = frame_clock_now_ns();
+        if(sendto(fd, pkt, len, 0, (struct sockaddr *)&to, sizeof(to)) < 0)
+            perror("sendto");
+        if(loopback && poll(&pfd, 1, 100) > 0 && net_receive(&nr, &f))
+            lat[got++] = f.timestamp_ns - sent_ns;
+        frame_clock_wait(&clock);
+    }
+    if(loopback) {
+        qsort(lat, got, sizeof(*lat), cmp_ll);
+        printf("%lu/%lu frames received; latency us: "
+               "p50 %.1f, p99 %.1f, max %.1f\n", got, frames,
+               got ? lat[got/2] / 1e3 : 0, got ? lat[got*99/100] / 1e3 : 0,
+               got ? lat[got-1] / 1e3 : 0);
+        net_close(&nr);
+        free(lat);
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,60 @@
+/* ring_producer - drive a running `quadcastrgb --shm` daemon.
+ * Build: make examples
+ * Usage: ./examples/ring_producer [fps] [seconds]
+ *
+ * Attaches to the daemon's frame ring and publishes a rainbow that runs
+ * around the six groups of QuadCast 2S; QuadCast S shows the first
+ * group of each part. Frames may be published at any rate, the daemon
+ * shows the newest one on each of its ticks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../modules/framering.h"
+
+static void hue_to_rgb(int hue, uint8_t *rgb)
+{
+    int sector = hue / 60 % 6, rise = (hue % 60) * 255 / 60;
+    static const int order[6][3] = {
+        { 2, 1, 0 }, { 1, 2, 0 }, { 0, 2, 1 },
+        { 0, 1, 2 }, { 1, 0, 2 }, { 2, 0, 1 }
+    }; /* 2 = full, 1 = rising or falling, 0 = off */
+    int i;
+    for(i = 0; i < 3; i++) {
+        if(order[sector][i] == 2)
+            rgb[i] = 255;
+        else if(order[sector][i] == 1)
+            rgb[i] = (sector % 2) ? 255 - rise : rise;
+        else
+            rgb[i] = 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct frame_ring ring;
+    struct ring_frame frame = {0};
+    struct frame_clock clock;
+    int fps = argc > 1 ? atoi(argv[1]) : 60;
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    unsigned long i;
+    int group;
+    if(fps <= 0 || seconds <= 0) {
+        fprintf(stderr, "Usage: %s [fps] [seconds]\n", argv[0]);
+        return 1;
+    }
+    if(ring_attach(&ring, RING_NAME)) {
+        fprintf(stderr, "No frame ring; is `quadcastrgb --shm` running?\n");
+        return 1;
+    }
+    frame_clock_start(&clock, 1000 / fps);
+    for(i = 0; i < (unsigned long)fps * seconds; i++) {
+        for(group = 0; group < QC2S_GROUP_COUNT; group++)
+            hue_to_rgb((int)(i*4 + group*60) % 360, frame.rgb[group]);
+        frame.timestamp_ns = 0; /* stamped on publishing */
+        ring_publish(&ring, &frame);
+        frame_clock_wait(&clock);
+    }
+    ring_detach(&ring);
+    return 0;
+}
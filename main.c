@@ -28,6 +28,8 @@
 #include "modules/argparser.h"
 #include "modules/rgbmodes.h"
 #include "modules/devio.h"
+#include "modules/rtsched.h"
+#include "modules/ctlsock.h"
 
 #define LOCALESETUP() \
     setlocale(LC_CTYPE, ""); \
@@ -43,31 +45,74 @@
 #define VERBOSE2_COL _("Assembling data packets.")
 #define VERBOSE3_MIC _("Opening the microphone descriptor.")
 #define VERBOSE4_PKT _("Sending packets.")
+#define VERBOSE4_PERSIST _("The microphones loop the animation alone.")
 #define VERBOSE5_END _("Done.")
 
 int main(int argc, const char **argv)
 {
     struct colschemes *cs;
-    datpack *data_arr;
-    libusb_device_handle *handle;
-    int verbose = 0, data_packet_cnt;
+    datpack *data_arrs[MAX_MICROS+1]; /* the shared one, then per device */
+    int data_packet_cnts[MAX_MICROS+1];
+    struct micro micros[MAX_MICROS];
+    struct runopts opts;
+    struct startup_times times;
+    long long start = frame_clock_now_ns();
+    int i, micro_cnt, status;
     /*LOCALESETUP();*/
     /* Parse arguments */
-    cs = parse_arg(argc, argv, &verbose);
-    VERBOSE_PRINT(verbose, VERBOSE1_ARG);
-    /* Create data packets */
-    VERBOSE_PRINT(verbose, VERBOSE2_COL);
-    data_arr = parse_colorscheme(cs, &data_packet_cnt);
+    cs = parse_arg(argc, argv, &opts);
+    times.parse_ns = frame_clock_now_ns() - start;
+    VERBOSE_PRINT(opts.verbose, VERBOSE1_ARG);
+    if(opts.bench_jitter) {
+        free(cs);
+        bench_jitter(opts.cpu);
+        return 0;
+    }
+    /* A running instance owns the microphone already */
+    status = (opts.stream || opts.bench_startup || opts.calibrate)
+             ? -1 : ctl_forward(argc, argv);
+    if(status >= 0) {
+        free(cs);
+        VERBOSE_PRINT(opts.verbose, CTL_FORWARD_MSG);
+        return status;
+    }
+    /* Create data packets; frames of the stream mode come from stdin */
+    VERBOSE_PRINT(opts.verbose, VERBOSE2_COL);
+    times.compile_ns = frame_clock_now_ns();
+    for(i = 0; i <= opts.dev_cnt; i++) {
+        data_arrs[i] = NULL;
+        data_packet_cnts[i] = 0;
+        if(!opts.stream && cs[i].upper.mode) /* or it mirrors the shared */
+            data_arrs[i] = parse_colorscheme(cs+i, data_packet_cnts+i);
+    }
+    times.compile_ns = frame_clock_now_ns() - times.compile_ns;
     free(cs);
-    /* Open the microphone */
-    VERBOSE_PRINT(verbose, VERBOSE3_MIC);
-    handle = open_micro(data_arr); /* data_arr for freeing memory */
-    /* Send packets */
-    VERBOSE_PRINT(verbose, VERBOSE4_PKT);
-    send_packets(handle, data_arr, data_packet_cnt, verbose);
+    /* Open the microphones */
+    VERBOSE_PRINT(opts.verbose, VERBOSE3_MIC);
+    micro_cnt = open_micros(micros, &opts, data_arrs, data_packet_cnts,
+                            &times);
+    /* Send packets, unless the microphones keep the animation */
+    if(opts.calibrate) {
+        calibrate_micros(micros, micro_cnt);
+    } else if(opts.persist && persist_micros(micros, micro_cnt, data_arrs[0],
+                                             data_packet_cnts[0], &opts)) {
+        VERBOSE_PRINT(opts.verbose, VERBOSE4_PERSIST);
+    } else {
+        VERBOSE_PRINT(opts.verbose, VERBOSE4_PKT);
+        send_packets(micros, micro_cnt, data_arrs[0], data_packet_cnts[0],
+                     &opts, &times);
+    }
+    if(opts.bench_startup)
+        printf(STARTUP_MSG, (times.parse_ns + times.compile_ns +
+                             times.open_ns + times.claim_ns +
+                             times.first_ns)/NSEC_PER_USEC,
+               times.parse_ns/NSEC_PER_USEC, times.compile_ns/NSEC_PER_USEC,
+               times.open_ns/NSEC_PER_USEC, times.claim_ns/NSEC_PER_USEC,
+               times.first_ns/NSEC_PER_USEC);
     /* Free all memory */
-    free(data_arr);
-    close_micro(handle);
-    VERBOSE_PRINT(verbose, VERBOSE5_END);
+    for(i = 0; i <= opts.dev_cnt; i++)
+        free(data_arrs[i]);
+    close_micros(micros, micro_cnt);
+    VERBOSE_PRINT(opts.verbose, VERBOSE5_END);
     return 0;
 }
@@ -27,9 +27,22 @@
 
 /* Static declarations */
 static void set_arg(const char ***arg_pp, const char **argv_end,
-                    struct colschemes *cs, int *state, int *verbose);
+                    struct colschemes *cs, int *state, struct runopts *opts);
+static void set_cpu(const char **arg_p, const char **argv_end,
+                    struct colschemes *cs, struct runopts *opts);
+static void set_stream(const char ***arg_pp, const char **argv_end,
+                       struct runopts *opts);
+static void set_num_opt(const char **arg_p, const char **argv_end,
+                        struct colschemes *cs, int *value, int min, int max);
+static void set_openrgb(const char ***arg_pp, const char **argv_end,
+                        struct colschemes *cs, struct runopts *opts);
+static void set_device(const char **arg_p, const char **argv_end,
+                       struct colschemes *cs, int *state,
+                       struct runopts *opts);
 static void set_br_spd_dly(const char **arg_p, const char **argv_end,
-                           int state, struct colschemes *cs);
+                           int state, struct colschemes *cs,
+                           struct colschemes *cur);
+static void set_defaults(struct colschemes *cs);
 static void set_mode(const char ***arg_pp, const char **argv_end,
                      int state, struct colschemes *cs);
 static void set_colors(const char ***arg_pp, const char **argv_end,
@@ -68,23 +81,57 @@ static const int rainbow[RAINBOW_CNT] = {
 };
 
 /* Functions */
-struct colschemes *parse_arg(int argc, const char **argv, int *verbose)
+struct colschemes *parse_arg(int argc, const char **argv,
+                             struct runopts *opts)
 {
-    struct colschemes *cs = malloc(sizeof(*cs));
+    struct colschemes *cs = malloc(sizeof(*cs) * (MAX_MICROS+1));
     const char **arg_p;
-    int cs_state = all;
+    int i, cs_state = all;
 
     /* Set defaults */
-    cs->upper.br = cs->lower.br = MAX_BR_SPD_DLY;
-    cs->upper.spd = cs->lower.spd = SPD_DEFAULT;
-    cs->upper.dly = cs->lower.dly = DLY_DEFAULT;
-    cs->upper.mode = cs->lower.mode = NULL;
+    for(i = 0; i <= MAX_MICROS; i++)
+        set_defaults(cs+i);
+    opts->verbose = 0;
+    opts->realtime = 0;
+    opts->cpu = -1;
+    opts->bench_jitter = 0;
+    opts->bench_startup = 0;
+    opts->calibrate = 0;
+    opts->shm = 0;
+    opts->bulk = 0;
+    opts->persist = 0;
+    opts->keepalive = QC2S_KEEPALIVE_MS;
+    opts->stream = stream_off;
+    opts->latest = 0;
+    opts->net = net_off;
+    opts->universe = 1;
+    opts->channel = 1;
+    opts->pixels = 6;
+    opts->port = 0;
+    opts->openrgb = 0;
+    opts->dev_cnt = 0;
 
     for(arg_p = argv+1; arg_p < argv+argc; arg_p++)
-        set_arg(&arg_p, argv+argc-1, cs, &cs_state, verbose);
+        set_arg(&arg_p, argv+argc-1, cs, &cs_state, opts);
 
-    if(!(cs->upper.mode)) { /* any chosen group sets also the other */
-        fprintf(stderr, NOMODE_MSG);
+    /* No colors to compile */
+    if(opts->bench_jitter || opts->stream || opts->calibrate)
+        return cs;
+    if(opts->pixels != 1 && opts->pixels != 2 && opts->pixels != 6) {
+        fprintf(stderr, PIXELS_MSG);
+        free(cs); exit(argerr);
+    }
+    /* Dark until the first frame */
+    if(!(cs->upper.mode) && (opts->shm || opts->net || opts->openrgb)) {
+        cs->upper.mode = cs->lower.mode = modes[0];
+        write_int_param(cs->upper.colors, cs->lower.colors, black, all);
+        write_int_param(cs->upper.colors+1, cs->lower.colors+1, nocolor, all);
+    }
+    /* The shared scheme is needed unless every device has its own */
+    for(i = 1; i <= opts->dev_cnt && cs[i].upper.mode; i++)
+        ;
+    if(!(cs->upper.mode) && (!opts->dev_cnt || i <= opts->dev_cnt)) {
+        fprintf(stderr, NOMODE_MSG); /* any group sets also the other */
         free(cs); exit(argerr);
     }
 
@@ -98,7 +145,7 @@ int strequ(const char *str1, const char *str2)
 
 /* Changes all given parameters except argv_end */
 static void set_arg(const char ***arg_pp, const char **argv_end,
-                    struct colschemes *cs, int *state, int *verbose)
+                    struct colschemes *cs, int *state, struct runopts *opts)
 {
     if(strequ(**arg_pp, "--version")) {
         puts(VERSION_MESSAGE);
@@ -107,7 +154,52 @@ static void set_arg(const char ***arg_pp, const char **argv_end,
         puts(HELP_MESSAGE);
         free(cs); exit(success);
     } else if(strequ(**arg_pp, "-v") || strequ(**arg_pp, "--verbose")) {
-        *verbose = 1;
+        opts->verbose = 1;
+    } else if(strequ(**arg_pp, "--realtime")) {
+        opts->realtime = 1;
+    } else if(strequ(**arg_pp, "--cpu")) {
+        set_cpu(*arg_pp, argv_end, cs, opts);
+        (*arg_pp)++; /* skip option's parameter */
+    } else if(strequ(**arg_pp, "--bench-jitter")) {
+        opts->bench_jitter = 1;
+    } else if(strequ(**arg_pp, "--bench-startup")) {
+        opts->bench_startup = 1;
+    } else if(strequ(**arg_pp, "--calibrate")) {
+        opts->calibrate = 1;
+    } else if(strequ(**arg_pp, "--shm")) {
+        opts->shm = 1;
+    } else if(strequ(**arg_pp, "--bulk")) {
+        opts->bulk = 1;
+    } else if(strequ(**arg_pp, "--persist")) {
+        opts->persist = 1;
+    } else if(strequ(**arg_pp, "--keepalive")) {
+        set_num_opt(*arg_pp, argv_end, cs, &opts->keepalive, 0,
+                    MAX_KEEPALIVE);
+        (*arg_pp)++; /* skip option's parameter */
+    } else if(strequ(**arg_pp, "--latest")) {
+        opts->latest = 1;
+    } else if(strequ(**arg_pp, "--e131")) {
+        opts->net = net_e131;
+        set_num_opt(*arg_pp, argv_end, cs, &opts->universe, 1, MAX_UNIVERSE);
+        (*arg_pp)++; /* skip option's parameter */
+    } else if(strequ(**arg_pp, "--ddp")) {
+        opts->net = net_ddp;
+    } else if(strequ(**arg_pp, "--channel")) {
+        set_num_opt(*arg_pp, argv_end, cs, &opts->channel, 1, MAX_CHANNEL);
+        (*arg_pp)++;
+    } else if(strequ(**arg_pp, "--pixels")) {
+        set_num_opt(*arg_pp, argv_end, cs, &opts->pixels, 1, 6);
+        (*arg_pp)++;
+    } else if(strequ(**arg_pp, "--port")) {
+        set_num_opt(*arg_pp, argv_end, cs, &opts->port, 1, MAX_PORT);
+        (*arg_pp)++;
+    } else if(strequ(**arg_pp, "--openrgb")) {
+        set_openrgb(arg_pp, argv_end, cs, opts);
+    } else if(strequ(**arg_pp, "--device")) {
+        set_device(*arg_pp, argv_end, cs, state, opts);
+        (*arg_pp)++;
+    } else if(strequ(**arg_pp, "stream")) {
+        set_stream(arg_pp, argv_end, opts);
     } else if(strequ(**arg_pp, "-a") || strequ(**arg_pp, "--all")) {
         *state = all;
     } else if(strequ(**arg_pp, "-u") || strequ(**arg_pp, "--upper")) {
@@ -116,11 +208,11 @@ static void set_arg(const char ***arg_pp, const char **argv_end,
         *state = lower;
     } else if(strequ(**arg_pp, "-b") || strequ(**arg_pp, "-s") ||
                                         strequ(**arg_pp, "-d")) {
-        set_br_spd_dly(*arg_pp, argv_end, *state, cs);
+        set_br_spd_dly(*arg_pp, argv_end, *state, cs, cs+opts->dev_cnt);
         (*arg_pp)++; /* skip option's parameter */
     } else if(is_mode(**arg_pp)) {
-        set_mode(arg_pp, argv_end, *state, cs);
-        set_colors(arg_pp, argv_end, *state, cs);
+        set_mode(arg_pp, argv_end, *state, cs+opts->dev_cnt);
+        set_colors(arg_pp, argv_end, *state, cs+opts->dev_cnt);
     } else {
         fprintf(stderr, BADARG_MSG, **arg_pp);
         free(cs); exit(argerr);
@@ -137,8 +229,35 @@ static int is_mode(const char *str)
     return 0;
 }
 
+static void set_defaults(struct colschemes *cs)
+{
+    cs->upper.br = cs->lower.br = MAX_BR_SPD_DLY;
+    cs->upper.spd = cs->lower.spd = SPD_DEFAULT;
+    cs->upper.dly = cs->lower.dly = DLY_DEFAULT;
+    cs->upper.mode = cs->lower.mode = NULL;
+}
+
+/* The colors given after the option are the device's own */
+static void set_device(const char **arg_p, const char **argv_end,
+                       struct colschemes *cs, int *state,
+                       struct runopts *opts)
+{
+    if(arg_p == argv_end) {
+        fprintf(stderr, NOPARAM_LONG_MSG, *arg_p);
+        free(cs); exit(argerr);
+    }
+    if(opts->dev_cnt == MAX_MICROS) {
+        fprintf(stderr, DEVICES_MSG, MAX_MICROS);
+        free(cs); exit(argerr);
+    }
+    opts->devices[opts->dev_cnt] = *(arg_p+1);
+    opts->dev_cnt++;
+    *state = all;
+}
+
 static void set_br_spd_dly(const char **arg_p, const char **argv_end,
-                           int state, struct colschemes *cs)
+                           int state, struct colschemes *cs,
+                           struct colschemes *cur)
 {
     short num;
     if(no_opt_param(arg_p, argv_end)) {
@@ -151,11 +270,62 @@ static void set_br_spd_dly(const char **arg_p, const char **argv_end,
         free(cs); exit(argerr);
     }
     if(strequ(*arg_p, "-b")) {        /* brightness */
-        write_int_param(&(cs->upper.br), &(cs->lower.br), num, state);
+        write_int_param(&(cur->upper.br), &(cur->lower.br), num, state);
     } else if(strequ(*arg_p, "-s")) { /* speed */
-        write_int_param(&(cs->upper.spd), &(cs->lower.spd), num, state);
+        write_int_param(&(cur->upper.spd), &(cur->lower.spd), num, state);
     } else if(strequ(*arg_p, "-d")) { /* delay */
-        write_int_param(&(cs->upper.dly), &(cs->lower.dly), num, state);
+        write_int_param(&(cur->upper.dly), &(cur->lower.dly), num, state);
+    }
+}
+
+static void set_cpu(const char **arg_p, const char **argv_end,
+                    struct colschemes *cs, struct runopts *opts)
+{
+    if(no_opt_param(arg_p, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, *arg_p);
+        free(cs); exit(argerr);
+    }
+    opts->cpu = atoi(*(arg_p+1));
+    opts->realtime = 1; /* pinning is a part of the low-jitter mode */
+}
+
+static void set_num_opt(const char **arg_p, const char **argv_end,
+                        struct colschemes *cs, int *value, int min, int max)
+{
+    if(no_opt_param(arg_p, argv_end)) {
+        fprintf(stderr, NOPARAM_SHORT_MSG, *arg_p);
+        free(cs); exit(argerr);
+    }
+    *value = atoi(*(arg_p+1));
+    if(*value < min || *value > max) {
+        fprintf(stderr, RANGE_MSG, *arg_p, min, max);
+        free(cs); exit(argerr);
+    }
+}
+
+/* The port is optional */
+static void set_openrgb(const char ***arg_pp, const char **argv_end,
+                        struct colschemes *cs, struct runopts *opts)
+{
+    opts->openrgb = OPENRGB_PORT;
+    if(no_opt_param(*arg_pp, argv_end))
+        return;
+    set_num_opt(*arg_pp, argv_end, cs, &opts->openrgb, 1, MAX_PORT);
+    (*arg_pp)++;
+}
+
+/* The format is optional, binary by default */
+static void set_stream(const char ***arg_pp, const char **argv_end,
+                       struct runopts *opts)
+{
+    opts->stream = stream_bin;
+    if(*arg_pp == argv_end)
+        return;
+    if(strequ(*(*arg_pp+1), "hex")) {
+        opts->stream = stream_hex;
+        (*arg_pp)++;
+    } else if(strequ(*(*arg_pp+1), "bin")) {
+        (*arg_pp)++;
     }
 }
 
@@ -34,14 +34,21 @@
 #include <stdlib.h> /* for malloc, exit, atoi */
 #include <string.h> /* for strcmp */
 #include "locale_macros.h"
+#include "qc2s_protocol.h" /* for QC2S_KEEPALIVE_MS */
 
 /* Constants */
 #define COLORS_CNT 11
 #define MODES_CNT 7
 #define RAINBOW_CNT 10
 #define MAX_BR_SPD_DLY 100
+#define MAX_UNIVERSE 63999
+#define MAX_CHANNEL 512
+#define MAX_PORT 65535
 #define SPD_DEFAULT 81
 #define DLY_DEFAULT 10
+#define OPENRGB_PORT 6742 /* of the OpenRGB SDK server */
+#define MAX_MICROS 8 /* driven by one daemon */
+#define MAX_KEEPALIVE 600000 /* ms */
 
 enum hexcolors {
     red = 0xf20000,
@@ -53,19 +60,41 @@ enum arg_exitcodes { success, argerr }; /* exitcodes */
 
 enum diode_group { all, upper, lower }; /* state values */
 
+enum stream_formats { stream_off, stream_bin, stream_hex };
+
+enum net_protocols { net_off, net_e131, net_ddp };
+
 /* Messages */
 #ifndef VERSION
 #define VERSION "unknown"
 #endif
 #define VERSION_MESSAGE "quadcastrgb version " VERSION
-#define HELP_MESSAGE _("Usage: quadcastrgb [-h] [-v] [-a|-u|-l] [-b bright] "\
-                     "[-s speed] mode [COLORS]...\nAvailable modes: "\
+#define HELP_MESSAGE _("Usage: quadcastrgb [-h] [-v] [--realtime] [--cpu N] "\
+                     "[--shm] [--bulk] [--persist]\n"\
+                     "                   [--keepalive MS] [-a|-u|-l] "\
+                     "[-b bright] [-s speed]\n"\
+                     "                   mode [COLORS]...\n"\
+                     "                   [--device all|BUS-PORT|SERIAL "\
+                     "[mode [COLORS]...]]...\n"\
+                     "       quadcastrgb [--latest] stream [bin|hex]\n"\
+                     "       quadcastrgb --e131 UNIVERSE|--ddp [--channel N] "\
+                     "[--pixels 1|2|6]\n"\
+                     "                   [--port N] [mode [COLORS]...]\n"\
+                     "       quadcastrgb --openrgb [PORT] [mode [COLORS]...]\n"\
+                     "       quadcastrgb --bench-jitter [--cpu N]\n"\
+                     "       quadcastrgb --bench-startup [--device SEL]... "\
+                     "mode [COLORS]...\n"\
+                     "       quadcastrgb --calibrate [--device SEL]...\n"\
+                     "Available modes: "\
                      "solid, blink, cycle, lightning, wave. Colors are hex "\
                      "numbers.\nSee 'man quadcastrgb' for details.")
 #define BADARG_MSG   _("Unknown option: %s\n")
 #define NOPARAM_LONG_MSG _("%s: no parameter(s) specified\n")
 #define NOPARAM_SHORT_MSG _("%s: no parameter or it isn't a natural number\n")
 #define BS_BADPARAM_MSG _("%s: the parameter must be an integer 0-100\n")
+#define RANGE_MSG _("%s: the parameter must be %d-%d\n")
+#define PIXELS_MSG _("--pixels: the parameter must be 1, 2 or 6\n")
+#define DEVICES_MSG _("--device: at most %d microphones\n")
 #define NOMODE_MSG _("No mode specified (solid|blink|cycle|lightning|wave)\n")
 
 /* Structs */
@@ -82,8 +111,35 @@ struct colschemes {
     struct colscheme lower; /* for the lower diodes */
 };
 
+/* Options that don't describe colors */
+struct runopts {
+    int verbose;
+    int realtime; /* low-jitter scheduling for the display loop */
+    int cpu; /* the CPU to pin the display loop to, -1 for any */
+    int bench_jitter; /* measure wakeup lateness instead of displaying */
+    int bench_startup; /* time the way to the first frame, then exit */
+    int calibrate; /* find how fast each QuadCast 2S keeps up, then exit */
+    int shm; /* show frames of the shared-memory ring when there are any */
+    int bulk; /* upload animations to QuadCast S in whole packets */
+    int persist; /* leave animations to the microphones that can loop them */
+    int keepalive; /* ms before a QuadCast 2S frame that stays is resent */
+    int stream; /* stream_off or the format of frames read from stdin */
+    int latest; /* streaming drops the frames the device can't keep up with */
+    int net; /* net_off or the protocol of the UDP receiver */
+    int universe; /* E1.31 universe to take */
+    int channel; /* the first channel of the pixels, from 1 */
+    int pixels; /* RGB pixels taken from the channels: 1, 2 or 6 */
+    int port; /* 0 for the protocol's own */
+    int openrgb; /* TCP port of the OpenRGB SDK server, 0 for none */
+    int dev_cnt; /* microphones chosen, 0 for the first one found */
+    const char *devices[MAX_MICROS]; /* "all", bus-port paths or serials */
+};
+
 /* Functions */
-struct colschemes *parse_arg(int argc, const char **argv, int *verbose);
+/* Returns dev_cnt+1 schemes: the shared one, then one per --device, whose
+ * mode is NULL if the device mirrors the shared scheme */
+struct colschemes *parse_arg(int argc, const char **argv,
+                             struct runopts *opts);
 int strequ(const char *str1, const char *str2);
 
 #endif
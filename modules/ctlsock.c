@@ -0,0 +1,458 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File ctlsock.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "ctlsock.h"
+#include <sys/stat.h> /* for chmod */
+#include <errno.h>
+
+static int ctl_path(struct sockaddr_un *addr);
+static struct ctl_client *find_client(struct ctl_server *srv, int fd);
+static int split_args(char *buf, int len, const char **argv);
+static int start_compiler(struct ctl_client *c, int argc, const char **argv);
+static void compile_child(int cfd, int out, int argc, const char **argv);
+static int applies_live(const struct runopts *opts);
+static datpack *take_result(struct ctl_client *c, int wstatus, int *pck_cnt,
+                            int *status);
+static void finish_client(struct ctl_client *c, int status);
+static int read_reply(int fd);
+static void reply_status(int cfd, int status);
+
+/* Returns 0, or -1 if another instance is listening already or the
+ * socket couldn't be created */
+int ctl_listen(struct ctl_server *srv)
+{
+    struct sockaddr_un addr;
+    int i;
+    srv->fd = -1;
+    srv->arrived = 0;
+    for(i = 0; i < CTL_MAX_CLIENTS; i++) {
+        srv->clients[i].fd = srv->clients[i].out = -1;
+        srv->clients[i].pid = 0;
+    }
+    if(ctl_path(&addr))
+        return -1;
+    srv->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(srv->fd < 0)
+        return -1;
+    if(bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        /* A socket left behind by a killed instance */
+        if(errno != EADDRINUSE || connect(srv->fd, (struct sockaddr *)&addr,
+                                          sizeof(addr)) == 0 ||
+           unlink(addr.sun_path) ||
+           bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+            close(srv->fd);
+            srv->fd = -1;
+            return -1;
+        }
+    }
+    chmod(addr.sun_path, 0600);
+    if(listen(srv->fd, CTL_MAX_CLIENTS)) {
+        ctl_close(srv);
+        return -1;
+    }
+    fcntl(srv->fd, F_SETFL, fcntl(srv->fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+/* The loop is over: compilers still running are of no use anymore */
+void ctl_close(struct ctl_server *srv)
+{
+    struct sockaddr_un addr;
+    struct ctl_client *c;
+    if(srv->fd < 0)
+        return;
+    for(c = srv->clients; c < srv->clients+CTL_MAX_CLIENTS; c++) {
+        if(c->out >= 0)
+            close(c->out);
+        if(c->pid > 0) {
+            kill(c->pid, SIGKILL);
+            waitpid(c->pid, NULL, 0);
+        }
+        if(c->fd >= 0)
+            close(c->fd);
+        c->fd = c->out = -1;
+        c->pid = 0;
+    }
+    close(srv->fd);
+    srv->fd = -1;
+    if(!ctl_path(&addr))
+        unlink(addr.sun_path);
+}
+
+/* Returns the socket of the new client, or -1 if there is none or no
+ * room for it */
+int ctl_accept(struct ctl_server *srv)
+{
+    struct ctl_client *c;
+    int fd;
+    fd = accept(srv->fd, NULL, NULL);
+    if(fd < 0)
+        return -1;
+    c = find_client(srv, -1);
+    if(!c) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    c->fd = fd;
+    c->out = -1;
+    c->pid = 0;
+    c->len = 0;
+    c->serial = ++srv->arrived;
+    c->deadline_ns = frame_clock_now_ns() + CTL_TIMEOUT*NSEC_PER_MSEC;
+    return fd;
+}
+
+/* Takes what the client has sent of its request. Returns 0 while more
+ * is to come, or -1 once it's all there or the client is gone: the loop
+ * stops watching the socket, then ctl_compile takes over */
+int ctl_read(struct ctl_server *srv, int fd)
+{
+    struct ctl_client *c;
+    ssize_t got;
+    c = find_client(srv, fd);
+    if(!c || c->fd != fd || c->pid)
+        return -1;
+    while(c->len < CTL_MAX_REQUEST) {
+        got = read(fd, c->buf+c->len, CTL_MAX_REQUEST - c->len);
+        if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            break;
+        c->len += got;
+    }
+    return -1;
+}
+
+/* Starts compiling the request. Returns the compiler's pipe to watch, or
+ * -1 if the client got its reply already */
+int ctl_compile(struct ctl_server *srv, int fd)
+{
+    const char *argv[CTL_MAX_ARGS+1];
+    struct ctl_client *c;
+    int argc;
+    c = find_client(srv, fd);
+    if(!c || c->fd != fd || c->pid)
+        return -1;
+    argc = split_args((char *)c->buf, c->len, argv);
+    if(argc < 0) {
+        write(fd, CTL_BADREQ_MSG, strlen(CTL_BADREQ_MSG));
+        finish_client(c, argerr);
+        return -1;
+    }
+    if(start_compiler(c, argc, argv)) {
+        finish_client(c, argerr);
+        return -1;
+    }
+    return c->out;
+}
+
+/* Takes what the compiler has sent. Returns 0 while more is to come, or
+ * -1 at the end of it: once the loop stops watching the pipe, ctl_reap
+ * tells how it went */
+int ctl_collect(struct ctl_server *srv, int out)
+{
+    struct ctl_client *c;
+    ssize_t got;
+    c = find_client(srv, out);
+    if(!c || c->out != out || c->collected)
+        return -1;
+    while(c->len < (int)CTL_RESULT_SIZE) {
+        got = read(out, c->buf+c->len, CTL_RESULT_SIZE - c->len);
+        if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0)
+            break;
+        c->len += got;
+    }
+    c->collected = 1;
+    return -1;
+}
+
+/* Replies to the clients whose compilers are done; a compiler is reaped
+ * only once its pipe is read to the end. Returns the packets of the
+ * newest request among them that compiled, or NULL */
+datpack *ctl_reap(struct ctl_server *srv, int *pck_cnt)
+{
+    struct ctl_client *c;
+    datpack *data_arr = NULL, *compiled;
+    unsigned long newest = 0;
+    int cnt, wstatus, status;
+    pid_t res;
+    for(c = srv->clients; c < srv->clients+CTL_MAX_CLIENTS; c++) {
+        if(c->fd < 0 || c->pid <= 0 || (c->out >= 0 && !c->collected))
+            continue;
+        res = waitpid(c->pid, &wstatus, WNOHANG);
+        if(res == 0 || (res < 0 && errno == EINTR))
+            continue;
+        if(res < 0) /* reaped by someone else, the status is lost */
+            wstatus = argerr << 8;
+        compiled = take_result(c, wstatus, &cnt, &status);
+        if(compiled && c->serial > newest) {
+            free(data_arr);
+            data_arr = compiled;
+            *pck_cnt = cnt;
+            newest = c->serial;
+        } else {
+            free(compiled);
+        }
+        finish_client(c, status);
+    }
+    return data_arr;
+}
+
+/* Returns the socket of a client which hasn't sent its request in time,
+ * or -1. It's for ctl_drop once the loop stops watching it */
+int ctl_expired(struct ctl_server *srv, long long now_ns)
+{
+    struct ctl_client *c;
+    for(c = srv->clients; c < srv->clients+CTL_MAX_CLIENTS; c++)
+        if(c->fd >= 0 && !c->pid && now_ns >= c->deadline_ns)
+            return c->fd;
+    return -1;
+}
+
+/* Gives up on the request the descriptor belongs to, one the loop
+ * doesn't watch: the socket of a client still sending it, or the pipe of
+ * its compiler. In the latter case the client gets its reply once
+ * ctl_reap finds the compiler done */
+void ctl_drop(struct ctl_server *srv, int fd)
+{
+    struct ctl_client *c = find_client(srv, fd);
+    if(!c)
+        return;
+    if(c->out == fd) {
+        close(c->out);
+        c->out = -1;
+        c->len = -1; /* the result is lost */
+    } else if(!c->pid) {
+        write(c->fd, CTL_BADREQ_MSG, strlen(CTL_BADREQ_MSG));
+        finish_client(c, argerr);
+    }
+}
+
+/* Returns the exit code of the request or -1 if nobody listens */
+int ctl_forward(int argc, const char **argv)
+{
+    struct sockaddr_un addr;
+    int fd, i, status;
+    if(ctl_path(&addr))
+        return -1;
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+        return -1;
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    for(i = 1; i < argc; i++)
+        write(fd, argv[i], strlen(argv[i])+1);
+    shutdown(fd, SHUT_WR);
+    status = read_reply(fd);
+    close(fd);
+    return status;
+}
+/* Copies the reply to stdout line by line. The last line is held back
+ * since it's the status */
+static int read_reply(int fd)
+{
+    char line[CTL_LINE_LEN+1], buf[256];
+    int len = 0, held = 0, status = argerr;
+    ssize_t got, i;
+    while((got = read(fd, buf, sizeof(buf))) > 0) {
+        for(i = 0; i < got; i++) {
+            if(held) { /* not the last line after all */
+                fwrite(line, 1, len, stdout);
+                len = held = 0;
+            }
+            if(len == CTL_LINE_LEN) {
+                fwrite(line, 1, len, stdout);
+                len = 0;
+            }
+            line[len++] = buf[i];
+            held = (buf[i] == '\n');
+        }
+    }
+    line[len] = 0;
+    if(sscanf(line, CTL_STATUS_FMT, &status) != 1)
+        fputs(line, stdout);
+    fflush(stdout);
+    return status;
+}
+
+/* $XDG_RUNTIME_DIR is private to the user, /tmp is the fallback */
+static int ctl_path(struct sockaddr_un *addr)
+{
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    int len;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(dir && *dir)
+        len = snprintf(addr->sun_path, sizeof(addr->sun_path), "%s/%s",
+                       dir, CTL_SOCKNAME);
+    else
+        len = snprintf(addr->sun_path, sizeof(addr->sun_path), "/tmp/%d-%s",
+                       (int)getuid(), CTL_SOCKNAME);
+    return (len < 0 || len >= (int)sizeof(addr->sun_path)) ? -1 : 0;
+}
+
+/* The arguments are NUL-terminated strings, argv[0] is implied */
+static int split_args(char *buf, int len, const char **argv)
+{
+    int argc = 1;
+    char *p;
+    if(len == 0 || len >= CTL_MAX_REQUEST || buf[len-1] != 0)
+        return -1;
+    argv[0] = "quadcastrgb";
+    for(p = buf; p < buf+len; p += strlen(p)+1) {
+        if(argc >= CTL_MAX_ARGS)
+            return -1;
+        argv[argc++] = p;
+    }
+    argv[argc] = NULL;
+    return argc;
+}
+
+/* By the socket or the compiler's pipe; -1 finds a free slot */
+static struct ctl_client *find_client(struct ctl_server *srv, int fd)
+{
+    struct ctl_client *c;
+    for(c = srv->clients; c < srv->clients+CTL_MAX_CLIENTS; c++)
+        if(c->fd == fd || (fd >= 0 && c->out == fd))
+            return c;
+    return NULL;
+}
+
+/* parse_arg and parse_colorscheme end the process on errors, so they
+ * run in a child which talks to the client directly. The packets come
+ * back through a pipe, read as they come */
+static int start_compiler(struct ctl_client *c, int argc, const char **argv)
+{
+    int pfd[2];
+    pid_t pid;
+    if(pipe(pfd))
+        return -1;
+    fflush(NULL); /* or the child flushes the buffers a second time */
+    pid = fork();
+    if(pid == 0) {
+        close(pfd[0]);
+        compile_child(c->fd, pfd[1], argc, argv);
+    }
+    close(pfd[1]);
+    if(pid < 0) {
+        close(pfd[0]);
+        return -1;
+    }
+    fcntl(pfd[0], F_SETFL, fcntl(pfd[0], F_GETFL) | O_NONBLOCK);
+    c->out = pfd[0];
+    c->collected = 0;
+    c->pid = pid;
+    c->len = 0;
+    return 0;
+}
+
+static void compile_child(int cfd, int out, int argc, const char **argv)
+{
+    struct colschemes *cs;
+    struct runopts opts;
+    datpack *data_arr;
+    int pck_cnt;
+    /* The messages may be long, the child has the time to wait */
+    fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) & ~O_NONBLOCK);
+    dup2(cfd, 1);
+    dup2(cfd, 2);
+    cs = parse_arg(argc, argv, &opts); /* exits on errors & --help */
+    if(!applies_live(&opts)) {
+        fputs(CTL_NOTLIVE_MSG, stderr);
+        exit(argerr);
+    }
+    /* Live changes apply to every microphone */
+    data_arr = parse_colorscheme(cs, &pck_cnt);
+    write(out, &pck_cnt, sizeof(pck_cnt));
+    write(out, data_arr, pck_cnt*sizeof(datpack));
+    fflush(NULL);
+    _exit(success); /* don't run the parent's atexit handlers */
+}
+
+/* The running instance takes a new shared scheme and nothing else: the
+ * other options and the devices are settled when it starts */
+static int applies_live(const struct runopts *opts)
+{
+    return !opts->realtime && opts->cpu < 0 && !opts->bench_jitter &&
+           !opts->bench_startup && !opts->calibrate && !opts->shm &&
+           !opts->bulk && !opts->persist &&
+           opts->keepalive == QC2S_KEEPALIVE_MS && !opts->stream &&
+           !opts->latest && !opts->net && opts->channel == 1 &&
+           opts->pixels == 6 && !opts->port && !opts->openrgb &&
+           !opts->dev_cnt;
+}
+
+/* The packets of a compiler which exited; NULL with the status set if
+ * there are none */
+static datpack *take_result(struct ctl_client *c, int wstatus, int *pck_cnt,
+                            int *status)
+{
+    datpack *data_arr;
+    *status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : argerr;
+    if(c->len < 0)
+        *status = argerr;
+    if(*status != success || c->len < (int)sizeof(int))
+        return NULL; /* --help & the like compile nothing */
+    memcpy(pck_cnt, c->buf, sizeof(int));
+    if(*pck_cnt < 1 || *pck_cnt > MAX_PCT_COUNT ||
+       c->len != (int)(sizeof(int) + *pck_cnt*sizeof(datpack))) {
+        *status = argerr;
+        return NULL;
+    }
+    data_arr = malloc(*pck_cnt*sizeof(datpack));
+    if(!data_arr) {
+        write(c->fd, CTL_NOMEM_MSG, strlen(CTL_NOMEM_MSG));
+        *status = argerr;
+        return NULL;
+    }
+    memcpy(data_arr, c->buf+sizeof(int), *pck_cnt*sizeof(datpack));
+    return data_arr;
+}
+
+static void finish_client(struct ctl_client *c, int status)
+{
+    reply_status(c->fd, status);
+    close(c->fd);
+    if(c->out >= 0)
+        close(c->out);
+    c->fd = c->out = -1;
+    c->pid = 0;
+}
+
+static void reply_status(int cfd, int status)
+{
+    char line[32];
+    int len = snprintf(line, sizeof(line), CTL_STATUS_FMT, status);
+    write(cfd, line, len);
+}
@@ -0,0 +1,102 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File ctlsock.h
+ * Control socket of the daemon.
+ * A running daemon listens on a Unix domain socket for the same arguments
+ * the command line takes. The arguments are compiled into data packets by
+ * a short-lived child, so that a bad request can't end the daemon, and the
+ * new packets replace the animation at the next frame. A second instance
+ * of the program forwards its arguments there instead of reopening the
+ * microphone.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef CTLSOCK_SENTRY
+#define CTLSOCK_SENTRY
+
+#include <stdio.h> /* for snprintf */
+#include <stdlib.h> /* for getenv */
+#include <unistd.h>
+#include <fcntl.h> /* for O_NONBLOCK */
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h> /* for waitpid */
+#include <signal.h> /* for kill */
+#include "locale_macros.h"
+#include "argparser.h" /* for parse_arg */
+#include "rgbmodes.h" /* for parse_colorscheme & datpack */
+#include "frameclock.h" /* for the deadlines of requests */
+
+/* Constants */
+#define CTL_SOCKNAME "quadcastrgb.sock"
+#define CTL_MAX_REQUEST 4096 /* bytes of NUL-separated arguments */
+#define CTL_MAX_ARGS 64
+#define CTL_TIMEOUT 200 /* ms for a client to send the request */
+#define CTL_LINE_LEN 256 /* of replies; longer ones are split */
+#define CTL_STATUS_FMT "status %d\n" /* the last line of every reply */
+#define CTL_MAX_CLIENTS 4
+/* What the compiler sends back: the count of packets, then the packets */
+#define CTL_RESULT_SIZE (sizeof(int) + MAX_PCT_COUNT*sizeof(datpack))
+
+/* Messages */
+#define CTL_FORWARD_MSG _("Forwarded to the running instance.")
+#define CTL_BADREQ_MSG _("Malformed request.\n")
+#define CTL_NOTLIVE_MSG _("The running instance only takes a new color " \
+                        "scheme; stop it to change the other options " \
+                        "or the devices.\n")
+#define CTL_NOMEM_MSG _("Not enough memory for the new animation.\n")
+
+/* Structs */
+/* A request goes through the slot in steps, each one waiting on a
+ * descriptor of the event loop: the arguments come from the client's
+ * socket, the packets from the compiler's pipe, then the compiler is
+ * reaped and the client gets its status */
+struct ctl_client {
+    int fd; /* -1 for a free slot */
+    int out; /* the read end of the compiler's pipe, -1 when not read */
+    int collected; /* the compiler has sent all there is */
+    pid_t pid; /* of the compiler, 0 until it runs */
+    unsigned long serial; /* of arrival, the newest request wins */
+    long long deadline_ns; /* for the request to be sent */
+    int len; /* of the request, then of the result; -1 if it's lost */
+    byte_t buf[CTL_RESULT_SIZE]; /* the request, then the result */
+};
+
+struct ctl_server {
+    int fd; /* -1 when not listening */
+    unsigned long arrived; /* clients so far */
+    struct ctl_client clients[CTL_MAX_CLIENTS];
+};
+
+/* Functions */
+int ctl_listen(struct ctl_server *srv);
+void ctl_close(struct ctl_server *srv);
+int ctl_accept(struct ctl_server *srv);
+int ctl_read(struct ctl_server *srv, int fd);
+int ctl_compile(struct ctl_server *srv, int fd);
+int ctl_collect(struct ctl_server *srv, int out);
+datpack *ctl_reap(struct ctl_server *srv, int *pck_cnt);
+int ctl_expired(struct ctl_server *srv, long long now_ns);
+void ctl_drop(struct ctl_server *srv, int fd);
+int ctl_forward(int argc, const char **argv);
+
+#endif
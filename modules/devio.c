@@ -24,15 +24,16 @@
  * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
  */
 #include "devio.h"
-#ifdef USE_HIDAPI
-#include "qc2s_bridge.h"
-#endif
 
-/* For open_micro */
+/* For open_micros */
+#define FREE_ARRS() \
+    for(i = 0; i <= opts->dev_cnt; i++) \
+        free(data_arrs[i])
+
 #define FREE_AND_EXIT() \
     if(devs) libusb_free_device_list(devs, 1); \
-    free(data_arr); \
-    libusb_exit(NULL); \
+    close_micros(micros, opened); \
+    FREE_ARRS(); \
     exit(libusberr)
 
 #define HANDLE_ERR(CONDITION, MSG) \
@@ -40,451 +41,1274 @@
         fprintf(stderr, MSG); \
         FREE_AND_EXIT(); \
     }
+
+/* Frames of the stream mode */
+struct stream_state {
+    int on;
+    int latest; /* drop frames instead of blocking the producer */
+    int ready; /* next holds a frame not shown yet */
+    int eof;
+    int fd_flags; /* of stdin before it was made non-blocking */
+    struct frame_stream in;
+    struct ring_frame next;
+    unsigned long shown;
+    unsigned long dropped;
+    long long first_ns, last_ns; /* times of the first & last shown frame */
+};
+
+/* Microphones lost and taken back */
+struct reconnect_stats {
+    unsigned long lost;
+    unsigned long reconnected;
+    unsigned long recovered; /* without being lost */
+    long long total_ns, max_ns; /* from the return to the first frame */
+};
+
+/* Everything the event handlers of the display loop need */
+struct display_state {
+    struct micro *micros;
+    int micro_cnt;
+    int on; /* microphones not given up on */
+    int slots; /* ticks per color command */
+    const datpack *data_arr; /* shared by the microphones without their own */
+    short command_cnt;
+    unsigned long first_tick; /* of the current animation */
+    datpack *owned; /* data_arr if it came through the control socket */
+    datpack *pending; /* replaces data_arr at the next frame */
+    int pending_cnt;
+    int qc2s; /* a QuadCast 2S is among them, the reports are built */
+    struct frame_reports reports; /* of data_arr */
+    struct frame_reports pending_reports;
+    struct frame_reports own_reports[MAX_MICROS]; /* of their animations */
+    struct frame_ring ring; /* shm is NULL without --shm */
+    struct ring_frame frame; /* the newest one from the ring or stdin */
+    int ring_live; /* the frame is recent enough to be shown */
+    struct net_receiver net; /* fd is -1 without --e131 & --ddp */
+    struct ring_frame net_frame; /* the newest one received */
+    int net_ready; /* net_frame isn't shown yet */
+    struct orgb_server orgb; /* fd is -1 without --openrgb */
+    struct ctl_server ctl; /* fd is -1 when not listening */
+    struct stream_state stream;
+    int hotplug_on; /* lost microphones are waited for */
+    libusb_hotplug_callback_handle hotplug;
+    libusb_device *arrived[MAX_MICROS]; /* referenced, taken at the tick */
+    long long arrived_ns[MAX_MICROS];
+    int arrived_cnt;
+    struct reconnect_stats reconnect;
+    int from_frame; /* the tick shows ds->frame instead of the animation */
+    int bulk; /* animations are uploaded to the models that can play them */
+    struct frame_clock clock; /* the time base of the animations */
+    long long send_ns[MAX_MICROS]; /* of the next send of each microphone */
+    unsigned long sends[MAX_MICROS]; /* its steps, a group each for QC2S */
+    struct evloop loop;
+};
+
 /* Microphone opening */
-static int claim_dev_interface(libusb_device_handle *handle);
+static int open_one(struct micro *m, libusb_device *dev,
+                    const struct micro *opened, int opened_cnt,
+                    long long *claim_ns);
 static libusb_device *dev_search(libusb_device **devs, ssize_t cnt);
-static int is_micro(libusb_device *dev);
-/* Packet transfer */
-static short send_display_command(byte_t *packet,
-                                  libusb_device_handle *handle);
-static short send_qc2s_report(const byte_t *packet,
-                              libusb_device_handle *handle);
-static void qc2s_read_ack(libusb_device_handle *handle);
-static void display_data_arr(libusb_device_handle *handle,
-                             const byte_t *colcommand, const byte_t *end);
-static void display_qc2s_data_arr(libusb_device_handle *handle,
-                                  const byte_t *colcommand,
-                                  const byte_t *end);
-static void get_group_colors(const byte_t *colcommand, byte_t *upper,
-                             byte_t *lower);
-static void write_qc2s_color_packet(byte_t group, const byte_t *rgb,
-                                    byte_t *packet);
+static int select_micros(libusb_device **devs, ssize_t cnt, const char *sel,
+                         int sel_scheme, libusb_device **found, int *scheme,
+                         int *found_cnt);
+static void micro_where(libusb_device *dev, char *where);
+static int serial_is(libusb_device *dev, const char *serial);
+static const struct micro_caps *micro_caps(libusb_device *dev);
+static unsigned short micro_firmware(libusb_device *dev);
+/* Display loop */
+static void next_tick(struct display_state *ds);
+static int show_frame(struct display_state *ds);
+static int show_micro(struct display_state *ds, struct micro *m,
+                      unsigned long step, long long next_ns);
+static int frame_starts(const struct display_state *ds, unsigned long step);
+static unsigned long ticks_due(const struct frame_clock *fc);
+static void retime_display(struct display_state *ds);
+static void arm_timer(struct display_state *ds);
+static void micro_sent(struct display_state *ds, struct micro *m);
+static void micro_failed(struct display_state *ds, struct micro *m, int res);
+static int recover_micro(struct micro *m);
+static void lose_micro(struct display_state *ds, struct micro *m);
+static void take_arrivals(struct display_state *ds);
+static int reopen_micro(struct micro *m, libusb_device *dev);
+static int replaces(const struct micro *m, libusb_device *dev);
+static void watch_hotplug(struct display_state *ds);
+static void unwatch_hotplug(struct display_state *ds);
+static int LIBUSB_CALL usb_hotplug(libusb_context *ctx, libusb_device *dev,
+                                   libusb_hotplug_event event, void *data);
+static void next_frame(unsigned long expirations, void *data);
+static void handle_signal(int signo, void *data);
+static void accept_control(int fd, short revents, void *data);
+static void read_control(int fd, short revents, void *data);
+static void collect_control(int fd, short revents, void *data);
+static void reap_control(struct display_state *ds);
+static void expire_control(struct display_state *ds);
+static void swap_animation(struct display_state *ds);
+static void build_reports(struct display_state *ds);
+static void free_reports(struct display_state *ds);
+static void watch_usb_events(struct evloop *loop);
+static void handle_usb_events(int fd, short revents, void *data);
+static void usb_pollfd_added(int fd, short events, void *data);
+static void usb_pollfd_removed(int fd, void *data);
+#ifdef __linux__
+static void watch_hidraw(struct display_state *ds);
+static void read_hidraw_acks(int fd, short revents, void *data);
+static void hidraw_added(int fd, void *data);
+static void hidraw_removed(int fd, void *data);
+#endif
+static unsigned int transfer_timeout(long long next_ns);
+static void print_frame_stats(const struct frame_stats *st);
+static int live_frame_due(struct display_state *ds);
+static void receive_net(int fd, short revents, void *data);
+static void print_net_stats(const struct net_receiver *nr);
+static void accept_openrgb(int fd, short revents, void *data);
+static void serve_openrgb(int fd, short revents, void *data);
+static void start_stream(struct display_state *ds, const struct runopts *opts);
+static void stop_stream(struct display_state *ds);
+static void read_stream(int fd, short revents, void *data);
+static void take_stream_frames(struct display_state *ds);
+static int stream_frame_due(struct display_state *ds);
 #if !defined(DEBUG) && !defined(OS_MAC)
 static void daemonize(int verbose);
-#endif
-#ifdef DEBUG
-static void print_packet(const byte_t *pck, const char *str);
+static void restart_usb(struct micro *micros, int micro_cnt);
 #endif
 
-/* Signal handling */
-volatile static sig_atomic_t nonstop = 0; /* BE CAREFUL: GLOBAL VARIABLE */
-static int qc2s_controller = 0;
-static byte_t qc2s_ep_out = QC2S_INTR_EP_OUT;
-static byte_t qc2s_ep_in = QC2S_INTR_EP_IN;
-static int qc2s_init_sent = 0;
-#ifdef USE_HIDAPI
-static qc2s_ctx *qc2s_bridge_ctx = NULL;
-#endif
-static void nonstop_reset_handler(int s)
-{
-    /* No need in saving errno or setting the handler again
-     * because the program just frees memory and exits */
-    (void)s;
-    nonstop = 0;
-}
-
 /* Functions */
-libusb_device_handle *open_micro(datpack *data_arr)
+/* Opens the microphones chosen with --device, or the first one found. On
+ * errors the animations are freed: the shared one, then those of devices */
+int open_micros(struct micro *micros, const struct runopts *opts,
+                datpack **data_arrs, const int *pck_cnts,
+                struct startup_times *times)
 {
     libusb_device **devs = NULL;
-    libusb_device *micro_dev = NULL;
-    libusb_device_handle *handle;
-    struct libusb_device_descriptor descr;
+    libusb_device *found[MAX_MICROS];
+    int scheme[MAX_MICROS]; /* of each found microphone, 0 is the shared */
     ssize_t dev_count;
+    int i, sel, matched, cnt = 0, opened = 0;
+    long long start = frame_clock_now_ns();
     short errcode;
+    times->claim_ns = 0;
     errcode = libusb_init(NULL);
     if(errcode) {
         perror("libusb_init");
-        free(data_arr); exit(libusberr);
+        FREE_ARRS(); exit(libusberr);
     }
     dev_count = libusb_get_device_list(NULL, &devs);
     HANDLE_ERR(dev_count < 0, DEVLIST_ERR_MSG);
-    micro_dev = dev_search(devs, dev_count);
-    HANDLE_ERR(!micro_dev, NODEV_ERR_MSG);
-    libusb_get_device_descriptor(micro_dev, &descr);
-    qc2s_controller = (descr.idVendor == DEV_VID_EU &&
-                       descr.idProduct == DEV_PID_NA3);
-    qc2s_init_sent = 0;
-#ifdef DEBUG
-    fprintf(stderr, "Selected USB device: %04x:%04x\n",
-            descr.idVendor, descr.idProduct);
-#endif
-
-#ifdef USE_HIDAPI
-    if(qc2s_controller) {
-        qc2s_bridge_ctx = qc2s_open();
-        if(!qc2s_bridge_ctx) {
-            fprintf(stderr, "hidapi: couldn't open QC2S interface 1\n");
+    if(!opts->dev_cnt) {
+        found[0] = dev_search(devs, dev_count);
+        HANDLE_ERR(!found[0], NODEV_ERR_MSG);
+        scheme[0] = 0;
+        cnt = 1;
+    }
+    for(sel = 0; sel < opts->dev_cnt; sel++) {
+        matched = select_micros(devs, dev_count, opts->devices[sel],
+                                data_arrs[sel+1] ? sel+1 : 0, found, scheme,
+                                &cnt);
+        if(matched < 0) {
+            fprintf(stderr, MANY_ERR_MSG, MAX_MICROS);
+            FREE_AND_EXIT();
+        }
+        if(!matched) {
+            fprintf(stderr, NOSEL_ERR_MSG, opts->devices[sel]);
             FREE_AND_EXIT();
         }
-        libusb_free_device_list(devs, 1);
-        return NULL; /* no libusb handle needed for QC2S on macOS */
-    }
-#endif
-
-    errcode = libusb_open(micro_dev, &handle);
-    if(errcode) {
-        fprintf(stderr, "%s\n%s", libusb_strerror(errcode), OPEN_ERR_MSG);
-        FREE_AND_EXIT();
     }
-    errcode = claim_dev_interface(handle);
-    if(errcode) {
-        libusb_close(handle); FREE_AND_EXIT();
+    for(opened = 0; opened < cnt; opened++) {
+        if(open_one(micros+opened, found[opened], micros, opened,
+                    &times->claim_ns)) {
+            FREE_AND_EXIT();
+        }
+        micros[opened].any = !opts->dev_cnt;
+        micros[opened].keepalive = opts->keepalive;
+        if(scheme[opened]) {
+            micros[opened].data_arr = data_arrs[scheme[opened]];
+            micros[opened].command_cnt =
+                count_color_commands(data_arrs[scheme[opened]],
+                                     pck_cnts[scheme[opened]], 0);
+        }
     }
     libusb_free_device_list(devs, 1);
-    return handle;
+    times->open_ns = frame_clock_now_ns() - start - times->claim_ns;
+    return cnt;
 }
 
-static int claim_dev_interface(libusb_device_handle *handle)
+/* Returns 1 on errors, which are reported already */
+static int open_one(struct micro *m, libusb_device *dev,
+                    const struct micro *opened, int opened_cnt,
+                    long long *claim_ns)
 {
-    int i, errs[3];
-    libusb_set_auto_detach_kernel_driver(handle, 1); /* might be unsupported */
-    for(i = 0; i < 3; i++)
-        errs[i] = libusb_claim_interface(handle, i);
-#ifdef DEBUG
-    fprintf(stderr, "claim if0=%d if1=%d if2=%d\n",
-            errs[0], errs[1], errs[2]);
-#endif
-    for(i = 0; i < 3; i++) {
-        if(errs[i] == LIBUSB_ERROR_ACCESS) {
+    memset(m, 0, sizeof(*m));
+    m->caps = micro_caps(dev);
+    m->firmware = micro_firmware(dev);
+    micro_where(dev, m->where);
 #ifdef DEBUG
-            fprintf(stderr, "claim: ACCESS denied (kernel HID driver), "
-                    "continuing anyway\n");
+    fprintf(stderr, "Selected USB device: %04x:%04x (%s) at %s\n",
+            m->caps->vid, m->caps->pid, m->caps->name, m->where);
 #endif
-            return 0; /* macOS kernel owns HID — use hidapi instead */
-        }
-        if(errs[i] == LIBUSB_ERROR_BUSY) {
-            fprintf(stderr, BUSY_ERR_MSG);
-            return 1;
-        }
-        if(errs[i] == LIBUSB_ERROR_NO_DEVICE) {
-            fprintf(stderr, OPEN_ERR_MSG);
+    /* Such a transport opens the first device it finds */
+    for(; m->caps->transport->single && opened_cnt > 0;
+        opened_cnt--, opened++) {
+        if(opened->caps->transport == m->caps->transport) {
+            fprintf(stderr, BRIDGE_ONE_MSG);
             return 1;
         }
     }
-    return 0;
+    return m->caps->transport->open(m, dev, claim_ns);
 }
 
 static libusb_device *dev_search(libusb_device **devs, ssize_t cnt)
 {
     libusb_device *fallback = NULL;
     libusb_device **dev;
-    struct libusb_device_descriptor descr;
+    const struct micro_caps *caps;
     for(dev = devs; dev < devs+cnt; dev++) {
-        libusb_get_device_descriptor(*dev, &descr);
+        caps = micro_caps(*dev);
         /* QuadCast 2 S has a dedicated HID controller device. Prefer it. */
-        if(descr.idVendor == DEV_VID_EU && descr.idProduct == DEV_PID_NA3)
+        if(caps && caps->format == report_groups)
             return *dev;
-        if(!fallback && is_micro(*dev))
+        if(!fallback && caps)
             fallback = *dev;
     }
     return fallback;
 }
 
-static int is_micro(libusb_device *dev)
+/* Adds the microphones sel stands for: "all", a bus-port path such as
+ * 1-4.2, or a serial number. Ones found already get the scheme if it is
+ * their own, so "all" may be followed by exceptions. Returns how many
+ * match, -1 if there are too many */
+static int select_micros(libusb_device **devs, ssize_t cnt, const char *sel,
+                         int sel_scheme, libusb_device **found, int *scheme,
+                         int *found_cnt)
+{
+    char where[MICRO_WHERE_LEN];
+    libusb_device **dev;
+    int i, matched = 0;
+    for(dev = devs; dev < devs+cnt; dev++) {
+        if(!micro_caps(*dev))
+            continue;
+        micro_where(*dev, where);
+        if(!strequ(sel, "all") && !strequ(sel, where) &&
+           !serial_is(*dev, sel))
+            continue;
+        matched++;
+        for(i = 0; i < *found_cnt && found[i] != *dev; i++)
+            ;
+        if(i == MAX_MICROS)
+            return -1;
+        if(i == *found_cnt) {
+            found[i] = *dev;
+            scheme[i] = 0;
+            (*found_cnt)++;
+        }
+        if(sel_scheme)
+            scheme[i] = sel_scheme;
+    }
+    return matched;
+}
+
+/* The bus number and the port path, as in /sys/bus/usb/devices */
+static void micro_where(libusb_device *dev, char *where)
+{
+    uint8_t ports[7]; /* the depth limit of USB 3 */
+    int i, cnt, len;
+    len = snprintf(where, MICRO_WHERE_LEN, "%d", libusb_get_bus_number(dev));
+    cnt = libusb_get_port_numbers(dev, ports, sizeof(ports));
+    for(i = 0; i < cnt && len < MICRO_WHERE_LEN; i++)
+        len += snprintf(where+len, MICRO_WHERE_LEN-len, i ? ".%d" : "-%d",
+                        ports[i]);
+}
+
+/* Linux keeps the string in sysfs; elsewhere the device is opened for a
+ * moment to read it, which takes a control transfer */
+static int serial_is(libusb_device *dev, const char *serial)
+{
+    struct libusb_device_descriptor descr;
+    libusb_device_handle *handle;
+    unsigned char buf[SERIAL_LEN];
+    int len;
+#ifdef __linux__
+    char path[sizeof(SYSFS_USB_DEVICES) + MICRO_WHERE_LEN + 8];
+    FILE *f;
+    len = snprintf(path, sizeof(path), SYSFS_USB_DEVICES "/");
+    micro_where(dev, path+len);
+    strcat(path, "/serial");
+    f = fopen(path, "r");
+    if(f) {
+        len = fgets((char *)buf, sizeof(buf), f) ? strlen((char *)buf) : 0;
+        fclose(f);
+        if(len > 0 && buf[len-1] == '\n')
+            buf[--len] = 0;
+        return len > 0 && strequ((char *)buf, serial);
+    }
+#endif
+    libusb_get_device_descriptor(dev, &descr);
+    if(!descr.iSerialNumber || libusb_open(dev, &handle))
+        return 0;
+    len = libusb_get_string_descriptor_ascii(handle, descr.iSerialNumber,
+                                             buf, sizeof(buf));
+    libusb_close(handle);
+    return len > 0 && (size_t)len == strlen(serial) &&
+           !memcmp(buf, serial, len);
+}
+
+/* NULL if it isn't a microphone */
+static const struct micro_caps *micro_caps(libusb_device *dev)
 {
     struct libusb_device_descriptor descr; /* no freeing needed */
     libusb_get_device_descriptor(dev, &descr);
-    if(descr.idVendor == DEV_VID_NA) {
-        if (descr.idProduct == DEV_PID_NA1 ||
-            descr.idProduct == DEV_PID_NA2 ||
-            descr.idProduct == DEV_PID_NA3) {
-              return 1;
+    return find_caps(descr.idVendor, descr.idProduct);
+}
+
+static unsigned short micro_firmware(libusb_device *dev)
+{
+    struct libusb_device_descriptor descr;
+    libusb_get_device_descriptor(dev, &descr);
+    return descr.bcdDevice;
+}
+
+void close_micros(struct micro *micros, int cnt)
+{
+    struct micro *m;
+    for(m = micros; m < micros+cnt; m++)
+        if(m->caps)
+            m->caps->transport->close(m);
+    libusb_exit(NULL);
+}
+
+/* --calibrate: each QuadCast 2S gets groups as fast as its acks allow
+ * for CALIBRATE_FRAMES frames; the period it settles at gives the frame
+ * rate the firmware keeps up with. Others aren't acked, their rate is
+ * fixed */
+void calibrate_micros(struct micro *micros, int micro_cnt)
+{
+    struct frame_clock fc;
+    struct micro *m;
+    long period;
+    int i, res;
+    for(m = micros; m < micros+micro_cnt; m++) {
+        if(m->caps->format != report_groups) {
+            printf(CALIBRATE_FIXED_MSG, m->caps->name, m->where,
+                   1000.0/m->caps->period);
+            continue;
         }
-    } else if(descr.idVendor == DEV_VID_EU) {
-        if(descr.idProduct == DEV_PID_EU1 ||
-           descr.idProduct == DEV_PID_EU2 ||
-           descr.idProduct == DEV_PID_EU3 ||
-           descr.idProduct == DEV_PID_EU4 ||
-           descr.idProduct == DEV_PID_NA3 ||
-           descr.idProduct == DEV_PID_DUOCAST) {
-            return 1;
+        memset(&m->pace, 0, sizeof(m->pace));
+        frame_clock_start(&fc, micro_period(m));
+        for(i = 0; i < CALIBRATE_FRAMES*m->caps->groups; i++) {
+            /* Every frame a shade apart, lest unchanged groups be skipped */
+            if(i % m->caps->groups == 0)
+                memset(m->frame.rgb, CALIBRATE_LEVEL + (i/m->caps->groups & 1),
+                       sizeof(m->frame.rgb));
+            res = m->caps->transport->send(m, i % m->caps->groups, TIMEOUT);
+            if(res == frame_fatal)
+                break;
+            frame_clock_retime(&fc, micro_period(m));
+            frame_clock_wait(&fc);
         }
+        period = micro_period(m);
+        printf(CALIBRATE_MSG, m->caps->name, m->where, m->firmware >> 8,
+               m->firmware & 0xff, 1000.0/(period*m->caps->groups), period,
+               m->pace.rtt_ns/NSEC_PER_USEC, m->pace.acked, m->pace.missed);
     }
-    return 0;
 }
 
-void close_micro(libusb_device_handle *handle)
+/* Every microphone gets its animation to loop alone, or none needs to:
+ * one that can't keep it is streamed to & so are the rest, in phase.
+ * Returns 1 if the host isn't needed anymore */
+int persist_micros(struct micro *micros, int micro_cnt,
+                   const datpack *data_arr, int pck_cnt,
+                   const struct runopts *opts)
 {
-#ifdef USE_HIDAPI
-    if(qc2s_bridge_ctx) {
-        qc2s_close(qc2s_bridge_ctx);
-        qc2s_bridge_ctx = NULL;
-    }
-#endif
-    if(handle) {
-        libusb_release_interface(handle, 0);
-        libusb_release_interface(handle, 1);
-        libusb_close(handle);
+    struct micro *m;
+    short shared_cnt;
+    int i;
+    /* Frames of other programs come through the host */
+    if(opts->stream || opts->shm || opts->net || opts->openrgb ||
+       opts->bench_startup)
+        return 0;
+    shared_cnt = data_arr ? count_color_commands(data_arr, pck_cnt, 0) : 0;
+    for(i = 0; i < micro_cnt; i++) {
+        m = micros+i;
+        if(micro_persist(m, m->data_arr ? m->data_arr : data_arr,
+                         m->data_arr ? m->command_cnt : shared_cnt,
+                         TIMEOUT)) {
+            fprintf(stderr, PERSIST_ERR_MSG, m->where);
+            return 0;
+        }
     }
-    libusb_exit(NULL);
+    return 1;
 }
 
-void send_packets(libusb_device_handle *handle, const datpack *data_arr,
-                  int pck_cnt, int verbose)
+void send_packets(struct micro *micros, int micro_cnt,
+                  const datpack *data_arr, int pck_cnt,
+                  const struct runopts *opts, struct startup_times *times)
 {
-    short command_cnt;
+    /* The compilers of control requests tell when they are done too */
+    static const int signals[] = { SIGINT, SIGTERM, SIGCHLD };
+    struct display_state ds;
+    int i, res, period;
     #ifdef DEBUG
     puts("Entering display mode...");
     #endif
     #if !defined(DEBUG) && !defined(OS_MAC)
-    daemonize(verbose);
+    if(!opts->stream && !opts->bench_startup) { /* streaming needs stdin */
+        daemonize(opts->verbose);
+        restart_usb(micros, micro_cnt);
+    }
     #endif
-    command_cnt = count_color_commands(data_arr, pck_cnt, 0);
-    signal(SIGINT, nonstop_reset_handler);
-    signal(SIGTERM, nonstop_reset_handler);
-    /* The loop works until a signal handler resets the variable */
-    nonstop = 1; /* set to 1 only here */
-    while(nonstop) {
-        if(qc2s_controller) {
-            display_qc2s_data_arr(handle, *data_arr,
-                                  *data_arr+2*BYTE_STEP*command_cnt);
-        } else {
-            display_data_arr(handle, *data_arr,
-                             *data_arr+2*BYTE_STEP*command_cnt);
+    /* After forking: neither memory locks nor affinity are inherited
+     * reliably, and the animation is compiled already */
+    if(opts->realtime)
+        rt_enable(opts->cpu, opts->verbose);
+    ds.micros = micros;
+    ds.micro_cnt = ds.on = micro_cnt;
+    /* QuadCast 2S shows a group per step; alone, it takes a color command
+     * per frame as before. Along with others, it shows the command of the
+     * tick its frame starts at, so all of them stay in phase. The shared
+     * clock suits the slowest of them, each sends at its own period */
+    ds.slots = micros[0].caps->groups;
+    period = micro_period(micros);
+    for(i = 1; i < micro_cnt; i++) {
+        if(micros[i].caps->groups < ds.slots)
+            ds.slots = micros[i].caps->groups;
+        if(micro_period(micros+i) > period)
+            period = micro_period(micros+i);
+    }
+    ds.data_arr = data_arr;
+    ds.command_cnt = data_arr ? count_color_commands(data_arr, pck_cnt, 0)
+                              : 0;
+    ds.from_frame = 0;
+    ds.bulk = opts->bulk;
+    ds.first_tick = 0;
+    ds.owned = ds.pending = NULL;
+    ds.ring.shm = NULL;
+    ds.ring_live = 0;
+    ds.net.fd = -1;
+    ds.net_ready = 0;
+    ds.orgb.fd = -1;
+    ds.ctl.fd = -1;
+    ds.stream.on = 0;
+    ds.arrived_cnt = 0;
+    memset(&ds.reconnect, 0, sizeof(ds.reconnect));
+    if(evloop_init(&ds.loop) ||
+       evloop_catch_signals(&ds.loop, signals, 3, handle_signal, &ds)) {
+        perror("evloop");
+        evloop_free(&ds.loop);
+        return;
+    }
+    build_reports(&ds);
+    watch_usb_events(&ds.loop);
+#ifdef __linux__
+    watch_hidraw(&ds);
+#endif
+    watch_hotplug(&ds);
+    /* Those not found again after forking are waited for as the lost
+     * ones are, or left alone without hotplug */
+    for(i = 0; i < micro_cnt; i++) {
+        if(micros[i].lost && !ds.hotplug_on) {
+            micros[i].lost = 0;
+            micros[i].off = 1;
+            ds.on--;
         }
     }
+    /* Clients may vanish before reading the reply */
+    signal(SIGPIPE, SIG_IGN);
+    if(opts->stream) { /* streams have no animation to change */
+        start_stream(&ds, opts);
+    } else if(!opts->bench_startup) {
+        if(!ctl_listen(&ds.ctl))
+            evloop_add(&ds.loop, ds.ctl.fd, POLLIN, accept_control, &ds);
+        if(opts->shm && ring_create(&ds.ring, RING_NAME))
+            fprintf(stderr, RING_ERR_MSG, RING_NAME, strerror(errno));
+        if(opts->net && net_open(&ds.net, opts->net, opts->port,
+                                 opts->universe, opts->channel, opts->pixels))
+            fprintf(stderr, NET_ERR_MSG, ds.net.port, strerror(errno));
+        if(ds.net.fd >= 0)
+            evloop_add(&ds.loop, ds.net.fd, POLLIN, receive_net, &ds);
+        if(opts->openrgb &&
+           orgb_listen(&ds.orgb, opts->openrgb,
+                       micros[0].caps->format == report_groups))
+            fprintf(stderr, ORGB_ERR_MSG, opts->openrgb, strerror(errno));
+        if(ds.orgb.fd >= 0)
+            evloop_add(&ds.loop, ds.orgb.fd, POLLIN, accept_openrgb, &ds);
+    }
+    /* The tick of the clock selects the color command, so skipped ticks
+     * keep the animation in phase */
+    frame_clock_start(&ds.clock, period);
+    for(i = 0; i < micro_cnt; i++) {
+        ds.send_ns[i] = frame_clock_deadline_ns(&ds.clock, 0);
+        ds.sends[i] = 0;
+    }
+    /* The loop works until a signal or persistent errors stop it */
+    times->first_ns = frame_clock_now_ns();
+    next_tick(&ds);
+    res = show_frame(&ds);
+    times->first_ns = frame_clock_now_ns() - times->first_ns;
+    if(!res && !opts->bench_startup) {
+        arm_timer(&ds);
+        evloop_run(&ds.loop);
+    }
+    unwatch_hotplug(&ds);
+    libusb_set_pollfd_notifiers(NULL, NULL, NULL, NULL);
+#ifdef __linux__
+    qc2s_hidraw_set_notifiers(NULL, NULL, NULL);
+#endif
+    evloop_free(&ds.loop);
+    ctl_close(&ds.ctl);
+    free(ds.owned);
+    free(ds.pending);
+    free_reports(&ds);
+    if(ds.stream.on)
+        stop_stream(&ds);
+    if(opts->verbose)
+        print_frame_stats(&ds.clock.stats);
+    if(opts->verbose)
+        printf(RECONNECT_STATS_MSG, ds.reconnect.lost,
+               ds.reconnect.reconnected, ds.reconnect.recovered,
+               ds.reconnect.reconnected ? ds.reconnect.total_ns/
+                   (long long)ds.reconnect.reconnected/NSEC_PER_USEC : 0,
+               ds.reconnect.max_ns/NSEC_PER_USEC);
+    if(opts->verbose && ds.ring.shm)
+        printf(RING_STATS_MSG, ds.ring.shown, ds.ring.dropped,
+               ds.ring.shown ? ds.ring.total_age_ns/ds.ring.shown/NSEC_PER_USEC
+                             : 0,
+               ds.ring.max_age_ns/NSEC_PER_USEC);
+    if(opts->verbose && ds.net.fd >= 0)
+        print_net_stats(&ds.net);
+    if(opts->verbose && ds.orgb.fd >= 0)
+        printf(ORGB_STATS_MSG, ds.orgb.packets, ds.orgb.updates,
+               ds.orgb.redundant, ds.orgb.malformed);
+    ring_detach(&ds.ring);
+    net_close(&ds.net);
+    orgb_close(&ds.orgb);
 }
 
-#if !defined(DEBUG) && !defined(OS_MAC)
-static void daemonize(int verbose)
+/* A tick of the shared clock: the microphones plugged in are taken and,
+ * when the frames start, the next animation or live frame */
+static void next_tick(struct display_state *ds)
 {
-    int pid;
+    if(ds->hotplug_on)
+        take_arrivals(ds);
+    if(!frame_starts(ds, ds->clock.tick - ds->first_tick))
+        return;
+    if(ds->pending)
+        swap_animation(ds);
+    if(ds->stream.on)
+        ds->from_frame = stream_frame_due(ds);
+    else
+        ds->from_frame = live_frame_due(ds);
+}
 
-    chdir("/");
-    pid = fork();
-    if(pid > 0)
-        exit(0);
-    setsid();
-    pid = fork();
-    if(pid > 0)
-        exit(0);
+/* Sends the microphones whose time came their share: the color command
+ * the shared clock is at, or the frame from the ring, the network or
+ * stdin. Each goes at its own period, so a slow one holds the others
+ * back by the time of its own send at most. A microphone failing for
+ * long is left alone, the others go on. Returns -1 once the display
+ * should stop */
+static int show_frame(struct display_state *ds)
+{
+    long long now = frame_clock_now_ns(), period;
+    struct micro *m;
+    int i, res;
+    for(i = 0; i < ds->micro_cnt; i++) {
+        m = ds->micros+i;
+        if(m->off || m->lost || now < ds->send_ns[i])
+            continue;
+        /* One that fell behind skips the sends it missed, not its steps */
+        period = micro_period(m)*NSEC_PER_MSEC;
+        ds->send_ns[i] += period;
+        if(ds->send_ns[i] <= now)
+            ds->send_ns[i] = now + period;
+        res = show_micro(ds, m, ds->sends[i]++, ds->send_ns[i]);
+        if(res == frame_sent)
+            micro_sent(ds, m);
+        else
+            micro_failed(ds, m, res);
+    }
+    retime_display(ds);
+    /* finish program in case of persistent errors of all */
+    return ds->on ? 0 : -1;
+}
 
-    if(verbose)
-        printf(PID_MSG, getpid()); /* notify the user */
-    fflush(stdout); /* force clear of the buffer */
-    close(0);
-    close(1);
-    close(2);
-    open("/dev/null", O_RDONLY);
-    open("/dev/null", O_WRONLY);
-    open("/dev/null", O_WRONLY);
+/* The shared clock follows the slowest microphone, so every model keeps
+ * the pace of the animation: QuadCast 2S alone goes as fast as its acks
+ * allow */
+static void retime_display(struct display_state *ds)
+{
+    struct micro *m;
+    long period = 0;
+    for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++)
+        if(!m->off && !m->lost && micro_period(m) > period)
+            period = micro_period(m);
+    if(!period || period*NSEC_PER_MSEC == ds->clock.period_ns)
+        return;
+    frame_clock_retime(&ds->clock, period);
 }
-#endif
 
-static void display_data_arr(libusb_device_handle *handle,
-                             const byte_t *colcommand, const byte_t *end)
-{
-    short sent;
-    byte_t *packet;
-    byte_t header_packet[PACKET_SIZE] = {
-        HEADER_CODE, DISPLAY_CODE, 0, 0, 0, 0, 0, 0, PACKET_CNT, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-    };
-    packet = calloc(PACKET_SIZE, 1);
-    while(colcommand < end && nonstop) {
-        sent = send_display_command(header_packet, handle);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0; break; /* finish program in case of any errors */
-        }
-        memcpy(packet, colcommand, 2*BYTE_STEP);
-        sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT,
-                   BREQUEST_OUT, WVALUE, WINDEX, packet, PACKET_SIZE, TIMEOUT);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0; break;
+/* The timer goes off at the next tick of the shared clock or the next
+ * send of a microphone, whichever comes first */
+static void arm_timer(struct display_state *ds)
+{
+    long long next = frame_clock_deadline_ns(&ds->clock, ds->clock.tick+1);
+    struct micro *m;
+    int i;
+    for(i = 0; i < ds->micro_cnt; i++) {
+        m = ds->micros+i;
+        if(!m->off && !m->lost && ds->send_ns[i] < next)
+            next = ds->send_ns[i];
+    }
+    evloop_set_timer(&ds->loop, next, 0, next_frame, ds);
+}
+
+/* Deadlines of the clock passed by now, 0 before the next one */
+static unsigned long ticks_due(const struct frame_clock *fc)
+{
+    long long late;
+    late = frame_clock_now_ns() - frame_clock_deadline_ns(fc, fc->tick+1);
+    return late < 0 ? 0 : late / fc->period_ns + 1;
+}
+
+static void micro_sent(struct display_state *ds, struct micro *m)
+{
+    struct reconnect_stats *rs = &ds->reconnect;
+    long long latency;
+    m->failures = 0;
+    if(m->recovering) {
+        rs->recovered++;
+        m->recovering = 0;
+    }
+    if(m->arrived_ns) {
+        latency = frame_clock_now_ns() - m->arrived_ns;
+        rs->reconnected++;
+        rs->total_ns += latency;
+        if(latency > rs->max_ns)
+            rs->max_ns = latency;
+        m->arrived_ns = 0;
+    }
+}
+
+/* Failing for long, the microphone gets its endpoints cleared and the
+ * interfaces re-claimed once. If that doesn't help or it is unplugged,
+ * it is waited for; without hotplug support, it is left */
+static void micro_failed(struct display_state *ds, struct micro *m, int res)
+{
+    ds->clock.stats.failed++;
+    m->failures++;
+    if(res != frame_fatal && m->failures <= RETRY_BUDGET)
+        return;
+    if(res != frame_fatal && !m->recovering && !recover_micro(m)) {
+        m->recovering = 1;
+        m->failures = 0;
+        return;
+    }
+    fprintf(stderr, TRANSFER_ERR_MSG);
+    if(ds->hotplug_on) {
+        lose_micro(ds, m);
+        return;
+    }
+    if(ds->micro_cnt > 1)
+        fprintf(stderr, MICRO_OFF_MSG, m->where);
+    m->off = 1;
+    ds->on--;
+}
+
+/* Returns 1 if the microphone can't be used as it is */
+static int recover_micro(struct micro *m)
+{
+    m->init_sent = 0;
+    m->uploaded = 0;
+    return m->caps->transport->recover(m);
+}
+
+static void lose_micro(struct display_state *ds, struct micro *m)
+{
+    fprintf(stderr, MICRO_LOST_MSG, m->where);
+    m->caps->transport->close(m);
+    m->lost = 1;
+    m->gone = 0;
+    m->failures = 0;
+    m->recovering = 0;
+    m->init_sent = 0;
+    m->uploaded = 0;
+    m->arrived_ns = 0;
+    ds->reconnect.lost++;
+}
+
+/* Microphones plugged in since the last tick replace the lost ones,
+ * including those unplugged since then too. Nothing is compiled again:
+ * the animation goes on from the tick */
+static void take_arrivals(struct display_state *ds)
+{
+    struct micro *m;
+    int i;
+    for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++)
+        if(m->gone && !m->lost)
+            lose_micro(ds, m);
+    for(i = 0; i < ds->arrived_cnt; i++) {
+        for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++) {
+            if(!m->lost || !replaces(m, ds->arrived[i]))
+                continue;
+            if(!reopen_micro(m, ds->arrived[i])) {
+                fprintf(stderr, MICRO_BACK_MSG, m->where);
+                m->lost = 0;
+                m->arrived_ns = ds->arrived_ns[i];
+                /* its frame starts at once, with the shared command */
+                ds->send_ns[m-ds->micros] = frame_clock_now_ns();
+                ds->sends[m-ds->micros] = 0;
+            }
+            break;
         }
-        #ifdef DEBUG
-        print_packet(packet, "Data:");
-        #endif
-        colcommand += 2*BYTE_STEP;
-        usleep(1000*55);
-    }
-    free(packet);
-}
-
-static void display_qc2s_data_arr(libusb_device_handle *handle,
-                                  const byte_t *colcommand,
-                                  const byte_t *end)
-{
-    byte_t packet[PACKET_SIZE] = {0};
-    byte_t upper[3], lower[3];
-    short sent;
-    int group;
-
-    if(!qc2s_init_sent) {
-        packet[0] = QC2S_CMD_INIT;
-        packet[1] = QC2S_SUB_START;
-        sent = send_qc2s_report(packet, handle);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0;
+        libusb_unref_device(ds->arrived[i]);
+    }
+    ds->arrived_cnt = 0;
+}
+
+/* Returns 1 on errors, which are reported already */
+static int reopen_micro(struct micro *m, libusb_device *dev)
+{
+    m->caps = micro_caps(dev); /* of the same transport */
+    m->firmware = micro_firmware(dev);
+    micro_where(dev, m->where);
+    memset(&m->pace, 0, sizeof(m->pace)); /* the firmware may be new */
+    return m->caps->transport->open(m, dev, NULL);
+}
+
+/* A microphone comes back to its port; the only one may come back
+ * anywhere. Either way it is driven the same */
+static int replaces(const struct micro *m, libusb_device *dev)
+{
+    const struct micro_caps *caps = micro_caps(dev);
+    char where[MICRO_WHERE_LEN];
+    if(!caps || caps->transport != m->caps->transport)
+        return 0;
+    if(m->any)
+        return 1;
+    micro_where(dev, where);
+    return strequ(where, m->where);
+}
+
+/* QuadCast S gets a whole frame, QuadCast 2S one group of its frame at
+ * each step of its own; its colors are taken when the frame starts, from
+ * the command of the shared tick. The transfers may last until next_ns,
+ * its next send */
+static int show_micro(struct display_state *ds, struct micro *m,
+                      unsigned long step, long long next_ns)
+{
+    const byte_t *colcommand = NULL;
+    const datpack *data_arr = m->data_arr ? m->data_arr : ds->data_arr;
+    short command_cnt = m->data_arr ? m->command_cnt : ds->command_cnt;
+    unsigned long tick = ds->clock.tick - ds->first_tick;
+    if(ds->bulk && !ds->from_frame && m->caps->transport->upload)
+        return micro_upload(m, data_arr, command_cnt,
+                            (tick / ds->slots) % command_cnt,
+                            transfer_timeout(next_ns));
+    if(!ds->from_frame && step % m->caps->groups == 0)
+        colcommand = *data_arr + 2*BYTE_STEP*
+                     ((tick / ds->slots) % command_cnt);
+    return micro_show(m, colcommand, &ds->frame, step,
+                      transfer_timeout(next_ns));
+}
+
+/* New colors are taken when the frames of all microphones start: every
+ * tick, or every QC2S_GROUP_COUNT ticks with QuadCast 2S alone */
+static int frame_starts(const struct display_state *ds, unsigned long step)
+{
+    return step % ds->slots == 0;
+}
+
+/* The timer is one-shot: the clocks tell what is due */
+static void next_frame(unsigned long expirations, void *data)
+{
+    struct display_state *ds = data;
+    expirations = ticks_due(&ds->clock);
+    if(expirations) {
+        frame_clock_advance(&ds->clock, expirations);
+        if(ds->ctl.fd >= 0)
+            expire_control(ds);
+        /* The stream is over once its last frame was shown */
+        if(ds->stream.on && ds->stream.eof && !ds->stream.ready &&
+           frame_starts(ds, ds->clock.tick - ds->first_tick)) {
+            evloop_stop(&ds->loop);
             return;
         }
-        qc2s_init_sent = 1;
+        next_tick(ds);
     }
+    if(show_frame(ds))
+        evloop_stop(&ds->loop);
+    else
+        arm_timer(ds);
+}
 
-    while(colcommand < end && nonstop) {
-        get_group_colors(colcommand, upper, lower);
+static void handle_signal(int signo, void *data)
+{
+    struct display_state *ds = data;
+    if(signo == SIGCHLD)
+        reap_control(ds);
+    else
+        evloop_stop(&ds->loop);
+}
 
-        memset(packet, 0, sizeof(packet));
-        packet[0] = QC2S_CMD_COLOR;
-        packet[1] = QC2S_SUB_START;
-        packet[2] = QC2S_GROUP_COUNT;
-        sent = send_qc2s_report(packet, handle);
-        if(sent != PACKET_SIZE) {
-            nonstop = 0; break;
-        }
+/* Frames of the ring and the network. The last one stays on while
+ * producers are quiet for less than RING_HOLD, then the colors set through
+ * OpenRGB or the animation take over again */
+static int live_frame_due(struct display_state *ds)
+{
+    long long age;
+    if(ds->ring.shm && ring_latest(&ds->ring, &ds->frame)) {
+        ds->ring_live = 1;
+        return 1;
+    }
+    if(ds->net_ready) {
+        ds->frame = ds->net_frame;
+        ds->net_ready = 0;
+        ds->ring_live = 1;
+        age = frame_clock_now_ns() - ds->frame.timestamp_ns;
+        ds->net.shown++;
+        ds->net.total_age_ns += age;
+        if(age > ds->net.max_age_ns)
+            ds->net.max_age_ns = age;
+        return 1;
+    }
+    if(ds->ring_live && frame_clock_now_ns() - ds->frame.timestamp_ns >
+                        RING_HOLD*NSEC_PER_MSEC)
+        ds->ring_live = 0;
+    if(ds->ring_live)
+        return 1;
+    /* OpenRGB sets the colors once, they stay until it sets others. Any
+     * number of updates between two ticks make a single frame */
+    if(ds->orgb.lit) {
+        orgb_take_frame(&ds->orgb, &ds->frame);
+        return 1;
+    }
+    return 0;
+}
 
-        for(group = 0; group < QC2S_GROUP_COUNT && nonstop; group++) {
-            const byte_t *rgb = (group < QC2S_UPPER_GROUPS) ? upper : lower;
-            write_qc2s_color_packet((byte_t)group, rgb, packet);
-            sent = send_qc2s_report(packet, handle);
-            if(sent != PACKET_SIZE) {
-                nonstop = 0; break;
-            }
-            usleep(1000*45);
+/* Bursts of datagrams between two frames leave only the newest frame */
+static void receive_net(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    (void)fd;
+    (void)revents;
+    if(net_receive(&ds->net, &ds->net_frame))
+        ds->net_ready = 1;
+}
+
+static void print_net_stats(const struct net_receiver *nr)
+{
+    printf(NET_STATS_MSG, nr->datagrams, nr->frames, nr->shown,
+           nr->malformed,
+           nr->shown ? nr->total_age_ns/(long long)nr->shown/NSEC_PER_USEC : 0,
+           nr->max_age_ns/NSEC_PER_USEC);
+}
+
+static void accept_openrgb(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    int client;
+    (void)fd;
+    (void)revents;
+    while((client = orgb_accept(&ds->orgb)) >= 0)
+        if(evloop_add(&ds->loop, client, POLLIN, serve_openrgb, ds))
+            orgb_drop(&ds->orgb, client);
+}
+
+static void serve_openrgb(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    (void)revents;
+    if(orgb_serve(&ds->orgb, fd)) /* the client is gone */
+        evloop_remove(&ds->loop, fd);
+}
+
+static void start_stream(struct display_state *ds, const struct runopts *opts)
+{
+    struct stream_state *ss = &ds->stream;
+    memset(ss, 0, sizeof(*ss));
+    ss->on = 1;
+    ss->latest = opts->latest;
+    stream_init(&ss->in, STDIN_FILENO, opts->stream);
+    ss->fd_flags = fcntl(STDIN_FILENO, F_GETFL);
+    fcntl(STDIN_FILENO, F_SETFL, ss->fd_flags | O_NONBLOCK);
+    memset(&ds->frame, 0, sizeof(ds->frame)); /* dark until the first one */
+    evloop_add(&ds->loop, STDIN_FILENO, POLLIN, read_stream, ds);
+}
+
+static void stop_stream(struct display_state *ds)
+{
+    struct stream_state *ss = &ds->stream;
+    double fps = 0;
+    fcntl(STDIN_FILENO, F_SETFL, ss->fd_flags);
+    if(ss->shown > 1 && ss->last_ns > ss->first_ns)
+        fps = (ss->shown-1) * (double)NSEC_PER_SEC / (ss->last_ns-ss->first_ns);
+    fprintf(stderr, STREAM_STATS_MSG, ss->shown, ss->dropped,
+            ss->in.malformed, fps);
+}
+
+static void read_stream(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    int got;
+    (void)revents;
+    got = stream_fill(&ds->stream.in);
+    if(got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+        ds->stream.eof = 1;
+        evloop_remove(&ds->loop, fd);
+    }
+    take_stream_frames(ds);
+}
+
+/* Without --latest every frame is shown: stdin isn't read while a frame
+ * waits, so a producer faster than the device blocks on the full pipe */
+static void take_stream_frames(struct display_state *ds)
+{
+    struct stream_state *ss = &ds->stream;
+    if(ss->latest) {
+        while(stream_next(&ss->in, &ss->next)) {
+            ss->dropped += ss->ready;
+            ss->ready = 1;
         }
-        colcommand += 2*BYTE_STEP;
+        return;
     }
+    if(!ss->ready)
+        ss->ready = stream_next(&ss->in, &ss->next);
+    if(ss->eof)
+        return;
+    if(ss->ready)
+        evloop_remove(&ds->loop, STDIN_FILENO);
+    else
+        evloop_add(&ds->loop, STDIN_FILENO, POLLIN, read_stream, ds);
+}
+
+/* The last frame is repeated until the next one comes */
+static int stream_frame_due(struct display_state *ds)
+{
+    struct stream_state *ss = &ds->stream;
+    if(!ss->ready)
+        return 1;
+    ds->frame = ss->next;
+    ss->ready = 0;
+    ss->shown++;
+    ss->last_ns = frame_clock_now_ns();
+    if(ss->shown == 1)
+        ss->first_ns = ss->last_ns;
+    take_stream_frames(ds);
+    return 1;
+}
+
+static void accept_control(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    int client;
+    (void)fd;
+    (void)revents;
+    while((client = ctl_accept(&ds->ctl)) >= 0)
+        if(evloop_add(&ds->loop, client, POLLIN, read_control, ds))
+            ctl_drop(&ds->ctl, client);
+}
+
+/* A request goes from the client's socket to the pipe of its compiler */
+static void read_control(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    int out;
+    (void)revents;
+    if(!ctl_read(&ds->ctl, fd))
+        return;
+    evloop_remove(&ds->loop, fd);
+    out = ctl_compile(&ds->ctl, fd);
+    if(out >= 0 &&
+       evloop_add(&ds->loop, out, POLLIN, collect_control, ds))
+        ctl_drop(&ds->ctl, out); /* the client is replied to on SIGCHLD */
+}
+
+static void collect_control(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    (void)revents;
+    if(!ctl_collect(&ds->ctl, fd))
+        return;
+    evloop_remove(&ds->loop, fd);
+    reap_control(ds); /* or on SIGCHLD if it hasn't exited yet */
 }
 
-static void get_group_colors(const byte_t *colcommand, byte_t *upper,
-                             byte_t *lower)
+/* Clients slower than CTL_TIMEOUT to send their requests are let go */
+static void expire_control(struct display_state *ds)
 {
-    if(*colcommand == RGB_CODE) {
-        memcpy(upper, colcommand+1, 3);
-    } else {
-        memset(upper, 0, 3);
+    long long now = frame_clock_now_ns();
+    int fd;
+    while((fd = ctl_expired(&ds->ctl, now)) >= 0) {
+        evloop_remove(&ds->loop, fd);
+        ctl_drop(&ds->ctl, fd);
     }
+}
+
+/* Compiling happens in the background, between frames; only the swap is
+ * left for the frame itself */
+static void reap_control(struct display_state *ds)
+{
+    datpack *data_arr;
+    int pck_cnt;
+    data_arr = ctl_reap(&ds->ctl, &pck_cnt);
+    if(!data_arr)
+        return;
+    free(ds->pending); /* a newer request wins */
+    ds->pending = data_arr;
+    ds->pending_cnt = pck_cnt;
+    frame_reports_free(&ds->pending_reports);
+    if(ds->qc2s)
+        frame_reports_build(&ds->pending_reports, data_arr,
+                            count_color_commands(data_arr, pck_cnt, 0));
+}
 
-    if(*(colcommand+BYTE_STEP) == RGB_CODE) {
-        memcpy(lower, colcommand+BYTE_STEP+1, 3);
-    } else {
-        memset(lower, 0, 3);
+/* The new animation starts from its first color command, on every
+ * microphone */
+static void swap_animation(struct display_state *ds)
+{
+    int i;
+    for(i = 0; i < ds->micro_cnt; i++) {
+        ds->micros[i].data_arr = NULL;
+        if(ds->micros[i].reports)
+            ds->micros[i].reports = &ds->reports;
+        ds->micros[i].cached = NULL; /* until its next frame */
+        frame_reports_free(ds->own_reports+i);
     }
+    free(ds->owned);
+    ds->owned = ds->pending;
+    ds->data_arr = ds->pending;
+    ds->command_cnt = count_color_commands(ds->pending, ds->pending_cnt, 0);
+    ds->first_tick = ds->clock.tick;
+    ds->pending = NULL;
+    frame_reports_free(&ds->reports);
+    ds->reports = ds->pending_reports;
+    memset(&ds->pending_reports, 0, sizeof(ds->pending_reports));
 }
 
-static void write_qc2s_color_packet(byte_t group, const byte_t *rgb,
-                                    byte_t *packet)
+/* QuadCast 2S frames hand out the group reports encoded here, once per
+ * animation; a failure only leaves them to be encoded as they go */
+static void build_reports(struct display_state *ds)
 {
+    struct micro *m;
     int i;
-    memset(packet, 0, PACKET_SIZE);
-    packet[0] = QC2S_CMD_COLOR;
-    packet[1] = QC2S_SUB_DATA;
-    packet[2] = group;
-    for(i = QC2S_RGB_OFFSET; i+2 < PACKET_SIZE; i += 3) {
-        packet[i] = rgb[0];
-        packet[i+1] = rgb[1];
-        packet[i+2] = rgb[2];
+    memset(&ds->reports, 0, sizeof(ds->reports));
+    memset(&ds->pending_reports, 0, sizeof(ds->pending_reports));
+    memset(ds->own_reports, 0, sizeof(ds->own_reports));
+    ds->qc2s = 0;
+    for(i = 0; i < ds->micro_cnt; i++) {
+        m = ds->micros+i;
+        if(m->caps->format != report_groups)
+            continue;
+        if(!ds->qc2s)
+            frame_reports_build(&ds->reports, ds->data_arr, ds->command_cnt);
+        ds->qc2s = 1;
+        m->reports = &ds->reports;
+        if(m->data_arr) {
+            frame_reports_build(ds->own_reports+i, m->data_arr,
+                                m->command_cnt);
+            m->reports = ds->own_reports+i;
+        }
     }
 }
 
-static short send_display_command(byte_t *packet, libusb_device_handle *handle)
+static void free_reports(struct display_state *ds)
 {
-    short sent;
-    sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT, BREQUEST_OUT,
-                                 WVALUE, WINDEX, packet, PACKET_SIZE,
-                                 TIMEOUT);
-    #ifdef DEBUG
-    print_packet(packet, "Header display:");
-    if(sent != PACKET_SIZE)
-        fprintf(stderr, HEADER_ERR_MSG, libusb_strerror(sent));
-    #endif
-    return sent;
+    int i;
+    for(i = 0; i < ds->micro_cnt; i++) {
+        ds->micros[i].reports = NULL;
+        ds->micros[i].cached = NULL;
+        frame_reports_free(ds->own_reports+i);
+    }
+    frame_reports_free(&ds->reports);
+    frame_reports_free(&ds->pending_reports);
+}
+
+/* Asynchronous libusb transfers and hotplug events are completed from
+ * the same loop, so libusb's descriptors are watched along with ours */
+static void watch_usb_events(struct evloop *loop)
+{
+    const struct libusb_pollfd **fds, **fd;
+    fds = libusb_get_pollfds(NULL);
+    if(!fds)
+        return;
+    for(fd = fds; *fd; fd++)
+        evloop_add(loop, (*fd)->fd, (*fd)->events, handle_usb_events, NULL);
+    libusb_free_pollfds(fds);
+    libusb_set_pollfd_notifiers(NULL, usb_pollfd_added, usb_pollfd_removed,
+                                loop);
+}
+
+/* Without hotplug support, microphones that are lost stay lost */
+static void watch_hotplug(struct display_state *ds)
+{
+    ds->hotplug_on = libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG) &&
+        !libusb_hotplug_register_callback(NULL,
+            LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+            LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT, LIBUSB_HOTPLUG_NO_FLAGS,
+            LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+            LIBUSB_HOTPLUG_MATCH_ANY, usb_hotplug, ds, &ds->hotplug);
 }
 
-static short send_qc2s_report(const byte_t *packet, libusb_device_handle *handle)
+static void unwatch_hotplug(struct display_state *ds)
 {
-    static const byte_t ep_out[] = {
-        QC2S_INTR_EP_OUT, QC2S_INTR_EP_OUT_ALT1, QC2S_INTR_EP_OUT_ALT2
-    };
-    static const byte_t ep_in[] = {
-        QC2S_INTR_EP_IN, QC2S_INTR_EP_IN_ALT1, QC2S_INTR_EP_IN_ALT2
-    };
-    int transferred = 0;
     int i;
+    if(!ds->hotplug_on)
+        return;
+    libusb_hotplug_deregister_callback(NULL, ds->hotplug);
+    for(i = 0; i < ds->arrived_cnt; i++)
+        libusb_unref_device(ds->arrived[i]);
+    ds->arrived_cnt = 0;
+}
 
-#ifdef USE_HIDAPI
-    if(qc2s_bridge_ctx) {
-        (void)handle;
-        if(qc2s_send_report(qc2s_bridge_ctx, packet, 1) < 0)
-            return -1;
-#ifdef DEBUG
-        print_packet(packet, "QC2S report (hidapi):");
-#endif
-        return PACKET_SIZE;
+/* Only notes the event: the devices are opened & closed at the tick,
+ * outside of libusb's event handling */
+static int LIBUSB_CALL usb_hotplug(libusb_context *ctx, libusb_device *dev,
+                                   libusb_hotplug_event event, void *data)
+{
+    struct display_state *ds = data;
+    struct micro *m;
+    (void)ctx;
+    if(!micro_caps(dev))
+        return 0;
+    if(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+        if(ds->arrived_cnt < MAX_MICROS) {
+            ds->arrived[ds->arrived_cnt] = libusb_ref_device(dev);
+            ds->arrived_ns[ds->arrived_cnt] = frame_clock_now_ns();
+            ds->arrived_cnt++;
+        }
+        return 0;
     }
-#endif
-
-    /* Try each interrupt endpoint; cache the one that works */
-    for(i = 0; i < (int)(sizeof(ep_out)/sizeof(ep_out[0])); i++) {
-        byte_t ep = (i == 0) ? qc2s_ep_out : ep_out[i];
-        if(i > 0 && ep == qc2s_ep_out)
+    /* The bridge & hidraw take no libusb handle */
+    for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++) {
+        if(m->lost)
             continue;
-        transferred = 0;
-        if(!libusb_interrupt_transfer(handle, ep, (unsigned char *)packet,
-                                      PACKET_SIZE, &transferred, TIMEOUT)
-           && transferred == PACKET_SIZE) {
-            qc2s_ep_out = ep;
-            qc2s_ep_in = ep_in[i];
-#ifdef DEBUG
-            print_packet(packet, "QC2S report (intr):");
-#endif
-            qc2s_read_ack(handle);
-            return PACKET_SIZE;
-        }
-#ifdef DEBUG
-        fprintf(stderr, "intr ep 0x%02x failed\n", ep);
-#endif
+        if(m->handle ? libusb_get_device(m->handle) == dev
+                     : replaces(m, dev))
+            m->gone = 1;
     }
+    return 0; /* stay registered */
+}
 
-    /* Last resort: HID SET_REPORT over control endpoint */
-    transferred = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT,
-                      BREQUEST_OUT, (0x0200 | packet[0]), 1,
-                      (unsigned char *)(packet+1), PACKET_SIZE-1, TIMEOUT);
-#ifdef DEBUG
-    print_packet(packet, "QC2S report (ctrl):");
-    if(transferred < 0)
-        fprintf(stderr, DATAPCK_ERR_MSG, libusb_strerror(transferred));
-#endif
-    return (transferred == PACKET_SIZE-1) ? PACKET_SIZE : (short)transferred;
+static void handle_usb_events(int fd, short revents, void *data)
+{
+    struct timeval nowait = { 0, 0 };
+    (void)fd; (void)revents; (void)data;
+    libusb_handle_events_timeout_completed(NULL, &nowait, NULL);
 }
 
-static void qc2s_read_ack(libusb_device_handle *handle)
+static void usb_pollfd_added(int fd, short events, void *data)
 {
-    byte_t ack[PACKET_SIZE] = {0};
+    evloop_add(data, fd, events, handle_usb_events, NULL);
+}
 
-#ifdef USE_HIDAPI
-    if(qc2s_bridge_ctx) {
-        (void)handle;
+static void usb_pollfd_removed(int fd, void *data)
+{
+    evloop_remove(data, fd);
+}
+
+#ifdef __linux__
+/* The acks of the hidraw nodes come between the ticks: read then, their
+ * times pace the groups as they are */
+static void watch_hidraw(struct display_state *ds)
+{
+    struct micro *m;
+    for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++)
+        if(m->caps->transport == &qc2s_hidraw_transport && m->hidraw >= 0)
+            hidraw_added(m->hidraw, ds);
+    qc2s_hidraw_set_notifiers(hidraw_added, hidraw_removed, ds);
+}
+
+/* An unplugged node is left to the tick, which closes it */
+static void read_hidraw_acks(int fd, short revents, void *data)
+{
+    struct display_state *ds = data;
+    struct micro *m;
+    for(m = ds->micros; m < ds->micros+ds->micro_cnt; m++) {
+        if(m->caps->transport != &qc2s_hidraw_transport || m->hidraw != fd)
+            continue;
+        if(revents & ~POLLIN)
+            evloop_remove(&ds->loop, fd);
+        else
+            qc2s_hidraw_acks(m);
         return;
     }
-#endif
+}
 
-    {
-        int errcode, transferred = 0;
-        errcode = libusb_interrupt_transfer(handle, qc2s_ep_in, ack,
-                                            PACKET_SIZE, &transferred,
-                                            QC2S_ACK_TIMEOUT);
-#ifdef DEBUG
-        if(!errcode && transferred > 0)
-            print_packet(ack, "QC2S ack:");
-        else if(errcode && errcode != LIBUSB_ERROR_TIMEOUT)
-            fprintf(stderr, "ack ep 0x%02x err=%d (%s)\n", qc2s_ep_in,
-                    errcode, libusb_strerror(errcode));
+static void hidraw_added(int fd, void *data)
+{
+    struct display_state *ds = data;
+    evloop_add(&ds->loop, fd, POLLIN, read_hidraw_acks, ds);
+}
+
+static void hidraw_removed(int fd, void *data)
+{
+    struct display_state *ds = data;
+    evloop_remove(&ds->loop, fd);
+}
 #endif
-    }
+
+static void print_frame_stats(const struct frame_stats *st)
+{
+    long long mean = st->ticks ? st->total_late_ns / (long long)st->ticks : 0;
+    printf(FRAMESTAT_MSG, st->ticks, st->late, st->dropped, st->failed,
+           mean / 1000, st->max_late_ns / 1000);
 }
 
-#ifdef DEBUG
-static void print_packet(const byte_t *pck, const char *str)
+#if !defined(DEBUG) && !defined(OS_MAC)
+static void daemonize(int verbose)
+{
+    int pid;
+
+    chdir("/");
+    pid = fork();
+    if(pid > 0)
+        exit(0);
+    setsid();
+    pid = fork();
+    if(pid > 0)
+        exit(0);
+
+    if(verbose)
+        printf(PID_MSG, getpid()); /* notify the user */
+    fflush(stdout); /* force clear of the buffer */
+    close(0);
+    close(1);
+    close(2);
+    open("/dev/null", O_RDONLY);
+    open("/dev/null", O_WRONLY);
+    open("/dev/null", O_WRONLY);
+}
+
+/* Only the forking thread is left in the daemon, libusb's hotplug
+ * monitor is gone with the others: libusb is started again and the
+ * microphones are opened anew with it */
+static void restart_usb(struct micro *micros, int micro_cnt)
 {
-    const byte_t *p;
-    puts(str);
-    for(p = pck; p < pck+PACKET_SIZE; p++) {
-        printf("%02X ", (int)(*p));
-        if((p-pck+1) % 16 == 0)
-            puts("");
+    libusb_device **devs;
+    struct micro *m;
+    ssize_t cnt;
+    int i;
+    for(m = micros; m < micros+micro_cnt; m++)
+        m->caps->transport->close(m);
+    libusb_exit(NULL);
+    if(libusb_init(NULL))
+        exit(libusberr);
+    cnt = libusb_get_device_list(NULL, &devs);
+    for(m = micros; m < micros+micro_cnt; m++) {
+        for(i = 0; i < cnt && !replaces(m, devs[i]); i++)
+            ;
+        m->lost = i >= cnt || reopen_micro(m, devs[i]);
     }
-    puts("");
+    if(cnt >= 0)
+        libusb_free_device_list(devs, 1);
 }
 #endif
+
+/* The transfers of a send may use what is left until the next one but
+ * no less than MIN_TIMEOUT, since zero means no timeout for libusb */
+static unsigned int transfer_timeout(long long next_ns)
+{
+    long long budget = (next_ns - frame_clock_now_ns()) / NSEC_PER_MSEC;
+    if(budget < MIN_TIMEOUT)
+        return MIN_TIMEOUT;
+    if(budget > TIMEOUT)
+        return TIMEOUT;
+    return (unsigned int)budget;
+}
@@ -3,6 +3,11 @@
  * Device input/output.
  * The device is microphone HyperX Quadcast S
  * distinguished by the VID & PID.
+ * Several microphones share one display loop and its clock, so their
+ * animations stay in phase; each gets a bounded share of every tick.
+ * A microphone that stops answering is recovered in place or, once
+ * unplugged, waited for and taken back where the animation is then.
+ * The transfers themselves are up to the transport of each model.
  *
  * <----- License notice ----->
  * Copyright (C) 2022, 2023, 2024 Ors1mer
@@ -29,62 +34,67 @@
 #ifndef DEVIO_SENTRY
 #define DEVIO_SENTRY
 
-#include <unistd.h> /* for usleep */
+#include <unistd.h> /* for fork & close */
 #include <libusb-1.0/libusb.h>
 #include <fcntl.h> /* for daemonization */
-#include <signal.h> /* for signal handling */
+#include <signal.h> /* for SIGINT & SIGTERM */
+#include <errno.h>
 #include "locale_macros.h"
 #include "rgbmodes.h" /* for datpack & byte_t types, count_color_pairs, defs */
-#include "qc2s_protocol.h"
+#include "frameclock.h" /* for deadline-based pacing */
+#include "rtsched.h" /* for the low-jitter mode */
+#include "evloop.h" /* for the display loop */
+#include "ctlsock.h" /* for live animation changes */
+#include "framering.h" /* for frames of other programs */
+#include "framestream.h" /* for the stream mode */
+#include "netrecv.h" /* for E1.31 & DDP */
+#include "orgbsrv.h" /* for OpenRGB */
+#include "transport.h" /* for struct micro & the models */
+#ifdef __linux__
+#include "qc2s_hidraw.h" /* for the acks of its nodes */
+#endif
+#include "usbdev.h"
 
 /* Constants */
-/* Vendor IDs */
-#define DEV_VID_NA      0x0951
-#define DEV_VID_EU      0x03f0
-/* Product IDs */
-#define DEV_PID_NA1     0x171f
-#define DEV_PID_NA2     0x0d84
-#define DEV_PID_NA3     0x02b5
-#define DEV_PID_EU1     0x0f8b
-#define DEV_PID_EU2     0x028c
-#define DEV_PID_EU3     0x048c
-#define DEV_PID_EU4     0x068c
-#define DEV_PID_DUOCAST 0x098c
-
-#define DEV_EPOUT 0x00 /* control endpoint OUT */
-#define DEV_EPIN 0x80 /* control endpoint IN */
-/* Packet info */
-#define MAX_PCT_CNT 90
-#define PACKET_SIZE 64 /* bytes */
-
-#define HEADER_CODE 0x04
-#define DISPLAY_CODE 0xf2
-#define PACKET_CNT 0x01
+#define SYSFS_USB_DEVICES "/sys/bus/usb/devices"
+#define SERIAL_LEN 64
 
-#define INTR_EP_IN 0x82
-#define INTR_LENGTH 8
-
-#define TIMEOUT 1000 /* one second per packet */
-#define BMREQUEST_TYPE_OUT 0x21
-#define BREQUEST_OUT 0x09
-#define BMREQUEST_TYPE_IN 0xa1
-#define BREQUEST_IN 0x01
-#define WVALUE 0x0300
-#define WINDEX 0x0000
+#define TIMEOUT 1000 /* one second per packet at most */
+#define MIN_TIMEOUT 10 /* even if the frame is out of time */
+#define RETRY_BUDGET 5 /* consecutive failed frames before giving up */
+#define CALIBRATE_FRAMES 60 /* per QuadCast 2S */
+#define CALIBRATE_LEVEL 0x40 /* of all channels while calibrating */
 
 /* Messages */
 #define DEVLIST_ERR_MSG _("Couldn't get the list of USB devices.\n")
 #define NODEV_ERR_MSG _("HyperX Quadcast S isn't connected.\n")
-#define OPEN_ERR_MSG _("Couldn't open the microphone.\n")
-#define BUSY_ERR_MSG _("Another program is using the microphone already. " \
-                       "Stopping.\n")
+#define NOSEL_ERR_MSG _("No microphone matches %s.\n")
+#define MANY_ERR_MSG _("Too many microphones, at most %d.\n")
+#define BRIDGE_ONE_MSG _("hidapi: only one QuadCast 2S is supported\n")
 #define TRANSFER_ERR_MSG _("Couldn't transfer a packet! " \
                            "The device might be busy.\n")
-#define FOOTER_ERR_MSG _("Footer packet error: %s\n")
-#define HEADER_ERR_MSG _("Header packet error: %s\n")
-#define SIZEPCK_ERR_MSG _("Size packet error: %s\n")
-#define DATAPCK_ERR_MSG _("Data packet error: %s\n")
+#define MICRO_OFF_MSG _("Leaving the microphone at %s.\n")
+#define MICRO_LOST_MSG _("Lost the microphone at %s, waiting for it.\n")
+#define MICRO_BACK_MSG _("The microphone at %s is back.\n")
+#define CALIBRATE_MSG _("%s at %s, firmware %x.%02x: %.1f fps, a group " \
+                        "every %ld ms (ack time %lld us, acks: %lu, " \
+                        "missed: %lu)\n")
+#define CALIBRATE_FIXED_MSG _("%s at %s: %.1f fps, not paced by acks\n")
+#define PERSIST_ERR_MSG _("The microphone at %s can't keep the animation, " \
+                          "streaming it.\n")
 #define PID_MSG _("Started with pid %d\n")
+#define FRAMESTAT_MSG _("Frames: %lu, late: %lu, dropped: %lu, " \
+                        "failed: %lu, mean lateness: %lld us, " \
+                        "max lateness: %lld us\n")
+#define STARTUP_MSG _("Time to the first frame: %lld us\n" \
+                      "  parse:          %lld us\n" \
+                      "  compile:        %lld us\n" \
+                      "  open:           %lld us\n" \
+                      "  claim:          %lld us\n" \
+                      "  first transfer: %lld us\n")
+#define RECONNECT_STATS_MSG _("Lost: %lu, reconnected: %lu, recovered in " \
+                              "place: %lu, mean reconnect latency: %lld " \
+                              "us, max reconnect latency: %lld us\n")
 /* Error codes */
 enum {
     libusberr = 2,
@@ -93,9 +103,26 @@ enum {
     transfererr
 };
 
+/* Structs */
+/* Phases of the way to the first frame, for --bench-startup */
+struct startup_times {
+    long long parse_ns;
+    long long compile_ns;
+    long long open_ns; /* finding & opening the microphones */
+    long long claim_ns; /* of their interfaces */
+    long long first_ns; /* the transfers of the first frame */
+};
+
 /* Functions */
-libusb_device_handle *open_micro(datpack *data_arr);
-void close_micro(libusb_device_handle *handle);
-void send_packets(libusb_device_handle *handle, const datpack *data_arr,
-                  int pck_cnt, int verbose);
+int open_micros(struct micro *micros, const struct runopts *opts,
+                datpack **data_arrs, const int *pck_cnts,
+                struct startup_times *times);
+void close_micros(struct micro *micros, int cnt);
+void calibrate_micros(struct micro *micros, int micro_cnt);
+int persist_micros(struct micro *micros, int micro_cnt,
+                   const datpack *data_arr, int pck_cnt,
+                   const struct runopts *opts);
+void send_packets(struct micro *micros, int micro_cnt,
+                  const datpack *data_arr, int pck_cnt,
+                  const struct runopts *opts, struct startup_times *times);
 #endif
@@ -0,0 +1,349 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File evloop.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "evloop.h"
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <stdint.h> /* for uint64_t */
+#else
+#include <fcntl.h> /* for fcntl */
+#endif
+
+static struct ev_watcher *free_slot(struct evloop *loop);
+static struct ev_watcher *find_watcher(struct evloop *loop, int fd);
+static void dispatch(struct ev_watcher *w, short revents);
+static void read_signals(int fd, short revents, void *data);
+#ifdef __linux__
+static void read_timer(int fd, short revents, void *data);
+#else
+static void fire_due_timer(struct evloop *loop);
+static int timer_timeout(const struct evloop *loop, int timeout_ms);
+static void write_sigpipe(int signo);
+
+static volatile int sigpipe_wr = -1; /* BE CAREFUL: GLOBAL VARIABLE */
+#endif
+
+int evloop_init(struct evloop *loop)
+{
+    int i;
+    memset(loop, 0, sizeof(*loop));
+    for(i = 0; i < EV_MAX_WATCHERS; i++)
+        loop->watchers[i].fd = -1;
+#ifdef __linux__
+    loop->timerfd = loop->sigfd = -1;
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->epfd < 0 ? -1 : 0;
+#else
+    loop->sigpipe[0] = loop->sigpipe[1] = -1;
+    return 0;
+#endif
+}
+
+void evloop_free(struct evloop *loop)
+{
+#ifdef __linux__
+    if(loop->timerfd >= 0)
+        close(loop->timerfd);
+    if(loop->sigfd >= 0)
+        close(loop->sigfd);
+    if(loop->epfd >= 0)
+        close(loop->epfd);
+    loop->epfd = loop->timerfd = loop->sigfd = -1;
+#else
+    if(loop->sigpipe[0] >= 0) {
+        sigpipe_wr = -1;
+        close(loop->sigpipe[0]);
+        close(loop->sigpipe[1]);
+    }
+    loop->sigpipe[0] = loop->sigpipe[1] = -1;
+#endif
+}
+
+int evloop_add(struct evloop *loop, int fd, short events,
+               ev_handler handler, void *data)
+{
+    struct ev_watcher *w = find_watcher(loop, fd);
+#ifdef __linux__
+    struct epoll_event ev;
+    int op = w ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+#endif
+    if(!w)
+        w = free_slot(loop);
+    if(!w)
+        return -1;
+#ifdef __linux__
+    memset(&ev, 0, sizeof(ev));
+    ev.events = ((events & POLLIN) ? EPOLLIN : 0) |
+                ((events & POLLOUT) ? EPOLLOUT : 0);
+    ev.data.u32 = (uint32_t)(w - loop->watchers);
+    if(epoll_ctl(loop->epfd, op, fd, &ev))
+        return -1;
+#endif
+    w->fd = fd;
+    w->events = events;
+    w->handler = handler;
+    w->data = data;
+    return 0;
+}
+
+void evloop_remove(struct evloop *loop, int fd)
+{
+    struct ev_watcher *w = find_watcher(loop, fd);
+    if(!w)
+        return;
+#ifdef __linux__
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+    w->fd = -1;
+}
+
+/* The first expiration is an absolute time on the monotonic clock,
+ * period 0 makes the timer one-shot */
+int evloop_set_timer(struct evloop *loop, long long first_ns,
+                     long long period_ns, ev_timer_handler handler,
+                     void *data)
+{
+    loop->on_timer = handler;
+    loop->timer_data = data;
+#ifdef __linux__
+    {
+        struct itimerspec its;
+        if(loop->timerfd < 0) {
+            loop->timerfd = timerfd_create(CLOCK_MONOTONIC,
+                                           TFD_NONBLOCK | TFD_CLOEXEC);
+            if(loop->timerfd < 0)
+                return -1;
+            if(evloop_add(loop, loop->timerfd, POLLIN, read_timer, loop))
+                return -1;
+        }
+        its.it_value.tv_sec = first_ns / NSEC_PER_SEC;
+        its.it_value.tv_nsec = first_ns % NSEC_PER_SEC;
+        its.it_interval.tv_sec = period_ns / NSEC_PER_SEC;
+        its.it_interval.tv_nsec = period_ns % NSEC_PER_SEC;
+        return timerfd_settime(loop->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+    }
+#else
+    loop->timer_next_ns = first_ns;
+    loop->timer_period_ns = period_ns;
+    return 0;
+#endif
+}
+
+/* The signals are delivered through the loop instead of interrupting
+ * whatever the process is doing */
+int evloop_catch_signals(struct evloop *loop, const int *signos, int cnt,
+                         ev_signal_handler handler, void *data)
+{
+    int i;
+    loop->on_signal = handler;
+    loop->signal_data = data;
+#ifdef __linux__
+    {
+        sigset_t mask;
+        sigemptyset(&mask);
+        for(i = 0; i < cnt; i++)
+            sigaddset(&mask, signos[i]);
+        if(sigprocmask(SIG_BLOCK, &mask, NULL))
+            return -1;
+        loop->sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if(loop->sigfd < 0)
+            return -1;
+        return evloop_add(loop, loop->sigfd, POLLIN, read_signals, loop);
+    }
+#else
+    {
+        struct sigaction sa;
+        if(pipe(loop->sigpipe))
+            return -1;
+        fcntl(loop->sigpipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(loop->sigpipe[1], F_SETFL, O_NONBLOCK);
+        sigpipe_wr = loop->sigpipe[1];
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = write_sigpipe;
+        sigemptyset(&sa.sa_mask);
+        for(i = 0; i < cnt; i++)
+            sigaction(signos[i], &sa, NULL);
+        return evloop_add(loop, loop->sigpipe[0], POLLIN, read_signals, loop);
+    }
+#endif
+}
+
+/* Waits for one batch of events; timeout_ms -1 waits for as long as
+ * needed. Returns the number of handled descriptors or -1 */
+int evloop_run_once(struct evloop *loop, int timeout_ms)
+{
+#ifdef __linux__
+    struct epoll_event evs[EV_MAX_WATCHERS];
+    int i, cnt;
+    cnt = epoll_wait(loop->epfd, evs, EV_MAX_WATCHERS, timeout_ms);
+    if(cnt < 0)
+        return (errno == EINTR) ? 0 : -1;
+    for(i = 0; i < cnt && loop->running; i++) {
+        short revents = 0;
+        if(evs[i].events & EPOLLIN)
+            revents |= POLLIN;
+        if(evs[i].events & EPOLLOUT)
+            revents |= POLLOUT;
+        if(evs[i].events & (EPOLLERR | EPOLLHUP))
+            revents |= POLLERR;
+        dispatch(&loop->watchers[evs[i].data.u32], revents);
+    }
+    return cnt;
+#else
+    struct pollfd pfds[EV_MAX_WATCHERS];
+    struct ev_watcher *ws[EV_MAX_WATCHERS];
+    int i, nfds = 0, cnt;
+    for(i = 0; i < EV_MAX_WATCHERS; i++) {
+        if(loop->watchers[i].fd < 0)
+            continue;
+        pfds[nfds].fd = loop->watchers[i].fd;
+        pfds[nfds].events = loop->watchers[i].events;
+        pfds[nfds].revents = 0;
+        ws[nfds] = &loop->watchers[i];
+        nfds++;
+    }
+    cnt = poll(pfds, nfds, timer_timeout(loop, timeout_ms));
+    if(cnt < 0)
+        return (errno == EINTR) ? 0 : -1;
+    for(i = 0; i < nfds && loop->running; i++) {
+        if(pfds[i].revents && ws[i]->fd == pfds[i].fd)
+            dispatch(ws[i], pfds[i].revents);
+    }
+    if(loop->running)
+        fire_due_timer(loop);
+    return cnt;
+#endif
+}
+
+int evloop_run(struct evloop *loop)
+{
+    loop->running = 1;
+    while(loop->running) {
+        if(evloop_run_once(loop, -1) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+void evloop_stop(struct evloop *loop)
+{
+    loop->running = 0;
+}
+
+static struct ev_watcher *free_slot(struct evloop *loop)
+{
+    return find_watcher(loop, -1);
+}
+
+static struct ev_watcher *find_watcher(struct evloop *loop, int fd)
+{
+    int i;
+    for(i = 0; i < EV_MAX_WATCHERS; i++) {
+        if(loop->watchers[i].fd == fd)
+            return &loop->watchers[i];
+    }
+    return NULL;
+}
+
+static void dispatch(struct ev_watcher *w, short revents)
+{
+    if(w->fd >= 0) /* might have been removed by an earlier handler */
+        w->handler(w->fd, revents, w->data);
+}
+
+static void read_signals(int fd, short revents, void *data)
+{
+    struct evloop *loop = data;
+#ifdef __linux__
+    struct signalfd_siginfo si;
+    while(read(fd, &si, sizeof(si)) == sizeof(si)) {
+        if(loop->on_signal)
+            loop->on_signal((int)si.ssi_signo, loop->signal_data);
+    }
+#else
+    unsigned char signo;
+    while(read(fd, &signo, 1) == 1) {
+        if(loop->on_signal)
+            loop->on_signal(signo, loop->signal_data);
+    }
+#endif
+    (void)revents;
+}
+
+#ifdef __linux__
+static void read_timer(int fd, short revents, void *data)
+{
+    struct evloop *loop = data;
+    uint64_t expirations;
+    (void)revents;
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return; /* spurious wakeup */
+    if(loop->on_timer)
+        loop->on_timer((unsigned long)expirations, loop->timer_data);
+}
+#else
+static void fire_due_timer(struct evloop *loop)
+{
+    unsigned long expirations = 1;
+    long long now;
+    if(!loop->timer_next_ns)
+        return;
+    now = frame_clock_now_ns();
+    if(now < loop->timer_next_ns)
+        return;
+    if(loop->timer_period_ns) {
+        expirations += (now - loop->timer_next_ns) / loop->timer_period_ns;
+        loop->timer_next_ns += expirations*loop->timer_period_ns;
+    } else {
+        loop->timer_next_ns = 0; /* one-shot */
+    }
+    if(loop->on_timer)
+        loop->on_timer(expirations, loop->timer_data);
+}
+
+/* Shortens the timeout of poll to wake up for the timer */
+static int timer_timeout(const struct evloop *loop, int timeout_ms)
+{
+    long long left;
+    if(!loop->timer_next_ns)
+        return timeout_ms;
+    left = loop->timer_next_ns - frame_clock_now_ns();
+    if(left <= 0)
+        return 0;
+    left = (left + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+    return (timeout_ms < 0 || left < timeout_ms) ? (int)left : timeout_ms;
+}
+
+static void write_sigpipe(int signo)
+{
+    int saved_errno = errno;
+    unsigned char byte = (unsigned char)signo;
+    if(sigpipe_wr >= 0)
+        write(sigpipe_wr, &byte, 1);
+    errno = saved_errno;
+}
+#endif
@@ -0,0 +1,89 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File evloop.h
+ * Single-threaded event loop of the daemon.
+ * On Linux the process sleeps in one epoll_wait between frames: a timerfd
+ * drives the frames, a signalfd delivers SIGINT/SIGTERM and any other
+ * descriptor (libusb, sockets) is watched in the same set. Elsewhere the
+ * same interface is built on poll, a computed timeout and a self-pipe.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef EVLOOP_SENTRY
+#define EVLOOP_SENTRY
+
+#include <poll.h> /* for POLLIN & POLLOUT, used as event masks */
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h> /* for read & close */
+#include "frameclock.h" /* for frame_clock_now_ns */
+
+/* Constants */
+#define EV_MAX_WATCHERS 32
+#define EV_MAX_SIGNALS 4
+
+/* Types */
+typedef void (*ev_handler)(int fd, short revents, void *data);
+typedef void (*ev_timer_handler)(unsigned long expirations, void *data);
+typedef void (*ev_signal_handler)(int signo, void *data);
+
+struct ev_watcher {
+    int fd; /* -1 for a free slot */
+    short events;
+    ev_handler handler;
+    void *data;
+};
+
+struct evloop {
+    int running;
+    struct ev_watcher watchers[EV_MAX_WATCHERS];
+    ev_timer_handler on_timer;
+    void *timer_data;
+    ev_signal_handler on_signal;
+    void *signal_data;
+#ifdef __linux__
+    int epfd;
+    int timerfd;
+    int sigfd;
+#else
+    long long timer_next_ns; /* 0 when disarmed */
+    long long timer_period_ns;
+    int sigpipe[2];
+#endif
+};
+
+/* Functions */
+int evloop_init(struct evloop *loop);
+void evloop_free(struct evloop *loop);
+int evloop_add(struct evloop *loop, int fd, short events,
+               ev_handler handler, void *data);
+void evloop_remove(struct evloop *loop, int fd);
+int evloop_set_timer(struct evloop *loop, long long first_ns,
+                     long long period_ns, ev_timer_handler handler,
+                     void *data);
+int evloop_catch_signals(struct evloop *loop, const int *signos, int cnt,
+                         ev_signal_handler handler, void *data);
+int evloop_run_once(struct evloop *loop, int timeout_ms);
+int evloop_run(struct evloop *loop);
+void evloop_stop(struct evloop *loop);
+
+#endif
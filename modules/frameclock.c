@@ -0,0 +1,160 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File frameclock.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "frameclock.h"
+
+static long long timespec_to_ns(const struct timespec *ts);
+static void ns_to_timespec(long long ns, struct timespec *ts);
+static void sleep_until(long long deadline_ns);
+
+void frame_clock_start(struct frame_clock *fc, long period_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, &fc->epoch);
+    fc->period_ns = period_ms * NSEC_PER_MSEC;
+    fc->tick = 0;
+    memset(&fc->stats, 0, sizeof(fc->stats));
+}
+
+/* Sleeps until the next deadline. Deadlines are derived from the epoch,
+ * not from the previous wakeup, so the error of one tick doesn't carry
+ * over to the next one */
+void frame_clock_wait(struct frame_clock *fc)
+{
+    long long deadline, now;
+    fc->tick++;
+    deadline = frame_clock_deadline_ns(fc, fc->tick);
+    now = frame_clock_now_ns();
+    if(now < deadline) {
+        sleep_until(deadline);
+        now = frame_clock_now_ns();
+    } else {
+        fc->stats.late++;
+        if(now - deadline >= fc->period_ns) { /* whole slots are gone */
+            unsigned long current;
+            current = (now - frame_clock_deadline_ns(fc, 0)) / fc->period_ns;
+            fc->stats.dropped += current - fc->tick;
+            fc->tick = current;
+            deadline = frame_clock_deadline_ns(fc, fc->tick);
+        }
+    }
+    frame_stats_add(&fc->stats, now > deadline ? now - deadline : 0);
+}
+
+/* For a caller woken up by a periodic timer instead of frame_clock_wait:
+ * moves on by the number of expirations, all but the last were missed */
+void frame_clock_advance(struct frame_clock *fc, unsigned long expirations)
+{
+    long long deadline, now;
+    if(expirations > 1) {
+        fc->stats.late++;
+        fc->stats.dropped += expirations-1;
+    }
+    fc->tick += expirations;
+    deadline = frame_clock_deadline_ns(fc, fc->tick);
+    now = frame_clock_now_ns();
+    frame_stats_add(&fc->stats, now > deadline ? now - deadline : 0);
+}
+
+/* The deadline of the current tick stays, the ones after it follow the
+ * new period. Tick numbers go on, so does whatever they select */
+void frame_clock_retime(struct frame_clock *fc, long period_ms)
+{
+    long long deadline = frame_clock_deadline_ns(fc, fc->tick);
+    fc->period_ns = period_ms * NSEC_PER_MSEC;
+    ns_to_timespec(deadline - (long long)fc->tick*fc->period_ns, &fc->epoch);
+}
+
+/* Sleeps until the given fraction of the current tick's period */
+void frame_clock_wait_part(const struct frame_clock *fc, int part, int parts)
+{
+    long long deadline = frame_clock_deadline_ns(fc, fc->tick);
+    deadline += fc->period_ns * part / parts;
+    if(frame_clock_now_ns() < deadline)
+        sleep_until(deadline);
+}
+
+/* Time left until the next deadline, 0 when it has passed already */
+long frame_clock_budget_ms(const struct frame_clock *fc)
+{
+    long long left;
+    left = frame_clock_deadline_ns(fc, fc->tick+1) - frame_clock_now_ns();
+    return left > 0 ? (long)(left / NSEC_PER_MSEC) : 0;
+}
+
+long long frame_clock_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespec_to_ns(&ts);
+}
+
+long long frame_clock_deadline_ns(const struct frame_clock *fc,
+                                  unsigned long tick)
+{
+    return timespec_to_ns(&fc->epoch) + (long long)tick*fc->period_ns;
+}
+
+void frame_stats_add(struct frame_stats *st, long long late_ns)
+{
+    long long us;
+    int bucket;
+    st->ticks++;
+    st->last_late_ns = late_ns;
+    st->total_late_ns += late_ns;
+    if(late_ns > st->max_late_ns)
+        st->max_late_ns = late_ns;
+    /* Bucket i > 0 holds [2^(i-1), 2^i) microseconds */
+    for(us = late_ns / NSEC_PER_USEC, bucket = 0;
+        us > 0 && bucket < JITTER_BUCKETS-1; us >>= 1, bucket++)
+        {}
+    st->hist[bucket]++;
+}
+
+static void sleep_until(long long deadline_ns)
+{
+    struct timespec ts;
+#ifdef __APPLE__ /* no clock_nanosleep, sleep for the remaining time */
+    long long now = frame_clock_now_ns();
+    if(deadline_ns <= now)
+        return;
+    ns_to_timespec(deadline_ns - now, &ts);
+    nanosleep(&ts, NULL);
+#else
+    ns_to_timespec(deadline_ns, &ts);
+    /* A signal interrupts the sleep so that the caller may stop */
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#endif
+}
+
+static long long timespec_to_ns(const struct timespec *ts)
+{
+    return (long long)ts->tv_sec*NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void ns_to_timespec(long long ns, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)(ns / NSEC_PER_SEC);
+    ts->tv_nsec = (long)(ns % NSEC_PER_SEC);
+}
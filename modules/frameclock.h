@@ -0,0 +1,75 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File frameclock.h
+ * Deadline-based pacing of frames.
+ * Every tick has an absolute deadline on the monotonic clock, computed
+ * from the start of the animation, so transfer time and wakeup latency
+ * never accumulate into the long-run frame rate. A wait that finds one or
+ * more whole periods already gone skips those ticks instead of replaying
+ * them, so the animation resumes in phase.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef FRAMECLOCK_SENTRY
+#define FRAMECLOCK_SENTRY
+
+#include <time.h> /* for clock_gettime & clock_nanosleep */
+#include <string.h> /* for memset */
+
+/* Constants */
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
+#define NSEC_PER_USEC 1000LL
+#define JITTER_BUCKETS 16 /* <1 us, 1-2 us, 2-4 us, ... , >=16384 us */
+
+/* Structs */
+struct frame_stats {
+    unsigned long ticks; /* deadlines waited for */
+    unsigned long late; /* deadlines already passed when the wait started */
+    unsigned long dropped; /* ticks skipped to get back in phase */
+    unsigned long failed; /* frames the caller couldn't deliver */
+    long long last_late_ns; /* wakeup time minus deadline, last tick */
+    long long max_late_ns;
+    long long total_late_ns;
+    unsigned long hist[JITTER_BUCKETS]; /* lateness by powers of two */
+};
+
+struct frame_clock {
+    struct timespec epoch; /* the deadline of tick 0 */
+    long long period_ns;
+    unsigned long tick; /* index of the last deadline */
+    struct frame_stats stats;
+};
+
+/* Functions */
+void frame_clock_start(struct frame_clock *fc, long period_ms);
+void frame_clock_wait(struct frame_clock *fc);
+void frame_clock_advance(struct frame_clock *fc, unsigned long expirations);
+void frame_clock_retime(struct frame_clock *fc, long period_ms);
+void frame_clock_wait_part(const struct frame_clock *fc, int part, int parts);
+long frame_clock_budget_ms(const struct frame_clock *fc);
+long long frame_clock_now_ns(void);
+void frame_stats_add(struct frame_stats *st, long long late_ns);
+long long frame_clock_deadline_ns(const struct frame_clock *fc,
+                                  unsigned long tick);
+
+#endif
@@ -0,0 +1,180 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framering.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "framering.h"
+
+static int ring_map(struct frame_ring *r, const char *name, int oflag);
+
+/* The daemon's side. An old ring is reused so that producers that are
+ * attached already keep working */
+int ring_create(struct frame_ring *r, const char *name)
+{
+    struct ring_shm *shm;
+    if(ring_map(r, name, O_CREAT))
+        return -1;
+    shm = r->shm;
+    r->owner = 1;
+    if(shm->magic != RING_MAGIC || shm->version != RING_VERSION) {
+        memset(shm, 0, sizeof(*shm));
+        shm->version = RING_VERSION;
+        shm->slots = RING_SLOTS;
+        shm->frame_size = sizeof(struct ring_frame);
+        __atomic_store_n(&shm->magic, RING_MAGIC, __ATOMIC_RELEASE);
+    }
+    /* Frames published before the daemon started are not worth showing */
+    r->last_seq = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+    return 0;
+}
+
+/* The producer's side */
+int ring_attach(struct frame_ring *r, const char *name)
+{
+    if(ring_map(r, name, 0))
+        return -1;
+    if(__atomic_load_n(&r->shm->magic, __ATOMIC_ACQUIRE) != RING_MAGIC ||
+       r->shm->version != RING_VERSION ||
+       r->shm->frame_size != sizeof(struct ring_frame)) {
+        ring_detach(r);
+        return -1;
+    }
+    return 0;
+}
+
+void ring_detach(struct frame_ring *r)
+{
+    if(!r->shm)
+        return;
+    munmap(r->shm, sizeof(*r->shm));
+    if(r->owner)
+        shm_unlink(r->name);
+    r->shm = NULL;
+}
+
+/* Lock-free for any number of producers: every frame takes its own
+ * sequence number and the slot is guarded like a seqlock */
+void ring_publish(struct frame_ring *r, const struct ring_frame *f)
+{
+    struct ring_shm *shm = r->shm;
+    struct ring_frame *slot;
+    uint64_t seq, head;
+    seq = __atomic_add_fetch(&shm->reserve, 1, __ATOMIC_RELAXED);
+    slot = &shm->slot[seq & (RING_SLOTS-1)];
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->timestamp_ns = f->timestamp_ns ? f->timestamp_ns :
+                                           frame_clock_now_ns();
+    memcpy(slot->rgb, f->rgb, sizeof(slot->rgb));
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+    /* A slower producer of an older frame must not move the head back */
+    head = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+    while(head < seq &&
+          !__atomic_compare_exchange_n(&shm->head, &head, seq, 1,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+}
+
+/* Returns 1 and the newest frame if it wasn't returned before, 0 if
+ * there is nothing new */
+int ring_latest(struct frame_ring *r, struct ring_frame *f)
+{
+    struct ring_shm *shm = r->shm;
+    const struct ring_frame *slot;
+    uint64_t head;
+    long long age;
+    int i;
+    for(i = 0; i < RING_RETRIES; i++) {
+        head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+        if(head == r->last_seq)
+            return 0;
+        slot = &shm->slot[head & (RING_SLOTS-1)];
+        if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != head)
+            continue; /* overwritten already, a newer head is coming */
+        f->timestamp_ns = slot->timestamp_ns;
+        memcpy(f->rgb, slot->rgb, sizeof(f->rgb));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != head)
+            continue;
+        f->seq = head;
+        r->dropped += head - r->last_seq - 1;
+        r->last_seq = head;
+        r->shown++;
+        age = frame_clock_now_ns() - f->timestamp_ns;
+        r->total_age_ns += age;
+        if(age > r->max_age_ns)
+            r->max_age_ns = age;
+        return 1;
+    }
+    return 0;
+}
+
+void ring_frame_set_parts(struct ring_frame *f, const uint8_t *upper,
+                          const uint8_t *lower)
+{
+    int group;
+    for(group = 0; group < QC2S_GROUP_COUNT; group++)
+        memcpy(f->rgb[group], group < QC2S_UPPER_GROUPS ? upper : lower, 3);
+}
+
+/* One color is for every group, two are for the parts, six for the
+ * groups. Returns -1 for other counts */
+int ring_frame_set_pixels(struct ring_frame *f, const uint8_t *rgb, int cnt)
+{
+    int group;
+    if(cnt == 1) {
+        for(group = 0; group < QC2S_GROUP_COUNT; group++)
+            memcpy(f->rgb[group], rgb, 3);
+    } else if(cnt == 2) {
+        ring_frame_set_parts(f, rgb, rgb+3);
+    } else if(cnt == QC2S_GROUP_COUNT) {
+        memcpy(f->rgb, rgb, sizeof(f->rgb));
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static int ring_map(struct frame_ring *r, const char *name, int oflag)
+{
+    struct stat st;
+    void *mem;
+    int fd;
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    fd = shm_open(name, O_RDWR | oflag, 0600);
+    if(fd < 0)
+        return -1;
+    if(((oflag & O_CREAT) && ftruncate(fd, sizeof(struct ring_shm))) ||
+       fstat(fd, &st) || st.st_size < (off_t)sizeof(struct ring_shm)) {
+        close(fd); /* a short object would fault on access */
+        return -1;
+    }
+    mem = mmap(NULL, sizeof(struct ring_shm), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+    close(fd); /* the mapping stays */
+    if(mem == MAP_FAILED)
+        return -1;
+    r->shm = mem;
+    return 0;
+}
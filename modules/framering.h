@@ -0,0 +1,102 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framering.h
+ * Shared-memory ring of frames for external producers.
+ * Producers map the ring and publish timestamped colors of the six groups
+ * without locks; the display loop picks the newest frame once per tick
+ * straight from the mapping and counts the frames it never showed.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef FRAMERING_SENTRY
+#define FRAMERING_SENTRY
+
+#include <stdint.h>
+#include <string.h> /* for memcpy */
+#include <fcntl.h> /* for O_* constants */
+#include <unistd.h> /* for ftruncate & close */
+#include <sys/mman.h> /* for shm_open & mmap */
+#include <sys/stat.h> /* for fstat */
+#include "locale_macros.h"
+#include "frameclock.h" /* for frame_clock_now_ns */
+#include "qc2s_protocol.h" /* for QC2S_GROUP_COUNT & QC2S_UPPER_GROUPS */
+
+/* Constants */
+#define RING_NAME "/quadcastrgb"
+#define RING_MAGIC 0x51435247 /* "QCRG" */
+#define RING_VERSION 1
+#define RING_SLOTS 64 /* a power of two */
+#define RING_RETRIES 4 /* reads racing a producer before giving up */
+#define RING_CACHELINE 64
+#define RING_HOLD 1000 /* ms the last frame stays after producers stop */
+
+/* Messages */
+#define RING_ERR_MSG _("Couldn't set up the frame ring %s: %s\n")
+#define RING_STATS_MSG _("Ring frames: %lu shown, %lu dropped, " \
+                         "age %lld us mean, %lld us max\n")
+
+/* Structs */
+/* Colors of all groups; the upper part is groups 0-1 and the lower one
+ * groups 2-5, QuadCast S shows the first group of each part */
+struct ring_frame {
+    uint64_t seq; /* written by ring_publish, 0 while the slot changes */
+    int64_t timestamp_ns; /* CLOCK_MONOTONIC; 0 means the publish time */
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
+    uint8_t reserved[6];
+};
+
+/* The layout of the shared memory object */
+struct ring_shm {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t frame_size;
+    /* The counters are written by different parties */
+    uint64_t head __attribute__((aligned(RING_CACHELINE))); /* newest seq */
+    uint64_t reserve __attribute__((aligned(RING_CACHELINE))); /* last taken */
+    struct ring_frame slot[RING_SLOTS]
+        __attribute__((aligned(RING_CACHELINE)));
+};
+
+struct frame_ring {
+    struct ring_shm *shm;
+    const char *name; /* unlinked on detach if the ring was created */
+    int owner;
+    /* Consumer side */
+    uint64_t last_seq;
+    unsigned long shown;
+    unsigned long dropped; /* published but overtaken by newer frames */
+    long long total_age_ns;
+    long long max_age_ns;
+};
+
+/* Functions */
+int ring_create(struct frame_ring *r, const char *name);
+int ring_attach(struct frame_ring *r, const char *name);
+void ring_detach(struct frame_ring *r);
+void ring_publish(struct frame_ring *r, const struct ring_frame *f);
+int ring_latest(struct frame_ring *r, struct ring_frame *f);
+void ring_frame_set_parts(struct ring_frame *f, const uint8_t *upper,
+                          const uint8_t *lower);
+int ring_frame_set_pixels(struct ring_frame *f, const uint8_t *rgb, int cnt);
+
+#endif
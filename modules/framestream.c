@@ -0,0 +1,157 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framestream.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "framestream.h"
+
+static int next_binary(struct frame_stream *st, struct ring_frame *f);
+static int next_hex(struct frame_stream *st, struct ring_frame *f);
+static int parse_hex_line(const unsigned char *line, int len,
+                          struct ring_frame *f);
+static int parse_hex_color(const unsigned char **p, const unsigned char *end,
+                           uint8_t *rgb);
+static int hex_value(unsigned char c);
+static void consume(struct frame_stream *st, int cnt);
+
+void stream_init(struct frame_stream *st, int fd, int format)
+{
+    memset(st, 0, sizeof(*st));
+    st->fd = fd;
+    st->format = format;
+}
+
+/* One read into the free part of the buffer. Returns what read returned,
+ * 0 meaning the end of the stream */
+int stream_fill(struct frame_stream *st)
+{
+    ssize_t got;
+    if(st->len == STREAM_BUF) { /* only an overlong hex line gets here */
+        st->len = 0;
+        st->skip_line = 1;
+        st->malformed++;
+    }
+    got = read(st->fd, st->buf+st->len, STREAM_BUF-st->len);
+    if(got > 0)
+        st->len += got;
+    return (int)got;
+}
+
+/* Returns 1 and the next buffered frame or 0 if it isn't complete yet */
+int stream_next(struct frame_stream *st, struct ring_frame *f)
+{
+    int res = (st->format == stream_hex) ? next_hex(st, f) :
+                                           next_binary(st, f);
+    if(res) {
+        f->timestamp_ns = frame_clock_now_ns();
+        st->frames++;
+    }
+    return res;
+}
+
+static int next_binary(struct frame_stream *st, struct ring_frame *f)
+{
+    if(st->len < STREAM_FRAME_SIZE)
+        return 0;
+    memcpy(f->rgb, st->buf, STREAM_FRAME_SIZE);
+    consume(st, STREAM_FRAME_SIZE);
+    return 1;
+}
+
+static int next_hex(struct frame_stream *st, struct ring_frame *f)
+{
+    const unsigned char *nl;
+    int len;
+    while((nl = memchr(st->buf, '\n', st->len))) {
+        len = nl - st->buf;
+        if(st->skip_line) {
+            st->skip_line = 0;
+        } else if(parse_hex_line(st->buf, len, f)) {
+            consume(st, len+1);
+            return 1;
+        } else if(len > 0) {
+            st->malformed++;
+        }
+        consume(st, len+1);
+    }
+    return 0;
+}
+
+static int parse_hex_line(const unsigned char *line, int len,
+                          struct ring_frame *f)
+{
+    const unsigned char *p = line, *end = line+len;
+    uint8_t colors[QC2S_GROUP_COUNT][3];
+    int cnt = 0;
+    while(p < end) {
+        if(*p == ' ' || *p == '\t' || *p == '\r') {
+            p++;
+            continue;
+        }
+        if(cnt == QC2S_GROUP_COUNT || !parse_hex_color(&p, end, colors[cnt]))
+            return 0;
+        cnt++;
+    }
+    return ring_frame_set_pixels(f, colors[0], cnt) == 0;
+}
+
+/* "rrggbb" or "#rrggbb" */
+static int parse_hex_color(const unsigned char **p, const unsigned char *end,
+                           uint8_t *rgb)
+{
+    const unsigned char *s = *p;
+    int i, hi, lo;
+    if(*s == '#')
+        s++;
+    if(end - s < 6)
+        return 0;
+    for(i = 0; i < 3; i++) {
+        hi = hex_value(s[2*i]);
+        lo = hex_value(s[2*i+1]);
+        if(hi < 0 || lo < 0)
+            return 0;
+        rgb[i] = (uint8_t)(hi << 4 | lo);
+    }
+    s += 6;
+    if(s < end && *s != ' ' && *s != '\t' && *s != '\r')
+        return 0;
+    *p = s;
+    return 1;
+}
+
+static int hex_value(unsigned char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static void consume(struct frame_stream *st, int cnt)
+{
+    st->len -= cnt;
+    memmove(st->buf, st->buf+cnt, st->len);
+}
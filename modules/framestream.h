@@ -0,0 +1,65 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File framestream.h
+ * Frames read from a pipe, for the stream mode.
+ * Binary frames are the 18 bytes of the six groups' colors; hex lines
+ * hold one color for everything, two for the upper and lower parts, or
+ * six for the groups. Parsing never allocates; the caller decides when
+ * to read, which is how the producer gets back-pressure.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef FRAMESTREAM_SENTRY
+#define FRAMESTREAM_SENTRY
+
+#include <unistd.h> /* for read */
+#include <string.h> /* for memcpy & memmove */
+#include <errno.h>
+#include "locale_macros.h"
+#include "argparser.h" /* for enum stream_formats */
+#include "framering.h" /* for struct ring_frame */
+
+/* Constants */
+#define STREAM_BUF 4096
+#define STREAM_FRAME_SIZE (QC2S_GROUP_COUNT*3) /* binary */
+
+/* Messages */
+#define STREAM_STATS_MSG _("Stream: %lu frames shown, %lu dropped, " \
+                           "%lu malformed, %.1f fps sustained\n")
+
+/* Structs */
+struct frame_stream {
+    int fd;
+    int format; /* stream_bin or stream_hex */
+    unsigned char buf[STREAM_BUF];
+    int len;
+    int skip_line; /* the rest of an overlong hex line is thrown away */
+    unsigned long frames; /* complete frames parsed */
+    unsigned long malformed; /* hex lines that weren't frames */
+};
+
+/* Functions */
+void stream_init(struct frame_stream *st, int fd, int format);
+int stream_fill(struct frame_stream *st);
+int stream_next(struct frame_stream *st, struct ring_frame *f);
+
+#endif
@@ -0,0 +1,244 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File netrecv.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "netrecv.h"
+
+static int parse_e131(struct net_receiver *nr, const uint8_t *pkt, int len,
+                      struct ring_frame *f);
+static int parse_ddp(struct net_receiver *nr, const uint8_t *pkt, int len,
+                     struct ring_frame *f);
+static int take_pixels(const struct net_receiver *nr, const uint8_t *data,
+                       int cnt, struct ring_frame *f);
+static void join_universe(int fd, int universe);
+static uint32_t get_be32(const uint8_t *p);
+static uint16_t get_be16(const uint8_t *p);
+static void put_be32(uint8_t *p, uint32_t v);
+static void put_be16(uint8_t *p, uint16_t v);
+
+/* Port 0 means the protocol's own port */
+int net_open(struct net_receiver *nr, int proto, int port, int universe,
+             int channel, int pixels)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+    memset(nr, 0, sizeof(*nr));
+    nr->proto = proto;
+    nr->port = port ? port : proto == net_e131 ? E131_PORT : DDP_PORT;
+    nr->universe = universe;
+    nr->channel = channel;
+    nr->pixels = pixels;
+    nr->last_seq = -1;
+    nr->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(nr->fd < 0)
+        return -1;
+    setsockopt(nr->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(nr->port);
+    if(bind(nr->fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(nr->fd);
+        nr->fd = -1;
+        return -1;
+    }
+    if(proto == net_e131)
+        join_universe(nr->fd, universe);
+    return 0;
+}
+
+void net_close(struct net_receiver *nr)
+{
+    if(nr->fd >= 0)
+        close(nr->fd);
+    nr->fd = -1;
+}
+
+/* Reads every queued datagram. Returns the number of frames they made,
+ * f is the newest one */
+int net_receive(struct net_receiver *nr, struct ring_frame *f)
+{
+    uint8_t pkt[NET_MAX_DATAGRAM];
+    ssize_t len;
+    int frames = 0;
+    while((len = recv(nr->fd, pkt, sizeof(pkt), MSG_DONTWAIT)) >= 0)
+        frames += net_parse(nr, pkt, (int)len, f);
+    return frames;
+}
+
+/* Returns 1 if the datagram completed a frame */
+int net_parse(struct net_receiver *nr, const uint8_t *pkt, int len,
+              struct ring_frame *f)
+{
+    int res;
+    nr->datagrams++;
+    res = (nr->proto == net_e131) ? parse_e131(nr, pkt, len, f) :
+                                    parse_ddp(nr, pkt, len, f);
+    if(res < 0) {
+        nr->malformed++;
+        return 0;
+    }
+    if(res) {
+        f->timestamp_ns = frame_clock_now_ns();
+        nr->frames++;
+    }
+    return res;
+}
+
+static int parse_e131(struct net_receiver *nr, const uint8_t *pkt, int len,
+                      struct ring_frame *f)
+{
+    int seq, values;
+    if(len < E131_HEADER_LEN ||
+       memcmp(pkt+E131_OFS_ACN_ID, E131_ACN_ID, E131_ACN_ID_LEN) ||
+       get_be32(pkt+E131_OFS_ROOT_VECTOR) != E131_VECTOR_ROOT ||
+       get_be32(pkt+E131_OFS_FRAME_VECTOR) != E131_VECTOR_FRAME ||
+       pkt[E131_OFS_DMP_VECTOR] != E131_VECTOR_DMP ||
+       get_be16(pkt+E131_OFS_UNIVERSE) != nr->universe)
+        return -1;
+    if(pkt[E131_OFS_OPTIONS] & (E131_OPT_PREVIEW | E131_OPT_TERMINATED))
+        return 0;
+    if(pkt[E131_OFS_START_CODE] != 0) /* not dimmer data */
+        return 0;
+    /* Reordered datagrams are older than the last one by a little */
+    seq = pkt[E131_OFS_SEQUENCE];
+    if(nr->last_seq >= 0) {
+        int diff = (signed char)(seq - nr->last_seq);
+        if(diff <= 0 && diff > -E131_SEQ_WINDOW)
+            return -1;
+    }
+    nr->last_seq = seq;
+    values = get_be16(pkt+E131_OFS_VALUE_CNT) - 1; /* minus start code */
+    if(values > len - E131_HEADER_LEN)
+        return -1;
+    return take_pixels(nr, pkt+E131_HEADER_LEN, values, f);
+}
+
+/* The data is placed by its byte offset; the frame is complete when a
+ * datagram with the push flag comes */
+static int parse_ddp(struct net_receiver *nr, const uint8_t *pkt, int len,
+                     struct ring_frame *f)
+{
+    int header = DDP_HEADER_LEN;
+    uint32_t offset;
+    int cnt;
+    if(len < DDP_HEADER_LEN || (pkt[0] & DDP_VER_MASK) != DDP_VER1)
+        return -1;
+    if(pkt[0] & DDP_FLAG_TIMECODE)
+        header += DDP_TIMECODE_LEN;
+    if(pkt[3] != DDP_ID_DISPLAY)
+        return 0; /* status & config queries aren't answered */
+    offset = get_be32(pkt+4);
+    cnt = get_be16(pkt+8);
+    if(len < header || cnt > len - header)
+        return -1;
+    if(offset < NET_CHANNELS) {
+        if(cnt > NET_CHANNELS - (int)offset)
+            cnt = NET_CHANNELS - offset;
+        memcpy(nr->data+offset, pkt+header, cnt);
+    }
+    if(!(pkt[0] & DDP_FLAG_PUSH))
+        return 0;
+    return take_pixels(nr, nr->data, NET_CHANNELS, f);
+}
+
+static int take_pixels(const struct net_receiver *nr, const uint8_t *data,
+                       int cnt, struct ring_frame *f)
+{
+    int first = nr->channel - 1;
+    if(first + 3*nr->pixels > cnt)
+        return -1; /* the sender doesn't cover our channels */
+    return ring_frame_set_pixels(f, data+first, nr->pixels) ? -1 : 1;
+}
+
+/* Builds a datagram carrying cnt channels, for senders & tests.
+ * Returns its length */
+int net_build(int proto, int universe, uint8_t seq, const uint8_t *channels,
+              int cnt, uint8_t *pkt)
+{
+    if(proto == net_ddp) {
+        memset(pkt, 0, DDP_HEADER_LEN);
+        pkt[0] = DDP_VER1 | DDP_FLAG_PUSH;
+        pkt[1] = seq & 0x0f;
+        pkt[3] = DDP_ID_DISPLAY;
+        put_be16(pkt+8, (uint16_t)cnt);
+        memcpy(pkt+DDP_HEADER_LEN, channels, cnt);
+        return DDP_HEADER_LEN + cnt;
+    }
+    memset(pkt, 0, E131_HEADER_LEN);
+    put_be16(pkt, 0x0010); /* preamble size */
+    memcpy(pkt+E131_OFS_ACN_ID, E131_ACN_ID, E131_ACN_ID_LEN);
+    put_be16(pkt+E131_OFS_ROOT_FLAGS,
+             E131_FLAGS | (E131_HEADER_LEN+cnt-E131_OFS_ROOT_FLAGS));
+    put_be32(pkt+E131_OFS_ROOT_VECTOR, E131_VECTOR_ROOT);
+    put_be16(pkt+E131_OFS_FRAME_FLAGS,
+             E131_FLAGS | (E131_HEADER_LEN+cnt-E131_OFS_FRAME_FLAGS));
+    put_be32(pkt+E131_OFS_FRAME_VECTOR, E131_VECTOR_FRAME);
+    memcpy(pkt+E131_OFS_SOURCE, "quadcastrgb", 11);
+    pkt[E131_OFS_PRIORITY] = E131_PRIORITY;
+    pkt[E131_OFS_SEQUENCE] = seq;
+    put_be16(pkt+E131_OFS_UNIVERSE, (uint16_t)universe);
+    put_be16(pkt+E131_OFS_DMP_FLAGS,
+             E131_FLAGS | (E131_HEADER_LEN+cnt-E131_OFS_DMP_FLAGS));
+    pkt[E131_OFS_DMP_VECTOR] = E131_VECTOR_DMP;
+    pkt[E131_OFS_ADDR_TYPE] = E131_ADDR_TYPE;
+    put_be16(pkt+E131_OFS_ADDR_INC, 1);
+    put_be16(pkt+E131_OFS_VALUE_CNT, (uint16_t)(cnt+1)); /* + start code */
+    memcpy(pkt+E131_HEADER_LEN, channels, cnt);
+    return E131_HEADER_LEN + cnt;
+}
+
+/* Senders multicast to 239.255.<universe>; unicast works either way */
+static void join_universe(int fd, int universe)
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = htonl(0xefff0000 | (universe & 0xffff));
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+}
+
+static uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v;
+}
@@ -0,0 +1,123 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File netrecv.h
+ * UDP receiver for lighting software: E1.31 (sACN) and DDP.
+ * Channel data from the configured start channel is read as RGB pixels:
+ * one for the whole microphone, two for the upper and lower parts, or six
+ * for the groups of QuadCast 2S. Datagrams are parsed in place; a burst
+ * of them leaves only the newest frame.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef NETRECV_SENTRY
+#define NETRECV_SENTRY
+
+#include <stdint.h>
+#include <string.h> /* for memcmp & memcpy */
+#include <unistd.h> /* for close */
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h> /* for struct sockaddr_in & htons */
+#include "locale_macros.h"
+#include "argparser.h" /* for enum net_protocols */
+#include "framering.h" /* for struct ring_frame */
+
+/* Constants */
+#define E131_PORT 5568
+#define DDP_PORT 4048
+#define NET_CHANNELS 512 /* a DMX universe, also the span kept for DDP */
+#define NET_MAX_DATAGRAM 1500
+#define NET_MAX_UNIVERSE 63999
+/* E1.31 */
+#define E131_ACN_ID "ASC-E1.17\0\0\0"
+#define E131_ACN_ID_LEN 12
+#define E131_VECTOR_ROOT 0x00000004
+#define E131_VECTOR_FRAME 0x00000002
+#define E131_VECTOR_DMP 0x02
+#define E131_OFS_ACN_ID 4
+#define E131_OFS_ROOT_FLAGS 16
+#define E131_OFS_ROOT_VECTOR 18
+#define E131_OFS_FRAME_FLAGS 38
+#define E131_OFS_FRAME_VECTOR 40
+#define E131_OFS_SOURCE 44
+#define E131_OFS_PRIORITY 108
+#define E131_OFS_SEQUENCE 111
+#define E131_OFS_OPTIONS 112
+#define E131_OFS_UNIVERSE 113
+#define E131_OFS_DMP_FLAGS 115
+#define E131_OFS_DMP_VECTOR 117
+#define E131_OFS_ADDR_TYPE 118
+#define E131_OFS_ADDR_INC 121
+#define E131_OFS_VALUE_CNT 123
+#define E131_OFS_START_CODE 125
+#define E131_HEADER_LEN 126 /* the first DMX channel follows */
+#define E131_MAX_DATAGRAM (E131_HEADER_LEN + NET_CHANNELS)
+#define E131_FLAGS 0x7000 /* of every layer's length field */
+#define E131_ADDR_TYPE 0xa1
+#define E131_PRIORITY 100
+#define E131_OPT_PREVIEW 0x80
+#define E131_OPT_TERMINATED 0x40
+#define E131_SEQ_WINDOW 20 /* older sequence numbers are discarded */
+/* DDP */
+#define DDP_HEADER_LEN 10
+#define DDP_TIMECODE_LEN 4
+#define DDP_VER_MASK 0xc0
+#define DDP_VER1 0x40
+#define DDP_FLAG_TIMECODE 0x10
+#define DDP_FLAG_PUSH 0x01
+#define DDP_ID_DISPLAY 1
+
+/* Messages */
+#define NET_ERR_MSG _("Couldn't listen on UDP port %d: %s\n")
+#define NET_STATS_MSG _("Network: %lu datagrams, %lu frames, %lu shown, " \
+                        "%lu malformed, age %lld us mean, %lld us max\n")
+
+/* Structs */
+struct net_receiver {
+    int fd;
+    int proto;
+    int port;
+    int universe; /* E1.31 only */
+    int channel; /* the first channel of the pixels, from 1 */
+    int pixels; /* 1, 2 or QC2S_GROUP_COUNT */
+    int last_seq; /* E1.31, -1 before the first datagram */
+    uint8_t data[NET_CHANNELS]; /* DDP frames arrive in parts */
+    unsigned long datagrams;
+    unsigned long frames;
+    unsigned long malformed; /* including other universes & stale ones */
+    /* Kept by the display loop */
+    unsigned long shown;
+    long long total_age_ns;
+    long long max_age_ns;
+};
+
+/* Functions */
+int net_open(struct net_receiver *nr, int proto, int port, int universe,
+             int channel, int pixels);
+void net_close(struct net_receiver *nr);
+int net_receive(struct net_receiver *nr, struct ring_frame *f);
+int net_parse(struct net_receiver *nr, const uint8_t *pkt, int len,
+              struct ring_frame *f);
+int net_build(int proto, int universe, uint8_t seq, const uint8_t *channels,
+              int cnt, uint8_t *pkt);
+
+#endif
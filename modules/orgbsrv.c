@@ -0,0 +1,401 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File orgbsrv.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "orgbsrv.h"
+
+static struct orgb_client *find_client(struct orgb_server *srv, int fd);
+static void drop_client(struct orgb_client *c);
+static int handle_packet(struct orgb_server *srv, struct orgb_client *c);
+static int update_leds(struct orgb_server *srv, uint32_t id,
+                       const uint8_t *data, uint32_t size);
+static void set_leds(struct orgb_server *srv, int first, const uint8_t *colors,
+                     int cnt);
+static int describe(const struct orgb_server *srv, int protocol, uint8_t *buf);
+static int send_reply(struct orgb_client *c, uint32_t dev, uint32_t id,
+                      const uint8_t *data, uint32_t size);
+static void put_string(uint8_t **p, const char *str);
+static void put_le32(uint8_t **p, uint32_t v);
+static void put_le16(uint8_t **p, uint16_t v);
+static uint32_t get_le32(const uint8_t *p);
+static uint16_t get_le16(const uint8_t *p);
+
+/* Listens on the loopback only. Port 0 picks a free one, srv->port tells
+ * which */
+int orgb_listen(struct orgb_server *srv, int port, int qc2s)
+{
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+    int i, one = 1;
+    memset(srv, 0, sizeof(*srv));
+    for(i = 0; i < ORGB_MAX_CLIENTS; i++)
+        srv->clients[i].fd = -1;
+    srv->port = port;
+    srv->zone_leds[0] = qc2s ? QC2S_UPPER_GROUPS : 1;
+    srv->zone_leds[1] = qc2s ? QC2S_GROUP_COUNT - QC2S_UPPER_GROUPS : 1;
+    srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(srv->fd < 0)
+        return -1;
+    setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if(bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+       listen(srv->fd, ORGB_MAX_CLIENTS) ||
+       getsockname(srv->fd, (struct sockaddr *)&addr, &addrlen)) {
+        close(srv->fd);
+        srv->fd = -1;
+        return -1;
+    }
+    srv->port = ntohs(addr.sin_port);
+    fcntl(srv->fd, F_SETFL, fcntl(srv->fd, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+void orgb_close(struct orgb_server *srv)
+{
+    int i;
+    for(i = 0; i < ORGB_MAX_CLIENTS; i++)
+        drop_client(&srv->clients[i]);
+    if(srv->fd >= 0)
+        close(srv->fd);
+    srv->fd = -1;
+}
+
+/* Returns the socket of the new client, or -1 if there is none or no
+ * room for it */
+int orgb_accept(struct orgb_server *srv)
+{
+    struct orgb_client *c;
+    int fd;
+    fd = accept(srv->fd, NULL, NULL);
+    if(fd < 0)
+        return -1;
+    c = find_client(srv, -1);
+    if(!c) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    c->fd = fd;
+    c->protocol = 0;
+    c->len = 0;
+    return fd;
+}
+
+/* Handles every complete packet the client has sent. Returns -1 once the
+ * client is gone and its socket is closed */
+int orgb_serve(struct orgb_server *srv, int fd)
+{
+    struct orgb_client *c;
+    ssize_t res;
+    uint32_t size;
+    int want;
+    c = find_client(srv, fd);
+    if(!c)
+        return -1;
+    for(;;) {
+        /* The header first, then exactly the data it announces */
+        want = ORGB_HEADER_LEN;
+        if(c->len >= ORGB_HEADER_LEN) {
+            /* Checked before it's added: any 32-bit size can come */
+            size = get_le32(c->buf+12);
+            if(size > ORGB_MAX_PACKET - ORGB_HEADER_LEN) {
+                srv->malformed++;
+                break;
+            }
+            want += size;
+        }
+        if(c->len == want) {
+            if(handle_packet(srv, c))
+                break;
+            c->len = 0;
+            continue;
+        }
+        res = recv(c->fd, c->buf+c->len, want - c->len, MSG_DONTWAIT);
+        if(res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 0;
+        if(res <= 0)
+            break;
+        c->len += res;
+    }
+    drop_client(c);
+    return -1;
+}
+
+void orgb_drop(struct orgb_server *srv, int fd)
+{
+    struct orgb_client *c = find_client(srv, fd);
+    if(c)
+        drop_client(c);
+}
+
+/* Writes the kept colors to f. Returns 1 if they changed since the last
+ * call */
+int orgb_take_frame(struct orgb_server *srv, struct ring_frame *f)
+{
+    const int lower_groups = QC2S_GROUP_COUNT - QC2S_UPPER_GROUPS;
+    int g, led, changed;
+    for(g = 0; g < QC2S_GROUP_COUNT; g++) {
+        if(g < QC2S_UPPER_GROUPS)
+            led = g*srv->zone_leds[0]/QC2S_UPPER_GROUPS;
+        else
+            led = srv->zone_leds[0] +
+                  (g - QC2S_UPPER_GROUPS)*srv->zone_leds[1]/lower_groups;
+        memcpy(f->rgb[g], srv->colors[led], 3);
+    }
+    f->timestamp_ns = srv->updated_ns;
+    changed = srv->dirty;
+    srv->dirty = 0;
+    return changed;
+}
+
+static struct orgb_client *find_client(struct orgb_server *srv, int fd)
+{
+    int i;
+    for(i = 0; i < ORGB_MAX_CLIENTS; i++)
+        if(srv->clients[i].fd == fd)
+            return &srv->clients[i];
+    return NULL;
+}
+
+static void drop_client(struct orgb_client *c)
+{
+    if(c->fd >= 0)
+        close(c->fd);
+    c->fd = -1;
+    c->len = 0;
+}
+
+/* Returns -1 if the client has to be dropped */
+static int handle_packet(struct orgb_server *srv, struct orgb_client *c)
+{
+    uint8_t reply[ORGB_MAX_PACKET];
+    uint8_t *p = reply;
+    const uint8_t *data = c->buf + ORGB_HEADER_LEN;
+    uint32_t dev, id, size, version;
+    if(memcmp(c->buf, ORGB_MAGIC, 4)) {
+        srv->malformed++;
+        return -1;
+    }
+    dev = get_le32(c->buf+4);
+    id = get_le32(c->buf+8);
+    size = get_le32(c->buf+12);
+    srv->packets++;
+    switch(id) {
+    case ORGB_REQUEST_PROTOCOL_VERSION:
+        version = size >= 4 ? get_le32(data) : 0;
+        c->protocol = version < ORGB_PROTOCOL_VERSION ? version :
+                                                        ORGB_PROTOCOL_VERSION;
+        put_le32(&p, ORGB_PROTOCOL_VERSION);
+        return send_reply(c, dev, id, reply, 4);
+    case ORGB_REQUEST_CONTROLLER_COUNT:
+        put_le32(&p, 1);
+        return send_reply(c, dev, id, reply, 4);
+    case ORGB_REQUEST_CONTROLLER_DATA:
+        if(dev != 0)
+            return 0;
+        /* Clients ask for the version they know, never above the agreed */
+        version = size >= 4 ? get_le32(data) : (uint32_t)c->protocol;
+        if(version > ORGB_PROTOCOL_VERSION)
+            version = ORGB_PROTOCOL_VERSION;
+        return send_reply(c, dev, id, reply, describe(srv, version, reply));
+    case ORGB_UPDATELEDS:
+    case ORGB_UPDATEZONELEDS:
+    case ORGB_UPDATESINGLELED:
+        if(dev != 0 || update_leds(srv, id, data, size))
+            srv->malformed++;
+        return 0;
+    default: /* names, modes & zone sizes have nothing to change */
+        return 0;
+    }
+}
+
+/* Returns -1 for a malformed update */
+static int update_leds(struct orgb_server *srv, uint32_t id,
+                       const uint8_t *data, uint32_t size)
+{
+    int first = 0, cnt, zone, total;
+    total = srv->zone_leds[0] + srv->zone_leds[1];
+    if(id == ORGB_UPDATESINGLELED) {
+        if(size < 8 || (int32_t)get_le32(data) < 0 ||
+           (int32_t)get_le32(data) >= total)
+            return -1;
+        set_leds(srv, get_le32(data), data+4, 1);
+        return 0;
+    }
+    /* The data begins with its own size */
+    if(id == ORGB_UPDATEZONELEDS) {
+        if(size < 10)
+            return -1;
+        zone = (int)get_le32(data+4);
+        if(zone < 0 || zone > 1)
+            return -1;
+        first = zone ? srv->zone_leds[0] : 0;
+        total = srv->zone_leds[zone];
+        data += 4;
+        size -= 4;
+    }
+    if(size < 6)
+        return -1;
+    cnt = get_le16(data+4);
+    if(6 + 4*(uint32_t)cnt > size)
+        return -1;
+    set_leds(srv, first, data+6, cnt < total ? cnt : total);
+    return 0;
+}
+
+/* The colors are R, G, B & a padding byte each */
+static void set_leds(struct orgb_server *srv, int first, const uint8_t *colors,
+                     int cnt)
+{
+    int i, changed = !srv->lit;
+    for(i = 0; i < cnt; i++, colors += 4) {
+        if(memcmp(srv->colors[first+i], colors, 3)) {
+            memcpy(srv->colors[first+i], colors, 3);
+            changed = 1;
+        }
+    }
+    srv->updates++;
+    srv->lit = 1;
+    if(!changed) {
+        srv->redundant++;
+        return;
+    }
+    srv->dirty = 1;
+    srv->updated_ns = frame_clock_now_ns();
+}
+
+/* The controller data block of the given protocol version, one "Direct"
+ * mode and the zones. Returns its size */
+static int describe(const struct orgb_server *srv, int protocol, uint8_t *buf)
+{
+    static const char *zone_names[2] = { "Upper", "Lower" };
+    char name[16];
+    uint8_t *p = buf + 4; /* the size goes first */
+    int zone, led, total;
+    total = srv->zone_leds[0] + srv->zone_leds[1];
+    put_le32(&p, ORGB_DEVICE_MICROPHONE);
+    put_string(&p, total == QC2S_GROUP_COUNT ? ORGB_NAME_QC2S : ORGB_NAME);
+    if(protocol >= 1)
+        put_string(&p, ORGB_VENDOR);
+    put_string(&p, ORGB_DESCRIPTION);
+    put_string(&p, ""); /* version */
+    put_string(&p, ""); /* serial */
+    put_string(&p, ORGB_LOCATION);
+    put_le16(&p, 1); /* modes */
+    put_le32(&p, 0); /* the active one */
+    put_string(&p, "Direct");
+    put_le32(&p, 0); /* value */
+    put_le32(&p, ORGB_MODE_PER_LED_COLOR);
+    put_le32(&p, 0); /* speed min */
+    put_le32(&p, 0); /* speed max */
+    if(protocol >= 3) {
+        put_le32(&p, 0); /* brightness min */
+        put_le32(&p, 0); /* brightness max */
+    }
+    put_le32(&p, 0); /* colors min */
+    put_le32(&p, 0); /* colors max */
+    put_le32(&p, 0); /* speed */
+    if(protocol >= 3)
+        put_le32(&p, 0); /* brightness */
+    put_le32(&p, 0); /* direction */
+    put_le32(&p, ORGB_COLORS_PER_LED);
+    put_le16(&p, 0); /* mode colors */
+    put_le16(&p, 2);
+    for(zone = 0; zone < 2; zone++) {
+        put_string(&p, zone_names[zone]);
+        put_le32(&p, ORGB_ZONE_LINEAR);
+        put_le32(&p, srv->zone_leds[zone]); /* min */
+        put_le32(&p, srv->zone_leds[zone]); /* max */
+        put_le32(&p, srv->zone_leds[zone]);
+        put_le16(&p, 0); /* no matrix */
+    }
+    put_le16(&p, total);
+    for(led = 0; led < total; led++) {
+        zone = led >= srv->zone_leds[0];
+        sprintf(name, "%s %d", zone_names[zone],
+                led - (zone ? srv->zone_leds[0] : 0) + 1);
+        put_string(&p, name);
+        put_le32(&p, led); /* value */
+    }
+    put_le16(&p, total);
+    for(led = 0; led < total; led++) {
+        memcpy(p, srv->colors[led], 3);
+        p[3] = 0;
+        p += 4;
+    }
+    total = p - buf;
+    p = buf;
+    put_le32(&p, total);
+    return total;
+}
+
+/* Returns -1 if the client can't take the whole reply */
+static int send_reply(struct orgb_client *c, uint32_t dev, uint32_t id,
+                      const uint8_t *data, uint32_t size)
+{
+    uint8_t pkt[ORGB_HEADER_LEN + ORGB_MAX_PACKET];
+    uint8_t *p = pkt + 4;
+    memcpy(pkt, ORGB_MAGIC, 4);
+    put_le32(&p, dev);
+    put_le32(&p, id);
+    put_le32(&p, size);
+    memcpy(p, data, size);
+    return send(c->fd, pkt, ORGB_HEADER_LEN + size, 0) ==
+           (ssize_t)(ORGB_HEADER_LEN + size) ? 0 : -1;
+}
+
+/* The length includes the terminating zero, which is sent too */
+static void put_string(uint8_t **p, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    put_le16(p, len);
+    memcpy(*p, str, len);
+    *p += len;
+}
+
+static void put_le32(uint8_t **p, uint32_t v)
+{
+    put_le16(p, v & 0xffff);
+    put_le16(p, v >> 16);
+}
+
+static void put_le16(uint8_t **p, uint16_t v)
+{
+    (*p)[0] = v & 0xff;
+    (*p)[1] = v >> 8;
+    *p += 2;
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | (uint32_t)get_le16(p+2) << 16;
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
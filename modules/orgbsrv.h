@@ -0,0 +1,111 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File orgbsrv.h
+ * OpenRGB SDK server: lighting software such as OpenRGB sees the
+ * microphone as a device with the zones Upper & Lower, whose LEDs are the
+ * six groups of QuadCast 2S (one LED per zone on the older models).
+ * Updates only change the kept colors, so any number of them between two
+ * frames costs a single frame on USB.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef ORGBSRV_SENTRY
+#define ORGBSRV_SENTRY
+
+#include <stdio.h> /* for sprintf */
+#include <stdint.h>
+#include <string.h> /* for memcpy & memcmp */
+#include <unistd.h> /* for close */
+#include <fcntl.h> /* for O_NONBLOCK */
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h> /* for struct sockaddr_in & htons */
+#include "locale_macros.h"
+#include "framering.h" /* for struct ring_frame */
+#include "qc2s_protocol.h" /* for QC2S_GROUP_COUNT & QC2S_UPPER_GROUPS */
+
+/* Constants */
+#define ORGB_MAGIC "ORGB"
+#define ORGB_HEADER_LEN 16 /* magic, device index, packet id & data size */
+#define ORGB_PROTOCOL_VERSION 3 /* modes with brightness, no segments */
+#define ORGB_MAX_PACKET 1024 /* a header & its data */
+#define ORGB_MAX_CLIENTS 8
+#define ORGB_LED_MAX QC2S_GROUP_COUNT
+/* Packet ids */
+#define ORGB_REQUEST_CONTROLLER_COUNT 0
+#define ORGB_REQUEST_CONTROLLER_DATA 1
+#define ORGB_REQUEST_PROTOCOL_VERSION 40
+#define ORGB_SET_CLIENT_NAME 50
+#define ORGB_RESIZEZONE 1000
+#define ORGB_UPDATELEDS 1050
+#define ORGB_UPDATEZONELEDS 1051
+#define ORGB_UPDATESINGLELED 1052
+#define ORGB_SETCUSTOMMODE 1100
+#define ORGB_UPDATEMODE 1101
+/* The controller description */
+#define ORGB_DEVICE_MICROPHONE 16
+#define ORGB_ZONE_LINEAR 1
+#define ORGB_MODE_PER_LED_COLOR 0x20 /* mode flag */
+#define ORGB_COLORS_PER_LED 1 /* color mode */
+#define ORGB_NAME "HyperX QuadCast S"
+#define ORGB_NAME_QC2S "HyperX QuadCast 2S"
+#define ORGB_VENDOR "HyperX"
+#define ORGB_DESCRIPTION "quadcastrgb"
+#define ORGB_LOCATION "USB"
+
+/* Messages */
+#define ORGB_ERR_MSG _("Couldn't listen for OpenRGB on TCP port %d: %s\n")
+#define ORGB_STATS_MSG _("OpenRGB: %lu packets, %lu updates, " \
+                         "%lu redundant, %lu malformed\n")
+
+/* Structs */
+struct orgb_client {
+    int fd; /* -1 for a free slot */
+    int protocol; /* agreed on, 0 until the client asks */
+    int len; /* of the packet gathered in buf */
+    uint8_t buf[ORGB_MAX_PACKET];
+};
+
+struct orgb_server {
+    int fd;
+    int port;
+    int zone_leds[2]; /* upper & lower */
+    uint8_t colors[ORGB_LED_MAX][3]; /* of the LEDs in the zone order */
+    int lit; /* a client has set the colors */
+    int dirty; /* they changed since orgb_take_frame */
+    int64_t updated_ns; /* when they changed */
+    struct orgb_client clients[ORGB_MAX_CLIENTS];
+    unsigned long packets;
+    unsigned long updates;
+    unsigned long redundant; /* updates that changed nothing */
+    unsigned long malformed;
+};
+
+/* Functions */
+int orgb_listen(struct orgb_server *srv, int port, int qc2s);
+void orgb_close(struct orgb_server *srv);
+int orgb_accept(struct orgb_server *srv);
+int orgb_serve(struct orgb_server *srv, int fd);
+void orgb_drop(struct orgb_server *srv, int fd);
+int orgb_take_frame(struct orgb_server *srv, struct ring_frame *f);
+
+#endif
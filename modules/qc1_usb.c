@@ -0,0 +1,363 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc1_usb.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include <stdlib.h>
+#include "qc1_usb.h"
+#include "usbdev.h"
+
+/* A frame in flight: its header & data transfers, each a control setup
+ * followed by the packet */
+struct qc1_slot {
+    struct qc1_pipe *pipe;
+    struct libusb_transfer *xfer[2];
+    int busy; /* transfers not completed yet */
+    int quiet; /* its failure was returned already */
+};
+
+struct qc1_pipe {
+    struct qc1_slot slot[QC1_PIPE_DEPTH];
+    unsigned char *buf; /* of all transfers */
+    int dev_mem; /* buf comes from libusb_dev_mem_alloc */
+    int next; /* slot of the next frame */
+    int result; /* a failure of a completed frame, not returned yet */
+};
+
+static int qc1_open(struct micro *m, struct libusb_device *dev,
+                    long long *claim_ns);
+static int qc1_send(struct micro *m, int group, unsigned int timeout);
+static int qc1_upload(struct micro *m, const datpack *packets, int cnt,
+                      unsigned int timeout);
+static int qc1_readback(struct micro *m, const datpack *packets, int cnt,
+                        unsigned int timeout);
+static int qc1_recover(struct micro *m);
+static void qc1_close(struct micro *m);
+static struct qc1_pipe *pipe_alloc(libusb_device_handle *handle);
+static void pipe_free(struct qc1_pipe *p, libusb_device_handle *handle);
+static int pipe_wait(struct qc1_slot *s, unsigned int timeout);
+static void pipe_drain(struct qc1_pipe *p);
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *xfer);
+static void fill_display_header(byte_t *header_packet, int cnt);
+static short send_display_command(byte_t *packet,
+                                  libusb_device_handle *handle,
+                                  unsigned int timeout);
+static void ring_colcommand(const struct ring_frame *f, byte_t *colcommand);
+
+const struct transport qc1_transport = {
+    qc1_open, qc1_send, qc1_upload, qc1_readback, qc1_recover, qc1_close, 0
+};
+
+/* Without the transfers of the pipeline, frames are sent synchronously */
+static int qc1_open(struct micro *m, struct libusb_device *dev,
+                    long long *claim_ns)
+{
+    if(usb_open(m, dev, claim_ns))
+        return 1;
+    m->pipe = pipe_alloc(m->handle);
+    return 0;
+}
+
+/* The header & the color command of the animation, or one made of the
+ * frame, are submitted & the tick goes on; only if the frame sent
+ * QC1_PIPE_DEPTH ticks ago isn't done yet, its completion is waited for.
+ * A failure is returned at the tick after it completed */
+static int qc1_send(struct micro *m, int group, unsigned int timeout)
+{
+    struct qc1_pipe *p = m->pipe;
+    struct qc1_slot *s;
+    datpack packet = {0};
+    byte_t *setup;
+    int i, res;
+    (void)group; /* the only one */
+    if(!p) {
+        if(m->command)
+            memcpy(packet, m->command, 2*BYTE_STEP);
+        else
+            ring_colcommand(&m->frame, packet);
+        return qc1_upload(m, (const datpack *)&packet, PACKET_CNT, timeout);
+    }
+    s = &p->slot[p->next];
+    if(s->busy && pipe_wait(s, timeout)) {
+        s->quiet = 1; /* this is the failure of its cancellation */
+        return frame_failed;
+    }
+    res = p->result;
+    p->result = frame_sent;
+    if(res != frame_sent)
+        return res;
+    s->quiet = 0;
+    for(i = 0; i < 2; i++) {
+        setup = s->xfer[i]->buffer;
+        libusb_fill_control_setup(setup, BMREQUEST_TYPE_OUT, BREQUEST_OUT,
+                                  WVALUE, WINDEX, PACKET_SIZE);
+        libusb_fill_control_transfer(s->xfer[i], m->handle, setup,
+                                     transfer_done, s, timeout);
+    }
+    fill_display_header(s->xfer[0]->buffer+LIBUSB_CONTROL_SETUP_SIZE,
+                        PACKET_CNT);
+    setup = s->xfer[1]->buffer+LIBUSB_CONTROL_SETUP_SIZE;
+    memset(setup, 0, PACKET_SIZE);
+    if(m->command)
+        memcpy(setup, m->command, 2*BYTE_STEP);
+    else
+        ring_colcommand(&m->frame, setup);
+    #ifdef DEBUG
+    print_packet(s->xfer[0]->buffer+LIBUSB_CONTROL_SETUP_SIZE,
+                 "Header display:");
+    print_packet(setup, "Data:");
+    #endif
+    for(i = 0; i < 2; i++) {
+        res = libusb_submit_transfer(s->xfer[i]);
+        if(res) {
+            #ifdef DEBUG
+            fprintf(stderr, i ? DATAPCK_ERR_MSG : HEADER_ERR_MSG,
+                    libusb_strerror(res));
+            #endif
+            /* Both or neither: a header alone would take the header of
+             * the next frame for its data. The slot is waited for at its
+             * next frame, its cancellation fails quietly */
+            if(s->busy) {
+                s->quiet = 1;
+                libusb_cancel_transfer(s->xfer[0]);
+            }
+            return transfer_result(res);
+        }
+        s->busy++;
+    }
+    p->next = (p->next+1) % QC1_PIPE_DEPTH;
+    return frame_sent;
+}
+
+/* The header counts the data packets following it. Frames in flight go
+ * first */
+static int qc1_upload(struct micro *m, const datpack *packets, int cnt,
+                      unsigned int timeout)
+{
+    short sent;
+    int i;
+    byte_t header_packet[PACKET_SIZE];
+    if(m->pipe)
+        pipe_drain(m->pipe);
+    fill_display_header(header_packet, cnt);
+    sent = send_display_command(header_packet, m->handle, timeout);
+    if(sent != PACKET_SIZE)
+        return transfer_result(sent);
+    for(i = 0; i < cnt; i++) {
+        sent = libusb_control_transfer(m->handle, BMREQUEST_TYPE_OUT,
+                   BREQUEST_OUT, WVALUE, WINDEX, (byte_t *)packets[i],
+                   PACKET_SIZE, timeout);
+        #ifdef DEBUG
+        print_packet(packets[i], "Data:");
+        if(sent != PACKET_SIZE)
+            fprintf(stderr, DATAPCK_ERR_MSG, libusb_strerror(sent));
+        #endif
+        if(sent != PACKET_SIZE)
+            return transfer_result(sent);
+    }
+    return frame_sent;
+}
+
+/* The packets are asked for one by one through GET_REPORT; firmware
+ * that doesn't keep them stalls or answers something else */
+static int qc1_readback(struct micro *m, const datpack *packets, int cnt,
+                        unsigned int timeout)
+{
+    byte_t packet[PACKET_SIZE];
+    short got;
+    int i;
+    if(m->pipe)
+        pipe_drain(m->pipe);
+    for(i = 0; i < cnt; i++) {
+        got = libusb_control_transfer(m->handle, BMREQUEST_TYPE_IN,
+                  BREQUEST_IN, WVALUE, WINDEX, packet, PACKET_SIZE, timeout);
+        #ifdef DEBUG
+        if(got == PACKET_SIZE)
+            print_packet(packet, "Readback:");
+        else
+            fprintf(stderr, READBACK_ERR_MSG, libusb_strerror(got));
+        #endif
+        if(got != PACKET_SIZE || memcmp(packet, packets[i], PACKET_SIZE))
+            return 1;
+    }
+    return 0;
+}
+
+static int qc1_recover(struct micro *m)
+{
+    if(m->pipe) {
+        pipe_drain(m->pipe);
+        m->pipe->result = frame_sent;
+    }
+    return usb_reclaim(m);
+}
+
+static void qc1_close(struct micro *m)
+{
+    if(m->pipe)
+        pipe_free(m->pipe, m->handle);
+    m->pipe = NULL;
+    usb_close(m);
+}
+
+/* The buffers come from usbfs where it can map them to the device, else
+ * from the heap. Returns NULL if the transfers can't be had */
+static struct qc1_pipe *pipe_alloc(libusb_device_handle *handle)
+{
+    struct qc1_pipe *p;
+    struct qc1_slot *s;
+    int i;
+    p = calloc(1, sizeof(*p));
+    if(!p)
+        return NULL;
+    #if LIBUSB_API_VERSION >= 0x01000105
+    p->buf = libusb_dev_mem_alloc(handle, QC1_PIPE_BUF_SIZE);
+    p->dev_mem = p->buf != NULL;
+    #endif
+    if(!p->buf)
+        p->buf = malloc(QC1_PIPE_BUF_SIZE);
+    for(s = p->slot; p->buf && s < p->slot+QC1_PIPE_DEPTH; s++) {
+        s->pipe = p;
+        for(i = 0; i < 2; i++) {
+            s->xfer[i] = libusb_alloc_transfer(0);
+            if(!s->xfer[i]) {
+                pipe_free(p, handle);
+                return NULL;
+            }
+            s->xfer[i]->buffer = p->buf + QC1_XFER_SIZE*
+                                 (2*(s-p->slot) + i);
+        }
+    }
+    if(!p->buf) {
+        free(p);
+        return NULL;
+    }
+    p->result = frame_sent;
+    return p;
+}
+
+/* Nothing is in flight once drained, so the device can be closed */
+static void pipe_free(struct qc1_pipe *p, libusb_device_handle *handle)
+{
+    struct qc1_slot *s;
+    int i;
+    pipe_drain(p);
+    for(s = p->slot; s < p->slot+QC1_PIPE_DEPTH; s++)
+        for(i = 0; i < 2; i++)
+            libusb_free_transfer(s->xfer[i]);
+    #if LIBUSB_API_VERSION >= 0x01000105
+    if(p->dev_mem)
+        libusb_dev_mem_free(handle, p->buf, QC1_PIPE_BUF_SIZE);
+    else
+    #endif
+        free(p->buf);
+    (void)handle;
+    free(p);
+}
+
+/* Only completions are waited for. Returns 1 if the slot's transfers
+ * didn't complete in timeout ms: they are cancelled */
+static int pipe_wait(struct qc1_slot *s, unsigned int timeout)
+{
+    long long deadline = frame_clock_now_ns() + timeout*NSEC_PER_MSEC;
+    long long left;
+    struct timeval tv;
+    int i;
+    while(s->busy && (left = deadline - frame_clock_now_ns()) > 0) {
+        tv.tv_sec = left / NSEC_PER_SEC;
+        tv.tv_usec = left % NSEC_PER_SEC / 1000;
+        libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+    }
+    if(!s->busy)
+        return 0;
+    for(i = 0; i < 2; i++)
+        libusb_cancel_transfer(s->xfer[i]);
+    return 1;
+}
+
+/* Waits for the frames in flight, cancelling them after
+ * QC1_DRAIN_TIMEOUT. The cancellations are waited for as long as they
+ * take: libusb owns the transfers & their buffers until then */
+static void pipe_drain(struct qc1_pipe *p)
+{
+    struct qc1_slot *s;
+    struct timeval tv;
+    for(s = p->slot; s < p->slot+QC1_PIPE_DEPTH; s++)
+        if(s->busy)
+            pipe_wait(s, QC1_DRAIN_TIMEOUT);
+    for(s = p->slot; s < p->slot+QC1_PIPE_DEPTH; s++) {
+        while(s->busy) {
+            tv.tv_sec = 0;
+            tv.tv_usec = QC1_DRAIN_TIMEOUT*1000;
+            libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+        }
+    }
+}
+
+static void LIBUSB_CALL transfer_done(struct libusb_transfer *xfer)
+{
+    struct qc1_slot *s = xfer->user_data;
+    s->busy--;
+    if(s->quiet || (xfer->status == LIBUSB_TRANSFER_COMPLETED &&
+                    xfer->actual_length == PACKET_SIZE))
+        return;
+    #ifdef DEBUG
+    fprintf(stderr, xfer == s->xfer[0] ? HEADER_ERR_MSG : DATAPCK_ERR_MSG,
+            "async transfer");
+    #endif
+    if(s->pipe->result != frame_fatal)
+        s->pipe->result = xfer->status == LIBUSB_TRANSFER_NO_DEVICE ?
+                          frame_fatal : frame_failed;
+}
+
+static void fill_display_header(byte_t *header_packet, int cnt)
+{
+    memset(header_packet, 0, PACKET_SIZE);
+    header_packet[0] = HEADER_CODE;
+    header_packet[1] = DISPLAY_CODE;
+    header_packet[PACKET_CNT_POS] = (byte_t)cnt;
+}
+
+static short send_display_command(byte_t *packet, libusb_device_handle *handle,
+                                  unsigned int timeout)
+{
+    short sent;
+    sent = libusb_control_transfer(handle, BMREQUEST_TYPE_OUT, BREQUEST_OUT,
+                                 WVALUE, WINDEX, packet, PACKET_SIZE,
+                                 timeout);
+    #ifdef DEBUG
+    print_packet(packet, "Header display:");
+    if(sent != PACKET_SIZE)
+        fprintf(stderr, HEADER_ERR_MSG, libusb_strerror(sent));
+    #endif
+    return sent;
+}
+
+/* QuadCast S has two parts only: the first group of each is shown */
+static void ring_colcommand(const struct ring_frame *f, byte_t *colcommand)
+{
+    colcommand[0] = RGB_CODE;
+    memcpy(colcommand+1, f->rgb[0], 3);
+    colcommand[BYTE_STEP] = RGB_CODE;
+    memcpy(colcommand+BYTE_STEP+1, f->rgb[QC2S_UPPER_GROUPS], 3);
+}
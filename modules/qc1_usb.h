@@ -0,0 +1,47 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc1_usb.h
+ * QuadCast S & DuoCast transport: a frame is a header & the color
+ * command, both sent with control transfers.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef QC1_USB_SENTRY
+#define QC1_USB_SENTRY
+
+#include "transport.h"
+
+/* Constants */
+#define HEADER_CODE 0x04
+#define DISPLAY_CODE 0xf2
+#define PACKET_CNT 0x01
+#define PACKET_CNT_POS 8 /* of the header */
+/* Frames submitted without waiting: the next one is queued while the
+ * last one completes */
+#define QC1_PIPE_DEPTH 2
+#define QC1_XFER_SIZE (LIBUSB_CONTROL_SETUP_SIZE+PACKET_SIZE)
+#define QC1_PIPE_BUF_SIZE (2*QC1_PIPE_DEPTH*QC1_XFER_SIZE)
+#define QC1_DRAIN_TIMEOUT 100 /* ms for the frames in flight to complete */
+
+/* Messages */
+#define READBACK_ERR_MSG _("Readback packet error: %s\n")
+#endif
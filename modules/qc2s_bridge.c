@@ -3,12 +3,16 @@
  * Thread-safe per context, no exit().
  */
 #include "qc2s_bridge.h"
+#include "qc2s_encode.h"
+#include "qc2s_pace.h"
 #include "qc2s_tcc_macos.h"
 #include <hidapi/hidapi.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <wchar.h>
 
 /* USB identifiers for the QC2S RGB controller */
 #define QC2S_VID       0x03f0
@@ -20,9 +24,16 @@
 #define QC2S_USAGE_POINTER              0x0001
 #define QC2S_USAGE_MOUSE                0x0002
 #define QC2S_PATH_LIST_CAP              16
-
-#define INTER_GROUP_MS 45
-
+#define QC2S_MATCH_PASSES               6
+#define QC2S_PATH_CAP                   256
+#define QC2S_SERIAL_CAP                 64
+#define QC2S_MAILBOX_SLOTS              4 /* a power of two */
+
+/* A posted frame; seq is 0 while a producer writes it */
+struct mailbox_slot {
+    uint64_t seq;
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+};
 #ifdef QC2S_BRIDGE_DEBUG
 #include <stdio.h>
 #define QC2S_LOG(...) fprintf(stderr, __VA_ARGS__)
@@ -39,13 +50,52 @@
 struct qc2s_ctx {
     hid_device *dev;
     int init_sent;
+    struct qc2s_pace pace; /* groups go as fast as their acks come */
+    /* the colors the device has, of each LED */
+    uint8_t shown[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+    int shown_valid; /* 0 until a whole frame went through */
+    long long shown_ns; /* of the last group report */
+    unsigned int keepalive_ms;
     pthread_mutex_t io_lock;
+
+    /* Health, from the reports sent; written under io_lock, read
+       without it */
+    long long io_ns; /* of the last report tried */
+    long long ok_ns; /* of the last report written */
+    long long ack_latency_ns; /* of the last ack */
+    unsigned int failures; /* reports failed in a row */
+    unsigned int probe_idle_ms;
+
+    /* Writer mode: producers post to the mailbox without waiting and the
+       writer thread sends the newest frame, see qc2s_start_writer */
+    int writer_running;
+    pthread_t writer;
+    uint64_t head; /* seq of the newest frame posted */
+    uint64_t reserve; /* last seq taken */
+    uint64_t completed; /* seq of the newest frame sent */
+    int writer_failed; /* the last frame the writer sent failed */
+    struct mailbox_slot slot[QC2S_MAILBOX_SLOTS];
+    /* Only held to check for work or wake the writer, never for I/O */
+    pthread_mutex_t wake_lock;
+    pthread_cond_t wake;
+    int stop;
 };
 
 /* Process-wide hidapi lifecycle */
 static pthread_mutex_t g_hid_state_lock = PTHREAD_MUTEX_INITIALIZER;
 static unsigned int g_hid_refcount = 0;
 
+/* The device opened last, tried before enumerating; guarded by
+   g_hid_state_lock */
+static char g_last_path[QC2S_PATH_CAP];
+static wchar_t g_last_serial[QC2S_SERIAL_CAP];
+
+/* An enumerated device and the first pass of matches_pass it meets */
+struct candidate {
+    const struct hid_device_info *info;
+    int pass;
+};
+
 /* ---- internal helpers ---- */
 static int hid_system_acquire(void)
 {
@@ -72,26 +122,60 @@ static void hid_system_release(void)
     pthread_mutex_unlock(&g_hid_state_lock);
 }
 
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Tells the health of the device what became of a report: rc is -1 if
+   it failed, 1 if written without an ack, 0 if acked */
+static int note_report(qc2s_ctx *ctx, long long start, int rc)
+{
+    long long now = now_ns();
+
+    __atomic_store_n(&ctx->io_ns, now, __ATOMIC_RELAXED);
+    if (rc < 0) {
+        __atomic_store_n(&ctx->failures, ctx->failures + 1, __ATOMIC_RELAXED);
+        return rc;
+    }
+    __atomic_store_n(&ctx->failures, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctx->ok_ns, now, __ATOMIC_RELAXED);
+    if (rc == 0)
+        __atomic_store_n(&ctx->ack_latency_ns, now - start, __ATOMIC_RELAXED);
+    return rc;
+}
+
+/* 1 if the ack didn't come in QC2S_ACK_TIMEOUT */
 static int send_report_locked(qc2s_ctx *ctx, const uint8_t *packet, int expect_ack)
 {
     uint8_t ack[QC2S_PACKET_SIZE];
+    long long start = now_ns();
     int res;
 
     res = hid_write(ctx->dev, packet, QC2S_PACKET_SIZE);
     if (res < 0) {
         QC2S_LOG("[qc2s] hid_write failed\n");
-        return -1;
+        return note_report(ctx, start, -1);
     }
 
     if (expect_ack) {
         res = hid_read_timeout(ctx->dev, ack, QC2S_PACKET_SIZE, QC2S_ACK_TIMEOUT);
         if (res < 0) {
             QC2S_LOG("[qc2s] hid_read_timeout failed\n");
-            return -1;
+            return note_report(ctx, start, -1);
         }
+        if (res == 0)
+            return note_report(ctx, start, 1);
     }
 
-    return 0;
+    if (!expect_ack) {
+        note_report(ctx, start, 1); /* written, but no ack to time */
+        return 0;
+    }
+    return note_report(ctx, start, 0);
 }
 
 static int hid_listen_access_allowed(void)
@@ -107,33 +191,38 @@ static int send_init_locked(qc2s_ctx *ctx)
 {
     uint8_t pkt[QC2S_PACKET_SIZE];
 
-    memset(pkt, 0, sizeof(pkt));
-    pkt[0] = QC2S_CMD_INIT;
-    pkt[1] = QC2S_SUB_START;
+    qc2s_encode_init(pkt);
     if (send_report_locked(ctx, pkt, 1) < 0)
         return -1;
 
     ctx->init_sent = 1;
+    ctx->shown_valid = 0;
     return 0;
 }
 
-static void build_color_packet(uint8_t group, uint8_t r, uint8_t g, uint8_t b,
-                               uint8_t *packet)
+/* The groups whose colors the device hasn't got, a bit each; all of them
+   until a whole frame went through and once the keepalive is due */
+static int changed_groups(
+    const qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
 {
-    int i;
+    int group, changed = 0;
+
+    if (!ctx->shown_valid ||
+        (ctx->keepalive_ms &&
+         now_ns() - ctx->shown_ns >= ctx->keepalive_ms * 1000000LL))
+        return (1 << QC2S_GROUP_COUNT) - 1;
 
-    memset(packet, 0, QC2S_PACKET_SIZE);
-    packet[0] = QC2S_CMD_COLOR;
-    packet[1] = QC2S_SUB_DATA;
-    packet[2] = group;
-    for (i = QC2S_RGB_OFFSET; i + 2 < QC2S_PACKET_SIZE; i += 3) {
-        packet[i] = r;
-        packet[i + 1] = g;
-        packet[i + 2] = b;
+    for (group = 0; group < QC2S_GROUP_COUNT; group++) {
+        if (memcmp(ctx->shown[group], leds[group],
+                   sizeof(ctx->shown[group])) != 0)
+            changed |= 1 << group;
     }
+    return changed;
 }
 
-static int path_in_list(const char *path, const char **paths, size_t count)
+static int path_in_list(const char *path, const struct candidate *list,
+                        size_t count)
 {
     size_t i;
 
@@ -141,23 +230,12 @@ static int path_in_list(const char *path, const char **paths, size_t count)
         return 0;
 
     for (i = 0; i < count; i++) {
-        if (strcmp(path, paths[i]) == 0)
+        if (strcmp(path, list[i].info->path) == 0)
             return 1;
     }
     return 0;
 }
 
-static void add_path_if_missing(const char *path, const char **paths,
-                                size_t *count)
-{
-    if (!path || !count || *count >= QC2S_PATH_LIST_CAP)
-        return;
-    if (path_in_list(path, paths, *count))
-        return;
-    paths[*count] = path;
-    (*count)++;
-}
-
 static int is_tcc_guarded_usage(const struct hid_device_info *dev)
 {
     return dev &&
@@ -199,53 +277,127 @@ static int matches_pass(int pass, const struct hid_device_info *dev)
     }
 }
 
-/* ---- public API ---- */
-qc2s_ctx *qc2s_open(void)
+static int first_pass(const struct hid_device_info *dev)
 {
-    struct hid_device_info *devs, *cur;
-    const char *attempted_paths[QC2S_PATH_LIST_CAP] = {0};
-    size_t attempted_count = 0;
-    hid_device *dev = NULL;
-    qc2s_ctx *ctx;
     int pass;
 
-    if (!hid_listen_access_allowed()) {
-        QC2S_LOG("[qc2s] Input Monitoring (ListenEvent) not granted\n");
-        return NULL;
+    for (pass = 0; pass < QC2S_MATCH_PASSES; pass++) {
+        if (matches_pass(pass, dev))
+            return pass;
     }
+    return -1;
+}
 
-    if (hid_system_acquire() != 0) {
-        QC2S_LOG("[qc2s] hid_init failed\n");
-        return NULL;
+/* One walk over the enumeration: the paths in the order the passes
+   would try them, each once */
+static size_t rank_candidates(const struct hid_device_info *devs,
+                              struct candidate *list)
+{
+    const struct hid_device_info *cur;
+    struct candidate c;
+    size_t count = 0, i;
+
+    for (cur = devs; cur && count < QC2S_PATH_LIST_CAP; cur = cur->next) {
+        if (!cur->path || path_in_list(cur->path, list, count))
+            continue;
+        c.info = cur;
+        c.pass = first_pass(cur);
+        if (c.pass < 0)
+            continue;
+        for (i = count; i > 0 && list[i - 1].pass > c.pass; i--)
+            list[i] = list[i - 1];
+        list[i] = c;
+        count++;
     }
+    return count;
+}
 
-    devs = hid_enumerate(QC2S_VID, QC2S_PID);
-    if (!devs) {
-        hid_system_release();
+/* Paths are reused once a device is gone, so the serial must match */
+static hid_device *open_last_path(void)
+{
+    char path[QC2S_PATH_CAP];
+    wchar_t serial[QC2S_SERIAL_CAP], got[QC2S_SERIAL_CAP];
+    hid_device *dev;
+
+    pthread_mutex_lock(&g_hid_state_lock);
+    memcpy(path, g_last_path, sizeof(path));
+    memcpy(serial, g_last_serial, sizeof(serial));
+    pthread_mutex_unlock(&g_hid_state_lock);
+    if (!path[0])
+        return NULL;
+
+    dev = hid_open_path(path);
+    if (!dev)
+        return NULL;
+    if (hid_get_serial_number_string(dev, got, QC2S_SERIAL_CAP) != 0 ||
+        wcscmp(got, serial) != 0) {
+        QC2S_LOG("[qc2s] %s is another device now\n", path);
+        hid_close(dev);
         return NULL;
     }
+    QC2S_LOG("[qc2s] reopened HID path %s\n", path);
+    return dev;
+}
 
-    for (pass = 0; pass < 6 && !dev; pass++) {
-        for (cur = devs; cur; cur = cur->next) {
-            if (!cur->path)
-                continue;
-            if (!matches_pass(pass, cur))
-                continue;
-            if (path_in_list(cur->path, attempted_paths, attempted_count))
-                continue;
+/* Devices without a serial can't be told apart, they aren't kept */
+static void remember_path(const struct hid_device_info *info)
+{
+    pthread_mutex_lock(&g_hid_state_lock);
+    g_last_path[0] = 0;
+    if (info->serial_number && info->serial_number[0] &&
+        strlen(info->path) < QC2S_PATH_CAP &&
+        wcslen(info->serial_number) < QC2S_SERIAL_CAP) {
+        strcpy(g_last_path, info->path);
+        wcscpy(g_last_serial, info->serial_number);
+    }
+    pthread_mutex_unlock(&g_hid_state_lock);
+}
 
-            add_path_if_missing(cur->path, attempted_paths, &attempted_count);
-            dev = hid_open_path(cur->path);
-            if (dev) {
-                QC2S_LOG("[qc2s] opened HID path %s (iface=%d usage=0x%04hx:0x%04hx)\n",
-                         cur->path, cur->interface_number, cur->usage_page,
-                         cur->usage);
-                break;
-            }
+static hid_device *open_enumerated(void)
+{
+    struct hid_device_info *devs;
+    struct candidate list[QC2S_PATH_LIST_CAP];
+    size_t count, i;
+    hid_device *dev = NULL;
+
+    devs = hid_enumerate(QC2S_VID, QC2S_PID);
+    if (!devs)
+        return NULL;
+
+    count = rank_candidates(devs, list);
+    for (i = 0; i < count && !dev; i++) {
+        dev = hid_open_path(list[i].info->path);
+        if (dev) {
+            QC2S_LOG("[qc2s] opened HID path %s (iface=%d usage=0x%04hx:0x%04hx)\n",
+                     list[i].info->path, list[i].info->interface_number,
+                     list[i].info->usage_page, list[i].info->usage);
+            remember_path(list[i].info);
         }
     }
     hid_free_enumeration(devs);
+    return dev;
+}
+
+/* ---- public API ---- */
+qc2s_ctx *qc2s_open(void)
+{
+    hid_device *dev;
+    qc2s_ctx *ctx;
 
+    if (!hid_listen_access_allowed()) {
+        QC2S_LOG("[qc2s] Input Monitoring (ListenEvent) not granted\n");
+        return NULL;
+    }
+
+    if (hid_system_acquire() != 0) {
+        QC2S_LOG("[qc2s] hid_init failed\n");
+        return NULL;
+    }
+
+    /* Enumerating walks every HID device of the host, reopening doesn't */
+    dev = open_last_path();
+    if (!dev)
+        dev = open_enumerated();
     if (!dev) {
         hid_system_release();
         return NULL;
@@ -260,12 +412,29 @@ qc2s_ctx *qc2s_open(void)
 
     ctx->dev = dev;
     ctx->init_sent = 0;
+    ctx->keepalive_ms = QC2S_KEEPALIVE_MS;
+    ctx->probe_idle_ms = QC2S_PROBE_IDLE_MS;
     if (pthread_mutex_init(&ctx->io_lock, NULL) != 0) {
         hid_close(dev);
         free(ctx);
         hid_system_release();
         return NULL;
     }
+    if (pthread_mutex_init(&ctx->wake_lock, NULL) != 0) {
+        pthread_mutex_destroy(&ctx->io_lock);
+        hid_close(dev);
+        free(ctx);
+        hid_system_release();
+        return NULL;
+    }
+    if (pthread_cond_init(&ctx->wake, NULL) != 0) {
+        pthread_mutex_destroy(&ctx->wake_lock);
+        pthread_mutex_destroy(&ctx->io_lock);
+        hid_close(dev);
+        free(ctx);
+        hid_system_release();
+        return NULL;
+    }
 
     return ctx;
 }
@@ -288,67 +457,362 @@ int qc2s_set_frame(qc2s_ctx *ctx,
                    uint8_t ur, uint8_t ug, uint8_t ub,
                    uint8_t lr, uint8_t lg, uint8_t lb)
 {
-    uint8_t pkt[QC2S_PACKET_SIZE];
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
     int group;
-    int rc = -1;
 
-    if (!ctx || !ctx->dev)
-        return -1;
+    for (group = 0; group < QC2S_GROUP_COUNT; group++) {
+        if (group < QC2S_UPPER_GROUPS) {
+            rgb[group][0] = ur;
+            rgb[group][1] = ug;
+            rgb[group][2] = ub;
+        } else {
+            rgb[group][0] = lr;
+            rgb[group][1] = lg;
+            rgb[group][2] = lb;
+        }
+    }
+    return qc2s_set_groups(ctx, (const uint8_t (*)[3])rgb);
+}
 
-    pthread_mutex_lock(&ctx->io_lock);
+/* Every LED of a group gets the color of the group */
+static void fill_leds(const uint8_t rgb[QC2S_GROUP_COUNT][3],
+                      uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    int group, led;
+
+    for (group = 0; group < QC2S_GROUP_COUNT; group++)
+        for (led = 0; led < QC2S_LEDS_PER_GROUP; led++)
+            memcpy(leds[group][led], rgb[group], 3);
+}
+
+static int send_groups_locked(
+    qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    uint8_t pkt[QC2S_PACKET_SIZE];
+    long long start, elapsed, period;
+    int group, res, changed, count;
+
+    if (!ctx->dev)
+        return -1;
 
     if (!ctx->init_sent) {
         if (send_init_locked(ctx) < 0)
-            goto done;
+            return -1;
     }
 
-    memset(pkt, 0, sizeof(pkt));
-    pkt[0] = QC2S_CMD_COLOR;
-    pkt[1] = QC2S_SUB_START;
-    pkt[2] = QC2S_GROUP_COUNT;
+    changed = changed_groups(ctx, leds);
+    for (group = 0, count = 0; group < QC2S_GROUP_COUNT; group++)
+        count += (changed >> group) & 1;
+    if (count == 0)
+        return 0; /* nothing to send */
+
+    qc2s_encode_start(pkt, count);
     if (send_report_locked(ctx, pkt, 1) < 0)
-        goto done;
+        return -1;
 
-    for (group = 0; group < QC2S_GROUP_COUNT; group++) {
-        if (group < QC2S_UPPER_GROUPS)
-            build_color_packet((uint8_t)group, ur, ug, ub, pkt);
-        else
-            build_color_packet((uint8_t)group, lr, lg, lb, pkt);
+    /* Until all of them went, the device's colors aren't known */
+    ctx->shown_valid = 0;
 
-        if (send_report_locked(ctx, pkt, 1) < 0)
-            goto done;
-        QC2S_SLEEP_MS(INTER_GROUP_MS);
+    /* The next group goes once the floor learned from the acks is over */
+    for (group = 0; group < QC2S_GROUP_COUNT; group++) {
+        if (!(changed & (1 << group)))
+            continue;
+        qc2s_encode_leds(pkt, (uint8_t)group, leds[group]);
+        start = now_ns();
+        res = send_report_locked(ctx, pkt, 1);
+        if (res < 0)
+            return -1;
+        memcpy(ctx->shown[group], leds[group], sizeof(ctx->shown[group]));
+        ctx->shown_ns = now_ns();
+        elapsed = ctx->shown_ns - start;
+        qc2s_pace_update(&ctx->pace, elapsed, res == 0);
+        period = qc2s_pace_period_ms(&ctx->pace) - elapsed / 1000000;
+        if (period > 0)
+            QC2S_SLEEP_MS(period);
     }
 
-    rc = 0;
-done:
+    ctx->shown_valid = 1;
+    return 0;
+}
+
+static int send_groups(
+    qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    int rc;
+
+    pthread_mutex_lock(&ctx->io_lock);
+    rc = send_groups_locked(ctx, leds);
     pthread_mutex_unlock(&ctx->io_lock);
     return rc;
 }
 
+/* Lock-free for any number of producers, as the frame ring: every frame
+   takes its own seq and its slot is guarded like a seqlock */
+static uint64_t mailbox_post(
+    qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    struct mailbox_slot *slot;
+    uint64_t seq, head;
+
+    seq = __atomic_add_fetch(&ctx->reserve, 1, __ATOMIC_RELAXED);
+    slot = &ctx->slot[seq & (QC2S_MAILBOX_SLOTS - 1)];
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(slot->leds, leds, sizeof(slot->leds));
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+    /* A slower producer of an older frame must not move the head back */
+    head = __atomic_load_n(&ctx->head, __ATOMIC_RELAXED);
+    while (head < seq &&
+           !__atomic_compare_exchange_n(&ctx->head, &head, seq, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+
+    pthread_mutex_lock(&ctx->wake_lock);
+    pthread_cond_signal(&ctx->wake);
+    pthread_mutex_unlock(&ctx->wake_lock);
+    return seq;
+}
+
+/* Returns the seq of the newest frame if it is newer than last, else 0 */
+static uint64_t mailbox_take(
+    qc2s_ctx *ctx, uint64_t last,
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    const struct mailbox_slot *slot;
+    uint64_t head;
+
+    for (;;) {
+        head = __atomic_load_n(&ctx->head, __ATOMIC_ACQUIRE);
+        if (head == last)
+            return 0;
+        slot = &ctx->slot[head & (QC2S_MAILBOX_SLOTS - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != head)
+            continue; /* overwritten already, a newer head is coming */
+        memcpy(leds, slot->leds, sizeof(slot->leds));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == head)
+            return head;
+    }
+}
+
+/* Frames posted while one is sent are coalesced into the newest. With
+   nothing new, the frame shown is sent again once the keepalive is due,
+   and a frame that failed within QC2S_RETRY_MS whatever the keepalive. */
+static void *writer_loop(void *data)
+{
+    qc2s_ctx *ctx = data;
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+    uint64_t last = 0, seq;
+    struct timespec until;
+    long long wake_ns;
+    unsigned int wait_ms;
+    int rc, failed = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&ctx->wake_lock);
+        while (!ctx->stop &&
+               __atomic_load_n(&ctx->head, __ATOMIC_ACQUIRE) == last) {
+            wait_ms = __atomic_load_n(&ctx->keepalive_ms, __ATOMIC_RELAXED);
+            if (failed && (!wait_ms || wait_ms > QC2S_RETRY_MS))
+                wait_ms = QC2S_RETRY_MS;
+            if (!last || !wait_ms) {
+                pthread_cond_wait(&ctx->wake, &ctx->wake_lock);
+                continue;
+            }
+            clock_gettime(CLOCK_REALTIME, &until);
+            wake_ns = until.tv_nsec + wait_ms * 1000000LL;
+            until.tv_sec += wake_ns / 1000000000LL;
+            until.tv_nsec = wake_ns % 1000000000LL;
+            if (pthread_cond_timedwait(&ctx->wake, &ctx->wake_lock,
+                                       &until) != 0)
+                break;
+        }
+        rc = ctx->stop;
+        pthread_mutex_unlock(&ctx->wake_lock);
+        if (rc)
+            return NULL;
+
+        seq = mailbox_take(ctx, last, leds);
+        if (seq)
+            last = seq;
+        /* else the keepalive, leds still has the frame sent last */
+        rc = send_groups(ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds);
+        failed = rc < 0;
+        __atomic_store_n(&ctx->writer_failed, failed, __ATOMIC_RELAXED);
+        if (rc == 0)
+            __atomic_store_n(&ctx->completed, last, __ATOMIC_RELEASE);
+    }
+}
+
+int qc2s_set_groups(qc2s_ctx *ctx, const uint8_t rgb[QC2S_GROUP_COUNT][3])
+{
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+
+    if (!rgb)
+        return -1;
+
+    fill_leds(rgb, leds);
+    return qc2s_set_leds(ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds);
+}
+
+int qc2s_set_leds(qc2s_ctx *ctx,
+                  const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    if (!ctx || !ctx->dev || !leds)
+        return -1;
+
+    if (ctx->writer_running)
+        return qc2s_post_leds(ctx, leds) ? 0 : -1;
+    return send_groups(ctx, leds);
+}
+
+/* Each frame is held until the sum of the durations before it and its own
+   is over, from the start of the batch, so slow groups don't make the
+   animation drift: a frame whose time passed before it could go is
+   skipped, as the CLI skips the ticks it missed. io_lock is only held
+   while a frame is sent, never while it is held. */
+int qc2s_submit_frames(qc2s_ctx *ctx, const struct qc2s_timed_frame *frames,
+                       int count)
+{
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+    long long end, left;
+    int i, rc, sent = 0;
+
+    if (!ctx || !ctx->dev || count < 0 || (count && !frames))
+        return -1;
+
+    end = now_ns();
+    for (i = 0; i < count; i++) {
+        end += frames[i].duration_ms * 1000000LL;
+        if (i + 1 < count && now_ns() >= end)
+            continue;
+        fill_leds(frames[i].rgb, leds);
+        if (ctx->writer_running)
+            rc = qc2s_post_leds(
+                ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds) ? 0 : -1;
+        else
+            rc = send_groups(
+                ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds);
+        if (rc < 0)
+            return -1;
+        sent++;
+        left = end - now_ns();
+        if (left > 0)
+            usleep(left / 1000); /* the hold is the API's, not pacing */
+    }
+    return sent;
+}
+
+int qc2s_start_writer(qc2s_ctx *ctx)
+{
+    if (!ctx || !ctx->dev)
+        return -1;
+    if (ctx->writer_running)
+        return 0;
+
+    ctx->stop = 0;
+    if (pthread_create(&ctx->writer, NULL, writer_loop, ctx) != 0)
+        return -1;
+    ctx->writer_running = 1;
+    return 0;
+}
+
+uint64_t qc2s_post_groups(qc2s_ctx *ctx,
+                          const uint8_t rgb[QC2S_GROUP_COUNT][3])
+{
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+
+    if (!rgb)
+        return 0;
+
+    fill_leds(rgb, leds);
+    return qc2s_post_leds(ctx,
+                          (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds);
+}
+
+uint64_t qc2s_post_leds(
+    qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    uint64_t seq;
+
+    if (!ctx || !ctx->writer_running || !leds)
+        return 0;
+
+    /* The writer retries with the newest frame, so it is taken anyway */
+    seq = mailbox_post(ctx, leds);
+    if (__atomic_load_n(&ctx->writer_failed, __ATOMIC_RELAXED))
+        return 0;
+    return seq;
+}
+
+uint64_t qc2s_completed_seq(qc2s_ctx *ctx)
+{
+    if (!ctx)
+        return 0;
+
+    return __atomic_load_n(&ctx->completed, __ATOMIC_ACQUIRE);
+}
+
+void qc2s_set_keepalive(qc2s_ctx *ctx, unsigned int ms)
+{
+    if (!ctx)
+        return;
+
+    __atomic_store_n(&ctx->keepalive_ms, ms, __ATOMIC_RELAXED);
+}
+
 int qc2s_set_color(qc2s_ctx *ctx, uint8_t r, uint8_t g, uint8_t b)
 {
     return qc2s_set_frame(ctx, r, g, b, r, g, b);
 }
 
+/* The reports of the frames tell, the device is only probed when
+   nothing was sent for a while. A frame being sent isn't waited for. */
 int qc2s_is_connected(qc2s_ctx *ctx)
 {
-    uint8_t pkt[QC2S_PACKET_SIZE];
-    int rc;
+    long long idle;
 
     if (!ctx || !ctx->dev)
         return 0;
 
-    pthread_mutex_lock(&ctx->io_lock);
-    memset(pkt, 0, sizeof(pkt));
-    pkt[0] = QC2S_CMD_INIT;
-    pkt[1] = QC2S_SUB_START;
-    rc = (send_report_locked(ctx, pkt, 1) == 0);
-    if (rc)
-        ctx->init_sent = 1;
-    pthread_mutex_unlock(&ctx->io_lock);
+    idle = now_ns() - __atomic_load_n(&ctx->io_ns, __ATOMIC_RELAXED);
+    if (idle >= __atomic_load_n(&ctx->probe_idle_ms, __ATOMIC_RELAXED) *
+                1000000LL &&
+        pthread_mutex_trylock(&ctx->io_lock) == 0) {
+        /* INIT may reset the colors, the next frame is sent whole */
+        if (ctx->dev)
+            send_init_locked(ctx);
+        pthread_mutex_unlock(&ctx->io_lock);
+    }
 
-    return rc;
+    return __atomic_load_n(&ctx->failures, __ATOMIC_RELAXED) == 0;
+}
+
+void qc2s_set_probe_idle(qc2s_ctx *ctx, unsigned int ms)
+{
+    if (!ctx)
+        return;
+
+    __atomic_store_n(&ctx->probe_idle_ms, ms, __ATOMIC_RELAXED);
+}
+
+void qc2s_get_health(qc2s_ctx *ctx, struct qc2s_health *health)
+{
+    long long ok_ns;
+
+    memset(health, 0, sizeof(*health));
+    if (!ctx)
+        return;
+
+    ok_ns = __atomic_load_n(&ctx->ok_ns, __ATOMIC_RELAXED);
+    health->idle_ms = ok_ns ? (now_ns() - ok_ns) / 1000000 : -1;
+    health->failures = __atomic_load_n(&ctx->failures, __ATOMIC_RELAXED);
+    health->ack_latency_us =
+        __atomic_load_n(&ctx->ack_latency_ns, __ATOMIC_RELAXED) / 1000;
 }
 
 void qc2s_close(qc2s_ctx *ctx)
@@ -358,6 +822,16 @@ void qc2s_close(qc2s_ctx *ctx)
     if (!ctx)
         return;
 
+    /* The frame being sent goes first */
+    if (ctx->writer_running) {
+        pthread_mutex_lock(&ctx->wake_lock);
+        ctx->stop = 1;
+        pthread_cond_signal(&ctx->wake);
+        pthread_mutex_unlock(&ctx->wake_lock);
+        pthread_join(ctx->writer, NULL);
+        ctx->writer_running = 0;
+    }
+
     pthread_mutex_lock(&ctx->io_lock);
     dev = ctx->dev;
     ctx->dev = NULL;
@@ -366,6 +840,8 @@ void qc2s_close(qc2s_ctx *ctx)
     if (dev)
         hid_close(dev);
 
+    pthread_cond_destroy(&ctx->wake);
+    pthread_mutex_destroy(&ctx->wake_lock);
     pthread_mutex_destroy(&ctx->io_lock);
     free(ctx);
     hid_system_release();
@@ -10,7 +10,8 @@
 
 typedef struct qc2s_ctx qc2s_ctx;
 
-/* Open the QC2S HID device (interface 1). Returns NULL on failure. */
+/* Open the QC2S HID device (interface 1). The path opened last is tried
+   first if the serial still matches. Returns NULL on failure. */
 qc2s_ctx *qc2s_open(void);
 
 /* Send a frame: groups 0-1 get (ur,ug,ub), groups 2-5 get (lr,lg,lb).
@@ -19,15 +20,93 @@ int qc2s_set_frame(qc2s_ctx *ctx,
                    uint8_t ur, uint8_t ug, uint8_t ub,
                    uint8_t lr, uint8_t lg, uint8_t lb);
 
+/* Send a frame with its own color for each of the 6 LED groups. Each group
+   goes as soon as the acks of the earlier ones allow, see qc2s_pace.h.
+   Only the groups whose colors changed are sent, nothing for the same
+   frame until the keepalive is due. Returns 0 on success, -1 on error. */
+int qc2s_set_groups(qc2s_ctx *ctx, const uint8_t rgb[QC2S_GROUP_COUNT][3]);
+
+/* Send a frame with its own color for each of the QC2S_LEDS_PER_GROUP
+   LEDs of every group, as the RGB slots of the group reports; the same
+   reports go as for qc2s_set_groups. See qc2s_effects.h for frames of
+   gradients, chases and rainbows. Returns 0 on success, -1 on error. */
+int qc2s_set_leds(qc2s_ctx *ctx,
+                  const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3]);
+
+/* A frame of qc2s_submit_frames */
+struct qc2s_timed_frame {
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
+    uint32_t duration_ms; /* held from its start before the next one */
+};
+
+/* Send count frames one after the other, as qc2s_set_groups does, in a
+   single call; it returns when the last one's time is over. Frames whose
+   time passed while earlier ones were sent are skipped, the last is
+   always sent. The device is only locked while a frame is sent, so the
+   writer, qc2s_is_connected and the other calls go on between them; with
+   the writer running, each frame is posted to it at its time. Returns
+   the number of frames sent or posted, -1 on error. */
+int qc2s_submit_frames(qc2s_ctx *ctx, const struct qc2s_timed_frame *frames,
+                       int count);
+
+/* Send the whole frame again if nothing was sent for ms milliseconds,
+   0 never. The default is QC2S_KEEPALIVE_MS. */
+void qc2s_set_keepalive(qc2s_ctx *ctx, unsigned int ms);
+
+/* Start a thread that owns the writes: from then on qc2s_set_frame,
+   qc2s_set_groups, qc2s_set_leds and qc2s_set_color only post the frame to a lock-free
+   mailbox and return at once. Frames posted while one is being sent are
+   coalesced into the newest. They return -1 once the writer failed to
+   send a frame, until it sends one: it tries again with the newest frame
+   every QC2S_RETRY_MS at most, even without a keepalive. qc2s_close
+   stops the thread.
+   Returns 0 on success, -1 on error. */
+int qc2s_start_writer(qc2s_ctx *ctx);
+#define QC2S_RETRY_MS 100
+
+/* Post a frame to the writer thread. Returns its sequence number, 0 if
+   the writer isn't running or failed; the frame is posted anyway then,
+   for the writer to try again with. */
+uint64_t qc2s_post_groups(qc2s_ctx *ctx,
+                          const uint8_t rgb[QC2S_GROUP_COUNT][3]);
+uint64_t qc2s_post_leds(
+    qc2s_ctx *ctx,
+    const uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3]);
+
+/* The sequence number of the newest frame the writer sent to the device,
+   0 before the first. Frames coalesced away are never completed. */
+uint64_t qc2s_completed_seq(qc2s_ctx *ctx);
+
 /* Send a solid color to all 6 LED groups. Returns 0 on success, -1 on error. */
 int qc2s_set_color(qc2s_ctx *ctx, uint8_t r, uint8_t g, uint8_t b);
 
-/* Send a raw 64-byte QC2S report. expect_ack=1 reads one ack frame. */
+/* Send a raw 64-byte QC2S report. expect_ack=1 reads one ack frame.
+   Returns 0 on success, 1 if the ack didn't come, -1 on error. */
 int qc2s_send_report(qc2s_ctx *ctx, const uint8_t *packet, int expect_ack);
 
-/* Check if the device is still responsive. Returns 1 if connected, 0 if not. */
+/* The device is only probed by qc2s_is_connected after this many
+   milliseconds without a report (default) */
+#define QC2S_PROBE_IDLE_MS 2000
+
+/* What the reports sent tell of the device */
+struct qc2s_health {
+    long long idle_ms; /* since the last report went through, -1 if none */
+    unsigned int failures; /* reports failed in a row */
+    long long ack_latency_us; /* of the last ack */
+};
+
+/* Check if the device is still responsive: whether the last report sent
+   went through. Doesn't touch the device unless it was idle for the probe
+   window, see qc2s_set_probe_idle. Returns 1 if connected, 0 if not. */
 int qc2s_is_connected(qc2s_ctx *ctx);
 
+/* Probe the device in qc2s_is_connected once ms milliseconds passed
+   without a report, 0 at every call. The default is QC2S_PROBE_IDLE_MS. */
+void qc2s_set_probe_idle(qc2s_ctx *ctx, unsigned int ms);
+
+/* Fill health in constant time, without touching the device */
+void qc2s_get_health(qc2s_ctx *ctx, struct qc2s_health *health);
+
 /* Close the device and free context. Safe to call with NULL. */
 void qc2s_close(qc2s_ctx *ctx);
 
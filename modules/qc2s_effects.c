@@ -0,0 +1,71 @@
+/*
+ * qc2s_effects.c — per-LED effects inside the QuadCast 2S groups
+ */
+#include "qc2s_effects.h"
+#include <string.h>
+
+#define LEDS QC2S_LEDS_PER_GROUP
+#define HUE_STEPS (6 * 256) /* a segment of the wheel per 256 */
+
+/* num/den of the way from a to b */
+static void blend(const uint8_t *a, const uint8_t *b, int num, int den,
+                  uint8_t *out)
+{
+    int c;
+
+    for (c = 0; c < 3; c++)
+        out[c] = (uint8_t)(a[c] + (b[c] - a[c]) * num / den);
+}
+
+static void hue(int h, uint8_t *out)
+{
+    int f = h & 255;
+
+    switch (h >> 8) {
+    case 0: out[0] = 255;     out[1] = f;       out[2] = 0;       break;
+    case 1: out[0] = 255 - f; out[1] = 255;     out[2] = 0;       break;
+    case 2: out[0] = 0;       out[1] = 255;     out[2] = f;       break;
+    case 3: out[0] = 0;       out[1] = 255 - f; out[2] = 255;     break;
+    case 4: out[0] = f;       out[1] = 0;       out[2] = 255;     break;
+    default: out[0] = 255;    out[1] = 0;       out[2] = 255 - f; break;
+    }
+}
+
+static void render_led(const struct qc2s_effect *e, unsigned long step,
+                       int led, uint8_t *out)
+{
+    int pos, behind;
+
+    switch (e->kind) {
+    case QC2S_EFFECT_GRADIENT:
+        pos = (int)((led + step) % (2 * (LEDS - 1)));
+        if (pos > LEDS - 1)
+            pos = 2 * (LEDS - 1) - pos;
+        blend(e->from, e->to, pos, LEDS - 1, out);
+        break;
+    case QC2S_EFFECT_CHASE:
+        behind = (int)((step % LEDS + LEDS - led) % LEDS);
+        if (behind == 0)
+            memcpy(out, e->from, 3);
+        else if (behind <= e->tail)
+            blend(e->from, e->to, behind, e->tail + 1, out);
+        else
+            memcpy(out, e->to, 3);
+        break;
+    default: /* QC2S_EFFECT_RAINBOW */
+        hue((int)((led + step) % LEDS) * HUE_STEPS / LEDS, out);
+        break;
+    }
+}
+
+void qc2s_effect_render(
+    const struct qc2s_effect *e, unsigned long step,
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3])
+{
+    int led, group;
+
+    for (led = 0; led < LEDS; led++)
+        render_led(e, step, led, leds[0][led]);
+    for (group = 1; group < QC2S_GROUP_COUNT; group++)
+        memcpy(leds[group], leds[0], sizeof(leds[0]));
+}
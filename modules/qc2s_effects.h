@@ -0,0 +1,32 @@
+/*
+ * qc2s_effects.h — per-LED effects inside the QuadCast 2S groups
+ * No I/O: frames are rendered for qc2s_set_leds, each LED slot of a group
+ * report gets its own color at no extra report.
+ */
+#ifndef QC2S_EFFECTS_H
+#define QC2S_EFFECTS_H
+
+#include <stdint.h>
+#include "qc2s_protocol.h"
+
+enum qc2s_effect_kind {
+    QC2S_EFFECT_GRADIENT, /* from the first LED to the last, scrolling */
+    QC2S_EFFECT_CHASE,    /* a lit LED with a fading tail runs around */
+    QC2S_EFFECT_RAINBOW   /* the hue wheel spread over the LEDs, spinning */
+};
+
+struct qc2s_effect {
+    int kind;        /* qc2s_effect_kind */
+    uint8_t from[3]; /* gradient start, chase head */
+    uint8_t to[3];   /* gradient end, chase background */
+    int tail;        /* chase: LEDs fading from the head to the background */
+};
+
+/* Frame step of the effect, the same in every group: each step moves it
+   one LED on. It repeats every QC2S_LEDS_PER_GROUP steps, the gradient
+   every 2 * (QC2S_LEDS_PER_GROUP - 1) as it goes back and forth */
+void qc2s_effect_render(
+    const struct qc2s_effect *e, unsigned long step,
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3]);
+
+#endif /* QC2S_EFFECTS_H */
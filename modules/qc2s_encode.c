@@ -0,0 +1,122 @@
+/*
+ * qc2s_encode.c — QuadCast 2S report encoder and precompiled frame reports
+ */
+#include "qc2s_encode.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_COLORS (QC2S_GROUP_COUNT * 3)
+
+void qc2s_encode_init(uint8_t *packet)
+{
+    memset(packet, 0, QC2S_PACKET_SIZE);
+    packet[0] = QC2S_CMD_INIT;
+    packet[1] = QC2S_SUB_START;
+}
+
+void qc2s_encode_start(uint8_t *packet, int cnt)
+{
+    memset(packet, 0, QC2S_PACKET_SIZE);
+    packet[0] = QC2S_CMD_COLOR;
+    packet[1] = QC2S_SUB_START;
+    packet[2] = (uint8_t)cnt;
+}
+
+void qc2s_encode_group(uint8_t *packet, uint8_t group, const uint8_t *rgb)
+{
+    int i;
+
+    memset(packet, 0, QC2S_PACKET_SIZE);
+    packet[0] = QC2S_CMD_COLOR;
+    packet[1] = QC2S_SUB_DATA;
+    packet[2] = group;
+    for (i = QC2S_RGB_OFFSET; i + 2 < QC2S_PACKET_SIZE; i += 3) {
+        packet[i] = rgb[0];
+        packet[i + 1] = rgb[1];
+        packet[i + 2] = rgb[2];
+    }
+}
+
+void qc2s_encode_leds(uint8_t *packet, uint8_t group,
+                      const uint8_t leds[QC2S_LEDS_PER_GROUP][3])
+{
+    memset(packet, 0, QC2S_PACKET_SIZE);
+    packet[0] = QC2S_CMD_COLOR;
+    packet[1] = QC2S_SUB_DATA;
+    packet[2] = group;
+    memcpy(packet + QC2S_RGB_OFFSET, leds, QC2S_LEDS_PER_GROUP * 3);
+}
+
+/* FNV-1a of the colors of a frame */
+static uint32_t frame_hash(const uint8_t (*frame)[3])
+{
+    const uint8_t *p = frame[0];
+    uint32_t h = 2166136261u;
+    int i;
+
+    for (i = 0; i < FRAME_COLORS; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Animations repeat their colors a lot: the distinct frames are found
+   with an open-addressed table of slot + 1, twice the frames in size */
+int qc2s_cache_build(struct qc2s_report_cache *c,
+                     const uint8_t (*frames)[QC2S_GROUP_COUNT][3], int cnt)
+{
+    int *table = NULL, *first = NULL;
+    unsigned int size = 1, mask, h;
+    void *arena;
+    int i, group, slot;
+
+    memset(c, 0, sizeof(*c));
+    if (cnt <= 0)
+        return 0;
+    while (size < 2u * (unsigned int)cnt)
+        size <<= 1;
+    mask = size - 1;
+    table = calloc(size, sizeof(*table));
+    first = malloc(cnt * sizeof(*first)); /* frame of each slot */
+    c->slot = malloc(cnt * sizeof(*c->slot));
+    if (!table || !first || !c->slot)
+        goto fail;
+    for (i = 0; i < cnt; i++) {
+        for (h = frame_hash(frames[i]) & mask; table[h]; h = (h + 1) & mask)
+            if (!memcmp(frames[first[table[h] - 1]], frames[i], FRAME_COLORS))
+                break;
+        if (!table[h]) {
+            first[c->distinct] = i;
+            table[h] = ++c->distinct;
+        }
+        c->slot[i] = table[h] - 1;
+    }
+    if (posix_memalign(&arena, QC2S_CACHE_ALIGN,
+                       (size_t)c->distinct * QC2S_FRAME_REPORTS_SIZE))
+        goto fail;
+    c->arena = arena;
+    for (slot = 0; slot < c->distinct; slot++)
+        for (group = 0; group < QC2S_GROUP_COUNT; group++)
+            qc2s_encode_group(c->arena +
+                              (long)slot * QC2S_FRAME_REPORTS_SIZE +
+                              group * QC2S_PACKET_SIZE,
+                              (uint8_t)group, frames[first[slot]][group]);
+    c->frames = cnt;
+    free(table);
+    free(first);
+    return 0;
+fail:
+    free(table);
+    free(first);
+    free(c->slot);
+    memset(c, 0, sizeof(*c));
+    return -1;
+}
+
+void qc2s_cache_free(struct qc2s_report_cache *c)
+{
+    free(c->arena);
+    free(c->slot);
+    memset(c, 0, sizeof(*c));
+}
@@ -0,0 +1,48 @@
+/*
+ * qc2s_encode.h — QuadCast 2S report encoder and precompiled frame reports
+ * No I/O: the CLI transports, the bridge and the tests share it.
+ */
+#ifndef QC2S_ENCODE_H
+#define QC2S_ENCODE_H
+
+#include <stdint.h>
+#include "qc2s_protocol.h"
+
+/* Reports of the cache start at this boundary, a cache line each */
+#define QC2S_CACHE_ALIGN 64
+
+/* Bytes of the reports of a frame: one per group */
+#define QC2S_FRAME_REPORTS_SIZE (QC2S_GROUP_COUNT * QC2S_PACKET_SIZE)
+
+/* Every report is QC2S_PACKET_SIZE bytes */
+void qc2s_encode_init(uint8_t *packet);
+/* Of cnt groups to come */
+void qc2s_encode_start(uint8_t *packet, int cnt);
+/* Every LED of the group gets rgb */
+void qc2s_encode_group(uint8_t *packet, uint8_t group, const uint8_t *rgb);
+/* Each LED of the group gets its own color */
+void qc2s_encode_leds(uint8_t *packet, uint8_t group,
+                      const uint8_t leds[QC2S_LEDS_PER_GROUP][3]);
+
+/* The group reports of every frame of an animation, encoded once. Frames
+   with the same colors share their reports; a zeroed one is empty */
+struct qc2s_report_cache {
+    uint8_t *arena; /* QC2S_FRAME_REPORTS_SIZE per distinct frame, aligned */
+    int *slot;      /* of each frame in the arena */
+    int frames;
+    int distinct;
+};
+
+/* Returns 0, or -1 without memory; the cache is left empty then */
+int qc2s_cache_build(struct qc2s_report_cache *c,
+                     const uint8_t (*frames)[QC2S_GROUP_COUNT][3], int cnt);
+void qc2s_cache_free(struct qc2s_report_cache *c);
+
+/* The reports of the frame, group after group */
+static inline const uint8_t *qc2s_cache_reports(
+    const struct qc2s_report_cache *c, int frame)
+{
+    return c->arena + (long)c->slot[frame] * QC2S_FRAME_REPORTS_SIZE;
+}
+
+#endif /* QC2S_ENCODE_H */
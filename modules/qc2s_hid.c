@@ -0,0 +1,90 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc2s_hid.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "qc2s_hid.h"
+#include "usbdev.h"
+#include "qc2s_bridge.h"
+
+static int qc2s_hid_open(struct micro *m, struct libusb_device *dev,
+                         long long *claim_ns);
+static int qc2s_hid_send(struct micro *m, int group, unsigned int timeout);
+static int qc2s_hid_recover(struct micro *m);
+static void qc2s_hid_close(struct micro *m);
+static int send_bridge_report(struct micro *m, const byte_t *packet,
+                              unsigned int timeout);
+
+const struct transport qc2s_hid_transport = {
+    qc2s_hid_open, qc2s_hid_send, NULL, NULL, qc2s_hid_recover, qc2s_hid_close, 1
+};
+
+/* No libusb handle is needed: the bridge finds the device itself */
+static int qc2s_hid_open(struct micro *m, struct libusb_device *dev,
+                         long long *claim_ns)
+{
+    (void)dev;
+    (void)claim_ns; /* nothing is claimed through libusb */
+    m->bridge = qc2s_open();
+    if(!m->bridge) {
+        fprintf(stderr, BRIDGE_ERR_MSG);
+        return 1;
+    }
+    return 0;
+}
+
+static int qc2s_hid_send(struct micro *m, int group, unsigned int timeout)
+{
+    return qc2s_send_group(m, group, timeout, send_bridge_report);
+}
+
+static int qc2s_hid_recover(struct micro *m)
+{
+    qc2s_close(m->bridge);
+    m->bridge = qc2s_open();
+    return !m->bridge;
+}
+
+static void qc2s_hid_close(struct micro *m)
+{
+    if(m->bridge)
+        qc2s_close(m->bridge);
+    m->bridge = NULL;
+}
+
+/* The bridge waits for the ack itself */
+static int send_bridge_report(struct micro *m, const byte_t *packet,
+                              unsigned int timeout)
+{
+    int rc;
+    (void)timeout;
+    rc = qc2s_send_report(m->bridge, packet, 1);
+    if(rc < 0)
+        return frame_failed;
+    if(rc > 0)
+        m->unacked++;
+#ifdef DEBUG
+    print_packet(packet, "QC2S report (hidapi):");
+#endif
+    return frame_sent;
+}
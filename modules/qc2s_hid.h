@@ -0,0 +1,35 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc2s_hid.h
+ * QuadCast 2S transport over hidapi, where the kernel owns the HID
+ * interfaces: the bridge opens the first QuadCast 2S it finds.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef QC2S_HID_SENTRY
+#define QC2S_HID_SENTRY
+
+#include "transport.h"
+
+/* Messages */
+#define BRIDGE_ERR_MSG _("hidapi: couldn't open QC2S interface 1\n")
+#endif
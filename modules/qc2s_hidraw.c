@@ -0,0 +1,232 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc2s_hidraw.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h> /* for PATH_MAX */
+#include <stdlib.h> /* for realpath */
+#include <unistd.h>
+#include <sys/uio.h> /* for writev */
+#include "qc2s_hidraw.h"
+#include "qc2s_usb.h"
+#include "usbdev.h"
+
+static int hidraw_open(struct micro *m, struct libusb_device *dev,
+                       long long *claim_ns);
+static int hidraw_send(struct micro *m, int group, unsigned int timeout);
+static int hidraw_recover(struct micro *m);
+static void hidraw_close(struct micro *m);
+static int open_watched(struct micro *m);
+static void close_watched(struct micro *m);
+static int open_node(const char *where, int iface);
+static int is_interface(char *hid_path, const char *where, int iface);
+
+const struct transport qc2s_hidraw_transport = {
+    hidraw_open, hidraw_send, NULL, NULL, hidraw_recover, hidraw_close, 0
+};
+
+/* Of the display loop, see qc2s_hidraw_set_notifiers */
+static hidraw_added_cb node_added = NULL;
+static hidraw_removed_cb node_removed = NULL;
+static void *notifier_data = NULL;
+
+/* No driver is detached & nothing is claimed: the node of the color
+ * interface is opened as it is. Without one or without the rights to
+ * it, libusb takes over */
+static int hidraw_open(struct micro *m, struct libusb_device *dev,
+                       long long *claim_ns)
+{
+    find_qc2s_endpoints(m, dev);
+    if(!open_watched(m))
+        return 0;
+#ifdef DEBUG
+    fprintf(stderr, "No hidraw node of %s:%d, using libusb\n", m->where,
+            m->iface);
+#endif
+    return usb_open(m, dev, claim_ns);
+}
+
+/* The reports due at the tick go in one write: the init & start reports
+ * come along with the first group due, a group the device has already
+ * isn't written at all. The group report comes from the reports of the
+ * animation when they were built. The kernel has its own timeouts for
+ * the write, and each of the reports goes as a transfer of its own. The
+ * acks aren't waited for: the display loop reads them as they come, or
+ * the next tick does, see qc2s_hidraw_acks. Those not in by then are
+ * missed */
+static int hidraw_send(struct micro *m, int group, unsigned int timeout)
+{
+    byte_t reports[HIDRAW_BATCH][QC2S_PACKET_SIZE];
+    struct iovec iov[HIDRAW_BATCH];
+    int i, due, cnt = 0, init = 0;
+    long long start;
+    ssize_t sent;
+    if(m->hidraw < 0)
+        return qc2s_usb_transport.send(m, group, timeout);
+    qc2s_hidraw_acks(m); /* without the loop, or came since it looked */
+    if(m->unacked) {
+        qc2s_pace_update(&m->pace, frame_clock_now_ns() - m->acks_ns, 0);
+        m->unacked = 0;
+    }
+    due = qc2s_group_due(m, group);
+    if(due == group_same)
+        return frame_sent;
+    if(due == group_first && !m->init_sent) {
+        qc2s_encode_init(reports[cnt++]);
+        init = 1;
+    }
+    if(due == group_first)
+        qc2s_encode_start(reports[cnt++], m->due_cnt);
+    for(i = 0; i < cnt; i++)
+        iov[i].iov_base = reports[i];
+    iov[cnt].iov_base = (void *)qc2s_group_report(m, group, reports[cnt]);
+    cnt++;
+    for(i = 0; i < cnt; i++)
+        iov[i].iov_len = QC2S_PACKET_SIZE;
+    start = frame_clock_now_ns();
+    sent = writev(m->hidraw, iov, cnt);
+#ifdef DEBUG
+    for(i = 0; i < cnt; i++)
+        print_packet(iov[i].iov_base, "QC2S report (hidraw):");
+    if(sent < 0)
+        perror("hidraw");
+#endif
+    if(init && sent >= QC2S_PACKET_SIZE)
+        m->init_sent = 1;
+    if(sent == cnt*QC2S_PACKET_SIZE) {
+        qc2s_group_shown(m, group);
+        if(timeout > QC2S_ACK_TIMEOUT)
+            timeout = QC2S_ACK_TIMEOUT;
+        m->unacked = cnt;
+        m->acks_ns = start;
+        m->acks_due_ns = start + timeout*NSEC_PER_MSEC;
+        return frame_sent;
+    }
+    return (sent < 0 && errno == ENODEV) ? frame_fatal : frame_failed;
+}
+
+static int hidraw_recover(struct micro *m)
+{
+    if(m->hidraw < 0)
+        return qc2s_usb_transport.recover(m);
+    close_watched(m);
+    return open_watched(m);
+}
+
+static void hidraw_close(struct micro *m)
+{
+    if(m->hidraw >= 0)
+        close_watched(m);
+    usb_close(m);
+}
+
+void qc2s_hidraw_set_notifiers(hidraw_added_cb added,
+                               hidraw_removed_cb removed, void *data)
+{
+    node_added = added;
+    node_removed = removed;
+    notifier_data = data;
+}
+
+void qc2s_hidraw_acks(struct micro *m)
+{
+    byte_t ack[QC2S_PACKET_SIZE];
+    long long now;
+    int i;
+    for(i = 0; i < HIDRAW_ACK_MAX; i++) {
+        if(read(m->hidraw, ack, sizeof(ack)) <= 0)
+            break;
+#ifdef DEBUG
+        print_packet(ack, "QC2S ack:");
+#endif
+        if(!m->unacked || --m->unacked) /* one given up on, or not the last */
+            continue;
+        now = frame_clock_now_ns();
+        qc2s_pace_update(&m->pace, now - m->acks_ns, now <= m->acks_due_ns);
+    }
+}
+
+/* Returns 1 if there is no node to open */
+static int open_watched(struct micro *m)
+{
+    m->unacked = 0;
+    m->hidraw = open_node(m->where, m->iface);
+    if(m->hidraw < 0)
+        return 1;
+    if(node_added)
+        node_added(m->hidraw, notifier_data);
+    return 0;
+}
+
+static void close_watched(struct micro *m)
+{
+    if(node_removed)
+        node_removed(m->hidraw, notifier_data);
+    close(m->hidraw);
+    m->hidraw = -1;
+}
+
+/* Returns the descriptor of the node, -1 if there is none */
+static int open_node(const char *where, int iface)
+{
+    char path[PATH_MAX], real[PATH_MAX];
+    struct dirent *ent;
+    DIR *dir;
+    int fd = -1;
+    dir = opendir(SYSFS_HIDRAW);
+    if(!dir)
+        return -1;
+    while((ent = readdir(dir))) {
+        if(strncmp(ent->d_name, "hidraw", 6))
+            continue;
+        snprintf(path, sizeof(path), SYSFS_HIDRAW "/%s/device",
+                 ent->d_name);
+        if(!realpath(path, real) || !is_interface(real, where, iface))
+            continue;
+        snprintf(path, sizeof(path), "/dev/%s", ent->d_name);
+        fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        break;
+    }
+    closedir(dir);
+    return fd;
+}
+
+/* The HID device lives in the directory of its USB interface, named
+ * "<where>:<config>.<interface>" */
+static int is_interface(char *hid_path, const char *where, int iface)
+{
+    char *name;
+    size_t len = strlen(where);
+    int config, num;
+    name = strrchr(hid_path, '/');
+    if(!name)
+        return 0;
+    *name = 0;
+    name = strrchr(hid_path, '/');
+    name = name ? name+1 : hid_path;
+    return !strncmp(name, where, len) && name[len] == ':' &&
+           sscanf(name+len+1, "%d.%d", &config, &num) == 2 && num == iface;
+}
@@ -0,0 +1,54 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc2s_hidraw.h
+ * QuadCast 2S transport over Linux hidraw: the kernel HID driver stays
+ * attached and the reports due at a tick go in one writev. Acks are read
+ * as they come instead of being waited for. Without a node it can open,
+ * the microphone is driven through libusb.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef QC2S_HIDRAW_SENTRY
+#define QC2S_HIDRAW_SENTRY
+
+#include "transport.h"
+
+/* Constants */
+#define SYSFS_HIDRAW "/sys/class/hidraw"
+#define HIDRAW_BATCH 3 /* init, start & a group at most */
+#define HIDRAW_ACK_MAX 16 /* read at once */
+
+/* Types */
+/* Told as the nodes are opened & before they are closed, so their acks
+ * are read as they come, see qc2s_hidraw_acks */
+typedef void (*hidraw_added_cb)(int fd, void *data);
+typedef void (*hidraw_removed_cb)(int fd, void *data);
+
+/* Functions */
+/* NULL for both to stop being told */
+void qc2s_hidraw_set_notifiers(hidraw_added_cb added,
+                               hidraw_removed_cb removed, void *data);
+/* Reads the acks of m that came. Once the last of a write is in, the
+ * time since the write paces the next group, as missed if it is later
+ * than the timeout of the write */
+void qc2s_hidraw_acks(struct micro *m);
+#endif
@@ -0,0 +1,46 @@
+/*
+ * qc2s_pace.c — ack-driven pacing of QuadCast 2S group reports
+ */
+#include "qc2s_pace.h"
+
+#define NS_PER_MS 1000000LL
+#define START_NS (QC2S_PACE_START_MS * NS_PER_MS)
+
+void qc2s_pace_update(struct qc2s_pace *p, long long elapsed_ns, int acked)
+{
+    long long target;
+
+    if (p->floor_ns == 0)
+        p->floor_ns = START_NS;
+
+    if (!acked) {
+        p->missed++;
+        p->floor_ns *= 2;
+        if (p->floor_ns > START_NS)
+            p->floor_ns = START_NS;
+        return;
+    }
+
+    p->acked++;
+    if (p->rtt_ns == 0)
+        p->rtt_ns = elapsed_ns;
+    else
+        p->rtt_ns += (elapsed_ns - p->rtt_ns) / (1 << QC2S_PACE_SHIFT);
+
+    /* A quarter on top for the ack times the average hides */
+    target = p->rtt_ns + p->rtt_ns / 4;
+    if (target < QC2S_PACE_MIN_MS * NS_PER_MS)
+        target = QC2S_PACE_MIN_MS * NS_PER_MS;
+    if (target >= p->floor_ns)
+        p->floor_ns = target;
+    else
+        p->floor_ns -= (p->floor_ns - target + (1 << QC2S_PACE_SHIFT) - 1)
+                       >> QC2S_PACE_SHIFT;
+}
+
+long qc2s_pace_period_ms(const struct qc2s_pace *p)
+{
+    if (p->floor_ns == 0)
+        return QC2S_PACE_START_MS;
+    return (long)((p->floor_ns + NS_PER_MS / 2) / NS_PER_MS);
+}
@@ -0,0 +1,34 @@
+/*
+ * qc2s_pace.h — ack-driven pacing of QuadCast 2S group reports
+ * No I/O and no clock: callers time their reports and ask for the period.
+ */
+#ifndef QC2S_PACE_H
+#define QC2S_PACE_H
+
+/* Group periods (milliseconds). Every firmware seen keeps up with the
+   first one; below the last one a frame of 6 groups would be shorter
+   than a QuadCast S frame */
+#define QC2S_PACE_START_MS 45
+#define QC2S_PACE_MIN_MS   10
+
+/* Smoothing of the ack times and decay of the floor, as 1/2^SHIFT */
+#define QC2S_PACE_SHIFT 3
+
+/* A zeroed one starts at QC2S_PACE_START_MS, as if nothing were known */
+struct qc2s_pace {
+    long long rtt_ns;   /* smoothed first write to last ack, 0 before any */
+    long long floor_ns; /* the shortest group period that keeps up */
+    unsigned long acked;
+    unsigned long missed;
+};
+
+/* The reports of a group took elapsed_ns from the first write to the
+   last ack; acked is 0 if an ack didn't come in time. An ack lowers the
+   floor towards the ack time with some margin, slowly; a miss doubles it,
+   up to QC2S_PACE_START_MS. */
+void qc2s_pace_update(struct qc2s_pace *p, long long elapsed_ns, int acked);
+
+/* The period to give the next group, to the nearest millisecond. */
+long qc2s_pace_period_ms(const struct qc2s_pace *p);
+
+#endif /* QC2S_PACE_H */
@@ -9,6 +9,8 @@
 #define QC2S_GROUP_COUNT 6
 #define QC2S_UPPER_GROUPS 2
 #define QC2S_RGB_OFFSET 4
+/* RGB slots of a group report, one per LED of the group */
+#define QC2S_LEDS_PER_GROUP ((QC2S_PACKET_SIZE - QC2S_RGB_OFFSET) / 3)
 
 /* Report commands */
 #define QC2S_CMD_INIT 0x10
@@ -16,15 +18,17 @@
 #define QC2S_SUB_START 0x01
 #define QC2S_SUB_DATA 0x02
 
-/* HID interrupt endpoints used by QC2S firmware variants */
+/* HID interface of the color reports and its interrupt endpoints
+   (firmware 61.12, see quadcast2s_usb_dump.txt) */
+#define QC2S_REPORT_IFACE 1
 #define QC2S_INTR_EP_OUT 0x06
-#define QC2S_INTR_EP_OUT_ALT1 0x04
-#define QC2S_INTR_EP_OUT_ALT2 0x02
 #define QC2S_INTR_EP_IN 0x85
-#define QC2S_INTR_EP_IN_ALT1 0x83
-#define QC2S_INTR_EP_IN_ALT2 0x81
 
 /* Ack timeout (milliseconds) */
 #define QC2S_ACK_TIMEOUT 100
 
+/* Only groups whose colors changed are sent; a frame that stays the same
+   is sent whole again after this many milliseconds (default) */
+#define QC2S_KEEPALIVE_MS 5000
+
 #endif /* QC2S_PROTOCOL_H */
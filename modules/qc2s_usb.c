@@ -0,0 +1,202 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File qc2s_usb.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "qc2s_usb.h"
+#include "usbdev.h"
+
+/* The interface of the color reports for each known QC2S firmware;
+ * others get QC2S_REPORT_IFACE or the first with an interrupt OUT */
+static const struct qc2s_firmware {
+    unsigned short bcd_device;
+    int iface;
+} qc2s_firmwares[] = {
+    { 0x6112, QC2S_REPORT_IFACE }
+};
+
+static int qc2s_usb_open(struct micro *m, libusb_device *dev,
+                         long long *claim_ns);
+static int qc2s_usb_send(struct micro *m, int group, unsigned int timeout);
+static int qc2s_usb_recover(struct micro *m);
+static int intr_endpoints(const struct libusb_config_descriptor *config,
+                          int iface, byte_t *ep_out, byte_t *ep_in);
+static int send_qc2s_report(struct micro *m, const byte_t *packet,
+                            unsigned int timeout);
+static int qc2s_read_ack(struct micro *m, unsigned int timeout);
+
+const struct transport qc2s_usb_transport = {
+    qc2s_usb_open, qc2s_usb_send, NULL, NULL, qc2s_usb_recover, usb_close, 0
+};
+
+/* A new firmware may come with a device plugged in again, so the
+ * endpoints are looked for at every opening */
+static int qc2s_usb_open(struct micro *m, libusb_device *dev,
+                         long long *claim_ns)
+{
+    if(usb_open(m, dev, claim_ns))
+        return 1;
+    find_qc2s_endpoints(m, dev);
+    return 0;
+}
+
+static int qc2s_usb_send(struct micro *m, int group, unsigned int timeout)
+{
+    return qc2s_send_group(m, group, timeout, send_qc2s_report);
+}
+
+static int qc2s_usb_recover(struct micro *m)
+{
+    if(m->ep_out)
+        libusb_clear_halt(m->handle, m->ep_out);
+    if(m->ep_in)
+        libusb_clear_halt(m->handle, m->ep_in);
+    return usb_reclaim(m);
+}
+
+/* The endpoints are picked once, from the descriptors: no transfer is
+ * spent on probing, neither in the first frame nor in retries */
+void find_qc2s_endpoints(struct micro *m, libusb_device *dev)
+{
+    struct libusb_device_descriptor descr;
+    struct libusb_config_descriptor *config;
+    int i;
+    libusb_get_device_descriptor(dev, &descr);
+    m->iface = QC2S_REPORT_IFACE;
+    for(i = 0; i < (int)(sizeof(qc2s_firmwares)/sizeof(*qc2s_firmwares));
+        i++)
+        if(qc2s_firmwares[i].bcd_device == descr.bcdDevice)
+            m->iface = qc2s_firmwares[i].iface;
+    m->ep_out = QC2S_INTR_EP_OUT; /* if the descriptors can't be read */
+    m->ep_in = QC2S_INTR_EP_IN;
+    if(libusb_get_active_config_descriptor(dev, &config))
+        return;
+    if(!intr_endpoints(config, m->iface, &m->ep_out, &m->ep_in)) {
+        for(i = 0; i < config->bNumInterfaces; i++) {
+            if(intr_endpoints(config, i, &m->ep_out, &m->ep_in)) {
+                m->iface = i;
+                break;
+            }
+        }
+        if(i == config->bNumInterfaces) /* SET_REPORT, acks included */
+            intr_endpoints(config, m->iface, &m->ep_out, &m->ep_in);
+    }
+    libusb_free_config_descriptor(config);
+#ifdef DEBUG
+    fprintf(stderr, "QC2S firmware %x.%02x: interface %d, "
+            "endpoints 0x%02x/0x%02x\n", descr.bcdDevice >> 8,
+            descr.bcdDevice & 0xff, m->iface, m->ep_out, m->ep_in);
+#endif
+}
+
+/* Interrupt endpoints of a HID interface, 0 where there are none.
+ * Returns 1 if there is an OUT one */
+static int intr_endpoints(const struct libusb_config_descriptor *config,
+                          int iface, byte_t *ep_out, byte_t *ep_in)
+{
+    const struct libusb_interface_descriptor *alt;
+    const struct libusb_endpoint_descriptor *ep;
+    int i;
+    *ep_out = *ep_in = 0;
+    for(i = 0; i < config->bNumInterfaces; i++) {
+        alt = config->interface[i].altsetting;
+        if(config->interface[i].num_altsetting > 0 &&
+           alt->bInterfaceNumber == iface &&
+           alt->bInterfaceClass == LIBUSB_CLASS_HID)
+            break;
+    }
+    if(i == config->bNumInterfaces)
+        return 0;
+    for(ep = alt->endpoint; ep < alt->endpoint+alt->bNumEndpoints; ep++) {
+        if((ep->bmAttributes & LIBUSB_TRANSFER_TYPE_MASK) !=
+           LIBUSB_TRANSFER_TYPE_INTERRUPT)
+            continue;
+        if(ep->bEndpointAddress & LIBUSB_ENDPOINT_IN)
+            *ep_in = ep->bEndpointAddress;
+        else
+            *ep_out = ep->bEndpointAddress;
+    }
+    return *ep_out != 0;
+}
+
+static int send_qc2s_report(struct micro *m, const byte_t *packet,
+                            unsigned int timeout)
+{
+    int transferred = 0;
+    int errcode;
+
+    if(m->ep_out) {
+        errcode = libusb_interrupt_transfer(m->handle, m->ep_out,
+                                            (unsigned char *)packet,
+                                            PACKET_SIZE, &transferred,
+                                            timeout);
+#ifdef DEBUG
+        print_packet(packet, "QC2S report (intr):");
+        if(errcode)
+            fprintf(stderr, DATAPCK_ERR_MSG, libusb_strerror(errcode));
+#endif
+        if(errcode)
+            return transfer_result(errcode);
+        if(transferred != PACKET_SIZE)
+            return frame_failed;
+        if(!qc2s_read_ack(m, timeout))
+            m->unacked++;
+        return frame_sent;
+    }
+
+    /* The interface has no OUT endpoint: HID SET_REPORT over control */
+    transferred = libusb_control_transfer(m->handle, BMREQUEST_TYPE_OUT,
+                      BREQUEST_OUT, (0x0200 | packet[0]), m->iface,
+                      (unsigned char *)(packet+1), PACKET_SIZE-1, timeout);
+#ifdef DEBUG
+    print_packet(packet, "QC2S report (ctrl):");
+    if(transferred < 0)
+        fprintf(stderr, DATAPCK_ERR_MSG, libusb_strerror(transferred));
+#endif
+    return (transferred == PACKET_SIZE-1) ? frame_sent
+                                          : transfer_result(transferred);
+}
+
+/* Returns 0 if the ack didn't come; without an IN endpoint there is
+ * none to wait for */
+static int qc2s_read_ack(struct micro *m, unsigned int timeout)
+{
+    byte_t ack[PACKET_SIZE] = {0};
+    int errcode, transferred = 0;
+
+    if(!m->ep_in)
+        return 1;
+
+    errcode = libusb_interrupt_transfer(m->handle, m->ep_in, ack,
+                                        PACKET_SIZE, &transferred,
+                                        timeout < QC2S_ACK_TIMEOUT ?
+                                        timeout : QC2S_ACK_TIMEOUT);
+#ifdef DEBUG
+    if(!errcode && transferred > 0)
+        print_packet(ack, "QC2S ack:");
+    else if(errcode && errcode != LIBUSB_ERROR_TIMEOUT)
+        fprintf(stderr, "ack ep 0x%02x err=%d (%s)\n", m->ep_in,
+                errcode, libusb_strerror(errcode));
+#endif
+    return !errcode && transferred > 0;
+}
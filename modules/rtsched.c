@@ -0,0 +1,179 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File rtsched.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifdef __linux__
+#define _GNU_SOURCE /* for sched_setaffinity */
+#endif
+#include "rtsched.h"
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+
+/* Not in the libc headers */
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_VALUE(CLASS, LVL) (((CLASS) << IOPRIO_CLASS_SHIFT) | (LVL))
+#endif
+
+static int raise_priority(int verbose);
+static void raise_io_priority(void);
+static int pin_cpu(int cpu);
+static void bench_usleep(struct frame_stats *st);
+static void bench_clock(struct frame_stats *st);
+static void print_jitter_table(const struct frame_stats *st, int cnt);
+
+/* Column titles of the benchmark */
+static const char *bench_modes[] = { "usleep", "deadline", "realtime" };
+
+/* Must be called after the animation has been compiled and the process
+ * forked, since the memory lock isn't inherited */
+int rt_enable(int cpu, int verbose)
+{
+    int level;
+    level = raise_priority(verbose);
+    raise_io_priority();
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) && verbose)
+        fprintf(stderr, RT_MLOCK_ERR_MSG);
+    if(cpu >= 0 && pin_cpu(cpu) && verbose)
+        fprintf(stderr, RT_CPU_ERR_MSG, cpu);
+    return level;
+}
+
+static int raise_priority(int verbose)
+{
+#ifdef __linux__
+    struct sched_param param;
+    param.sched_priority = RT_PRIORITY;
+    if(!sched_setscheduler(0, SCHED_FIFO, &param)) {
+        if(verbose)
+            printf(RT_FIFO_MSG, "SCHED_FIFO");
+        return rt_realtime;
+    }
+    if(!sched_setscheduler(0, SCHED_RR, &param)) {
+        if(verbose)
+            printf(RT_FIFO_MSG, "SCHED_RR");
+        return rt_realtime;
+    }
+#endif
+    if(!setpriority(PRIO_PROCESS, 0, RT_NICE)) {
+        if(verbose)
+            printf(RT_NICE_MSG, RT_NICE);
+        return rt_nice;
+    }
+    if(verbose)
+        printf(RT_NONE_MSG);
+    return rt_none;
+}
+
+static void raise_io_priority(void)
+{
+#ifdef __linux__
+    /* The real-time class needs CAP_SYS_ADMIN, the best of the
+     * best-effort class is allowed to anyone */
+    if(syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+               IOPRIO_VALUE(IOPRIO_CLASS_RT, 0)))
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                IOPRIO_VALUE(IOPRIO_CLASS_BE, 0));
+#endif
+}
+
+static int pin_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+    return -1; /* no affinity API */
+#endif
+}
+
+/* Compares the pacing of the old loop (usleep after every frame), the
+ * deadline clock and the deadline clock in the low-jitter mode */
+void bench_jitter(int cpu)
+{
+    struct frame_stats st[3];
+    memset(st, 0, sizeof(st));
+    bench_usleep(&st[0]);
+    bench_clock(&st[1]);
+    rt_enable(cpu, 1);
+    bench_clock(&st[2]);
+    printf(BENCH_HEAD_MSG, BENCH_TICKS, BENCH_PERIOD);
+    print_jitter_table(st, 3);
+}
+
+static void bench_usleep(struct frame_stats *st)
+{
+    int i;
+    for(i = 0; i < BENCH_TICKS; i++) {
+        long long start = frame_clock_now_ns(), late;
+        usleep(1000*BENCH_PERIOD);
+        late = frame_clock_now_ns() - start - BENCH_PERIOD*NSEC_PER_MSEC;
+        frame_stats_add(st, late > 0 ? late : 0);
+    }
+}
+
+static void bench_clock(struct frame_stats *st)
+{
+    struct frame_clock fc;
+    int i;
+    frame_clock_start(&fc, BENCH_PERIOD);
+    for(i = 0; i < BENCH_TICKS; i++)
+        frame_clock_wait(&fc);
+    *st = fc.stats;
+}
+
+static void print_jitter_table(const struct frame_stats *st, int cnt)
+{
+    int i, bucket;
+    printf("%14s", "");
+    for(i = 0; i < cnt; i++)
+        printf("%10s", bench_modes[i]);
+    puts("");
+    for(bucket = 0; bucket < JITTER_BUCKETS; bucket++) {
+        if(bucket == 0)
+            printf("%14s", "< 1 us");
+        else if(bucket == JITTER_BUCKETS-1)
+            printf("%8s%-6d", ">= ", 1 << (bucket-1));
+        else
+            printf("%7d-%-6d", 1 << (bucket-1), 1 << bucket);
+        for(i = 0; i < cnt; i++)
+            printf("%10lu", st[i].hist[bucket]);
+        puts("");
+    }
+    printf("%14s", _("mean, us"));
+    for(i = 0; i < cnt; i++)
+        printf("%10lld", st[i].ticks ?
+               st[i].total_late_ns / (long long)st[i].ticks / 1000 : 0);
+    puts("");
+    printf("%14s", _("max, us"));
+    for(i = 0; i < cnt; i++)
+        printf("%10lld", st[i].max_late_ns / 1000);
+    puts("");
+}
@@ -0,0 +1,63 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File rtsched.h
+ * Low-jitter scheduling for the display loop.
+ * Asks for a real-time policy when permitted, falls back to a higher nice
+ * value and I/O priority otherwise, locks the memory and pins the process
+ * to a CPU. Also measures the wakeup lateness of the frame pacing.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef RTSCHED_SENTRY
+#define RTSCHED_SENTRY
+
+#include <stdio.h> /* for printf */
+#include <unistd.h> /* for usleep */
+#include <sys/mman.h> /* for mlockall */
+#include <sys/resource.h> /* for setpriority */
+#include "locale_macros.h"
+#include "frameclock.h" /* for frame_clock & frame_stats */
+
+/* Constants */
+#define RT_PRIORITY 10 /* low for SCHED_FIFO, but above every normal task */
+#define RT_NICE -10
+#define BENCH_PERIOD 10 /* ms */
+#define BENCH_TICKS 300
+
+/* Messages */
+#define RT_FIFO_MSG _("Low-jitter mode: real-time scheduling (%s).\n")
+#define RT_NICE_MSG _("Low-jitter mode: no real-time permission, " \
+                      "nice %d.\n")
+#define RT_NONE_MSG _("Low-jitter mode: no permission to raise the " \
+                      "priority.\n")
+#define RT_MLOCK_ERR_MSG _("Low-jitter mode: couldn't lock the memory.\n")
+#define RT_CPU_ERR_MSG _("Low-jitter mode: couldn't pin to CPU %d.\n")
+#define BENCH_HEAD_MSG _("Wakeup lateness, %d ticks of %d ms:\n")
+
+/* Levels of the achieved priority */
+enum rt_levels { rt_none, rt_nice, rt_realtime };
+
+/* Functions */
+int rt_enable(int cpu, int verbose);
+void bench_jitter(int cpu);
+
+#endif
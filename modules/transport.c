@@ -0,0 +1,275 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File transport.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include <stdint.h> /* for uintptr_t */
+#include <stdlib.h> /* for malloc */
+#include "transport.h"
+
+#if defined(USE_HIDAPI)
+#define QC2S_TRANSPORT (&qc2s_hid_transport) /* the kernel owns HID */
+#elif defined(__linux__)
+#define QC2S_TRANSPORT (&qc2s_hidraw_transport) /* libusb without hidraw */
+#else
+#define QC2S_TRANSPORT (&qc2s_usb_transport)
+#endif
+
+/* The models known. QuadCast 2S shows a group per tick, so a frame takes
+ * QC2S_GROUP_COUNT of them */
+static const struct micro_caps models[] = {
+    { DEV_VID_NA, DEV_PID_NA1, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_NA, DEV_PID_NA2, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_NA, DEV_PID_NA3, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_EU1, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_EU2, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_EU3, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_EU4, "QuadCast S", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_DUOCAST, "DuoCast", report_command, 1,
+      FRAME_PERIOD, &qc1_transport },
+    { DEV_VID_EU, DEV_PID_NA3, "QuadCast 2S", report_groups,
+      QC2S_GROUP_COUNT, QC2S_GROUP_PERIOD, QC2S_TRANSPORT }
+};
+
+static void command_frame(const byte_t *colcommand, struct ring_frame *f);
+static const byte_t *cached_reports(const struct frame_reports *r,
+                                    const byte_t *colcommand);
+static void get_group_colors(const byte_t *colcommand, byte_t *upper,
+                             byte_t *lower);
+
+const struct micro_caps *find_caps(unsigned short vid, unsigned short pid)
+{
+    const struct micro_caps *c;
+    for(c = models; c < models+sizeof(models)/sizeof(*models); c++)
+        if(c->vid == vid && c->pid == pid)
+            return c;
+    return NULL;
+}
+
+int micro_show(struct micro *m, const byte_t *colcommand,
+               const struct ring_frame *f, unsigned long step,
+               unsigned int timeout)
+{
+    int group = step % m->caps->groups;
+    if(group == 0) {
+        m->command = colcommand;
+        m->cached = NULL;
+        if(colcommand) {
+            command_frame(colcommand, &m->frame);
+            m->cached = cached_reports(m->reports, colcommand);
+        } else {
+            m->frame = *f;
+        }
+    }
+    m->uploaded = 0;
+    return m->caps->transport->send(m, group, timeout);
+}
+
+int micro_upload(struct micro *m, const datpack *data_arr, short command_cnt,
+                 unsigned long pos, unsigned int timeout)
+{
+    int first, res;
+    if(m->uploaded && pos)
+        return frame_sent;
+    first = pos / COLPAIR_PER_PCT;
+    res = m->caps->transport->upload(m, data_arr+first,
+              (command_cnt+COLPAIR_PER_PCT-1)/COLPAIR_PER_PCT - first,
+              timeout);
+    m->uploaded = (res == frame_sent);
+    return res;
+}
+
+int micro_persist(struct micro *m, const datpack *data_arr, short command_cnt,
+                  unsigned int timeout)
+{
+    const struct transport *t = m->caps->transport;
+    if(!t->upload || !t->readback || !command_cnt)
+        return 1;
+    m->uploaded = 0;
+    if(micro_upload(m, data_arr, command_cnt, 0, timeout) != frame_sent)
+        return 1;
+    return t->readback(m, data_arr,
+                       (command_cnt+COLPAIR_PER_PCT-1)/COLPAIR_PER_PCT,
+                       timeout);
+}
+
+long micro_period(const struct micro *m)
+{
+    if(m->caps->format == report_groups)
+        return qc2s_pace_period_ms(&m->pace);
+    return m->caps->period;
+}
+
+/* The time from the first write to the last ack paces the next group.
+ * The groups the device has already cost nothing */
+int qc2s_send_group(struct micro *m, int group, unsigned int timeout,
+                    qc2s_report_fn report)
+{
+    byte_t packet[QC2S_PACKET_SIZE];
+    long long start;
+    int res, due;
+    due = qc2s_group_due(m, group);
+    if(due == group_same)
+        return frame_sent;
+    start = frame_clock_now_ns();
+    m->unacked = 0;
+    if(due == group_first && !m->init_sent) {
+        qc2s_encode_init(packet);
+        res = report(m, packet, timeout);
+        if(res != frame_sent)
+            return res;
+        m->init_sent = 1;
+    }
+    if(due == group_first) {
+        qc2s_encode_start(packet, m->due_cnt);
+        res = report(m, packet, timeout);
+        if(res != frame_sent)
+            return res;
+    }
+    res = report(m, qc2s_group_report(m, group, packet), timeout);
+    if(res == frame_sent) {
+        qc2s_group_shown(m, group);
+        qc2s_pace_update(&m->pace, frame_clock_now_ns() - start,
+                         !m->unacked);
+    }
+    return res;
+}
+
+/* The groups due are found when the frame starts: all of them before the
+ * init report and once m->keepalive ms passed without a report, else
+ * those whose colors the device hasn't got */
+int qc2s_group_due(struct micro *m, int group)
+{
+    int i, all;
+    if(group == 0) {
+        all = !m->init_sent || (m->keepalive &&
+              frame_clock_now_ns() - m->shown_ns >=
+              m->keepalive*NSEC_PER_MSEC);
+        m->due = m->due_cnt = 0;
+        for(i = 0; i < QC2S_GROUP_COUNT; i++) {
+            if(all || memcmp(m->shown[i], m->frame.rgb[i], 3)) {
+                m->due |= 1 << i;
+                m->due_cnt++;
+            }
+        }
+    }
+    if(!(m->due & 1 << group))
+        return group_same;
+    return (m->due & ((1 << group) - 1)) ? group_due : group_first;
+}
+
+void qc2s_group_shown(struct micro *m, int group)
+{
+    memcpy(m->shown[group], m->frame.rgb[group], 3);
+    m->shown_ns = frame_clock_now_ns();
+}
+
+const byte_t *qc2s_group_report(const struct micro *m, int group,
+                                byte_t *packet)
+{
+    if(m->cached)
+        return m->cached + group*QC2S_PACKET_SIZE;
+    qc2s_encode_group(packet, (byte_t)group, m->frame.rgb[group]);
+    return packet;
+}
+
+int frame_reports_build(struct frame_reports *r, const datpack *data_arr,
+                        short command_cnt)
+{
+    byte_t (*frames)[QC2S_GROUP_COUNT][3];
+    struct ring_frame f;
+    int i, res;
+    r->data_arr = data_arr;
+    r->command_cnt = command_cnt;
+    memset(&r->cache, 0, sizeof(r->cache));
+    if(!data_arr || !command_cnt)
+        return 0;
+    frames = malloc(command_cnt*sizeof(*frames));
+    if(!frames)
+        return 1;
+    for(i = 0; i < command_cnt; i++) {
+        command_frame(*data_arr + 2*BYTE_STEP*i, &f);
+        memcpy(frames[i], f.rgb, sizeof(*frames));
+    }
+    res = qc2s_cache_build(&r->cache, (const uint8_t (*)[QC2S_GROUP_COUNT][3])
+                           frames, command_cnt);
+    free(frames);
+    return res != 0;
+}
+
+void frame_reports_free(struct frame_reports *r)
+{
+    qc2s_cache_free(&r->cache);
+    r->data_arr = NULL;
+    r->command_cnt = 0;
+}
+
+/* NULL if colcommand isn't one of the animation */
+static const byte_t *cached_reports(const struct frame_reports *r,
+                                    const byte_t *colcommand)
+{
+    uintptr_t first, at;
+    long pos;
+    if(!r || !r->cache.arena)
+        return NULL;
+    /* Pointers into other objects can't be subtracted: the addresses are
+     * compared before */
+    first = (uintptr_t)*r->data_arr;
+    at = (uintptr_t)colcommand;
+    if(at < first || at - first >= (uintptr_t)r->command_cnt*2*BYTE_STEP)
+        return NULL;
+    pos = colcommand - *r->data_arr;
+    if(pos % (2*BYTE_STEP))
+        return NULL;
+    return qc2s_cache_reports(&r->cache, pos/(2*BYTE_STEP));
+}
+
+static void command_frame(const byte_t *colcommand, struct ring_frame *f)
+{
+    byte_t upper[3], lower[3];
+    get_group_colors(colcommand, upper, lower);
+    ring_frame_set_parts(f, upper, lower);
+}
+
+static void get_group_colors(const byte_t *colcommand, byte_t *upper,
+                             byte_t *lower)
+{
+    if(*colcommand == RGB_CODE) {
+        memcpy(upper, colcommand+1, 3);
+    } else {
+        memset(upper, 0, 3);
+    }
+
+    if(*(colcommand+BYTE_STEP) == RGB_CODE) {
+        memcpy(lower, colcommand+BYTE_STEP+1, 3);
+    } else {
+        memset(lower, 0, 3);
+    }
+}
@@ -0,0 +1,214 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File transport.h
+ * Transports of microphones: each model is driven through a set of
+ * operations over its own context, so the display loop doesn't care about
+ * the protocol and models of any kind can be driven together.
+ * The table of models says which transport a model takes and how its
+ * frames are sent.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef TRANSPORT_SENTRY
+#define TRANSPORT_SENTRY
+
+#include <string.h> /* for memcpy */
+#include "rgbmodes.h" /* for datpack, byte_t, BYTE_STEP & RGB_CODE */
+#include "framering.h" /* for struct ring_frame */
+#include "qc2s_protocol.h"
+#include "qc2s_pace.h" /* for the ack-driven QC2S period */
+#include "qc2s_encode.h" /* for the QC2S reports */
+
+/* Constants */
+/* Vendor IDs */
+#define DEV_VID_NA      0x0951
+#define DEV_VID_EU      0x03f0
+/* Product IDs */
+#define DEV_PID_NA1     0x171f
+#define DEV_PID_NA2     0x0d84
+#define DEV_PID_NA3     0x02b5
+#define DEV_PID_EU1     0x0f8b
+#define DEV_PID_EU2     0x028c
+#define DEV_PID_EU3     0x048c
+#define DEV_PID_EU4     0x068c
+#define DEV_PID_DUOCAST 0x098c
+
+#define FRAME_PERIOD 55 /* ms per QuadCast S color command */
+#define QC2S_GROUP_PERIOD QC2S_PACE_START_MS /* until its acks tell */
+#define MICRO_WHERE_LEN 32 /* "bus-port.port..." */
+
+/* Results of sending a report */
+enum { frame_sent, frame_failed, frame_fatal };
+
+/* QuadCast 2S groups of a frame, see qc2s_group_due */
+enum {
+    group_same, /* the device has its colors, nothing is sent */
+    group_due,
+    group_first /* the first one due, the start report goes before it */
+};
+
+/* How frames are sent */
+enum report_formats {
+    report_command, /* a color command of the upper & lower parts */
+    report_groups /* a report per group of light diodes */
+};
+
+/* Structs */
+struct micro;
+struct libusb_device;
+struct qc1_pipe;
+
+struct transport {
+    /* Opens & claims the device, adds the time of claiming to claim_ns
+     * unless it is NULL. Returns 1 on errors, which are reported already */
+    int (*open)(struct micro *m, struct libusb_device *dev,
+                long long *claim_ns);
+    /* Sends a group of m->frame, all of it for models of one group.
+     * Returns frame_sent, frame_failed or frame_fatal if it is gone */
+    int (*send)(struct micro *m, int group, unsigned int timeout);
+    /* Sends cnt packets of color commands for the device to play by
+     * itself, NULL if it can't. Returns as send does */
+    int (*upload)(struct micro *m, const datpack *packets, int cnt,
+                  unsigned int timeout);
+    /* Returns 0 if the device reads back the cnt packets uploaded last,
+     * NULL if it can't be asked */
+    int (*readback)(struct micro *m, const datpack *packets, int cnt,
+                    unsigned int timeout);
+    /* Returns 1 if the device can't be used as it is */
+    int (*recover)(struct micro *m);
+    void (*close)(struct micro *m);
+    int single; /* takes the first device it finds, so one at most */
+};
+
+/* The QuadCast 2S group reports of every color command of an animation,
+ * see frame_reports_build */
+struct frame_reports {
+    struct qc2s_report_cache cache; /* empty if it couldn't be built */
+    const datpack *data_arr; /* the animation */
+    short command_cnt;
+};
+
+/* What a model can do */
+struct micro_caps {
+    unsigned short vid;
+    unsigned short pid;
+    const char *name;
+    int format; /* report_formats */
+    int groups; /* reports per frame, one per tick */
+    int period; /* ms between two reports at least, see micro_period */
+    const struct transport *transport;
+};
+
+/* A microphone of the display loop */
+struct micro {
+    const struct micro_caps *caps;
+    struct libusb_device_handle *handle; /* NULL if the bridge is used */
+    struct qc2s_ctx *bridge; /* hidapi builds, QuadCast 2S only */
+    struct qc1_pipe *pipe; /* QuadCast S transfers, NULL: synchronous */
+    int iface; /* QC2S interface of the color reports */
+    int hidraw; /* its /dev/hidraw* node, -1 if libusb is used */
+    byte_t ep_out; /* its interrupt endpoints; SET_REPORT without OUT */
+    byte_t ep_in; /* 0 if there are no acks to read */
+    int init_sent;
+    struct qc2s_pace pace; /* QC2S: how fast its acks come */
+    int unacked; /* reports of the group whose ack didn't come */
+    long long acks_ns; /* hidraw: of the write whose acks are awaited */
+    long long acks_due_ns; /* they are missed after it */
+    byte_t shown[QC2S_GROUP_COUNT][3]; /* QC2S: the colors it has */
+    long long shown_ns; /* of its last group report */
+    int keepalive; /* ms without a report before all is sent again, 0 never */
+    int due; /* groups of the frame to send, a bit each */
+    int due_cnt;
+    const datpack *data_arr; /* its own animation, NULL for the shared */
+    short command_cnt;
+    const struct frame_reports *reports; /* QC2S: of its animation or NULL */
+    const byte_t *cached; /* group reports of the frame, NULL: encoded */
+    const byte_t *command; /* of the frame, NULL if it isn't animated */
+    int uploaded; /* plays the animation by itself, see micro_upload */
+    struct ring_frame frame; /* the one being sent */
+    int failures; /* consecutive */
+    int off; /* given up on */
+    int recovering; /* endpoints were cleared, interfaces re-claimed */
+    int gone; /* the hotplug callback saw it unplugged */
+    int lost; /* closed, waits to be plugged in again */
+    long long arrived_ns; /* of its return, until it shows a frame */
+    int any; /* found without --device: any microphone may replace it */
+    unsigned short firmware; /* bcdDevice */
+    char where[MICRO_WHERE_LEN];
+};
+
+/* Sends a QuadCast 2S report: returns frame_sent, frame_failed or
+ * frame_fatal. One sent whose ack didn't come is counted in m->unacked */
+typedef int (*qc2s_report_fn)(struct micro *m, const byte_t *packet,
+                              unsigned int timeout);
+
+/* Transports */
+extern const struct transport qc1_transport;
+extern const struct transport qc2s_usb_transport;
+#ifdef USE_HIDAPI
+extern const struct transport qc2s_hid_transport;
+#endif
+#ifdef __linux__
+extern const struct transport qc2s_hidraw_transport;
+#endif
+
+/* Functions */
+/* NULL for other devices */
+const struct micro_caps *find_caps(unsigned short vid, unsigned short pid);
+/* Sends the share of the tick: the frame or one group of it. The colors
+ * are taken when the frame starts, from colcommand or, if it is NULL,
+ * from f */
+int micro_show(struct micro *m, const byte_t *colcommand,
+               const struct ring_frame *f, unsigned long step,
+               unsigned int timeout);
+/* Bulk mode: the animation is uploaded from the packet of pos on and
+ * the device plays it until it starts over; the ticks in between send
+ * nothing. After a failure or a frame of micro_show it is uploaded
+ * again */
+int micro_upload(struct micro *m, const datpack *data_arr, short command_cnt,
+                 unsigned long pos, unsigned int timeout);
+/* Uploads the whole animation for the device to loop without the host.
+ * Returns 0 once the device confirmed it, 1 if it can't keep it */
+int micro_persist(struct micro *m, const datpack *data_arr, short command_cnt,
+                  unsigned int timeout);
+/* The ms the next tick needs at least: QuadCast 2S is paced by its acks,
+ * others by their caps */
+long micro_period(const struct micro *m);
+/* The init report goes before the first frame, the start report before
+ * the first group of each */
+int qc2s_send_group(struct micro *m, int group, unsigned int timeout,
+                    qc2s_report_fn report);
+/* Delta updates: returns group_same, group_due or group_first */
+int qc2s_group_due(struct micro *m, int group);
+/* The group reached the device */
+void qc2s_group_shown(struct micro *m, int group);
+/* The report of the group of m->frame: from the reports of the animation,
+ * else encoded into packet */
+const byte_t *qc2s_group_report(const struct micro *m, int group,
+                                byte_t *packet);
+/* Encodes the reports of every color command once, when the animation is
+ * loaded, so the frames only hand them out. Returns 1 without memory; the
+ * frames are encoded as they go then */
+int frame_reports_build(struct frame_reports *r, const datpack *data_arr,
+                        short command_cnt);
+void frame_reports_free(struct frame_reports *r);
+#endif
@@ -0,0 +1,117 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbdev.c
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#include "usbdev.h"
+
+static int claim_dev_interface(libusb_device_handle *handle);
+
+int usb_open(struct micro *m, struct libusb_device *dev, long long *claim_ns)
+{
+    long long start;
+    short errcode;
+    errcode = libusb_open(dev, &m->handle);
+    if(errcode) {
+        fprintf(stderr, "%s\n%s", libusb_strerror(errcode), OPEN_ERR_MSG);
+        m->handle = NULL;
+        return 1;
+    }
+    start = frame_clock_now_ns();
+    errcode = claim_dev_interface(m->handle);
+    if(claim_ns)
+        *claim_ns += frame_clock_now_ns() - start;
+    if(errcode) {
+        libusb_close(m->handle);
+        m->handle = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+void usb_close(struct micro *m)
+{
+    if(m->handle) {
+        libusb_release_interface(m->handle, 0);
+        libusb_release_interface(m->handle, 1);
+        libusb_close(m->handle);
+    }
+    m->handle = NULL;
+}
+
+int usb_reclaim(struct micro *m)
+{
+    int i;
+    for(i = 0; i < DEV_IFACE_CNT; i++)
+        libusb_release_interface(m->handle, i);
+    return claim_dev_interface(m->handle);
+}
+
+static int claim_dev_interface(libusb_device_handle *handle)
+{
+    int i, errs[DEV_IFACE_CNT];
+    libusb_set_auto_detach_kernel_driver(handle, 1); /* might be unsupported */
+    for(i = 0; i < DEV_IFACE_CNT; i++)
+        errs[i] = libusb_claim_interface(handle, i);
+#ifdef DEBUG
+    fprintf(stderr, "claim if0=%d if1=%d if2=%d\n",
+            errs[0], errs[1], errs[2]);
+#endif
+    for(i = 0; i < DEV_IFACE_CNT; i++) {
+        if(errs[i] == LIBUSB_ERROR_ACCESS) {
+#ifdef DEBUG
+            fprintf(stderr, "claim: ACCESS denied (kernel HID driver), "
+                    "continuing anyway\n");
+#endif
+            return 0; /* macOS kernel owns HID — use hidapi instead */
+        }
+        if(errs[i] == LIBUSB_ERROR_BUSY) {
+            fprintf(stderr, BUSY_ERR_MSG);
+            return 1;
+        }
+        if(errs[i] == LIBUSB_ERROR_NO_DEVICE) {
+            fprintf(stderr, OPEN_ERR_MSG);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int transfer_result(int sent)
+{
+    return (sent == LIBUSB_ERROR_NO_DEVICE) ? frame_fatal : frame_failed;
+}
+
+#ifdef DEBUG
+void print_packet(const byte_t *pck, const char *str)
+{
+    const byte_t *p;
+    puts(str);
+    for(p = pck; p < pck+PACKET_SIZE; p++) {
+        printf("%02X ", (int)(*p));
+        if((p-pck+1) % 16 == 0)
+            puts("");
+    }
+    puts("");
+}
+#endif
@@ -0,0 +1,64 @@
+/* quadcastrgb - set RGB lights of HyperX Quadcast S and DuoCast
+ * File usbdev.h
+ * What the libusb transports share: opening & claiming the device,
+ * the results of transfers and dumps of packets.
+ *
+ * <----- License notice ----->
+ * Copyright (C) 2022, 2023, 2024 Ors1mer
+ *
+ * You may contact the author by email:
+ * ors1mer [[at]] ors1mer dot xyz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 of the License ONLY.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/gpl-2.0.en.html>. For any questions
+ * concerning the license, you can write to <licensing@fsf.org>.
+ * Also, you may visit the Free Software Foundation at
+ * 51 Franklin Street, Fifth Floor Boston, MA 02110 USA. 
+ */
+#ifndef USBDEV_SENTRY
+#define USBDEV_SENTRY
+
+#include <stdio.h>
+#include <libusb-1.0/libusb.h>
+#include "locale_macros.h"
+#include "frameclock.h" /* for frame_clock_now_ns */
+#include "transport.h"
+
+/* Constants */
+#define PACKET_SIZE 64 /* bytes */
+#define DEV_IFACE_CNT 3
+
+#define BMREQUEST_TYPE_OUT 0x21
+#define BREQUEST_OUT 0x09
+#define BMREQUEST_TYPE_IN 0xa1
+#define BREQUEST_IN 0x01
+#define WVALUE 0x0300
+#define WINDEX 0x0000
+
+/* Messages */
+#define OPEN_ERR_MSG _("Couldn't open the microphone.\n")
+#define BUSY_ERR_MSG _("Another program is using the microphone already. " \
+                       "Stopping.\n")
+#define HEADER_ERR_MSG _("Header packet error: %s\n")
+#define DATAPCK_ERR_MSG _("Data packet error: %s\n")
+
+/* Functions */
+int usb_open(struct micro *m, struct libusb_device *dev, long long *claim_ns);
+void usb_close(struct micro *m);
+/* Releases the interfaces & claims them again. Returns 1 on errors */
+int usb_reclaim(struct micro *m);
+int transfer_result(int sent);
+#ifdef DEBUG
+void print_packet(const byte_t *pck, const char *str);
+#endif
+#endif
@@ -0,0 +1,106 @@
+/* Throughput benchmark for the shared-memory frame ring.
+ * Build & run: make bench
+ * Measures publishing and reading alone, then a producer thread running
+ * flat out against a consumer that polls once per millisecond, as a
+ * daemon with a short period would.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "../modules/framering.h"
+
+#define BENCH_FRAMES 1000000
+#define BENCH_POLLS 1000
+#define POLL_PERIOD_NS NSEC_PER_MSEC
+
+struct bench {
+    struct frame_ring prod;
+    volatile int stop;
+    unsigned long published;
+};
+
+static void *produce(void *data)
+{
+    struct bench *b = data;
+    struct ring_frame f;
+    memset(&f, 0, sizeof(f));
+    while(!b->stop) {
+        f.rgb[0][0]++;
+        f.timestamp_ns = 0;
+        ring_publish(&b->prod, &f);
+        b->published++;
+    }
+    return NULL;
+}
+
+static void bench_alone(struct frame_ring *cons, struct frame_ring *prod)
+{
+    struct ring_frame f;
+    long long start, publish_ns, read_ns = 0;
+    int i;
+    memset(&f, 0, sizeof(f));
+    f.timestamp_ns = 1; /* keep clock reads out of the loop */
+    start = frame_clock_now_ns();
+    for(i = 0; i < BENCH_FRAMES; i++)
+        ring_publish(prod, &f);
+    publish_ns = frame_clock_now_ns() - start;
+    for(i = 0; i < BENCH_FRAMES; i++) {
+        ring_publish(prod, &f);
+        start = frame_clock_now_ns();
+        ring_latest(cons, &f);
+        read_ns += frame_clock_now_ns() - start;
+    }
+    printf("publish: %.1f ns/frame (%.1f Mframes/s)\n",
+           (double)publish_ns / BENCH_FRAMES,
+           BENCH_FRAMES / (publish_ns / 1e3));
+    printf("read:    %.1f ns/frame, clock reads included\n",
+           (double)read_ns / BENCH_FRAMES);
+}
+
+static void bench_concurrent(struct frame_ring *cons, struct bench *b)
+{
+    struct ring_frame f;
+    struct timespec ts = { 0, POLL_PERIOD_NS };
+    pthread_t th;
+    unsigned long shown = cons->shown, dropped = cons->dropped;
+    long long start, elapsed;
+    int i;
+    cons->total_age_ns = cons->max_age_ns = 0;
+    b->stop = 0;
+    b->published = 0;
+    start = frame_clock_now_ns();
+    pthread_create(&th, NULL, produce, b);
+    for(i = 0; i < BENCH_POLLS; i++) {
+        nanosleep(&ts, NULL);
+        ring_latest(cons, &f);
+    }
+    b->stop = 1;
+    pthread_join(th, NULL);
+    elapsed = frame_clock_now_ns() - start;
+    shown = cons->shown - shown;
+    dropped = cons->dropped - dropped;
+    printf("concurrent: %lu frames published (%.1f Mframes/s), "
+           "%lu shown, %lu dropped\n", b->published,
+           b->published / (elapsed / 1e3), shown, dropped);
+    printf("age when shown: %lld us mean, %lld us max\n",
+           shown ? cons->total_age_ns / (long long)shown / NSEC_PER_USEC : 0,
+           cons->max_age_ns / NSEC_PER_USEC);
+}
+
+int main(void)
+{
+    struct frame_ring cons;
+    struct bench b;
+    char name[64];
+    snprintf(name, sizeof(name), "/quadcastrgb-bench-%d", (int)getpid());
+    if(ring_create(&cons, name) || ring_attach(&b.prod, name)) {
+        perror("shm");
+        return 1;
+    }
+    bench_alone(&cons, &b.prod);
+    bench_concurrent(&cons, &b);
+    ring_detach(&b.prod);
+    ring_detach(&cons);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/* Host cost of QuadCast S frames: async transfers against synchronous ones.
+ * Build & run: make bench
+ * tests/mock_libusb plays a device that takes DEVICE_LATENCY_US per
+ * control transfer. The synchronous path sends the header & the data
+ * packet of a frame one after the other and blocks for both; the
+ * pipelined one submits them & returns, the completions are handled in
+ * the idle time between ticks, as the event loop does. Per frame, the
+ * time a tick spends in the transport and the CPU time of the thread
+ * are printed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../modules/transport.h"
+#include "../modules/qc1_usb.h"
+#include "../modules/usbdev.h"
+#include "../modules/frameclock.h"
+#include "mock_libusb_control.h"
+
+#define BENCH_FRAMES 500
+#define DEVICE_LATENCY_US 500
+#define TICK_IDLE_NS (2 * NSEC_PER_MSEC) /* between ticks */
+#define TRANSFER_TIMEOUT 1000 /* ms */
+
+static long long cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (long long)ts.tv_sec*NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* The rest of the tick goes to the completions, as in the event loop */
+static void idle(void)
+{
+    long long until = frame_clock_now_ns() + TICK_IDLE_NS, left;
+    struct timeval tv;
+    while((left = until - frame_clock_now_ns()) > 0) {
+        tv.tv_sec = 0;
+        tv.tv_usec = left / NSEC_PER_USEC;
+        if(mock_usb_in_flight)
+            libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+        else
+            usleep(tv.tv_usec);
+    }
+}
+
+/* Returns the failed ticks */
+static unsigned long run(const char *name, struct micro *m)
+{
+    byte_t colcommand[2*BYTE_STEP] = { RGB_CODE, 0, 0, 0, RGB_CODE };
+    long long start, tick_ns, max_ns = 0, total_ns = 0, cpu;
+    unsigned long failed = 0;
+    int frame;
+    mock_usb_control_calls = 0;
+    cpu = cpu_ns();
+    for(frame = 0; frame < BENCH_FRAMES; frame++) {
+        colcommand[1] = (byte_t)frame;
+        start = frame_clock_now_ns();
+        if(micro_show(m, colcommand, NULL, frame, TRANSFER_TIMEOUT) !=
+           frame_sent)
+            failed++;
+        tick_ns = frame_clock_now_ns() - start;
+        total_ns += tick_ns;
+        if(tick_ns > max_ns)
+            max_ns = tick_ns;
+        idle();
+    }
+    m->caps->transport->close(m);
+    cpu = cpu_ns() - cpu;
+    printf("%-10s %7.1f us/tick mean, %7.1f us/tick max, %5.1f us CPU/frame, "
+           "%d transfers, %lu failed ticks\n", name,
+           total_ns / 1e3 / BENCH_FRAMES, max_ns / 1e3,
+           cpu / 1e3 / BENCH_FRAMES, mock_usb_control_calls, failed);
+    return failed;
+}
+
+int main(void)
+{
+    struct micro m;
+    unsigned long failed;
+
+    mock_usb_reset();
+    mock_usb_latency_us = DEVICE_LATENCY_US;
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_NA, DEV_PID_NA1);
+    usb_open(&m, NULL, NULL); /* without the pipeline */
+    failed = run("sync:", &m);
+
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_NA, DEV_PID_NA1);
+    m.caps->transport->open(&m, NULL, NULL);
+    failed += run("pipelined:", &m);
+    return failed != 0;
+}
@@ -0,0 +1,84 @@
+/* Host cost of QuadCast 2S group reports: encoded per frame against the
+ * reports of the animation, built once when it loads.
+ * Build & run: make bench
+ * An animation of BENCH_COMMANDS color commands with BENCH_COLORS distinct
+ * frames is shown BENCH_ROUNDS times; per frame, the time taken to get
+ * the reports of its groups ready to send is printed, and for the cache
+ * the time it took to build it. Nothing is sent: the transports are the
+ * mocks of tests/mock_transport.c.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "../modules/transport.h"
+#include "../modules/frameclock.h"
+
+#define BENCH_COMMANDS 1600
+#define BENCH_COLORS 100
+#define BENCH_ROUNDS 500
+
+static datpack anim[BENCH_COMMANDS*2*BYTE_STEP/DATA_PACKET_SIZE];
+
+static void make_animation(void)
+{
+    byte_t *colcommand;
+    int i;
+    for(i = 0; i < BENCH_COMMANDS; i++) {
+        colcommand = *anim + 2*BYTE_STEP*i;
+        colcommand[0] = colcommand[BYTE_STEP] = RGB_CODE;
+        colcommand[1] = (byte_t)(i % BENCH_COLORS);
+        colcommand[BYTE_STEP+3] = (byte_t)(255 - i % BENCH_COLORS);
+    }
+}
+
+/* Returns ns per frame; the reports are read as a send would */
+static double run(struct micro *m, const struct frame_reports *r,
+                  unsigned long *sink)
+{
+    byte_t packet[QC2S_PACKET_SIZE];
+    const byte_t *report;
+    long long start;
+    int round, i, group;
+    start = frame_clock_now_ns();
+    for(round = 0; round < BENCH_ROUNDS; round++) {
+        for(i = 0; i < BENCH_COMMANDS; i++) {
+            m->cached = r ? qc2s_cache_reports(&r->cache, i) : NULL;
+            m->frame.rgb[0][0] = (byte_t)i;
+            for(group = 0; group < QC2S_GROUP_COUNT; group++) {
+                report = qc2s_group_report(m, group, packet);
+                *sink += report[QC2S_PACKET_SIZE-1];
+            }
+        }
+    }
+    return (double)(frame_clock_now_ns() - start) /
+           ((double)BENCH_ROUNDS*BENCH_COMMANDS);
+}
+
+int main(void)
+{
+    struct frame_reports r;
+    struct micro m;
+    unsigned long sink = 0;
+    long long build_ns;
+    double encoded, cached;
+
+    make_animation();
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    build_ns = frame_clock_now_ns();
+    if(frame_reports_build(&r, anim, BENCH_COMMANDS)) {
+        fputs("out of memory\n", stderr);
+        return 1;
+    }
+    build_ns = frame_clock_now_ns() - build_ns;
+
+    encoded = run(&m, NULL, &sink);
+    cached = run(&m, &r, &sink);
+    printf("encoded: %6.1f ns/frame\n", encoded);
+    printf("cached:  %6.1f ns/frame, built once in %lld us: "
+           "%d distinct of %d frames, %d bytes\n", cached,
+           build_ns/NSEC_PER_USEC, r.cache.distinct, r.cache.frames,
+           r.cache.distinct*QC2S_FRAME_REPORTS_SIZE);
+    frame_reports_free(&r);
+    return sink == 0; /* keeps the reads */
+}
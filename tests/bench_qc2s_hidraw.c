@@ -0,0 +1,137 @@
+/* Host latency of QuadCast 2S frames: hidraw against libusb.
+ * Build & run: make bench (Linux)
+ * A thread plays the microphone on a socketpair and acks every report,
+ * as the firmware does. The hidraw transport writes the reports of a
+ * tick at once and reads their acks between the ticks, as the display
+ * loop does; the libusb one, through tests/mock_libusb, sends a report
+ * per transfer and waits for its ack. Only the time spent in the
+ * transport counts, not the idle one between ticks.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../modules/transport.h"
+#include "../modules/frameclock.h"
+#include "../modules/qc2s_hidraw.h"
+#include "mock_libusb_control.h"
+
+#define BENCH_FRAMES 2000
+#define TICK_IDLE_NS (100 * 1000) /* between ticks, not counted */
+
+struct device {
+    int fd;
+    unsigned long reports;
+};
+
+/* hidraw has no write_iter: the kernel writes the iovecs of a writev
+ * one after the other, each as a report of its own. Here each is a
+ * message, so the microphone gets them as it would; the calls this
+ * adds are counted against hidraw */
+ssize_t writev(int fd, const struct iovec *iov, int cnt)
+{
+    ssize_t len, sent = 0;
+    int i;
+    for(i = 0; i < cnt; i++) {
+        len = write(fd, iov[i].iov_base, iov[i].iov_len);
+        if(len < 0)
+            return sent ? sent : -1;
+        sent += len;
+    }
+    return sent;
+}
+
+/* A report per message, each gets its ack */
+static void *play_device(void *data)
+{
+    struct device *d = data;
+    byte_t buf[QC2S_PACKET_SIZE];
+    while(read(d->fd, buf, sizeof(buf)) == QC2S_PACKET_SIZE) {
+        d->reports++;
+        if(write(d->fd, buf, QC2S_PACKET_SIZE) < 0)
+            return NULL;
+    }
+    return NULL;
+}
+
+/* Returns the failed ticks */
+static unsigned long run(const char *name, struct micro *m)
+{
+    struct timespec idle = { 0, TICK_IDLE_NS };
+    struct ring_frame f;
+    long long start, frame_ns, total_ns = 0, max_ns = 0;
+    unsigned long step, failed = 0;
+    int frame, group;
+    memset(&f, 0, sizeof(f));
+    for(frame = 0; frame < BENCH_FRAMES; frame++) {
+        for(group = 0; group < QC2S_GROUP_COUNT; group++)
+            f.rgb[group][0] = (byte_t)frame; /* all sent, none skipped */
+        frame_ns = 0;
+        for(group = 0; group < m->caps->groups; group++) {
+            step = (unsigned long)frame * m->caps->groups + group;
+            start = frame_clock_now_ns();
+            if(micro_show(m, NULL, &f, step, QC2S_ACK_TIMEOUT) != frame_sent)
+                failed++;
+            frame_ns += frame_clock_now_ns() - start;
+            nanosleep(&idle, NULL);
+            if(m->hidraw >= 0)
+                qc2s_hidraw_acks(m);
+        }
+        total_ns += frame_ns;
+        if(frame_ns > max_ns)
+            max_ns = frame_ns;
+    }
+    printf("%-7s %.1f us/frame mean, %.1f us/frame max, %lu failed ticks, "
+           "%lu groups acked in time\n", name, total_ns / 1e3 / BENCH_FRAMES,
+           max_ns / 1e3, failed, m->pace.acked);
+    return failed;
+}
+
+int main(void)
+{
+    struct device dev;
+    struct micro m;
+    pthread_t th;
+    int fds[2];
+    unsigned long failed;
+    byte_t ack[QC2S_PACKET_SIZE];
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+        perror("socketpair");
+        return 1;
+    }
+    dev.fd = fds[1];
+    dev.reports = 0;
+    pthread_create(&th, NULL, play_device, &dev);
+
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    m.hidraw = fds[0];
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    failed = run("hidraw:", &m);
+    usleep(10000); /* the last acks, so they aren't taken for new ones */
+    while(read(fds[0], ack, sizeof(ack)) > 0)
+        ;
+
+    mock_usb_reset();
+    mock_usb_fd = fds[0];
+    fcntl(fds[0], F_SETFL, 0);
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    m.hidraw = -1;
+    m.ep_out = QC2S_INTR_EP_OUT;
+    m.ep_in = QC2S_INTR_EP_IN;
+    libusb_open(NULL, &m.handle);
+    failed += run("libusb:", &m);
+
+    shutdown(fds[0], SHUT_RDWR);
+    pthread_join(th, NULL);
+    printf("%lu reports acked\n", dev.reports);
+    close(fds[0]);
+    close(fds[1]);
+    return failed != 0;
+}
@@ -30,6 +30,8 @@ struct hid_device_info *hid_enumerate(unsigned short vendor_id,
                                       unsigned short product_id);
 void hid_free_enumeration(struct hid_device_info *devs);
 hid_device *hid_open_path(const char *path);
+int hid_get_serial_number_string(hid_device *dev, wchar_t *string,
+                                 size_t maxlen);
 int hid_write(hid_device *dev, const unsigned char *data, size_t length);
 int hid_read_timeout(hid_device *dev, unsigned char *data, size_t length,
                      int milliseconds);
@@ -2,9 +2,11 @@
 #include "mock_hidapi_control.h"
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 struct hid_device_ {
     int alive;
+    const wchar_t *serial;
 };
 
 int mock_hid_init_calls = 0;
@@ -20,7 +22,14 @@ int mock_hid_has_device = 1;
 int mock_hid_interface_number = 1;
 int mock_hid_open_success = 1;
 int mock_hid_write_fail_call = 0;
+int mock_hid_write_delay_us = 0;
 int mock_hid_read_result = 0;
+const wchar_t *mock_hid_serial = L"MOCK0001";
+const char *mock_hid_open_fail_path = NULL;
+
+struct mock_hid_entry mock_hid_entries[MOCK_HID_ENTRY_CAP];
+int mock_hid_entry_count = 0;
+char mock_hid_last_open_path[MOCK_HID_PATH_CAP];
 
 int mock_hid_packet_count = 0;
 uint8_t mock_hid_packets[MOCK_HID_PACKET_LOG_CAP][MOCK_HID_PACKET_SIZE];
@@ -40,7 +49,14 @@ void mock_hid_reset(void)
     mock_hid_interface_number = 1;
     mock_hid_open_success = 1;
     mock_hid_write_fail_call = 0;
+    mock_hid_write_delay_us = 0;
     mock_hid_read_result = 0;
+    mock_hid_serial = L"MOCK0001";
+    mock_hid_open_fail_path = NULL;
+
+    memset(mock_hid_entries, 0, sizeof(mock_hid_entries));
+    mock_hid_entry_count = 0;
+    mock_hid_last_open_path[0] = 0;
 
     mock_hid_packet_count = 0;
     memset(mock_hid_packets, 0, sizeof(mock_hid_packets));
@@ -58,10 +74,49 @@ int hid_exit(void)
     return 0;
 }
 
+static struct hid_device_info *new_info(const char *path, int iface,
+                                        unsigned short usage_page,
+                                        unsigned short usage,
+                                        const wchar_t *serial)
+{
+    struct hid_device_info *dev;
+
+    dev = calloc(1, sizeof(*dev));
+    if (!dev)
+        return NULL;
+    dev->path = strdup(path);
+    dev->interface_number = iface;
+    dev->usage_page = usage_page;
+    dev->usage = usage;
+    dev->serial_number = serial ? wcsdup(serial) : NULL;
+    return dev;
+}
+
+/* The entry of a path, NULL for unknown paths */
+static const struct mock_hid_entry *find_entry(const char *path)
+{
+    static struct mock_hid_entry def;
+    int i;
+
+    if (mock_hid_entry_count == 0) {
+        def.path = MOCK_HID_DEFAULT_PATH;
+        def.serial = mock_hid_serial;
+        return (mock_hid_has_device && strcmp(path, def.path) == 0) ?
+               &def : NULL;
+    }
+    for (i = 0; i < mock_hid_entry_count; i++) {
+        if (strcmp(path, mock_hid_entries[i].path) == 0)
+            return &mock_hid_entries[i];
+    }
+    return NULL;
+}
+
 struct hid_device_info *hid_enumerate(unsigned short vendor_id,
                                       unsigned short product_id)
 {
-    struct hid_device_info *dev;
+    struct hid_device_info *head = NULL, **tail = &head;
+    const struct mock_hid_entry *e;
+    int i;
 
     (void)vendor_id;
     (void)product_id;
@@ -70,13 +125,19 @@ struct hid_device_info *hid_enumerate(unsigned short vendor_id,
     if (!mock_hid_has_device)
         return NULL;
 
-    dev = calloc(1, sizeof(*dev));
-    if (!dev)
-        return NULL;
-
-    dev->path = strdup("mock-device-path");
-    dev->interface_number = mock_hid_interface_number;
-    return dev;
+    if (mock_hid_entry_count == 0)
+        return new_info(MOCK_HID_DEFAULT_PATH, mock_hid_interface_number,
+                        0, 0, mock_hid_serial);
+
+    for (i = 0; i < mock_hid_entry_count; i++) {
+        e = &mock_hid_entries[i];
+        *tail = new_info(e->path, e->interface_number, e->usage_page,
+                         e->usage, e->serial);
+        if (!*tail)
+            break;
+        tail = &(*tail)->next;
+    }
+    return head;
 }
 
 void hid_free_enumeration(struct hid_device_info *devs)
@@ -84,6 +145,7 @@ void hid_free_enumeration(struct hid_device_info *devs)
     while (devs) {
         struct hid_device_info *next = devs->next;
         free(devs->path);
+        free(devs->serial_number);
         free(devs);
         devs = next;
     }
@@ -91,23 +153,40 @@ void hid_free_enumeration(struct hid_device_info *devs)
 
 hid_device *hid_open_path(const char *path)
 {
+    const struct mock_hid_entry *e;
     hid_device *dev;
 
-    (void)path;
     mock_hid_open_calls++;
-    if (!mock_hid_open_success)
+    strncpy(mock_hid_last_open_path, path, MOCK_HID_PATH_CAP - 1);
+    e = find_entry(path);
+    if (!mock_hid_open_success || !e)
+        return NULL;
+    if (mock_hid_open_fail_path && strcmp(path, mock_hid_open_fail_path) == 0)
         return NULL;
 
     dev = calloc(1, sizeof(*dev));
     if (!dev)
         return NULL;
     dev->alive = 1;
+    dev->serial = e->serial;
     return dev;
 }
 
+int hid_get_serial_number_string(hid_device *dev, wchar_t *string,
+                                 size_t maxlen)
+{
+    if (!dev || !dev->serial || maxlen == 0)
+        return -1;
+    wcsncpy(string, dev->serial, maxlen - 1);
+    string[maxlen - 1] = 0;
+    return 0;
+}
+
 int hid_write(hid_device *dev, const unsigned char *data, size_t length)
 {
     (void)dev;
+    if (mock_hid_write_delay_us)
+        usleep(mock_hid_write_delay_us);
     mock_hid_write_calls++;
 
     if (mock_hid_packet_count < MOCK_HID_PACKET_LOG_CAP &&
@@ -2,9 +2,22 @@
 #define MOCK_HIDAPI_CONTROL_H
 
 #include <stdint.h>
+#include <wchar.h>
 
 #define MOCK_HID_PACKET_LOG_CAP 32
 #define MOCK_HID_PACKET_SIZE 64
+#define MOCK_HID_ENTRY_CAP 8
+#define MOCK_HID_PATH_CAP 64
+#define MOCK_HID_DEFAULT_PATH "mock-device-path"
+
+/* An enumerated interface; without any, one default device is listed */
+struct mock_hid_entry {
+    const char *path;
+    int interface_number;
+    unsigned short usage_page;
+    unsigned short usage;
+    const wchar_t *serial;
+};
 
 extern int mock_hid_init_calls;
 extern int mock_hid_exit_calls;
@@ -19,7 +32,14 @@ extern int mock_hid_has_device;
 extern int mock_hid_interface_number;
 extern int mock_hid_open_success;
 extern int mock_hid_write_fail_call;
+extern int mock_hid_write_delay_us; /* how long each write takes */
 extern int mock_hid_read_result;
+extern const wchar_t *mock_hid_serial;
+extern const char *mock_hid_open_fail_path;
+
+extern struct mock_hid_entry mock_hid_entries[MOCK_HID_ENTRY_CAP];
+extern int mock_hid_entry_count;
+extern char mock_hid_last_open_path[MOCK_HID_PATH_CAP];
 
 extern int mock_hid_packet_count;
 extern uint8_t mock_hid_packets[MOCK_HID_PACKET_LOG_CAP][MOCK_HID_PACKET_SIZE];
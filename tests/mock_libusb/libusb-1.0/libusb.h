@@ -0,0 +1,254 @@
+#ifndef MOCK_LIBUSB_H
+#define MOCK_LIBUSB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <sys/types.h> /* for ssize_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBUSB_CALL
+#define LIBUSB_API_VERSION 0x01000109
+
+typedef struct libusb_context libusb_context;
+typedef struct libusb_device libusb_device;
+typedef struct libusb_device_handle libusb_device_handle;
+
+enum libusb_error {
+    LIBUSB_SUCCESS = 0,
+    LIBUSB_ERROR_IO = -1,
+    LIBUSB_ERROR_INVALID_PARAM = -2,
+    LIBUSB_ERROR_ACCESS = -3,
+    LIBUSB_ERROR_NO_DEVICE = -4,
+    LIBUSB_ERROR_NOT_FOUND = -5,
+    LIBUSB_ERROR_BUSY = -6,
+    LIBUSB_ERROR_TIMEOUT = -7,
+    LIBUSB_ERROR_OVERFLOW = -8,
+    LIBUSB_ERROR_PIPE = -9,
+    LIBUSB_ERROR_OTHER = -99
+};
+
+enum libusb_transfer_type {
+    LIBUSB_TRANSFER_TYPE_CONTROL = 0,
+    LIBUSB_TRANSFER_TYPE_ISOCHRONOUS = 1,
+    LIBUSB_TRANSFER_TYPE_BULK = 2,
+    LIBUSB_TRANSFER_TYPE_INTERRUPT = 3
+};
+
+enum libusb_transfer_status {
+    LIBUSB_TRANSFER_COMPLETED,
+    LIBUSB_TRANSFER_ERROR,
+    LIBUSB_TRANSFER_TIMED_OUT,
+    LIBUSB_TRANSFER_CANCELLED,
+    LIBUSB_TRANSFER_STALL,
+    LIBUSB_TRANSFER_NO_DEVICE,
+    LIBUSB_TRANSFER_OVERFLOW
+};
+
+typedef int libusb_hotplug_callback_handle;
+
+typedef enum {
+    LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED = 1,
+    LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT = 2
+} libusb_hotplug_event;
+
+typedef enum {
+    LIBUSB_HOTPLUG_NO_FLAGS = 0,
+    LIBUSB_HOTPLUG_ENUMERATE = 1
+} libusb_hotplug_flag;
+
+#define LIBUSB_HOTPLUG_MATCH_ANY -1
+#define LIBUSB_CAP_HAS_HOTPLUG 0x0001
+
+typedef int (LIBUSB_CALL *libusb_hotplug_callback_fn)(
+    libusb_context *ctx, libusb_device *device, libusb_hotplug_event event,
+    void *user_data);
+
+struct libusb_pollfd {
+    int fd;
+    short events;
+};
+
+typedef void (LIBUSB_CALL *libusb_pollfd_added_cb)(int fd, short events,
+                                                   void *user_data);
+typedef void (LIBUSB_CALL *libusb_pollfd_removed_cb)(int fd,
+                                                     void *user_data);
+
+#define LIBUSB_ENDPOINT_IN 0x80
+#define LIBUSB_TRANSFER_TYPE_MASK 0x03
+#define LIBUSB_CLASS_HID 3
+#define LIBUSB_CONTROL_SETUP_SIZE 8
+
+struct libusb_control_setup {
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+};
+
+struct libusb_transfer;
+typedef void (LIBUSB_CALL *libusb_transfer_cb_fn)(
+    struct libusb_transfer *transfer);
+
+struct libusb_transfer {
+    libusb_device_handle *dev_handle;
+    uint8_t flags;
+    unsigned char endpoint;
+    unsigned char type;
+    unsigned int timeout;
+    enum libusb_transfer_status status;
+    int length;
+    int actual_length;
+    libusb_transfer_cb_fn callback;
+    void *user_data;
+    unsigned char *buffer;
+    int num_iso_packets;
+};
+
+struct libusb_device_descriptor {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bcdUSB;
+    uint8_t bDeviceClass;
+    uint8_t bDeviceSubClass;
+    uint8_t bDeviceProtocol;
+    uint8_t bMaxPacketSize0;
+    uint16_t idVendor;
+    uint16_t idProduct;
+    uint16_t bcdDevice;
+    uint8_t iManufacturer;
+    uint8_t iProduct;
+    uint8_t iSerialNumber;
+    uint8_t bNumConfigurations;
+};
+
+struct libusb_endpoint_descriptor {
+    uint8_t bEndpointAddress;
+    uint8_t bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t bInterval;
+};
+
+struct libusb_interface_descriptor {
+    uint8_t bInterfaceNumber;
+    uint8_t bNumEndpoints;
+    uint8_t bInterfaceClass;
+    const struct libusb_endpoint_descriptor *endpoint;
+};
+
+struct libusb_interface {
+    const struct libusb_interface_descriptor *altsetting;
+    int num_altsetting;
+};
+
+struct libusb_config_descriptor {
+    uint8_t bNumInterfaces;
+    const struct libusb_interface *interface;
+};
+
+/* The one device there is, while it is plugged in */
+int libusb_init(libusb_context **ctx);
+void libusb_exit(libusb_context *ctx);
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list);
+void libusb_free_device_list(libusb_device **list, int unref_devices);
+libusb_device *libusb_ref_device(libusb_device *dev);
+void libusb_unref_device(libusb_device *dev);
+libusb_device *libusb_get_device(libusb_device_handle *handle);
+uint8_t libusb_get_bus_number(libusb_device *dev);
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers,
+                            int port_numbers_len);
+int libusb_get_string_descriptor_ascii(libusb_device_handle *handle,
+                                       uint8_t desc_index,
+                                       unsigned char *data, int length);
+int libusb_get_device_descriptor(libusb_device *dev,
+                                 struct libusb_device_descriptor *desc);
+int libusb_get_active_config_descriptor(libusb_device *dev,
+    struct libusb_config_descriptor **config);
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config);
+int libusb_open(libusb_device *dev, libusb_device_handle **handle);
+void libusb_close(libusb_device_handle *handle);
+int libusb_set_auto_detach_kernel_driver(libusb_device_handle *handle,
+                                         int enable);
+int libusb_claim_interface(libusb_device_handle *handle, int iface);
+int libusb_release_interface(libusb_device_handle *handle, int iface);
+int libusb_clear_halt(libusb_device_handle *handle, unsigned char endpoint);
+int libusb_control_transfer(libusb_device_handle *handle,
+                            uint8_t request_type, uint8_t request,
+                            uint16_t value, uint16_t index,
+                            unsigned char *data, uint16_t length,
+                            unsigned int timeout);
+int libusb_interrupt_transfer(libusb_device_handle *handle,
+                              unsigned char endpoint, unsigned char *data,
+                              int length, int *transferred,
+                              unsigned int timeout);
+const char *libusb_strerror(int errcode);
+
+/* Asynchronous transfers complete in the order they were submitted, in
+ * libusb_handle_events_timeout_completed */
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets);
+void libusb_free_transfer(struct libusb_transfer *transfer);
+int libusb_submit_transfer(struct libusb_transfer *transfer);
+int libusb_cancel_transfer(struct libusb_transfer *transfer);
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+                                           struct timeval *tv,
+                                           int *completed);
+unsigned char *libusb_dev_mem_alloc(libusb_device_handle *handle,
+                                    size_t length);
+
+/* Hotplug events are noted by a monitor thread and the callbacks called
+ * in libusb_handle_events_timeout_completed, woken through the pollfd */
+int libusb_has_capability(uint32_t capability);
+int libusb_hotplug_register_callback(libusb_context *ctx, int events,
+    int flags, int vendor_id, int product_id, int dev_class,
+    libusb_hotplug_callback_fn cb_fn, void *user_data,
+    libusb_hotplug_callback_handle *callback_handle);
+void libusb_hotplug_deregister_callback(libusb_context *ctx,
+    libusb_hotplug_callback_handle callback_handle);
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx);
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds);
+void libusb_set_pollfd_notifiers(libusb_context *ctx,
+    libusb_pollfd_added_cb added_cb, libusb_pollfd_removed_cb removed_cb,
+    void *user_data);
+int libusb_dev_mem_free(libusb_device_handle *handle, unsigned char *buffer,
+                        size_t length);
+
+static inline void libusb_fill_control_setup(unsigned char *buffer,
+    uint8_t request_type, uint8_t request, uint16_t value, uint16_t index,
+    uint16_t length)
+{
+    struct libusb_control_setup *setup = (struct libusb_control_setup *)
+                                         (void *)buffer;
+    setup->bmRequestType = request_type;
+    setup->bRequest = request;
+    setup->wValue = value;
+    setup->wIndex = index;
+    setup->wLength = length;
+}
+
+static inline void libusb_fill_control_transfer(
+    struct libusb_transfer *transfer, libusb_device_handle *handle,
+    unsigned char *buffer, libusb_transfer_cb_fn callback, void *user_data,
+    unsigned int timeout)
+{
+    struct libusb_control_setup *setup = (struct libusb_control_setup *)
+                                         (void *)buffer;
+    transfer->dev_handle = handle;
+    transfer->endpoint = 0;
+    transfer->type = LIBUSB_TRANSFER_TYPE_CONTROL;
+    transfer->timeout = timeout;
+    transfer->buffer = buffer;
+    if(setup)
+        transfer->length = (int)(LIBUSB_CONTROL_SETUP_SIZE + setup->wLength);
+    transfer->user_data = user_data;
+    transfer->callback = callback;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOCK_LIBUSB_H */
@@ -0,0 +1,607 @@
+#include "libusb-1.0/libusb.h"
+#include "mock_libusb_control.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+
+#define MOCK_USB_QUEUE_CAP 16
+#define MOCK_USB_EVENT_CAP 16
+
+struct libusb_device_handle {
+    int alive;
+};
+
+struct libusb_device {
+    int bus;
+};
+
+static struct libusb_device_handle mock_handle;
+static struct libusb_device mock_device = { 1 };
+
+struct libusb_device_descriptor mock_usb_descriptor;
+struct libusb_config_descriptor *mock_usb_config = NULL;
+
+int mock_usb_open_calls = 0;
+int mock_usb_close_calls = 0;
+int mock_usb_control_calls = 0;
+int mock_usb_interrupt_calls = 0;
+
+int mock_usb_open_result = 0;
+int mock_usb_fail_call = 0;
+int mock_usb_fail_result = LIBUSB_ERROR_IO;
+int mock_usb_fd = -1;
+
+int mock_usb_packet_count = 0;
+uint8_t mock_usb_packets[MOCK_USB_PACKET_LOG_CAP][MOCK_USB_PACKET_SIZE];
+unsigned char mock_usb_packet_eps[MOCK_USB_PACKET_LOG_CAP];
+
+int mock_usb_keeps_uploads = 0;
+int mock_usb_kept_count = 0;
+uint8_t mock_usb_kept[MOCK_USB_PACKET_LOG_CAP][MOCK_USB_PACKET_SIZE];
+static int kept_expected = 0;
+static int kept_read = 0;
+
+int mock_usb_latency_us = 0;
+int mock_usb_submit_calls = 0;
+int mock_usb_in_flight = 0;
+int mock_usb_submit_fail_call = 0;
+int mock_usb_cancel_latency_us = 0;
+int mock_usb_closed_in_flight = 0;
+int mock_usb_dev_mem = 0;
+int mock_usb_dev_mem_allocs = 0;
+int mock_usb_hotplug_fd = -1;
+int mock_usb_init_calls = 0;
+
+/* Submitted transfers & when each is done */
+static struct libusb_transfer *queue[MOCK_USB_QUEUE_CAP];
+static long long queue_due[MOCK_USB_QUEUE_CAP];
+static int queue_cancelled[MOCK_USB_QUEUE_CAP];
+
+/* The hotplug monitor & the events it noted for the callback */
+static pthread_t monitor;
+static pid_t monitor_pid = 0;
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+static int hotplug_events[MOCK_USB_EVENT_CAP];
+static int event_cnt = 0;
+static int event_pipe[2] = { -1, -1 };
+static volatile int device_gone = 0;
+static libusb_hotplug_callback_fn hotplug_cb = NULL;
+static void *hotplug_data;
+static struct libusb_pollfd event_pollfd;
+
+void mock_usb_reset(void)
+{
+    memset(&mock_usb_descriptor, 0, sizeof(mock_usb_descriptor));
+    mock_usb_config = NULL;
+
+    mock_usb_open_calls = 0;
+    mock_usb_close_calls = 0;
+    mock_usb_control_calls = 0;
+    mock_usb_interrupt_calls = 0;
+
+    mock_usb_open_result = 0;
+    mock_usb_fail_call = 0;
+    mock_usb_fail_result = LIBUSB_ERROR_IO;
+    mock_usb_fd = -1;
+
+    mock_usb_packet_count = 0;
+    memset(mock_usb_packets, 0, sizeof(mock_usb_packets));
+    memset(mock_usb_packet_eps, 0, sizeof(mock_usb_packet_eps));
+
+    mock_usb_keeps_uploads = 0;
+    mock_usb_kept_count = 0;
+    memset(mock_usb_kept, 0, sizeof(mock_usb_kept));
+    kept_expected = 0;
+    kept_read = 0;
+
+    mock_usb_latency_us = 0;
+    mock_usb_submit_calls = 0;
+    mock_usb_in_flight = 0;
+    mock_usb_submit_fail_call = 0;
+    mock_usb_cancel_latency_us = 0;
+    mock_usb_closed_in_flight = 0;
+    mock_usb_dev_mem = 0;
+    mock_usb_dev_mem_allocs = 0;
+    mock_usb_hotplug_fd = -1;
+    mock_usb_init_calls = 0;
+    device_gone = 0;
+}
+
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+/* The QuadCast S header is 0x04 0xf2 with the packet count at byte 8 */
+static void keep_packet(const unsigned char *data, int length)
+{
+    if(!mock_usb_keeps_uploads || length != MOCK_USB_PACKET_SIZE)
+        return;
+    if(data[0] == 0x04 && data[1] == 0xf2) {
+        kept_expected = data[8];
+        mock_usb_kept_count = 0;
+        kept_read = 0;
+    } else if(mock_usb_kept_count < kept_expected &&
+              mock_usb_kept_count < MOCK_USB_PACKET_LOG_CAP) {
+        memcpy(mock_usb_kept[mock_usb_kept_count++], data, length);
+    }
+}
+
+static int read_kept(unsigned char *data, int length)
+{
+    if(!mock_usb_keeps_uploads || !mock_usb_kept_count)
+        return LIBUSB_ERROR_PIPE;
+    if(length > MOCK_USB_PACKET_SIZE)
+        length = MOCK_USB_PACKET_SIZE;
+    memcpy(data, mock_usb_kept[kept_read++ % mock_usb_kept_count], length);
+    return length;
+}
+
+static int transfer_fails(void)
+{
+    return mock_usb_fail_call &&
+           mock_usb_control_calls + mock_usb_interrupt_calls ==
+           mock_usb_fail_call;
+}
+
+static void *monitor_loop(void *data)
+{
+    char c;
+    (void)data;
+    while(read(mock_usb_hotplug_fd, &c, 1) == 1) {
+        pthread_mutex_lock(&events_lock);
+        device_gone = c == 'L';
+        if(event_cnt < MOCK_USB_EVENT_CAP)
+            hotplug_events[event_cnt++] = device_gone ?
+                LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT :
+                LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED;
+        pthread_mutex_unlock(&events_lock);
+        if(write(event_pipe[1], &c, 1) != 1)
+            break;
+    }
+    return NULL;
+}
+
+/* The callback gets the events the monitor noted since the last call */
+static void call_hotplug(void)
+{
+    int noted[MOCK_USB_EVENT_CAP];
+    char buf[MOCK_USB_EVENT_CAP];
+    int i, cnt;
+    if(event_pipe[0] < 0)
+        return;
+    while(read(event_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+    pthread_mutex_lock(&events_lock);
+    cnt = event_cnt;
+    memcpy(noted, hotplug_events, cnt*sizeof(*noted));
+    event_cnt = 0;
+    pthread_mutex_unlock(&events_lock);
+    for(i = 0; i < cnt && hotplug_cb; i++)
+        hotplug_cb(NULL, &mock_device, noted[i], hotplug_data);
+}
+
+int libusb_init(libusb_context **ctx)
+{
+    sigset_t all, old;
+    int res;
+    (void)ctx;
+    mock_usb_init_calls++;
+    if(pipe(event_pipe))
+        return LIBUSB_ERROR_OTHER;
+    fcntl(event_pipe[0], F_SETFL, O_NONBLOCK);
+    if(mock_usb_hotplug_fd < 0)
+        return 0;
+    /* As libusb's, the thread takes no signals */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    res = pthread_create(&monitor, NULL, monitor_loop, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if(res)
+        return LIBUSB_ERROR_OTHER;
+    monitor_pid = getpid();
+    return 0;
+}
+
+void libusb_exit(libusb_context *ctx)
+{
+    (void)ctx;
+    /* A forked child has none to stop */
+    if(monitor_pid == getpid()) {
+        pthread_cancel(monitor);
+        pthread_join(monitor, NULL);
+    }
+    monitor_pid = 0;
+    close(event_pipe[0]);
+    close(event_pipe[1]);
+    event_pipe[0] = event_pipe[1] = -1;
+    event_cnt = 0;
+    hotplug_cb = NULL;
+}
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list)
+{
+    (void)ctx;
+    *list = calloc(2, sizeof(**list));
+    if(!*list)
+        return LIBUSB_ERROR_OTHER;
+    if(device_gone)
+        return 0;
+    (*list)[0] = &mock_device;
+    return 1;
+}
+
+void libusb_free_device_list(libusb_device **list, int unref_devices)
+{
+    (void)unref_devices;
+    free(list);
+}
+
+libusb_device *libusb_ref_device(libusb_device *dev)
+{
+    return dev;
+}
+
+void libusb_unref_device(libusb_device *dev)
+{
+    (void)dev;
+}
+
+libusb_device *libusb_get_device(libusb_device_handle *handle)
+{
+    (void)handle;
+    return &mock_device;
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev)
+{
+    return dev->bus;
+}
+
+int libusb_get_port_numbers(libusb_device *dev, uint8_t *port_numbers,
+                            int port_numbers_len)
+{
+    (void)dev;
+    if(port_numbers_len < 1)
+        return LIBUSB_ERROR_OVERFLOW;
+    port_numbers[0] = 1;
+    return 1;
+}
+
+int libusb_get_string_descriptor_ascii(libusb_device_handle *handle,
+                                       uint8_t desc_index,
+                                       unsigned char *data, int length)
+{
+    (void)handle; (void)desc_index; (void)data; (void)length;
+    return LIBUSB_ERROR_PIPE;
+}
+
+static void log_packet(unsigned char endpoint, const unsigned char *data,
+                       int length)
+{
+    if(mock_usb_packet_count >= MOCK_USB_PACKET_LOG_CAP)
+        return;
+    if(length > MOCK_USB_PACKET_SIZE)
+        length = MOCK_USB_PACKET_SIZE;
+    memset(mock_usb_packets[mock_usb_packet_count], 0, MOCK_USB_PACKET_SIZE);
+    memcpy(mock_usb_packets[mock_usb_packet_count], data, length);
+    mock_usb_packet_eps[mock_usb_packet_count] = endpoint;
+    mock_usb_packet_count++;
+}
+
+int libusb_get_device_descriptor(libusb_device *dev,
+                                 struct libusb_device_descriptor *desc)
+{
+    (void)dev;
+    *desc = mock_usb_descriptor;
+    return 0;
+}
+
+int libusb_get_active_config_descriptor(libusb_device *dev,
+    struct libusb_config_descriptor **config)
+{
+    (void)dev;
+    if(!mock_usb_config)
+        return LIBUSB_ERROR_NOT_FOUND;
+    *config = mock_usb_config;
+    return 0;
+}
+
+void libusb_free_config_descriptor(struct libusb_config_descriptor *config)
+{
+    (void)config;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **handle)
+{
+    (void)dev;
+    mock_usb_open_calls++;
+    if(device_gone)
+        return LIBUSB_ERROR_NO_DEVICE;
+    if(mock_usb_open_result)
+        return mock_usb_open_result;
+    mock_handle.alive = 1;
+    *handle = &mock_handle;
+    return 0;
+}
+
+void libusb_close(libusb_device_handle *handle)
+{
+    mock_usb_close_calls++;
+    mock_usb_closed_in_flight = mock_usb_in_flight;
+    handle->alive = 0;
+}
+
+int libusb_set_auto_detach_kernel_driver(libusb_device_handle *handle,
+                                         int enable)
+{
+    (void)handle; (void)enable;
+    return 0;
+}
+
+int libusb_claim_interface(libusb_device_handle *handle, int iface)
+{
+    (void)handle; (void)iface;
+    return 0;
+}
+
+int libusb_release_interface(libusb_device_handle *handle, int iface)
+{
+    (void)handle; (void)iface;
+    return 0;
+}
+
+int libusb_clear_halt(libusb_device_handle *handle, unsigned char endpoint)
+{
+    (void)handle; (void)endpoint;
+    return 0;
+}
+
+/* Control transfers are logged on endpoint 0 */
+int libusb_control_transfer(libusb_device_handle *handle,
+                            uint8_t request_type, uint8_t request,
+                            uint16_t value, uint16_t index,
+                            unsigned char *data, uint16_t length,
+                            unsigned int timeout)
+{
+    (void)handle; (void)request; (void)value; (void)index; (void)timeout;
+    if(mock_usb_latency_us)
+        usleep(mock_usb_latency_us);
+    mock_usb_control_calls++;
+    if(device_gone)
+        return LIBUSB_ERROR_NO_DEVICE;
+    if(transfer_fails())
+        return mock_usb_fail_result;
+    if(request_type & LIBUSB_ENDPOINT_IN)
+        return read_kept(data, length);
+    log_packet(0, data, length);
+    keep_packet(data, length);
+    if(mock_usb_fd >= 0 && write(mock_usb_fd, data, length) != length)
+        return LIBUSB_ERROR_IO;
+    return length;
+}
+
+int libusb_interrupt_transfer(libusb_device_handle *handle,
+                              unsigned char endpoint, unsigned char *data,
+                              int length, int *transferred,
+                              unsigned int timeout)
+{
+    struct pollfd pfd;
+    ssize_t len;
+    (void)handle;
+    mock_usb_interrupt_calls++;
+    *transferred = 0;
+    if(device_gone)
+        return LIBUSB_ERROR_NO_DEVICE;
+    if(transfer_fails())
+        return mock_usb_fail_result;
+    if(!(endpoint & LIBUSB_ENDPOINT_IN)) {
+        log_packet(endpoint, data, length);
+        if(mock_usb_fd >= 0 && write(mock_usb_fd, data, length) != length)
+            return LIBUSB_ERROR_IO;
+        *transferred = length;
+        return 0;
+    }
+    if(mock_usb_fd < 0)
+        return LIBUSB_ERROR_TIMEOUT;
+    pfd.fd = mock_usb_fd;
+    pfd.events = POLLIN;
+    if(poll(&pfd, 1, (int)timeout) <= 0)
+        return LIBUSB_ERROR_TIMEOUT;
+    len = read(mock_usb_fd, data, length);
+    if(len < 0)
+        return LIBUSB_ERROR_IO;
+    *transferred = (int)len;
+    return 0;
+}
+
+struct libusb_transfer *libusb_alloc_transfer(int iso_packets)
+{
+    (void)iso_packets;
+    return calloc(1, sizeof(struct libusb_transfer));
+}
+
+void libusb_free_transfer(struct libusb_transfer *transfer)
+{
+    free(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *transfer)
+{
+    long long due = now_ns() + mock_usb_latency_us*1000LL;
+    mock_usb_submit_calls++;
+    if(device_gone)
+        return LIBUSB_ERROR_NO_DEVICE;
+    if(mock_usb_submit_calls == mock_usb_submit_fail_call)
+        return LIBUSB_ERROR_IO;
+    if(mock_usb_in_flight == MOCK_USB_QUEUE_CAP)
+        return LIBUSB_ERROR_BUSY;
+    /* The device takes them one after another */
+    if(mock_usb_in_flight &&
+       queue_due[mock_usb_in_flight-1] + mock_usb_latency_us*1000LL > due)
+        due = queue_due[mock_usb_in_flight-1] + mock_usb_latency_us*1000LL;
+    queue[mock_usb_in_flight] = transfer;
+    queue_due[mock_usb_in_flight] = due;
+    queue_cancelled[mock_usb_in_flight] = 0;
+    mock_usb_in_flight++;
+    return 0;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer *transfer)
+{
+    int i;
+    for(i = 0; i < mock_usb_in_flight; i++) {
+        if(queue[i] == transfer) {
+            if(queue_cancelled[i])
+                return LIBUSB_ERROR_NOT_FOUND;
+            queue_cancelled[i] = 1;
+            queue_due[i] = now_ns() + mock_usb_cancel_latency_us*1000LL;
+            return 0;
+        }
+    }
+    return LIBUSB_ERROR_NOT_FOUND;
+}
+
+/* A control transfer the device is done with, as the synchronous one */
+static void complete_first(void)
+{
+    struct libusb_transfer *t = queue[0];
+    const struct libusb_control_setup *setup;
+    int cancelled = queue_cancelled[0], res;
+    mock_usb_in_flight--;
+    memmove(queue, queue+1, mock_usb_in_flight*sizeof(*queue));
+    memmove(queue_due, queue_due+1, mock_usb_in_flight*sizeof(*queue_due));
+    memmove(queue_cancelled, queue_cancelled+1,
+            mock_usb_in_flight*sizeof(*queue_cancelled));
+    t->actual_length = 0;
+    if(cancelled) {
+        t->status = LIBUSB_TRANSFER_CANCELLED;
+    } else {
+        setup = (const struct libusb_control_setup *)(void *)t->buffer;
+        mock_usb_control_calls++;
+        res = device_gone ? LIBUSB_ERROR_NO_DEVICE :
+              transfer_fails() ? mock_usb_fail_result : setup->wLength;
+        if(res >= 0 && !(setup->bmRequestType & LIBUSB_ENDPOINT_IN)) {
+            log_packet(0, t->buffer+LIBUSB_CONTROL_SETUP_SIZE, res);
+            keep_packet(t->buffer+LIBUSB_CONTROL_SETUP_SIZE, res);
+            if(mock_usb_fd >= 0 &&
+               write(mock_usb_fd, t->buffer+LIBUSB_CONTROL_SETUP_SIZE,
+                     res) != res)
+                res = LIBUSB_ERROR_IO;
+        }
+        if(res == LIBUSB_ERROR_NO_DEVICE)
+            t->status = LIBUSB_TRANSFER_NO_DEVICE;
+        else if(res < 0)
+            t->status = LIBUSB_TRANSFER_ERROR;
+        else
+            t->status = LIBUSB_TRANSFER_COMPLETED;
+        t->actual_length = res < 0 ? 0 : res;
+    }
+    t->callback(t);
+}
+
+/* Calls the hotplug callback, then sleeps until the first transfer is
+ * done, tv at most */
+int libusb_handle_events_timeout_completed(libusb_context *ctx,
+                                           struct timeval *tv,
+                                           int *completed)
+{
+    long long wait;
+    (void)ctx; (void)completed;
+    call_hotplug();
+    if(!mock_usb_in_flight)
+        return 0;
+    wait = queue_due[0] - now_ns();
+    if(wait > tv->tv_sec*1000000000LL + tv->tv_usec*1000LL)
+        wait = tv->tv_sec*1000000000LL + tv->tv_usec*1000LL;
+    if(wait > 0)
+        usleep(wait/1000);
+    while(mock_usb_in_flight && queue_due[0] <= now_ns())
+        complete_first();
+    return 0;
+}
+
+unsigned char *libusb_dev_mem_alloc(libusb_device_handle *handle,
+                                    size_t length)
+{
+    unsigned char *buf;
+    (void)handle;
+    if(!mock_usb_dev_mem)
+        return NULL;
+    buf = calloc(1, length);
+    if(buf)
+        mock_usb_dev_mem_allocs++;
+    return buf;
+}
+
+int libusb_dev_mem_free(libusb_device_handle *handle, unsigned char *buffer,
+                        size_t length)
+{
+    (void)handle; (void)length;
+    free(buffer);
+    mock_usb_dev_mem_allocs--;
+    return 0;
+}
+
+int libusb_has_capability(uint32_t capability)
+{
+    return capability == LIBUSB_CAP_HAS_HOTPLUG;
+}
+
+int libusb_hotplug_register_callback(libusb_context *ctx, int events,
+    int flags, int vendor_id, int product_id, int dev_class,
+    libusb_hotplug_callback_fn cb_fn, void *user_data,
+    libusb_hotplug_callback_handle *callback_handle)
+{
+    (void)ctx; (void)events; (void)flags;
+    (void)vendor_id; (void)product_id; (void)dev_class;
+    hotplug_cb = cb_fn;
+    hotplug_data = user_data;
+    *callback_handle = 1;
+    return 0;
+}
+
+void libusb_hotplug_deregister_callback(libusb_context *ctx,
+    libusb_hotplug_callback_handle callback_handle)
+{
+    (void)ctx; (void)callback_handle;
+    hotplug_cb = NULL;
+}
+
+/* The read end of the pipe the monitor wakes the event handling with */
+const struct libusb_pollfd **libusb_get_pollfds(libusb_context *ctx)
+{
+    const struct libusb_pollfd **fds;
+    (void)ctx;
+    fds = calloc(2, sizeof(*fds));
+    if(!fds || event_pipe[0] < 0)
+        return fds;
+    event_pollfd.fd = event_pipe[0];
+    event_pollfd.events = POLLIN;
+    fds[0] = &event_pollfd;
+    return fds;
+}
+
+void libusb_free_pollfds(const struct libusb_pollfd **pollfds)
+{
+    free((void *)pollfds);
+}
+
+void libusb_set_pollfd_notifiers(libusb_context *ctx,
+    libusb_pollfd_added_cb added_cb, libusb_pollfd_removed_cb removed_cb,
+    void *user_data)
+{
+    (void)ctx; (void)added_cb; (void)removed_cb; (void)user_data;
+}
+
+const char *libusb_strerror(int errcode)
+{
+    return errcode == LIBUSB_ERROR_NO_DEVICE ? "No such device" : "mock";
+}
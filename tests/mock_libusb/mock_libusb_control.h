@@ -0,0 +1,60 @@
+#ifndef MOCK_LIBUSB_CONTROL_H
+#define MOCK_LIBUSB_CONTROL_H
+
+#include <stdint.h>
+#include "libusb-1.0/libusb.h"
+
+#define MOCK_USB_PACKET_LOG_CAP 32
+#define MOCK_USB_PACKET_SIZE 64
+
+/* The one device there is: libusb_open accepts any libusb_device */
+extern struct libusb_device_descriptor mock_usb_descriptor;
+extern struct libusb_config_descriptor *mock_usb_config; /* NULL: none */
+
+extern int mock_usb_open_calls;
+extern int mock_usb_close_calls;
+extern int mock_usb_control_calls;
+extern int mock_usb_interrupt_calls;
+
+extern int mock_usb_open_result;
+extern int mock_usb_fail_call; /* of the transfers, from 1; 0 for none */
+extern int mock_usb_fail_result;
+
+/* A descriptor of the emulated device end: OUT transfers are written to
+ * it, IN ones read from it. -1 logs the OUT ones & times the IN out */
+extern int mock_usb_fd;
+
+/* OUT transfers as the device would see them */
+extern int mock_usb_packet_count;
+extern uint8_t mock_usb_packets[MOCK_USB_PACKET_LOG_CAP][MOCK_USB_PACKET_SIZE];
+extern unsigned char mock_usb_packet_eps[MOCK_USB_PACKET_LOG_CAP];
+
+/* Emulates QuadCast S firmware that keeps an upload: the data packets
+ * after a header are kept & GET_REPORT reads them back in turn. 0 makes
+ * GET_REPORT stall, as on firmware that can't */
+extern int mock_usb_keeps_uploads;
+extern int mock_usb_kept_count;
+extern uint8_t mock_usb_kept[MOCK_USB_PACKET_LOG_CAP][MOCK_USB_PACKET_SIZE];
+
+/* How long a control transfer takes the device: the synchronous ones
+ * sleep, the asynchronous ones complete once it passed, one at a time */
+extern int mock_usb_latency_us;
+extern int mock_usb_submit_calls;
+extern int mock_usb_in_flight; /* submitted, not completed yet */
+extern int mock_usb_submit_fail_call; /* of the submissions, from 1 */
+extern int mock_usb_cancel_latency_us; /* for a cancellation to complete */
+extern int mock_usb_closed_in_flight; /* at libusb_close */
+/* libusb_dev_mem_alloc succeeds, as with zero-copy usbfs */
+extern int mock_usb_dev_mem;
+extern int mock_usb_dev_mem_allocs; /* not freed yet */
+
+/* Hotplug as udev sees it: the monitor thread libusb_init starts reads
+ * 'L' off this descriptor when the device leaves & 'A' when it arrives;
+ * -1 starts none. A device that left can't be opened and its transfers
+ * fail. Only the process that called libusb_init has the thread */
+extern int mock_usb_hotplug_fd;
+extern int mock_usb_init_calls;
+
+void mock_usb_reset(void);
+
+#endif /* MOCK_LIBUSB_CONTROL_H */
@@ -0,0 +1,82 @@
+/* Transports of the models without USB: QuadCast S sends are logged as
+ * they are, QuadCast 2S ones go through qc2s_send_group to the report log.
+ */
+#include <string.h>
+#include "mock_transport.h"
+
+struct mock_send mock_sends[MOCK_SEND_CAP];
+int mock_send_count;
+byte_t mock_reports[MOCK_SEND_CAP][QC2S_PACKET_SIZE];
+int mock_report_count;
+int mock_report_fail_at = -1;
+
+static int mock_open(struct micro *m, struct libusb_device *dev,
+                     long long *claim_ns)
+{
+    (void)m; (void)dev; (void)claim_ns;
+    return 0;
+}
+
+static int mock_recover(struct micro *m)
+{
+    (void)m;
+    return 0;
+}
+
+static void mock_close(struct micro *m)
+{
+    (void)m;
+}
+
+static int mock_qc1_send(struct micro *m, int group, unsigned int timeout)
+{
+    (void)timeout;
+    if(mock_send_count < MOCK_SEND_CAP) {
+        mock_sends[mock_send_count].group = group;
+        mock_sends[mock_send_count].command = m->command;
+        mock_sends[mock_send_count].frame = m->frame;
+        mock_send_count++;
+    }
+    return frame_sent;
+}
+
+static int mock_report(struct micro *m, const byte_t *packet,
+                       unsigned int timeout)
+{
+    (void)m; (void)timeout;
+    if(mock_report_count == mock_report_fail_at) {
+        mock_report_fail_at = -1;
+        return frame_failed;
+    }
+    if(mock_report_count < MOCK_SEND_CAP)
+        memcpy(mock_reports[mock_report_count++], packet, QC2S_PACKET_SIZE);
+    return frame_sent;
+}
+
+static int mock_qc2s_send(struct micro *m, int group, unsigned int timeout)
+{
+    return qc2s_send_group(m, group, timeout, mock_report);
+}
+
+const struct transport qc1_transport = {
+    mock_open, mock_qc1_send, NULL, NULL, mock_recover, mock_close, 0
+};
+
+const struct transport qc2s_usb_transport = {
+    mock_open, mock_qc2s_send, NULL, NULL, mock_recover, mock_close, 0
+};
+
+#ifdef __linux__
+const struct transport qc2s_hidraw_transport = {
+    mock_open, mock_qc2s_send, NULL, NULL, mock_recover, mock_close, 0
+};
+#endif
+
+void mock_transport_reset(void)
+{
+    memset(mock_sends, 0, sizeof(mock_sends));
+    memset(mock_reports, 0, sizeof(mock_reports));
+    mock_send_count = 0;
+    mock_report_count = 0;
+    mock_report_fail_at = -1;
+}
@@ -0,0 +1,25 @@
+#ifndef MOCK_TRANSPORT_H
+#define MOCK_TRANSPORT_H
+
+#include "../modules/transport.h"
+
+#define MOCK_SEND_CAP 32
+
+/* A send of the QuadCast S transport */
+struct mock_send {
+    int group;
+    const byte_t *command;
+    struct ring_frame frame;
+};
+
+extern struct mock_send mock_sends[MOCK_SEND_CAP];
+extern int mock_send_count;
+
+/* Reports of the QuadCast 2S transport */
+extern byte_t mock_reports[MOCK_SEND_CAP][QC2S_PACKET_SIZE];
+extern int mock_report_count;
+extern int mock_report_fail_at; /* index of the report that fails, or -1 */
+
+void mock_transport_reset(void);
+
+#endif /* MOCK_TRANSPORT_H */
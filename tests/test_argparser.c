@@ -0,0 +1,205 @@
+/* Unit tests for the argument parser.
+ * Build: make test
+ * Errors end the process, so those cases run in a child.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../modules/argparser.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define PARSE(OPTS, ...) parse(OPTS, (const char *[]){ "quadcastrgb", \
+                                                       __VA_ARGS__, NULL })
+
+static struct colschemes *parse(struct runopts *opts, const char **argv)
+{
+    int argc;
+    for(argc = 0; argv[argc]; argc++)
+        ;
+    return parse_arg(argc, argv, opts);
+}
+
+/* The exit status of parsing in a child, stderr silenced */
+static int parse_status(const char **argv)
+{
+    struct runopts opts;
+    int status;
+    pid_t pid = fork();
+    if(pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        parse(&opts, argv);
+        _exit(success);
+    }
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int mode_is(const struct colscheme *c, const char *mode)
+{
+    return c->mode && strequ(c->mode, mode);
+}
+
+/* ---- Tests ---- */
+
+static void test_single_microphone(void)
+{
+    struct runopts opts;
+    struct colschemes *cs;
+    cs = PARSE(&opts, "solid", "ff0000");
+    ASSERT_EQ(opts.dev_cnt, 0, "no device chosen");
+    ASSERT_TRUE(mode_is(&cs->upper, "solid"), "the shared scheme");
+    ASSERT_EQ(cs->upper.colors[0], 0xff0000, "its color");
+    free(cs);
+}
+
+static void test_own_and_mirrored_schemes(void)
+{
+    struct runopts opts;
+    struct colschemes *cs;
+    cs = PARSE(&opts, "-u", "solid", "00ff00", "--device", "1-4.2",
+               "blink", "--device", "ABC123");
+    ASSERT_EQ(opts.dev_cnt, 2, "two devices");
+    ASSERT_TRUE(strequ(opts.devices[0], "1-4.2"), "a bus-port path");
+    ASSERT_TRUE(strequ(opts.devices[1], "ABC123"), "a serial");
+    ASSERT_TRUE(mode_is(&cs[0].upper, "solid"), "the shared upper part");
+    ASSERT_EQ(cs[0].upper.colors[0], 0x00ff00, "its color");
+    /* --device starts with both parts chosen again */
+    ASSERT_TRUE(mode_is(&cs[1].upper, "blink") &&
+                mode_is(&cs[1].lower, "blink"), "the device's own");
+    ASSERT_TRUE(cs[2].upper.mode == NULL, "mirrors the shared one");
+    free(cs);
+}
+
+static void test_own_schemes_only(void)
+{
+    struct runopts opts;
+    struct colschemes *cs;
+    cs = PARSE(&opts, "--device", "all", "-b", "40", "wave");
+    ASSERT_EQ(opts.dev_cnt, 1, "one selector");
+    ASSERT_TRUE(cs[0].upper.mode == NULL, "no shared scheme needed");
+    ASSERT_TRUE(mode_is(&cs[1].lower, "wave"), "the scheme of all");
+    ASSERT_EQ(cs[1].lower.br, 40, "brightness of the device");
+    ASSERT_EQ(cs[0].lower.br, MAX_BR_SPD_DLY, "not the shared one's");
+    free(cs);
+}
+
+static void test_device_errors(void)
+{
+    ASSERT_EQ(parse_status((const char *[]){ "quadcastrgb", "--device",
+                                             "1-2", NULL }),
+              argerr, "a mirroring device needs the shared scheme");
+    ASSERT_EQ(parse_status((const char *[]){ "quadcastrgb", "solid",
+                                             "--device", NULL }),
+              argerr, "the selector is required");
+    ASSERT_EQ(parse_status((const char *[]){ "quadcastrgb", "solid",
+              "--device", "1", "--device", "2", "--device", "3",
+              "--device", "4", "--device", "5", "--device", "6",
+              "--device", "7", "--device", "8", "--device", "9", NULL }),
+              argerr, "too many devices");
+}
+
+static void test_openrgb_port(void)
+{
+    struct runopts opts;
+    free(PARSE(&opts, "--openrgb"));
+    ASSERT_EQ(opts.openrgb, OPENRGB_PORT, "the default port");
+    free(PARSE(&opts, "--openrgb", "7000", "solid"));
+    ASSERT_EQ(opts.openrgb, 7000, "a given port");
+}
+
+static void test_bench_startup(void)
+{
+    struct runopts opts;
+    free(PARSE(&opts, "solid", "ff0000"));
+    ASSERT_EQ(opts.bench_startup, 0, "off by default");
+    free(PARSE(&opts, "--bench-startup", "cycle"));
+    ASSERT_EQ(opts.bench_startup, 1, "the benchmark is on");
+    ASSERT_EQ(parse_status((const char *[]){ "quadcastrgb", "--bench-startup",
+                                             NULL }),
+              argerr, "the benchmark compiles a mode");
+}
+
+static void test_bulk(void)
+{
+    struct runopts opts;
+    free(PARSE(&opts, "solid", "ff0000"));
+    ASSERT_EQ(opts.bulk, 0, "frames one by one by default");
+    free(PARSE(&opts, "--bulk", "cycle"));
+    ASSERT_EQ(opts.bulk, 1, "bulk uploads");
+}
+
+static void test_persist(void)
+{
+    struct runopts opts;
+    free(PARSE(&opts, "wave"));
+    ASSERT_EQ(opts.persist, 0, "the host streams by default");
+    free(PARSE(&opts, "--persist", "-b", "50", "wave"));
+    ASSERT_EQ(opts.persist, 1, "left to the microphone");
+    ASSERT_EQ(opts.bulk, 0, "independent of --bulk");
+}
+
+static void test_keepalive(void)
+{
+    struct runopts opts;
+    free(PARSE(&opts, "solid"));
+    ASSERT_EQ(opts.keepalive, QC2S_KEEPALIVE_MS, "resent now and then");
+    free(PARSE(&opts, "--keepalive", "0", "solid"));
+    ASSERT_EQ(opts.keepalive, 0, "never resent");
+    free(PARSE(&opts, "--keepalive", "1500", "solid"));
+    ASSERT_EQ(opts.keepalive, 1500, "in ms");
+}
+
+static void test_calibrate(void)
+{
+    struct runopts opts;
+    struct colschemes *cs;
+    cs = PARSE(&opts, "--calibrate");
+    ASSERT_EQ(opts.calibrate, 1, "calibration");
+    ASSERT_TRUE(cs->upper.mode == NULL, "no mode needed");
+    free(cs);
+    free(PARSE(&opts, "--calibrate", "--device", "1-2"));
+    ASSERT_EQ(opts.dev_cnt, 1, "of the devices chosen");
+}
+
+int main(void)
+{
+    test_single_microphone();
+    test_own_and_mirrored_schemes();
+    test_own_schemes_only();
+    test_device_errors();
+    test_openrgb_port();
+    test_bench_startup();
+    test_bulk();
+    test_persist();
+    test_keepalive();
+    test_calibrate();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d argument parser tests passed\n", tests_run);
+    return 0;
+}
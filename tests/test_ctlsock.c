@@ -0,0 +1,239 @@
+/* Unit tests for the control socket of the daemon.
+ * Build: make test
+ * The daemon side runs in a thread against a socket in a temporary
+ * directory, polling the descriptors as its event loop would; no USB
+ * needed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+
+#include "../modules/ctlsock.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+struct server {
+    struct ctl_server ctl;
+    datpack *data_arr;
+    int pck_cnt;
+};
+
+static void wait_readable(int fd)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, 1000);
+}
+
+static int clients_left(const struct ctl_server *ctl)
+{
+    int i, cnt = 0;
+    for(i = 0; i < CTL_MAX_CLIENTS; i++)
+        cnt += ctl->clients[i].fd >= 0;
+    return cnt;
+}
+
+/* One request through every step, as the display loop takes it */
+static void *serve_one(void *data)
+{
+    struct server *srv = data;
+    int fd, out;
+    do {
+        wait_readable(srv->ctl.fd);
+    } while((fd = ctl_accept(&srv->ctl)) < 0);
+    do {
+        wait_readable(fd);
+    } while(!ctl_read(&srv->ctl, fd));
+    out = ctl_compile(&srv->ctl, fd);
+    if(out >= 0) {
+        do {
+            wait_readable(out);
+        } while(!ctl_collect(&srv->ctl, out));
+    }
+    /* Where the loop would wait for SIGCHLD */
+    while(clients_left(&srv->ctl)) {
+        srv->data_arr = ctl_reap(&srv->ctl, &srv->pck_cnt);
+        if(clients_left(&srv->ctl))
+            usleep(1000);
+    }
+    return NULL;
+}
+
+/* Forwards argv to a server thread, returns the client's exit code */
+static int forward(struct server *srv, int argc, const char **argv)
+{
+    pthread_t th;
+    int status;
+    srv->data_arr = NULL;
+    srv->pck_cnt = 0;
+    pthread_create(&th, NULL, serve_one, srv);
+    status = ctl_forward(argc, argv);
+    pthread_join(th, NULL);
+    return status;
+}
+
+/* ---- Tests ---- */
+
+static void test_no_daemon(void)
+{
+    const char *argv[] = { "quadcastrgb", "solid" };
+    ASSERT_EQ(ctl_forward(2, argv), -1, "nobody listens");
+}
+
+static void test_valid_request_compiled(void)
+{
+    const char *argv[] = { "quadcastrgb", "solid", "ff0000" };
+    struct server srv;
+    ASSERT_EQ(ctl_listen(&srv.ctl), 0, "listening");
+    ASSERT_EQ(forward(&srv, 3, argv), success, "status of the reply");
+    ASSERT_TRUE(srv.data_arr != NULL, "new packets compiled");
+    ASSERT_EQ(srv.pck_cnt, 1, "one packet for a solid color");
+    if(srv.data_arr) {
+        ASSERT_EQ((*srv.data_arr)[0], 0x81, "color command tag");
+        ASSERT_EQ((*srv.data_arr)[1], 0xff, "red of the color");
+        ASSERT_EQ((*srv.data_arr)[2], 0x00, "green of the color");
+    }
+    free(srv.data_arr);
+    ctl_close(&srv.ctl);
+}
+
+static void test_bad_request_survived(void)
+{
+    const char *argv[] = { "quadcastrgb", "--no-such-option" };
+    const char *good[] = { "quadcastrgb", "-l", "cycle" };
+    struct server srv;
+    ctl_listen(&srv.ctl);
+    ASSERT_EQ(forward(&srv, 2, argv), argerr, "error status forwarded");
+    ASSERT_TRUE(srv.data_arr == NULL, "nothing to swap");
+    /* The server is still able to take requests */
+    ASSERT_EQ(forward(&srv, 3, good), success, "next request works");
+    ASSERT_TRUE(srv.data_arr != NULL && srv.pck_cnt > 1,
+                "animation compiled");
+    free(srv.data_arr);
+    ctl_close(&srv.ctl);
+}
+
+static void test_startup_options_refused(void)
+{
+    const char *device[] = { "quadcastrgb", "solid", "00ff00",
+                             "--device", "1-2", "solid", "0000ff" };
+    const char *persist[] = { "quadcastrgb", "--persist", "solid", "ff0000" };
+    const char *rt[] = { "quadcastrgb", "--realtime", "-l", "cycle" };
+    struct server srv;
+    ctl_listen(&srv.ctl);
+    ASSERT_EQ(forward(&srv, 7, device), argerr, "a scheme per device");
+    ASSERT_TRUE(srv.data_arr == NULL, "the shared one isn't taken alone");
+    ASSERT_EQ(forward(&srv, 4, persist), argerr, "an option of the start");
+    ASSERT_TRUE(srv.data_arr == NULL, "nothing compiled");
+    ASSERT_EQ(forward(&srv, 4, rt), argerr, "the scheduling stays");
+    ASSERT_TRUE(srv.data_arr == NULL, "nothing compiled either");
+    ctl_close(&srv.ctl);
+}
+
+/* Connects without sending anything yet */
+static int connect_raw(void)
+{
+    struct sockaddr_un addr;
+    const char *dir = getenv("XDG_RUNTIME_DIR");
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s", dir,
+             CTL_SOCKNAME);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void test_slow_client_doesnt_block(void)
+{
+    struct ctl_server ctl;
+    char reply[256], want[32];
+    long long start;
+    ssize_t len;
+    int client, fd;
+    ctl_listen(&ctl);
+    ASSERT_EQ(ctl_accept(&ctl), -1, "no client, accept returns at once");
+    client = connect_raw();
+    ASSERT_TRUE(client >= 0, "connected");
+    write(client, "solid", 5); /* no NUL nor EOF yet */
+    wait_readable(ctl.fd);
+    fd = ctl_accept(&ctl);
+    ASSERT_TRUE(fd >= 0, "accepted");
+    wait_readable(fd);
+    start = frame_clock_now_ns();
+    ASSERT_EQ(ctl_read(&ctl, fd), 0, "more of the request to come");
+    ASSERT_EQ(ctl_read(&ctl, fd), 0, "nothing new, no waiting");
+    ASSERT_TRUE(frame_clock_now_ns() - start < CTL_TIMEOUT*NSEC_PER_MSEC,
+                "the reads returned before the timeout");
+    ASSERT_EQ(ctl_expired(&ctl, start), -1, "in time still");
+    ASSERT_EQ(ctl_expired(&ctl, start + CTL_TIMEOUT*NSEC_PER_MSEC), fd,
+              "late after the timeout");
+    ctl_drop(&ctl, fd);
+    len = read(client, reply, sizeof(reply)-1);
+    reply[len > 0 ? len : 0] = 0;
+    snprintf(want, sizeof(want), CTL_STATUS_FMT, argerr);
+    ASSERT_TRUE(strstr(reply, want) != NULL, "the client is told");
+    ASSERT_EQ(clients_left(&ctl), 0, "the slot is free again");
+    close(client);
+    ctl_close(&ctl);
+}
+
+static void test_stale_socket_replaced(void)
+{
+    struct ctl_server first, second;
+    ASSERT_EQ(ctl_listen(&first), 0, "listening");
+    ASSERT_EQ(ctl_listen(&second), -1, "a live listener is kept");
+    close(first.fd); /* killed without cleaning up */
+    ASSERT_EQ(ctl_listen(&second), 0, "stale socket taken over");
+    ctl_close(&second);
+}
+
+int main(void)
+{
+    char dir[] = "/tmp/test_ctlsockXXXXXX";
+    if(!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    setenv("XDG_RUNTIME_DIR", dir, 1);
+    signal(SIGPIPE, SIG_IGN); /* as the daemon does */
+    test_no_daemon();
+    test_valid_request_compiled();
+    test_bad_request_survived();
+    test_startup_options_refused();
+    test_slow_client_doesnt_block();
+    test_stale_socket_replaced();
+    rmdir(dir);
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d control socket tests passed\n", tests_run);
+    return 0;
+}
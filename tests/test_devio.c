@@ -0,0 +1,167 @@
+/* Unit tests for the display loop of the daemon.
+ * Build: make test
+ * libusb is tests/mock_libusb: its QuadCast S writes the transfers to a
+ * socket, and it is unplugged & plugged in through the pipe its hotplug
+ * monitor reads, as udev would tell libusb. The daemon is forked off as
+ * it is without DEBUG; the test reaps it as a subreaper.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h> /* for PR_SET_CHILD_SUBREAPER */
+
+#include "../modules/devio.h"
+#include "../modules/argparser.h"
+#include "mock_libusb_control.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define WAIT_MS 2000 /* for the daemon to get on */
+#define QUIET_MS 300 /* without transfers while the device is gone */
+
+/* As main does it, with the pid printed */
+static void run_daemon(void)
+{
+    const char *argv[] = { "quadcastrgb", "-v", "solid", "ff0000" };
+    datpack *data_arrs[MAX_MICROS+1];
+    int pck_cnts[MAX_MICROS+1];
+    struct micro micros[MAX_MICROS];
+    struct startup_times times;
+    struct colschemes *cs;
+    struct runopts opts;
+    int cnt;
+    cs = parse_arg(4, argv, &opts);
+    memset(data_arrs, 0, sizeof(data_arrs));
+    memset(pck_cnts, 0, sizeof(pck_cnts));
+    data_arrs[0] = parse_colorscheme(cs, pck_cnts);
+    free(cs);
+    cnt = open_micros(micros, &opts, data_arrs, pck_cnts, &times);
+    send_packets(micros, cnt, data_arrs[0], pck_cnts[0], &opts, &times);
+    free(data_arrs[0]);
+    close_micros(micros, cnt);
+    exit(0);
+}
+
+/* Transfers the device gets within ms */
+static int count_transfers(int fd, int ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    uint8_t buf[MOCK_USB_PACKET_SIZE];
+    long long end = frame_clock_now_ns() + ms*NSEC_PER_MSEC;
+    int left, cnt = 0;
+    while((left = (end - frame_clock_now_ns())/NSEC_PER_MSEC) > 0)
+        if(poll(&pfd, 1, left) > 0 && recv(fd, buf, sizeof(buf), 0) > 0)
+            cnt++;
+    return cnt;
+}
+
+/* Waits for the first transfer, ms at most */
+static int transfers_resume(int fd, int ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    uint8_t buf[MOCK_USB_PACKET_SIZE];
+    return poll(&pfd, 1, ms) > 0 && recv(fd, buf, sizeof(buf), 0) > 0;
+}
+
+static pid_t daemon_pid(int fd)
+{
+    char line[128];
+    FILE *out = fdopen(fd, "r");
+    int pid = -1;
+    while(pid < 0 && fgets(line, sizeof(line), out))
+        sscanf(line, "Started with pid %d", &pid);
+    fclose(out);
+    return pid;
+}
+
+/* ---- Tests ---- */
+
+/* libusb started before forking has lost its hotplug monitor: the daemon
+ * starts it again, and gets the microphone back once it's plugged in */
+static void test_replug_after_daemonizing(void)
+{
+    char dir[] = "/tmp/quadcastrgb-test-XXXXXX";
+    int dev[2], hotplug[2], out[2], status;
+    pid_t pid, daemon;
+
+    ASSERT_TRUE(mkdtemp(dir) != NULL, "runtime dir made");
+    setenv("XDG_RUNTIME_DIR", dir, 1); /* for the control socket */
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, dev), 0, "device");
+    ASSERT_EQ(pipe(hotplug), 0, "udev");
+    ASSERT_EQ(pipe(out), 0, "stdout");
+    mock_usb_reset();
+    mock_usb_descriptor.idVendor = DEV_VID_NA;
+    mock_usb_descriptor.idProduct = DEV_PID_NA1;
+    mock_usb_fd = dev[1];
+    mock_usb_hotplug_fd = hotplug[0];
+
+    pid = fork();
+    if(pid == 0) {
+        dup2(out[1], 1);
+        run_daemon();
+    }
+    close(out[1]);
+    daemon = daemon_pid(out[0]);
+    ASSERT_TRUE(daemon > 0, "the daemon tells its pid");
+    ASSERT_TRUE(daemon != pid, "and is forked off");
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && !WEXITSTATUS(status),
+                "the starting process is done");
+    ASSERT_TRUE(transfers_resume(dev[0], WAIT_MS), "the daemon shows");
+
+    write(hotplug[1], "L", 1);
+    count_transfers(dev[0], QUIET_MS); /* those already underway */
+    ASSERT_EQ(count_transfers(dev[0], QUIET_MS), 0,
+              "the unplugged microphone is noticed");
+    write(hotplug[1], "A", 1);
+    ASSERT_TRUE(transfers_resume(dev[0], WAIT_MS),
+                "and taken again once it is back");
+
+    if(daemon > 0) {
+        kill(daemon, SIGTERM);
+        ASSERT_EQ(waitpid(daemon, &status, 0), daemon, "the daemon ends");
+        ASSERT_TRUE(WIFEXITED(status) && !WEXITSTATUS(status),
+                    "on SIGTERM");
+    }
+    while(waitpid(-1, NULL, WNOHANG) > 0) /* the forking one in between */
+        ;
+    close(dev[0]);
+    close(dev[1]);
+    close(hotplug[0]);
+    close(hotplug[1]);
+    rmdir(dir);
+}
+
+int main(void)
+{
+    test_replug_after_daemonizing();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d daemon tests passed\n", tests_run);
+    return 0;
+}
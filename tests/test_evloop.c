@@ -0,0 +1,163 @@
+/* Unit tests for the event loop of the daemon.
+ * Build: make test
+ * Uses pipes, the loop's timer and a real signal; no USB needed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../modules/evloop.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+struct counters {
+    struct evloop *loop;
+    int reads;
+    unsigned long expirations;
+    int timer_calls;
+    int stop_after;
+    int signo;
+};
+
+static void on_readable(int fd, short revents, void *data)
+{
+    struct counters *c = data;
+    char buf[16];
+    if((revents & POLLIN) && read(fd, buf, sizeof(buf)) > 0)
+        c->reads++;
+}
+
+static void on_timer(unsigned long expirations, void *data)
+{
+    struct counters *c = data;
+    c->expirations += expirations;
+    c->timer_calls++;
+    if(c->timer_calls == c->stop_after)
+        evloop_stop(c->loop);
+}
+
+static void on_signal(int signo, void *data)
+{
+    struct counters *c = data;
+    c->signo = signo;
+    evloop_stop(c->loop);
+}
+
+/* ---- Tests ---- */
+
+static void test_readable_fd_dispatched(void)
+{
+    struct evloop loop;
+    struct counters c;
+    int fds[2];
+
+    memset(&c, 0, sizeof(c));
+    ASSERT_EQ(evloop_init(&loop), 0, "init");
+    ASSERT_EQ(pipe(fds), 0, "pipe");
+    ASSERT_EQ(evloop_add(&loop, fds[0], POLLIN, on_readable, &c), 0, "add");
+    loop.running = 1;
+
+    ASSERT_EQ(evloop_run_once(&loop, 0), 0, "nothing to read yet");
+    write(fds[1], "x", 1);
+    evloop_run_once(&loop, 100);
+    ASSERT_EQ(c.reads, 1, "handler called for a readable pipe");
+
+    evloop_remove(&loop, fds[0]);
+    write(fds[1], "y", 1);
+    evloop_run_once(&loop, 0);
+    ASSERT_EQ(c.reads, 1, "removed fd no longer dispatched");
+
+    close(fds[0]);
+    close(fds[1]);
+    evloop_free(&loop);
+}
+
+static void test_periodic_timer(void)
+{
+    struct evloop loop;
+    struct counters c;
+    long long start, elapsed;
+
+    memset(&c, 0, sizeof(c));
+    c.loop = &loop;
+    c.stop_after = 5;
+    evloop_init(&loop);
+    start = frame_clock_now_ns();
+    evloop_set_timer(&loop, start + 4*NSEC_PER_MSEC, 4*NSEC_PER_MSEC,
+                     on_timer, &c);
+    evloop_run(&loop);
+    elapsed = frame_clock_now_ns() - start;
+    ASSERT_EQ(c.timer_calls, 5, "loop stopped by the timer handler");
+    ASSERT_TRUE(c.expirations >= 5, "every expiration reported");
+    ASSERT_TRUE(elapsed >= 20*NSEC_PER_MSEC, "timer not early");
+    evloop_free(&loop);
+}
+
+static void test_missed_expirations_are_counted(void)
+{
+    struct evloop loop;
+    struct counters c;
+    struct timespec ts = { 0, 13*NSEC_PER_MSEC };
+
+    memset(&c, 0, sizeof(c));
+    c.loop = &loop;
+    c.stop_after = 1;
+    evloop_init(&loop);
+    evloop_set_timer(&loop, frame_clock_now_ns() + 3*NSEC_PER_MSEC,
+                     3*NSEC_PER_MSEC, on_timer, &c);
+    nanosleep(&ts, NULL); /* a slow frame */
+    evloop_run(&loop);
+    ASSERT_EQ(c.timer_calls, 1, "one wakeup for the backlog");
+    ASSERT_TRUE(c.expirations >= 4, "missed periods reported at once");
+    evloop_free(&loop);
+}
+
+static void test_signal_stops_loop(void)
+{
+    static const int signos[] = { SIGUSR1 };
+    struct evloop loop;
+    struct counters c;
+
+    memset(&c, 0, sizeof(c));
+    c.loop = &loop;
+    evloop_init(&loop);
+    ASSERT_EQ(evloop_catch_signals(&loop, signos, 1, on_signal, &c), 0,
+              "catch signals");
+    raise(SIGUSR1);
+    evloop_run(&loop);
+    ASSERT_EQ(c.signo, SIGUSR1, "signal delivered through the loop");
+    evloop_free(&loop);
+}
+
+int main(void)
+{
+    test_readable_fd_dispatched();
+    test_periodic_timer();
+    test_missed_expirations_are_counted();
+    test_signal_stops_loop();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d event loop tests passed\n", tests_run);
+    return 0;
+}
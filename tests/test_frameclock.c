@@ -0,0 +1,168 @@
+/* Unit tests for the deadline-based frame clock.
+ * Build: make test
+ * The timing tests use short periods and generous bounds.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../modules/frameclock.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static void busy_for(long long ns)
+{
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)ns;
+    nanosleep(&ts, NULL);
+}
+
+/* ---- Tests ---- */
+
+static void test_deadlines_are_absolute(void)
+{
+    struct frame_clock fc;
+    long long d0, d3;
+
+    frame_clock_start(&fc, 10);
+    d0 = frame_clock_deadline_ns(&fc, 0);
+    d3 = frame_clock_deadline_ns(&fc, 3);
+    ASSERT_EQ(d3 - d0, 30*NSEC_PER_MSEC, "tick 3 is three periods away");
+    ASSERT_EQ(fc.tick, 0, "no ticks after start");
+    ASSERT_EQ(fc.stats.ticks, 0, "no stats after start");
+}
+
+static void test_transfer_time_does_not_drift(void)
+{
+    struct frame_clock fc;
+    long long elapsed;
+    int i;
+
+    frame_clock_start(&fc, 5);
+    for(i = 0; i < 20; i++) {
+        busy_for(2*NSEC_PER_MSEC); /* simulated transfer */
+        frame_clock_wait(&fc);
+    }
+    elapsed = frame_clock_now_ns() - frame_clock_deadline_ns(&fc, 0);
+    /* Relative sleeps would take 20*(5+2) = 140 ms */
+    ASSERT_TRUE(elapsed >= 100*NSEC_PER_MSEC, "never ahead of schedule");
+    ASSERT_TRUE(elapsed < 120*NSEC_PER_MSEC, "transfer time not accumulated");
+    ASSERT_EQ(fc.stats.ticks, 20, "every tick recorded");
+}
+
+static void test_late_tick_is_counted(void)
+{
+    struct frame_clock fc;
+
+    frame_clock_start(&fc, 5);
+    busy_for(7*NSEC_PER_MSEC);
+    frame_clock_wait(&fc);
+    ASSERT_EQ(fc.stats.late, 1, "overrun tick counted as late");
+    ASSERT_EQ(fc.stats.dropped, 0, "overrun within one period isn't dropped");
+    ASSERT_TRUE(fc.stats.last_late_ns >= 2*NSEC_PER_MSEC,
+                "lateness measured from the deadline");
+    ASSERT_TRUE(fc.stats.max_late_ns == fc.stats.last_late_ns,
+                "max lateness tracked");
+}
+
+static void test_whole_slots_are_dropped(void)
+{
+    struct frame_clock fc;
+
+    frame_clock_start(&fc, 4);
+    busy_for(14*NSEC_PER_MSEC); /* ticks 1, 2 and 3 are gone */
+    frame_clock_wait(&fc);
+    ASSERT_EQ(fc.stats.late, 1, "the wait found its deadline passed");
+    ASSERT_TRUE(fc.stats.dropped >= 2, "missed slots counted as dropped");
+    ASSERT_EQ(fc.tick, 1 + fc.stats.dropped, "tick moved to current slot");
+    ASSERT_TRUE(fc.stats.last_late_ns < 4*NSEC_PER_MSEC,
+                "lateness measured within the current slot");
+}
+
+static void test_budget_shrinks_within_the_period(void)
+{
+    struct frame_clock fc;
+    long budget;
+
+    frame_clock_start(&fc, 50);
+    budget = frame_clock_budget_ms(&fc);
+    ASSERT_TRUE(budget > 40 && budget <= 50, "full budget right after start");
+    busy_for(20*NSEC_PER_MSEC);
+    budget = frame_clock_budget_ms(&fc);
+    ASSERT_TRUE(budget <= 30, "budget shrinks as the period elapses");
+    frame_clock_wait_part(&fc, 3, 5);
+    budget = frame_clock_budget_ms(&fc);
+    ASSERT_TRUE(budget <= 20, "partial wait sleeps into the period");
+    ASSERT_EQ(fc.tick, 0, "partial wait doesn't advance the tick");
+}
+
+static void test_advance_by_timer_expirations(void)
+{
+    struct frame_clock fc;
+
+    frame_clock_start(&fc, 5);
+    frame_clock_advance(&fc, 1);
+    ASSERT_EQ(fc.tick, 1, "one expiration, one tick");
+    ASSERT_EQ(fc.stats.dropped, 0, "nothing missed");
+    frame_clock_advance(&fc, 3);
+    ASSERT_EQ(fc.tick, 4, "ticks follow the expirations");
+    ASSERT_EQ(fc.stats.late, 1, "a backlog of expirations is late");
+    ASSERT_EQ(fc.stats.dropped, 2, "all but the last expiration dropped");
+    ASSERT_EQ(fc.stats.ticks, 2, "lateness recorded per wakeup");
+}
+
+static void test_retime_keeps_the_current_deadline(void)
+{
+    struct frame_clock fc;
+    long long d4;
+
+    frame_clock_start(&fc, 45);
+    frame_clock_advance(&fc, 4);
+    d4 = frame_clock_deadline_ns(&fc, 4);
+    frame_clock_retime(&fc, 10);
+    ASSERT_EQ(fc.tick, 4, "ticks go on");
+    ASSERT_EQ(frame_clock_deadline_ns(&fc, 4), d4, "current deadline kept");
+    ASSERT_EQ(frame_clock_deadline_ns(&fc, 5) - d4, 10*NSEC_PER_MSEC,
+              "the next one a new period away");
+    frame_clock_retime(&fc, 45);
+    ASSERT_EQ(frame_clock_deadline_ns(&fc, 4), d4, "slower again");
+    ASSERT_EQ(frame_clock_deadline_ns(&fc, 6) - d4, 90*NSEC_PER_MSEC,
+              "two slow periods");
+}
+
+int main(void)
+{
+    test_deadlines_are_absolute();
+    test_transfer_time_does_not_drift();
+    test_late_tick_is_counted();
+    test_whole_slots_are_dropped();
+    test_budget_shrinks_within_the_period();
+    test_advance_by_timer_expirations();
+    test_retime_keeps_the_current_deadline();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d frame clock tests passed\n", tests_run);
+    return 0;
+}
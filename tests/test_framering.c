@@ -0,0 +1,176 @@
+/* Unit tests for the shared-memory frame ring.
+ * Build: make test
+ * Uses a private shm object; producers are threads of the test.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../modules/framering.h"
+
+#define PRODUCERS 2
+#define FRAMES_EACH 20000
+
+static int tests_run = 0;
+static int tests_failed = 0;
+static char ring_name[64];
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static void fill_frame(struct ring_frame *f, uint8_t value)
+{
+    memset(f, 0, sizeof(*f));
+    memset(f->rgb, value, sizeof(f->rgb));
+}
+
+/* A torn read would mix the bytes of two frames */
+static int frame_is_whole(const struct ring_frame *f)
+{
+    int i;
+    for(i = 1; i < (int)sizeof(f->rgb); i++) {
+        if(f->rgb[i/3][i%3] != f->rgb[0][0])
+            return 0;
+    }
+    return 1;
+}
+
+static void *produce(void *data)
+{
+    struct frame_ring *r = data;
+    struct ring_frame f;
+    int i;
+    for(i = 0; i < FRAMES_EACH; i++) {
+        fill_frame(&f, (uint8_t)i);
+        ring_publish(r, &f);
+    }
+    return NULL;
+}
+
+/* ---- Tests ---- */
+
+static void test_attach_needs_a_ring(void)
+{
+    struct frame_ring prod;
+    ASSERT_EQ(ring_attach(&prod, ring_name), -1, "no daemon, no ring");
+}
+
+static void test_newest_frame_shown(void)
+{
+    struct frame_ring cons, prod;
+    struct ring_frame f, got;
+    ASSERT_EQ(ring_create(&cons, ring_name), 0, "create");
+    ASSERT_EQ(ring_attach(&prod, ring_name), 0, "attach");
+    ASSERT_EQ(ring_latest(&cons, &got), 0, "empty ring");
+
+    fill_frame(&f, 7);
+    ring_publish(&prod, &f);
+    ASSERT_EQ(ring_latest(&cons, &got), 1, "published frame seen");
+    ASSERT_EQ(got.seq, 1, "sequence numbers start at 1");
+    ASSERT_EQ(got.rgb[5][2], 7, "colors carried");
+    ASSERT_TRUE(got.timestamp_ns > 0, "publish time filled in");
+    ASSERT_EQ(ring_latest(&cons, &got), 0, "a frame is returned once");
+
+    fill_frame(&f, 1);
+    ring_publish(&prod, &f);
+    fill_frame(&f, 2);
+    ring_publish(&prod, &f);
+    fill_frame(&f, 3);
+    ring_publish(&prod, &f);
+    ASSERT_EQ(ring_latest(&cons, &got), 1, "new frames");
+    ASSERT_EQ(got.rgb[0][0], 3, "only the newest one");
+    ASSERT_EQ(cons.dropped, 2, "overtaken frames counted");
+    ASSERT_EQ(cons.shown, 2, "shown frames counted");
+
+    ring_detach(&prod);
+    ring_detach(&cons);
+}
+
+static void test_wraparound(void)
+{
+    struct frame_ring cons, prod;
+    struct ring_frame f, got;
+    int i;
+    ring_create(&cons, ring_name);
+    ring_attach(&prod, ring_name);
+    for(i = 0; i < 3*RING_SLOTS+5; i++) {
+        fill_frame(&f, (uint8_t)i);
+        ring_publish(&prod, &f);
+    }
+    ASSERT_EQ(ring_latest(&cons, &got), 1, "frame after wrapping");
+    ASSERT_EQ(got.seq, 3*RING_SLOTS+5, "newest sequence");
+    ASSERT_EQ(got.rgb[0][0], (uint8_t)(3*RING_SLOTS+4), "newest colors");
+    ring_detach(&prod);
+    ring_detach(&cons);
+}
+
+static void test_parts(void)
+{
+    static const uint8_t up[3] = { 1, 2, 3 }, low[3] = { 4, 5, 6 };
+    struct ring_frame f;
+    ring_frame_set_parts(&f, up, low);
+    ASSERT_EQ(f.rgb[QC2S_UPPER_GROUPS-1][2], 3, "upper groups");
+    ASSERT_EQ(f.rgb[QC2S_UPPER_GROUPS][0], 4, "lower groups");
+    ASSERT_EQ(f.rgb[QC2S_GROUP_COUNT-1][1], 5, "last group");
+}
+
+static void test_concurrent_producers(void)
+{
+    struct frame_ring cons, prod;
+    struct ring_frame got;
+    pthread_t th[PRODUCERS];
+    int i, torn = 0, backwards = 0;
+    uint64_t prev = 0;
+    ring_create(&cons, ring_name);
+    ring_attach(&prod, ring_name);
+    for(i = 0; i < PRODUCERS; i++)
+        pthread_create(&th[i], NULL, produce, &prod);
+    while(cons.last_seq < (uint64_t)PRODUCERS*FRAMES_EACH) {
+        if(!ring_latest(&cons, &got))
+            continue;
+        torn += !frame_is_whole(&got);
+        backwards += (got.seq <= prev);
+        prev = got.seq;
+    }
+    for(i = 0; i < PRODUCERS; i++)
+        pthread_join(th[i], NULL);
+    ASSERT_EQ(torn, 0, "no torn frames");
+    ASSERT_EQ(backwards, 0, "sequence only grows");
+    ASSERT_EQ(cons.shown + cons.dropped, PRODUCERS*FRAMES_EACH,
+              "every frame shown or counted as dropped");
+    ring_detach(&prod);
+    ring_detach(&cons);
+}
+
+int main(void)
+{
+    snprintf(ring_name, sizeof(ring_name), "/quadcastrgb-test-%d",
+             (int)getpid());
+    test_attach_needs_a_ring();
+    test_newest_frame_shown();
+    test_wraparound();
+    test_parts();
+    test_concurrent_producers();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d frame ring tests passed\n", tests_run);
+    return 0;
+}
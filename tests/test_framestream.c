@@ -0,0 +1,145 @@
+/* Unit tests for the frame parser of the stream mode.
+ * Build: make test
+ * Frames are written into a pipe the way a producer would.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../modules/framestream.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static int fds[2];
+
+static void feed(const void *data, size_t len)
+{
+    if(write(fds[1], data, len) != (ssize_t)len)
+        perror("write");
+}
+
+static void open_stream(struct frame_stream *st, int format)
+{
+    if(pipe(fds))
+        perror("pipe");
+    stream_init(st, fds[0], format);
+}
+
+static void close_stream(void)
+{
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ---- Tests ---- */
+
+static void test_binary_frames(void)
+{
+    struct frame_stream st;
+    struct ring_frame f;
+    unsigned char data[2*STREAM_FRAME_SIZE];
+    int i;
+    for(i = 0; i < (int)sizeof(data); i++)
+        data[i] = (unsigned char)i;
+    open_stream(&st, stream_bin);
+    feed(data, STREAM_FRAME_SIZE + 5); /* a frame and a bit */
+    ASSERT_EQ(stream_fill(&st), STREAM_FRAME_SIZE + 5, "read what's there");
+    ASSERT_EQ(stream_next(&st, &f), 1, "first frame");
+    ASSERT_EQ(f.rgb[0][0], 0, "first byte");
+    ASSERT_EQ(f.rgb[5][2], STREAM_FRAME_SIZE-1, "last byte of a frame");
+    ASSERT_TRUE(f.timestamp_ns > 0, "frames are stamped");
+    ASSERT_EQ(stream_next(&st, &f), 0, "partial frame waits");
+    feed(data + STREAM_FRAME_SIZE + 5, STREAM_FRAME_SIZE - 5);
+    stream_fill(&st);
+    ASSERT_EQ(stream_next(&st, &f), 1, "completed frame");
+    ASSERT_EQ(f.rgb[0][0], STREAM_FRAME_SIZE, "frames stay aligned");
+    close(fds[1]);
+    ASSERT_EQ(stream_fill(&st), 0, "end of stream");
+    close(fds[0]);
+}
+
+static void test_hex_lines(void)
+{
+    static const char text[] =
+        "ff0000\n"
+        "#00ff00 0000ff\r\n"
+        "010101 020202 030303 040404 050505 060606\n"
+        "\n"
+        "nonsense\n"
+        "123456 654321 abcdef\n"
+        "abcdef";
+    struct frame_stream st;
+    struct ring_frame f;
+    open_stream(&st, stream_hex);
+    feed(text, sizeof(text)-1);
+    stream_fill(&st);
+    ASSERT_EQ(stream_next(&st, &f), 1, "one color");
+    ASSERT_EQ(f.rgb[5][0], 0xff, "one color for all groups");
+    ASSERT_EQ(stream_next(&st, &f), 1, "two colors");
+    ASSERT_EQ(f.rgb[0][1], 0xff, "upper part");
+    ASSERT_EQ(f.rgb[QC2S_UPPER_GROUPS][2], 0xff, "lower part");
+    ASSERT_EQ(f.rgb[QC2S_UPPER_GROUPS][1], 0, "lower isn't green");
+    ASSERT_EQ(stream_next(&st, &f), 1, "six colors");
+    ASSERT_EQ(f.rgb[3][0], 4, "groups in order");
+    ASSERT_EQ(stream_next(&st, &f), 0, "unterminated line waits");
+    ASSERT_EQ(st.malformed, 2, "bad lines counted, empty ones not");
+    ASSERT_EQ(st.frames, 3, "frames counted");
+    feed("\n", 1);
+    stream_fill(&st);
+    ASSERT_EQ(stream_next(&st, &f), 1, "terminated later");
+    ASSERT_EQ(f.rgb[1][2], 0xef, "its color");
+    close_stream();
+}
+
+static void test_overlong_line(void)
+{
+    struct frame_stream st;
+    struct ring_frame f;
+    char junk[512];
+    int i;
+    memset(junk, 'x', sizeof(junk));
+    open_stream(&st, stream_hex);
+    for(i = 0; i < STREAM_BUF/(int)sizeof(junk) + 1; i++) {
+        feed(junk, sizeof(junk));
+        stream_fill(&st);
+        stream_next(&st, &f);
+    }
+    feed("\n00ff00\n", 8);
+    stream_fill(&st);
+    ASSERT_EQ(stream_next(&st, &f), 1, "parsing resumes after the long line");
+    ASSERT_EQ(f.rgb[0][1], 0xff, "the next line's color");
+    ASSERT_EQ(st.malformed, 1, "the long line counted once");
+    close_stream();
+}
+
+int main(void)
+{
+    test_binary_frames();
+    test_hex_lines();
+    test_overlong_line();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d frame stream tests passed\n", tests_run);
+    return 0;
+}
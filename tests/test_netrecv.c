@@ -0,0 +1,183 @@
+/* Unit tests for the E1.31 & DDP receiver.
+ * Build: make test
+ * Datagrams are parsed directly and sent over loopback; no USB needed.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <arpa/inet.h> /* for inet_addr */
+
+#include "../modules/netrecv.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+/* A receiver that isn't bound, for parsing only */
+static void init_parser(struct net_receiver *nr, int proto, int channel,
+                        int pixels)
+{
+    memset(nr, 0, sizeof(*nr));
+    nr->fd = -1;
+    nr->proto = proto;
+    nr->universe = 7;
+    nr->channel = channel;
+    nr->pixels = pixels;
+    nr->last_seq = -1;
+}
+
+static void fill_channels(uint8_t *ch, int cnt)
+{
+    int i;
+    for(i = 0; i < cnt; i++)
+        ch[i] = (uint8_t)(i+1);
+}
+
+/* ---- Tests ---- */
+
+static void test_e131_frame(void)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    uint8_t ch[NET_CHANNELS], pkt[E131_MAX_DATAGRAM];
+    int len;
+    fill_channels(ch, 30);
+    init_parser(&nr, net_e131, 4, 6);
+    len = net_build(net_e131, 7, 1, ch, 30, pkt);
+    ASSERT_EQ(len, E131_HEADER_LEN + 30, "datagram length");
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "frame parsed");
+    ASSERT_EQ(f.rgb[0][0], 4, "starts at the given channel");
+    ASSERT_EQ(f.rgb[5][2], 21, "six pixels taken");
+    ASSERT_TRUE(f.timestamp_ns > 0, "arrival time stamped");
+
+    len = net_build(net_e131, 8, 2, ch, 30, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "other universe ignored");
+    len = net_build(net_e131, 7, 1, ch, 30, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "repeated sequence dropped");
+    len = net_build(net_e131, 7, 2, ch, 30, pkt);
+    pkt[E131_OFS_OPTIONS] = E131_OPT_PREVIEW;
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "preview data ignored");
+    len = net_build(net_e131, 7, 3, ch, 10, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "too few channels");
+    ASSERT_EQ(net_parse(&nr, pkt, 40, &f), 0, "truncated datagram");
+    len = net_build(net_e131, 7, 0, ch, 30, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "reordered datagram dropped");
+    len = net_build(net_e131, 7, 4, ch, 30, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "later sequence accepted");
+    ASSERT_EQ(nr.frames, 2, "frames counted");
+    ASSERT_EQ(nr.malformed, 5, "rejected datagrams counted");
+}
+
+static void test_e131_sequence_wraps(void)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    uint8_t ch[18] = {0}, pkt[E131_MAX_DATAGRAM];
+    int len;
+    init_parser(&nr, net_e131, 1, 6);
+    len = net_build(net_e131, 7, 254, ch, 18, pkt);
+    net_parse(&nr, pkt, len, &f);
+    len = net_build(net_e131, 7, 1, ch, 18, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "254 -> 1 is newer");
+    len = net_build(net_e131, 7, 100, ch, 18, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "a restarted sender");
+}
+
+static void test_parts_mapping(void)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    uint8_t ch[6] = { 1, 2, 3, 4, 5, 6 }, pkt[E131_MAX_DATAGRAM];
+    int len;
+    init_parser(&nr, net_e131, 1, 2);
+    len = net_build(net_e131, 7, 1, ch, 6, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "two pixels");
+    ASSERT_EQ(f.rgb[QC2S_UPPER_GROUPS-1][0], 1, "upper part");
+    ASSERT_EQ(f.rgb[QC2S_GROUP_COUNT-1][2], 6, "lower part");
+}
+
+static void test_ddp_parts_and_push(void)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    uint8_t ch[18], pkt[DDP_HEADER_LEN+DDP_TIMECODE_LEN+18];
+    int len;
+    fill_channels(ch, 18);
+    init_parser(&nr, net_ddp, 1, 6);
+    /* Second half first, without push */
+    len = net_build(net_ddp, 0, 1, ch+9, 9, pkt);
+    pkt[0] &= ~DDP_FLAG_PUSH;
+    pkt[7] = 9; /* offset */
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "no push, no frame");
+    len = net_build(net_ddp, 0, 2, ch, 9, pkt);
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 1, "push completes it");
+    ASSERT_EQ(f.rgb[0][0], 1, "first part");
+    ASSERT_EQ(f.rgb[5][2], 18, "second part");
+    /* With a timecode the data moves by four bytes */
+    len = net_build(net_ddp, 0, 3, ch, 18, pkt);
+    memmove(pkt+DDP_HEADER_LEN+DDP_TIMECODE_LEN, pkt+DDP_HEADER_LEN, 18);
+    pkt[0] |= DDP_FLAG_TIMECODE;
+    pkt[DDP_HEADER_LEN+DDP_TIMECODE_LEN] = 0x42;
+    ASSERT_EQ(net_parse(&nr, pkt, len+DDP_TIMECODE_LEN, &f), 1, "timecode");
+    ASSERT_EQ(f.rgb[0][0], 0x42, "data after the timecode");
+    pkt[0] = 0x80; /* version 2 */
+    ASSERT_EQ(net_parse(&nr, pkt, len, &f), 0, "unknown version");
+    ASSERT_EQ(nr.malformed, 1, "counted");
+}
+
+static void test_loopback_coalescing(void)
+{
+    struct net_receiver nr;
+    struct ring_frame f;
+    struct sockaddr_in to;
+    uint8_t ch[18], pkt[E131_MAX_DATAGRAM];
+    int port = 40000 + getpid() % 20000, fd, len, i;
+    ASSERT_EQ(net_open(&nr, net_e131, port, 7, 1, 6), 0, "bound");
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for(i = 0; i < 3; i++) {
+        memset(ch, i+1, sizeof(ch));
+        len = net_build(net_e131, 7, (uint8_t)i, ch, 18, pkt);
+        sendto(fd, pkt, len, 0, (struct sockaddr *)&to, sizeof(to));
+    }
+    ASSERT_EQ(net_receive(&nr, &f), 3, "a burst read at once");
+    ASSERT_EQ(f.rgb[2][1], 3, "the newest frame is kept");
+    ASSERT_EQ(net_receive(&nr, &f), 0, "nothing left");
+    close(fd);
+    net_close(&nr);
+}
+
+int main(void)
+{
+    test_e131_frame();
+    test_e131_sequence_wraps();
+    test_parts_mapping();
+    test_ddp_parts_and_push();
+    test_loopback_coalescing();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d network receiver tests passed\n", tests_run);
+    return 0;
+}
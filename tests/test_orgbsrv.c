@@ -0,0 +1,388 @@
+/* Unit tests for the OpenRGB SDK server.
+ * Build: make test
+ * A scripted SDK client talks to the server over loopback; the frames go
+ * through the QC2S bridge to the mock hidapi.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <arpa/inet.h> /* for inet_addr */
+#include <sys/time.h> /* for struct timeval */
+
+#include "../modules/orgbsrv.h"
+#include "../modules/qc2s_bridge.h"
+#include "mock_hidapi/mock_hidapi_control.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+/* The scripted client, blocking with a timeout */
+static int sdk_connect(const struct orgb_server *srv, int *server_fd)
+{
+    struct sockaddr_in addr;
+    struct timeval tv = { 1, 0 };
+    int fd;
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(srv->port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    *server_fd = orgb_accept((struct orgb_server *)srv);
+    return fd;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static void sdk_send(int fd, uint32_t dev, uint32_t id, const uint8_t *data,
+                     uint32_t size)
+{
+    uint8_t pkt[ORGB_HEADER_LEN + ORGB_MAX_PACKET];
+    memcpy(pkt, ORGB_MAGIC, 4);
+    put32(pkt+4, dev);
+    put32(pkt+8, id);
+    put32(pkt+12, size);
+    memcpy(pkt+ORGB_HEADER_LEN, data, size);
+    send(fd, pkt, ORGB_HEADER_LEN + size, 0);
+}
+
+/* Returns the data size of the reply, -1 if there is none */
+static int sdk_recv(int fd, uint32_t *id, uint8_t *data)
+{
+    uint8_t hdr[ORGB_HEADER_LEN];
+    uint32_t size;
+    if(recv(fd, hdr, sizeof(hdr), MSG_WAITALL) != sizeof(hdr) ||
+       memcmp(hdr, ORGB_MAGIC, 4))
+        return -1;
+    *id = get32(hdr+8);
+    size = get32(hdr+12);
+    if(size && recv(fd, data, size, MSG_WAITALL) != (ssize_t)size)
+        return -1;
+    return size;
+}
+
+/* UpdateLEDs with the colors (R, G, B) */
+static void sdk_update_leds(int fd, const uint8_t (*rgb)[3], int cnt)
+{
+    uint8_t data[64];
+    int i, size = 6 + 4*cnt;
+    put32(data, size);
+    data[4] = cnt;
+    data[5] = 0;
+    for(i = 0; i < cnt; i++) {
+        memcpy(data+6+4*i, rgb[i], 3);
+        data[6+4*i+3] = 0;
+    }
+    sdk_send(fd, 0, ORGB_UPDATELEDS, data, size);
+}
+
+static const char *skip_string(const uint8_t **p)
+{
+    const char *str = (const char *)*p + 2;
+    *p += 2 + get16(*p);
+    return str;
+}
+
+static void assert_groups(const struct ring_frame *f,
+                          const uint8_t (*want)[3], const char *msg)
+{
+    int g;
+    for(g = 0; g < QC2S_GROUP_COUNT; g++)
+        ASSERT_TRUE(!memcmp(f->rgb[g], want[g], 3), msg);
+}
+
+static const uint8_t six_colors[QC2S_GROUP_COUNT][3] = {
+    { 0x10, 0x11, 0x12 }, { 0x20, 0x21, 0x22 }, { 0x30, 0x31, 0x32 },
+    { 0x40, 0x41, 0x42 }, { 0x50, 0x51, 0x52 }, { 0x60, 0x61, 0x62 }
+};
+
+/* ---- Tests ---- */
+
+static void test_handshake_and_description(void)
+{
+    struct orgb_server srv;
+    uint8_t data[ORGB_MAX_PACKET], req[4];
+    const uint8_t *p;
+    uint32_t id;
+    int fd, sfd, size, size_v0;
+    ASSERT_EQ(orgb_listen(&srv, 0, 1), 0, "listening on a free port");
+    fd = sdk_connect(&srv, &sfd);
+    ASSERT_TRUE(fd >= 0 && sfd >= 0, "the client is accepted");
+
+    put32(req, 4);
+    sdk_send(fd, 0, ORGB_REQUEST_PROTOCOL_VERSION, req, 4);
+    sdk_send(fd, 0, ORGB_SET_CLIENT_NAME, (const uint8_t *)"test", 5);
+    sdk_send(fd, 0, ORGB_REQUEST_CONTROLLER_COUNT, NULL, 0);
+    ASSERT_EQ(orgb_serve(&srv, sfd), 0, "the client stays");
+    size = sdk_recv(fd, &id, data);
+    ASSERT_EQ(id, ORGB_REQUEST_PROTOCOL_VERSION, "version reply");
+    ASSERT_EQ(get32(data), ORGB_PROTOCOL_VERSION, "the server's version");
+    size = sdk_recv(fd, &id, data);
+    ASSERT_EQ(size, 4, "count reply");
+    ASSERT_EQ(get32(data), 1, "one controller");
+
+    put32(req, ORGB_PROTOCOL_VERSION);
+    sdk_send(fd, 0, ORGB_REQUEST_CONTROLLER_DATA, req, 4);
+    orgb_serve(&srv, sfd);
+    size = sdk_recv(fd, &id, data);
+    ASSERT_EQ(id, ORGB_REQUEST_CONTROLLER_DATA, "data reply");
+    ASSERT_EQ(get32(data), size, "the block starts with its size");
+    ASSERT_EQ(get32(data+4), ORGB_DEVICE_MICROPHONE, "a microphone");
+    p = data + 8;
+    ASSERT_TRUE(!strcmp(skip_string(&p), ORGB_NAME_QC2S), "name");
+    ASSERT_TRUE(!strcmp(skip_string(&p), ORGB_VENDOR), "vendor");
+    skip_string(&p); /* description */
+    skip_string(&p); /* version */
+    skip_string(&p); /* serial */
+    skip_string(&p); /* location */
+    ASSERT_EQ(get16(p), 1, "one mode");
+    p += 2 + 4;
+    ASSERT_TRUE(!strcmp(skip_string(&p), "Direct"), "the direct mode");
+    ASSERT_EQ(get32(p+4), ORGB_MODE_PER_LED_COLOR, "per-LED colors");
+    p += 4*12 + 2;
+    ASSERT_EQ(get16(p), 2, "two zones");
+    p += 2;
+    ASSERT_TRUE(!strcmp(skip_string(&p), "Upper"), "the upper zone");
+    ASSERT_EQ(get32(p+12), QC2S_UPPER_GROUPS, "upper LEDs");
+    p += 4*4 + 2;
+    ASSERT_TRUE(!strcmp(skip_string(&p), "Lower"), "the lower zone");
+    ASSERT_EQ(get32(p+12), QC2S_GROUP_COUNT - QC2S_UPPER_GROUPS,
+              "lower LEDs");
+    p += 4*4 + 2;
+    ASSERT_EQ(get16(p), QC2S_GROUP_COUNT, "a LED per group");
+
+    /* Version 0 clients get neither the vendor nor brightness */
+    put32(req, 0);
+    sdk_send(fd, 0, ORGB_REQUEST_CONTROLLER_DATA, req, 4);
+    orgb_serve(&srv, sfd);
+    size_v0 = sdk_recv(fd, &id, data);
+    ASSERT_EQ(size - size_v0, 2 + sizeof(ORGB_VENDOR) + 3*4,
+              "the block of version 0");
+    close(fd);
+    ASSERT_EQ(orgb_serve(&srv, sfd), -1, "a closed client is dropped");
+    orgb_close(&srv);
+}
+
+static void test_updates_reach_the_bridge(void)
+{
+    struct orgb_server srv;
+    struct ring_frame f;
+    qc2s_ctx *ctx;
+    int fd, sfd, g;
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "the bridge opens");
+    orgb_listen(&srv, 0, 1);
+    fd = sdk_connect(&srv, &sfd);
+    ASSERT_EQ(orgb_take_frame(&srv, &f), 0, "nothing before an update");
+
+    sdk_update_leds(fd, six_colors, QC2S_GROUP_COUNT);
+    orgb_serve(&srv, sfd);
+    ASSERT_TRUE(srv.lit, "the colors are set");
+    ASSERT_EQ(orgb_take_frame(&srv, &f), 1, "a new frame");
+    assert_groups(&f, six_colors, "LEDs map to the groups");
+    ASSERT_EQ(qc2s_set_groups(ctx, (const uint8_t (*)[3])f.rgb), 0,
+              "the frame is sent");
+    ASSERT_EQ(mock_hid_write_calls, 2 + QC2S_GROUP_COUNT,
+              "init, start & the groups");
+    for(g = 0; g < QC2S_GROUP_COUNT; g++) {
+        ASSERT_EQ(mock_hid_packets[2+g][2], g, "group report");
+        ASSERT_TRUE(!memcmp(mock_hid_packets[2+g]+QC2S_RGB_OFFSET,
+                            six_colors[g], 3), "group color");
+    }
+    close(fd);
+    orgb_serve(&srv, sfd);
+    orgb_close(&srv);
+    qc2s_close(ctx);
+}
+
+static void test_spam_is_coalesced(void)
+{
+    struct orgb_server srv;
+    struct ring_frame f;
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
+    qc2s_ctx *ctx;
+    int fd, sfd, i, writes;
+    mock_hid_reset();
+    ctx = qc2s_open();
+    orgb_listen(&srv, 0, 1);
+    fd = sdk_connect(&srv, &sfd);
+    for(i = 0; i < 50; i++) {
+        memset(rgb, i, sizeof(rgb));
+        sdk_update_leds(fd, (const uint8_t (*)[3])rgb, QC2S_GROUP_COUNT);
+    }
+    orgb_serve(&srv, sfd);
+    ASSERT_EQ(srv.updates, 50, "every update is read");
+    ASSERT_EQ(orgb_take_frame(&srv, &f), 1, "they make one frame");
+    ASSERT_EQ(f.rgb[5][2], 49, "the newest colors");
+    qc2s_set_groups(ctx, (const uint8_t (*)[3])f.rgb);
+    writes = mock_hid_write_calls;
+    ASSERT_EQ(writes, 2 + QC2S_GROUP_COUNT, "a single frame on USB");
+
+    for(i = 0; i < 10; i++)
+        sdk_update_leds(fd, (const uint8_t (*)[3])rgb, QC2S_GROUP_COUNT);
+    orgb_serve(&srv, sfd);
+    ASSERT_EQ(srv.redundant, 10, "the same colors change nothing");
+    if(orgb_take_frame(&srv, &f))
+        qc2s_set_groups(ctx, (const uint8_t (*)[3])f.rgb);
+    ASSERT_EQ(mock_hid_write_calls, writes, "no frame for them");
+    close(fd);
+    orgb_serve(&srv, sfd);
+    orgb_close(&srv);
+    qc2s_close(ctx);
+}
+
+static void test_zone_and_single_led(void)
+{
+    struct orgb_server srv;
+    struct ring_frame f;
+    uint8_t data[32];
+    uint8_t want[QC2S_GROUP_COUNT][3];
+    int fd, sfd, i;
+    orgb_listen(&srv, 0, 1);
+    fd = sdk_connect(&srv, &sfd);
+    /* The lower zone gets the last four colors */
+    put32(data, 10 + 4*4);
+    put32(data+4, 1);
+    data[8] = 4;
+    data[9] = 0;
+    for(i = 0; i < 4; i++) {
+        memcpy(data+10+4*i, six_colors[2+i], 3);
+        data[13+4*i] = 0;
+    }
+    sdk_send(fd, 0, ORGB_UPDATEZONELEDS, data, 10 + 4*4);
+    put32(data, 1);
+    memcpy(data+4, six_colors[1], 3);
+    data[7] = 0;
+    sdk_send(fd, 0, ORGB_UPDATESINGLELED, data, 8);
+    orgb_serve(&srv, sfd);
+    orgb_take_frame(&srv, &f);
+    memcpy(want, six_colors, sizeof(want));
+    memset(want[0], 0, 3);
+    assert_groups(&f, (const uint8_t (*)[3])want, "zone & single LED");
+
+    put32(data, 9); /* out of range */
+    sdk_send(fd, 0, ORGB_UPDATESINGLELED, data, 8);
+    orgb_serve(&srv, sfd);
+    ASSERT_EQ(srv.malformed, 1, "a LED that doesn't exist");
+    close(fd);
+    orgb_serve(&srv, sfd);
+    orgb_close(&srv);
+}
+
+static void test_quadcast_s_parts(void)
+{
+    struct orgb_server srv;
+    struct ring_frame f;
+    uint8_t want[QC2S_GROUP_COUNT][3];
+    int fd, sfd, g;
+    orgb_listen(&srv, 0, 0);
+    fd = sdk_connect(&srv, &sfd);
+    sdk_update_leds(fd, six_colors, 2);
+    orgb_serve(&srv, sfd);
+    orgb_take_frame(&srv, &f);
+    for(g = 0; g < QC2S_GROUP_COUNT; g++)
+        memcpy(want[g], six_colors[g >= QC2S_UPPER_GROUPS], 3);
+    assert_groups(&f, (const uint8_t (*)[3])want, "one LED per part");
+    close(fd);
+    orgb_serve(&srv, sfd);
+    orgb_close(&srv);
+}
+
+static void test_bad_magic_drops_client(void)
+{
+    struct orgb_server srv;
+    uint8_t junk[ORGB_HEADER_LEN] = "HTTP/1.1 GET /";
+    uint32_t id;
+    int fd, sfd;
+    orgb_listen(&srv, 0, 1);
+    fd = sdk_connect(&srv, &sfd);
+    send(fd, junk, sizeof(junk), 0);
+    ASSERT_EQ(orgb_serve(&srv, sfd), -1, "the client is dropped");
+    ASSERT_EQ(sdk_recv(fd, &id, junk), -1, "and its socket closed");
+    ASSERT_EQ(srv.malformed, 1, "counted as malformed");
+    close(fd);
+    orgb_close(&srv);
+}
+
+/* Sizes past the buffer, those that would overflow an int too */
+static void test_oversized_packet_drops_client(void)
+{
+    static const uint32_t sizes[] = {
+        ORGB_MAX_PACKET - ORGB_HEADER_LEN + 1, 0x80000000, 0xfffffff8
+    };
+    struct orgb_server srv;
+    uint8_t hdr[ORGB_HEADER_LEN + 64];
+    uint32_t id;
+    int i, fd, sfd;
+    orgb_listen(&srv, 0, 1);
+    for(i = 0; i < (int)(sizeof(sizes)/sizeof(*sizes)); i++) {
+        fd = sdk_connect(&srv, &sfd);
+        memcpy(hdr, ORGB_MAGIC, 4);
+        put32(hdr+4, 0);
+        put32(hdr+8, ORGB_UPDATELEDS);
+        put32(hdr+12, sizes[i]);
+        memset(hdr+ORGB_HEADER_LEN, 0x41, 64);
+        send(fd, hdr, sizeof(hdr), 0);
+        ASSERT_EQ(orgb_serve(&srv, sfd), -1, "the client is dropped");
+        ASSERT_EQ(sdk_recv(fd, &id, hdr), -1, "and its socket closed");
+        ASSERT_EQ(srv.malformed, i+1, "counted as malformed");
+        ASSERT_EQ(srv.clients[1].fd, -1, "nothing written past the buffer");
+        close(fd);
+    }
+    orgb_close(&srv);
+}
+
+int main(void)
+{
+    signal(SIGPIPE, SIG_IGN); /* as the display loop does */
+    test_handshake_and_description();
+    test_updates_reach_the_bridge();
+    test_spam_is_coalesced();
+    test_zone_and_single_led();
+    test_quadcast_s_parts();
+    test_bad_magic_drops_client();
+    test_oversized_packet_drops_client();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d OpenRGB server tests passed\n", tests_run);
+    return 0;
+}
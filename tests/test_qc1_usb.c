@@ -0,0 +1,308 @@
+/* Unit tests for the QuadCast S transport, its bulk uploads & --persist.
+ * Build: make test
+ * libusb is tests/mock_libusb: every transfer is counted.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "../modules/qc1_usb.h"
+#include "mock_libusb_control.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define COMMANDS 20 /* three packets, the last one not full */
+
+static datpack anim[(COMMANDS+COLPAIR_PER_PCT-1)/COLPAIR_PER_PCT];
+
+static void setup(struct micro *m)
+{
+    int i;
+    mock_usb_reset();
+    memset(m, 0, sizeof(*m));
+    m->caps = find_caps(DEV_VID_NA, DEV_PID_NA1);
+    m->caps->transport->open(m, NULL, NULL);
+    memset(anim, 0, sizeof(anim));
+    for(i = 0; i < COMMANDS; i++) {
+        anim[0][2*BYTE_STEP*i] = RGB_CODE;
+        anim[0][2*BYTE_STEP*i+1] = (byte_t)i;
+        anim[0][2*BYTE_STEP*i+BYTE_STEP] = RGB_CODE;
+    }
+}
+
+static const byte_t *command(int i)
+{
+    return anim[0] + 2*BYTE_STEP*i;
+}
+
+/* As the event loop does between ticks */
+static void complete_transfers(void)
+{
+    struct timeval tv = { 0, 0 };
+    libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+}
+
+/* The usual way: a header & a data packet per frame */
+static void test_frame_per_tick(void)
+{
+    struct micro m;
+    int i;
+
+    setup(&m);
+    for(i = 0; i < 2*COMMANDS; i++)
+        micro_show(&m, command(i % COMMANDS), NULL, i, 50);
+    m.caps->transport->close(&m); /* the frames in flight complete */
+    ASSERT_EQ(mock_usb_control_calls, 4*COMMANDS, "two transfers a tick");
+    ASSERT_EQ(mock_usb_packets[0][0], HEADER_CODE, "header first");
+    ASSERT_EQ(mock_usb_packets[0][PACKET_CNT_POS], 1, "one packet");
+    ASSERT_EQ(mock_usb_packets[1][1], 0, "the first command");
+    ASSERT_EQ(mock_usb_packets[3][1], 1, "the second command");
+    ASSERT_EQ(mock_usb_packets[1][2*BYTE_STEP], 0, "one command a packet");
+    ASSERT_EQ(mock_usb_in_flight, 0, "none left in flight");
+}
+
+/* The next frame is queued while the last one completes; a tick only
+ * waits for the frame QC1_PIPE_DEPTH ticks before it */
+static void test_frames_are_pipelined(void)
+{
+    struct micro m;
+    long long start;
+    int i;
+
+    setup(&m);
+    ASSERT_TRUE(m.pipe != NULL, "transfers allocated");
+    mock_usb_latency_us = 20000;
+    start = frame_clock_now_ns();
+    for(i = 0; i < QC1_PIPE_DEPTH; i++)
+        ASSERT_EQ(micro_show(&m, command(i), NULL, i, 500), frame_sent,
+                  "frame submitted");
+    ASSERT_TRUE(frame_clock_now_ns() - start < 10*NSEC_PER_MSEC,
+                "no tick waits for the device");
+    ASSERT_EQ(mock_usb_in_flight, 2*QC1_PIPE_DEPTH, "all of them in flight");
+    ASSERT_EQ(mock_usb_control_calls, 0, "none completed yet");
+
+    ASSERT_EQ(micro_show(&m, command(2), NULL, 2, 500), frame_sent,
+              "the next frame");
+    ASSERT_TRUE(mock_usb_control_calls >= 2, "after the first completed");
+    ASSERT_EQ(mock_usb_in_flight, 2*QC1_PIPE_DEPTH, "still two in flight");
+    m.caps->transport->close(&m);
+    ASSERT_EQ(mock_usb_control_calls, 6, "every transfer completed");
+    for(i = 0; i < 3; i++) {
+        ASSERT_EQ(mock_usb_packets[2*i][0], HEADER_CODE, "header");
+        ASSERT_EQ(mock_usb_packets[2*i+1][1], i, "then its command");
+    }
+}
+
+static void test_failure_at_the_next_tick(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_fail_call = 2;
+    ASSERT_EQ(micro_show(&m, command(0), NULL, 0, 50), frame_sent,
+              "submitted");
+    complete_transfers();
+    ASSERT_EQ(micro_show(&m, command(1), NULL, 1, 50), frame_failed,
+              "its failure comes at the next tick");
+    ASSERT_EQ(micro_show(&m, command(2), NULL, 2, 50), frame_sent,
+              "then frames go on");
+    mock_usb_fail_call = 0;
+    m.caps->transport->close(&m);
+}
+
+/* A header without its data would take the next header for it */
+static void test_header_cancelled_with_its_data(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_latency_us = 20000;
+    mock_usb_submit_fail_call = 2;
+    ASSERT_EQ(micro_show(&m, command(0), NULL, 0, 50), frame_failed,
+              "the data couldn't be submitted");
+    complete_transfers();
+    ASSERT_EQ(mock_usb_in_flight, 0, "the header is cancelled");
+    ASSERT_EQ(micro_show(&m, command(1), NULL, 1, 50), frame_sent,
+              "the failure isn't returned twice");
+    m.caps->transport->close(&m);
+    ASSERT_EQ(mock_usb_control_calls, 2, "only the next frame went");
+    ASSERT_EQ(mock_usb_packets[1][1], 1, "with its own header");
+}
+
+/* Transfers & their buffers belong to libusb until they complete */
+static void test_close_waits_for_cancellations(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_latency_us = 1000000;
+    mock_usb_cancel_latency_us = 3*QC1_DRAIN_TIMEOUT*1000;
+    micro_show(&m, command(0), NULL, 0, 50);
+    micro_show(&m, command(1), NULL, 1, 50);
+    m.caps->transport->close(&m);
+    ASSERT_EQ(mock_usb_closed_in_flight, 0, "nothing in flight at close");
+    ASSERT_EQ(mock_usb_control_calls, 0, "the frames were cancelled");
+    ASSERT_TRUE(m.pipe == NULL, "the transfers are freed");
+}
+
+static void test_zero_copy_buffers(void)
+{
+    struct micro m;
+
+    mock_usb_reset();
+    mock_usb_dev_mem = 1;
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_NA, DEV_PID_NA1);
+    m.caps->transport->open(&m, NULL, NULL);
+    ASSERT_EQ(mock_usb_dev_mem_allocs, 1, "buffers from usbfs");
+    micro_show(&m, command(0), NULL, 0, 50);
+    m.caps->transport->close(&m);
+    ASSERT_EQ(mock_usb_dev_mem_allocs, 0, "given back on close");
+    ASSERT_EQ(mock_usb_control_calls, 2, "the frame went");
+}
+
+static void test_bulk_upload(void)
+{
+    struct micro m;
+    int i;
+
+    setup(&m);
+    for(i = 0; i < 2*COMMANDS; i++)
+        ASSERT_EQ(micro_upload(&m, anim, COMMANDS, i % COMMANDS, 50),
+                  frame_sent, "tick sent");
+    ASSERT_EQ(mock_usb_control_calls, 2*(1+3),
+              "a header & three packets per cycle");
+    ASSERT_EQ(mock_usb_packets[0][PACKET_CNT_POS], 3, "header counts them");
+    ASSERT_TRUE(!memcmp(mock_usb_packets[1], anim[0], DATA_PACKET_SIZE),
+                "whole packets");
+    ASSERT_EQ(mock_usb_packets[2][1], COLPAIR_PER_PCT,
+              "eight commands a packet");
+    ASSERT_EQ(mock_usb_packets[4][0], HEADER_CODE, "uploaded again");
+    m.caps->transport->close(&m);
+}
+
+/* After a frame of its own, the device gets the rest of the animation
+ * from the packet it is in */
+static void test_bulk_after_a_frame(void)
+{
+    struct micro m;
+
+    setup(&m);
+    micro_upload(&m, anim, COMMANDS, 0, 50);
+    micro_show(&m, command(0), NULL, 1, 50);
+    complete_transfers();
+    mock_usb_packet_count = 0;
+    mock_usb_control_calls = 0;
+    micro_upload(&m, anim, COMMANDS, 10, 50);
+    ASSERT_EQ(mock_usb_control_calls, 3, "the packets from the current one");
+    ASSERT_EQ(mock_usb_packets[0][PACKET_CNT_POS], 2, "two left");
+    ASSERT_EQ(mock_usb_packets[1][1], COLPAIR_PER_PCT, "the second packet");
+    micro_upload(&m, anim, COMMANDS, 11, 50);
+    ASSERT_EQ(mock_usb_control_calls, 3, "then nothing");
+    m.caps->transport->close(&m);
+}
+
+static void test_bulk_failure_uploads_again(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_fail_call = 2;
+    ASSERT_EQ(micro_upload(&m, anim, COMMANDS, 0, 50), frame_failed,
+              "a failed packet fails the upload");
+    ASSERT_EQ(m.uploaded, 0, "not uploaded");
+    ASSERT_EQ(micro_upload(&m, anim, COMMANDS, 1, 50), frame_sent,
+              "uploaded at the next tick");
+    ASSERT_EQ(mock_usb_control_calls, 2+4, "all of it again");
+    mock_usb_fail_call = 0;
+    m.caps->transport->close(&m);
+}
+
+/* --persist: the animation goes once & is read back */
+static void test_persist_confirmed(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_keeps_uploads = 1;
+    ASSERT_EQ(micro_persist(&m, anim, COMMANDS, 50), 0, "confirmed");
+    ASSERT_EQ(mock_usb_control_calls, 1+3+3,
+              "a header, three packets & three readbacks");
+    ASSERT_EQ(mock_usb_kept_count, 3, "the device keeps all three");
+    ASSERT_EQ(mock_usb_packets[0][PACKET_CNT_POS], 3, "header counts them");
+    m.caps->transport->close(&m);
+}
+
+static void test_persist_unsupported(void)
+{
+    struct micro m;
+
+    setup(&m);
+    ASSERT_EQ(micro_persist(&m, anim, COMMANDS, 50), 1,
+              "a stalled readback isn't a confirmation");
+    ASSERT_EQ(mock_usb_control_calls, 1+3+1, "stops at the first readback");
+    m.caps->transport->close(&m);
+}
+
+static void test_persist_mismatch(void)
+{
+    struct micro m;
+
+    setup(&m);
+    mock_usb_keeps_uploads = 1;
+    micro_persist(&m, anim, COMMANDS, 50);
+    mock_usb_kept[1][1] ^= 0xff;
+    mock_usb_control_calls = 0;
+    ASSERT_EQ(m.caps->transport->readback(&m, anim, 3, 50), 1,
+              "a packet the device got wrong");
+    ASSERT_EQ(mock_usb_control_calls, 2, "found at the second packet");
+
+    mock_usb_fail_call = 2;
+    mock_usb_control_calls = 0;
+    ASSERT_EQ(micro_persist(&m, anim, COMMANDS, 50), 1,
+              "a failed upload isn't read back");
+    ASSERT_EQ(mock_usb_control_calls, 2, "given up at the failure");
+    mock_usb_fail_call = 0;
+    m.caps->transport->close(&m);
+}
+
+int main(void)
+{
+    test_frame_per_tick();
+    test_frames_are_pipelined();
+    test_failure_at_the_next_tick();
+    test_header_cancelled_with_its_data();
+    test_close_waits_for_cancellations();
+    test_zero_copy_buffers();
+    test_bulk_upload();
+    test_bulk_after_a_frame();
+    test_bulk_failure_uploads_again();
+    test_persist_confirmed();
+    test_persist_unsupported();
+    test_persist_mismatch();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d QuadCast S transport tests passed\n", tests_run);
+    return 0;
+}
@@ -1,6 +1,8 @@
 /* Unit tests for QC2S packet building functions.
  * Build: make test
- * These test pure functions that don't require USB hardware.
+ * These test pure functions that don't require USB hardware: the encoder
+ * and the report cache of modules/qc2s_encode.c, and the per-LED effects
+ * of modules/qc2s_effects.c.
  */
 #include <stdio.h>
 #include <string.h>
@@ -9,6 +11,8 @@
 /* Pull in the types we need */
 #include "../modules/rgbmodes.h"
 #include "../modules/qc2s_protocol.h"
+#include "../modules/qc2s_encode.h"
+#include "../modules/qc2s_effects.h"
 
 /* Keep test independent from libusb-heavy headers */
 #define PACKET_SIZE QC2S_PACKET_SIZE
@@ -35,21 +39,6 @@ static int tests_failed = 0;
 
 /* ---- Functions under test (copied to avoid libusb dependency) ---- */
 
-static void write_qc2s_color_packet(byte_t group, const byte_t *rgb,
-                                    byte_t *packet)
-{
-    int i;
-    memset(packet, 0, PACKET_SIZE);
-    packet[0] = QC2S_CMD_COLOR;
-    packet[1] = QC2S_SUB_DATA;
-    packet[2] = group;
-    for(i = QC2S_RGB_OFFSET; i+2 < PACKET_SIZE; i += 3) {
-        packet[i] = rgb[0];
-        packet[i+1] = rgb[1];
-        packet[i+2] = rgb[2];
-    }
-}
-
 static void get_group_colors(const byte_t *colcommand, byte_t *upper,
                              byte_t *lower)
 {
@@ -73,7 +62,7 @@ static void test_write_color_packet_header(void)
     byte_t packet[PACKET_SIZE];
     byte_t rgb[3] = {0xFF, 0x55, 0x00};
 
-    write_qc2s_color_packet(3, rgb, packet);
+    qc2s_encode_group(packet, 3, rgb);
 
     ASSERT_EQ(packet[0], QC2S_CMD_COLOR, "byte 0 should be CMD_COLOR");
     ASSERT_EQ(packet[1], QC2S_SUB_DATA, "byte 1 should be SUB_DATA");
@@ -87,7 +76,7 @@ static void test_write_color_packet_rgb_fill(void)
     byte_t rgb[3] = {0xFF, 0x55, 0x00};
     int i;
 
-    write_qc2s_color_packet(0, rgb, packet);
+    qc2s_encode_group(packet, 0, rgb);
 
     /* Verify all RGB triplets from offset 4 onward */
     for(i = QC2S_RGB_OFFSET; i+2 < PACKET_SIZE; i += 3) {
@@ -103,7 +92,7 @@ static void test_write_color_packet_black(void)
     byte_t rgb[3] = {0, 0, 0};
     int i;
 
-    write_qc2s_color_packet(5, rgb, packet);
+    qc2s_encode_group(packet, 5, rgb);
 
     ASSERT_EQ(packet[0], QC2S_CMD_COLOR, "header present for black");
     /* All data bytes should be zero */
@@ -118,11 +107,168 @@ static void test_write_color_packet_all_groups(void)
     int g;
 
     for(g = 0; g < QC2S_GROUP_COUNT; g++) {
-        write_qc2s_color_packet((byte_t)g, rgb, packet);
+        qc2s_encode_group(packet, (byte_t)g, rgb);
         ASSERT_EQ(packet[2], g, "group index matches");
     }
 }
 
+static void test_init_and_start_reports(void)
+{
+    byte_t packet[PACKET_SIZE];
+    byte_t zero[PACKET_SIZE] = {0};
+
+    qc2s_encode_init(packet);
+    ASSERT_EQ(packet[0], QC2S_CMD_INIT, "init command");
+    ASSERT_EQ(packet[1], QC2S_SUB_START, "init subcommand");
+    ASSERT_MEM_EQ(packet+2, zero, PACKET_SIZE-2, "rest of init is zero");
+
+    qc2s_encode_start(packet, 4);
+    ASSERT_EQ(packet[0], QC2S_CMD_COLOR, "start command");
+    ASSERT_EQ(packet[1], QC2S_SUB_START, "start subcommand");
+    ASSERT_EQ(packet[2], 4, "start has the count");
+    ASSERT_MEM_EQ(packet+3, zero, PACKET_SIZE-3, "rest of start is zero");
+}
+
+static void test_write_leds_packet(void)
+{
+    byte_t packet[PACKET_SIZE];
+    byte_t leds[QC2S_LEDS_PER_GROUP][3];
+    int led;
+
+    for(led = 0; led < QC2S_LEDS_PER_GROUP; led++) {
+        leds[led][0] = (byte_t)led;
+        leds[led][1] = (byte_t)(0x80 + led);
+        leds[led][2] = (byte_t)(0xFF - led);
+    }
+    qc2s_encode_leds(packet, 4, leds);
+
+    ASSERT_EQ(packet[0], QC2S_CMD_COLOR, "leds packet cmd");
+    ASSERT_EQ(packet[1], QC2S_SUB_DATA, "leds packet sub");
+    ASSERT_EQ(packet[2], 4, "leds packet group");
+    ASSERT_EQ(packet[3], 0, "leds packet padding");
+    for(led = 0; led < QC2S_LEDS_PER_GROUP; led++)
+        ASSERT_MEM_EQ(packet + QC2S_RGB_OFFSET + 3*led, leds[led], 3,
+                      "each slot has its LED");
+}
+
+static byte_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+
+static int groups_alike(void)
+{
+    int g;
+    for(g = 1; g < QC2S_GROUP_COUNT; g++)
+        if(memcmp(leds[g], leds[0], sizeof(leds[0])))
+            return 0;
+    return 1;
+}
+
+static void test_effect_gradient(void)
+{
+    struct qc2s_effect e = { QC2S_EFFECT_GRADIENT, {0xFF, 0, 0},
+                             {0, 0, 0xFF}, 0 };
+    int last = QC2S_LEDS_PER_GROUP - 1;
+
+    qc2s_effect_render(&e, 0, leds);
+    ASSERT_MEM_EQ(leds[0][0], e.from, 3, "gradient starts at from");
+    ASSERT_MEM_EQ(leds[0][last], e.to, 3, "and ends at to");
+    ASSERT_EQ(leds[0][last/2][0] > 0 && leds[0][last/2][2] > 0, 1,
+              "blended in the middle");
+    ASSERT_EQ(leds[0][1][0] < leds[0][0][0], 1, "red fades");
+    ASSERT_EQ(groups_alike(), 1, "every group the same");
+
+    qc2s_effect_render(&e, 1, leds);
+    ASSERT_EQ(leds[0][last-1][2], 0xFF, "scrolled one LED on");
+    ASSERT_EQ(leds[0][last][2] < 0xFF, 1, "and coming back");
+}
+
+static void test_effect_chase(void)
+{
+    struct qc2s_effect e = { QC2S_EFFECT_CHASE, {0xFF, 0xFF, 0xFF},
+                             {0, 0, 0}, 2 };
+    int led, lit;
+
+    qc2s_effect_render(&e, 5, leds);
+    ASSERT_MEM_EQ(leds[0][5], e.from, 3, "the head at the step");
+    ASSERT_EQ(leds[0][4][0], 0xFF*2/3, "tail fades");
+    ASSERT_EQ(leds[0][3][0], 0xFF/3, "to the background");
+    for(led = 0, lit = 0; led < QC2S_LEDS_PER_GROUP; led++)
+        lit += leds[0][led][0] != 0;
+    ASSERT_EQ(lit, 3, "the head and its tail lit");
+
+    qc2s_effect_render(&e, QC2S_LEDS_PER_GROUP + 1, leds);
+    ASSERT_MEM_EQ(leds[0][1], e.from, 3, "around again");
+    ASSERT_EQ(leds[0][0][0], 0xFF*2/3, "tail behind it");
+    ASSERT_EQ(leds[0][QC2S_LEDS_PER_GROUP-1][0], 0xFF/3,
+              "tail wraps around");
+}
+
+static void test_effect_rainbow(void)
+{
+    struct qc2s_effect e = { QC2S_EFFECT_RAINBOW, {0}, {0}, 0 };
+    byte_t first[QC2S_LEDS_PER_GROUP][3];
+    int led, other;
+
+    qc2s_effect_render(&e, 0, leds);
+    ASSERT_EQ(leds[0][0][0], 0xFF, "starts red");
+    ASSERT_EQ(leds[0][0][1] | leds[0][0][2], 0, "pure red");
+    for(led = 0; led < QC2S_LEDS_PER_GROUP; led++)
+        for(other = 0; other < led; other++)
+            ASSERT_EQ(memcmp(leds[0][led], leds[0][other], 3) != 0, 1,
+                      "a color per LED");
+    ASSERT_EQ(groups_alike(), 1, "every group the same");
+
+    memcpy(first, leds[0], sizeof(first));
+    qc2s_effect_render(&e, 3, leds);
+    for(led = 0; led < QC2S_LEDS_PER_GROUP; led++)
+        ASSERT_MEM_EQ(leds[0][led],
+                      first[(led + 3) % QC2S_LEDS_PER_GROUP], 3,
+                      "spun by the steps");
+}
+
+static void test_cache_shares_equal_frames(void)
+{
+    byte_t frames[4][QC2S_GROUP_COUNT][3];
+    byte_t packet[PACKET_SIZE];
+    struct qc2s_report_cache c;
+    const byte_t *reports;
+    int f, g;
+
+    memset(frames, 0, sizeof(frames));
+    for(g = 0; g < QC2S_GROUP_COUNT; g++) {
+        frames[0][g][0] = 0xFF;
+        frames[1][g][2] = (byte_t)g;
+    }
+    memcpy(frames[2], frames[0], sizeof(frames[0]));
+    /* frames[3] stays black */
+
+    ASSERT_EQ(qc2s_cache_build(&c, (const byte_t (*)[QC2S_GROUP_COUNT][3])
+                               frames, 4), 0, "cache built");
+    ASSERT_EQ(c.frames, 4, "every frame");
+    ASSERT_EQ(c.distinct, 3, "equal frames share their reports");
+    ASSERT_EQ(c.slot[2], c.slot[0], "the repeated frame");
+    ASSERT_EQ((long)((size_t)c.arena % QC2S_CACHE_ALIGN), 0,
+              "arena is cache aligned");
+    for(f = 0; f < 4; f++) {
+        reports = qc2s_cache_reports(&c, f);
+        for(g = 0; g < QC2S_GROUP_COUNT; g++) {
+            qc2s_encode_group(packet, (byte_t)g, frames[f][g]);
+            ASSERT_MEM_EQ(reports + g*PACKET_SIZE, packet, PACKET_SIZE,
+                          "cached report as encoded");
+        }
+    }
+    qc2s_cache_free(&c);
+    ASSERT_EQ(c.arena == NULL, 1, "freed");
+}
+
+static void test_cache_of_nothing(void)
+{
+    struct qc2s_report_cache c;
+
+    ASSERT_EQ(qc2s_cache_build(&c, NULL, 0), 0, "empty animation");
+    ASSERT_EQ(c.distinct, 0, "no reports");
+    qc2s_cache_free(&c);
+}
+
 static void test_get_group_colors_both_set(void)
 {
     /* Simulate datpack layout: [RGB_CODE R G B] [RGB_CODE R G B] ... */
@@ -187,6 +333,13 @@ int main(void)
     test_write_color_packet_rgb_fill();
     test_write_color_packet_black();
     test_write_color_packet_all_groups();
+    test_init_and_start_reports();
+    test_write_leds_packet();
+    test_effect_gradient();
+    test_effect_chase();
+    test_effect_rainbow();
+    test_cache_shares_equal_frames();
+    test_cache_of_nothing();
     test_get_group_colors_both_set();
     test_get_group_colors_upper_only();
     test_get_group_colors_neither_set();
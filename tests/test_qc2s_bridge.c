@@ -1,8 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "../modules/qc2s_bridge.h"
 #include "../modules/qc2s_protocol.h"
+#include "../modules/qc2s_effects.h"
 #include "mock_hidapi/mock_hidapi_control.h"
 
 static int tests_run = 0;
@@ -60,6 +64,121 @@ static void test_open_close_refcount(void)
     ASSERT_EQ_INT(mock_hid_exit_calls, 1, "hid_exit after last close");
 }
 
+/* A vendor interface of the wrong number, the primary one, and a mouse
+   interface that is never opened */
+static void set_three_interfaces(const wchar_t *serial)
+{
+    mock_hid_entries[0].path = "hid-vendor";
+    mock_hid_entries[0].interface_number = 0;
+    mock_hid_entries[0].usage_page = 0xff00;
+    mock_hid_entries[0].usage = 0x0001;
+    mock_hid_entries[0].serial = serial;
+    mock_hid_entries[1].path = "hid-primary";
+    mock_hid_entries[1].interface_number = 1;
+    mock_hid_entries[1].usage_page = 0xff13;
+    mock_hid_entries[1].usage = 0xff00;
+    mock_hid_entries[1].serial = serial;
+    mock_hid_entries[2].path = "hid-mouse";
+    mock_hid_entries[2].interface_number = 1;
+    mock_hid_entries[2].usage_page = 0x0001;
+    mock_hid_entries[2].usage = 0x0002;
+    mock_hid_entries[2].serial = serial;
+    mock_hid_entry_count = 3;
+}
+
+static void test_open_prefers_primary_interface(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    set_three_interfaces(L"S1");
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open with three interfaces");
+    ASSERT_TRUE(strcmp(mock_hid_last_open_path, "hid-primary") == 0,
+                "primary usage opened though listed second");
+    ASSERT_EQ_INT(mock_hid_enumerate_calls, 1, "one enumeration");
+    qc2s_close(ctx);
+}
+
+static void test_open_falls_back_in_pass_order(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    set_three_interfaces(L"S1");
+    mock_hid_open_fail_path = "hid-primary";
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open when the primary interface fails");
+    ASSERT_TRUE(strcmp(mock_hid_last_open_path, "hid-vendor") == 0,
+                "vendor usage is next, the mouse is never tried");
+    qc2s_close(ctx);
+
+    mock_hid_reset();
+    set_three_interfaces(L"S1");
+    mock_hid_entry_count = 1;
+    mock_hid_entries[0] = mock_hid_entries[2];
+    mock_hid_open_calls = 0;
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx == NULL, "mouse interface alone isn't opened");
+    ASSERT_TRUE(strcmp(mock_hid_last_open_path, "hid-mouse") != 0,
+                "mouse interface never tried");
+}
+
+static void test_reopen_skips_enumeration(void)
+{
+    char first[MOCK_HID_PATH_CAP];
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    set_three_interfaces(L"S1");
+    ctx = qc2s_open();
+    qc2s_close(ctx);
+    strcpy(first, mock_hid_last_open_path);
+
+    mock_hid_enumerate_calls = 0;
+    mock_hid_open_calls = 0;
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "reopen succeeds");
+    ASSERT_EQ_INT(mock_hid_enumerate_calls, 0, "reopen doesn't enumerate");
+    ASSERT_EQ_INT(mock_hid_open_calls, 1, "reopen opens the last path only");
+    ASSERT_TRUE(strcmp(mock_hid_last_open_path, first) == 0,
+                "reopen uses the last path");
+    qc2s_close(ctx);
+}
+
+static void test_reopen_checks_serial(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    set_three_interfaces(L"S1");
+    ctx = qc2s_open();
+    qc2s_close(ctx);
+
+    /* Another microphone got the path */
+    set_three_interfaces(L"S2");
+    mock_hid_enumerate_calls = 0;
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open after the serial changed");
+    ASSERT_EQ_INT(mock_hid_enumerate_calls, 1, "serial mismatch enumerates");
+    qc2s_close(ctx);
+
+    /* Devices without a serial aren't remembered */
+    set_three_interfaces(NULL);
+    ctx = qc2s_open();
+    qc2s_close(ctx);
+    mock_hid_enumerate_calls = 0;
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open without a serial");
+    ASSERT_EQ_INT(mock_hid_enumerate_calls, 1, "no serial, no shortcut");
+    qc2s_close(ctx);
+
+    /* The device is gone */
+    mock_hid_reset();
+    mock_hid_has_device = 0;
+    ASSERT_TRUE(qc2s_open() == NULL, "open fails without a device");
+}
+
 static void test_set_color_packet_sequence(void)
 {
     qc2s_ctx *ctx;
@@ -110,6 +229,412 @@ static void test_set_frame_uses_upper_and_lower_colors(void)
     qc2s_close(ctx);
 }
 
+static void test_set_groups_uses_each_color(void)
+{
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
+    qc2s_ctx *ctx;
+    int g;
+
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        rgb[g][0] = (uint8_t)(0x10 * g);
+        rgb[g][1] = (uint8_t)(0x10 * g + 1);
+        rgb[g][2] = (uint8_t)(0x10 * g + 2);
+    }
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for set_groups");
+    ASSERT_EQ_INT(qc2s_set_groups(ctx, (const uint8_t (*)[3])rgb), 0,
+                  "set_groups succeeds");
+    ASSERT_EQ_INT(mock_hid_write_calls, 8, "set_groups writes init + start + 6 groups");
+
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        assert_group_packet_rgb(mock_hid_packets[2 + g], (uint8_t)g,
+                                rgb[g][0], rgb[g][1], rgb[g][2]);
+    }
+
+    ASSERT_EQ_INT(qc2s_set_groups(ctx, NULL), -1, "set_groups rejects NULL");
+    qc2s_close(ctx);
+}
+
+/* Each LED gets its slot of the group report, in the same reports */
+static void test_set_leds_fills_each_slot(void)
+{
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+    qc2s_ctx *ctx;
+    int g, led;
+
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        for (led = 0; led < QC2S_LEDS_PER_GROUP; led++) {
+            leds[g][led][0] = (uint8_t)g;
+            leds[g][led][1] = (uint8_t)led;
+            leds[g][led][2] = (uint8_t)(g * QC2S_LEDS_PER_GROUP + led);
+        }
+    }
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for set_leds");
+    ASSERT_EQ_INT(qc2s_set_leds(ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])
+                                leds), 0, "set_leds succeeds");
+    ASSERT_EQ_INT(mock_hid_write_calls, 8,
+                  "as many reports as a frame of group colors");
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        ASSERT_EQ_INT(mock_hid_packets[2 + g][2], g, "group in order");
+        ASSERT_TRUE(!memcmp(mock_hid_packets[2 + g] + QC2S_RGB_OFFSET,
+                            leds[g], sizeof(leds[g])), "a slot per LED");
+    }
+
+    /* One LED changed sends its group only */
+    leds[3][7][0] = 0xEE;
+    ASSERT_EQ_INT(qc2s_set_leds(ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])
+                                leds), 0, "one LED changed");
+    ASSERT_EQ_INT(mock_hid_write_calls, 10, "start & its group");
+    ASSERT_EQ_INT(mock_hid_packets[9][2], 3, "the group of the LED");
+    ASSERT_EQ_INT(mock_hid_packets[9][QC2S_RGB_OFFSET + 3 * 7], 0xEE,
+                  "the LED's slot");
+
+    ASSERT_EQ_INT(qc2s_set_leds(ctx, NULL), -1, "set_leds rejects NULL");
+    qc2s_close(ctx);
+}
+
+/* A chase through the bridge: the head moves one slot a frame */
+static void test_effect_frames_are_sent(void)
+{
+    struct qc2s_effect e = { QC2S_EFFECT_CHASE, {0xFF, 0x80, 0}, {0, 0, 0},
+                             0 };
+    uint8_t leds[QC2S_GROUP_COUNT][QC2S_LEDS_PER_GROUP][3];
+    const uint8_t *slot;
+    qc2s_ctx *ctx;
+    int step, g;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for effects");
+    for (step = 0; step < 3; step++) {
+        qc2s_effect_render(&e, (unsigned long)step, leds);
+        ASSERT_EQ_INT(qc2s_set_leds(
+                          ctx, (const uint8_t (*)[QC2S_LEDS_PER_GROUP][3])leds),
+                      0, "effect frame sent");
+    }
+    ASSERT_EQ_INT(mock_hid_write_calls, 8 + 2 * (1 + QC2S_GROUP_COUNT),
+                  "a report per group and frame");
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        slot = mock_hid_packets[8 + (1 + QC2S_GROUP_COUNT) + 1 + g] +
+               QC2S_RGB_OFFSET;
+        ASSERT_EQ_INT(slot[-QC2S_RGB_OFFSET + 2], g, "last frame's groups");
+        ASSERT_TRUE(!memcmp(slot + 3 * 2, e.from, 3), "head at the third LED");
+        ASSERT_EQ_INT(slot[3 * 1], 0, "gone from the second");
+    }
+    qc2s_close(ctx);
+}
+
+static void test_submit_frames_in_order(void)
+{
+    struct qc2s_timed_frame frames[3];
+    qc2s_ctx *ctx;
+    int f, g;
+
+    memset(frames, 0, sizeof(frames));
+    for (f = 0; f < 3; f++) {
+        for (g = 0; g < QC2S_GROUP_COUNT; g++)
+            frames[f].rgb[g][0] = (uint8_t)(0x10 * f + g);
+        frames[f].duration_ms = 1;
+    }
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for submit");
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, frames, 3), 3, "every frame sent");
+    ASSERT_EQ_INT(mock_hid_write_calls, 2 + 3 * (1 + QC2S_GROUP_COUNT) - 1,
+                  "init once, start & groups per frame");
+    for (f = 0; f < 3; f++) {
+        for (g = 0; g < QC2S_GROUP_COUNT; g++)
+            assert_group_packet_rgb(mock_hid_packets[2 + f * 7 + g],
+                                    (uint8_t)g, frames[f].rgb[g][0], 0, 0);
+    }
+
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, NULL, 0), 0, "nothing to submit");
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, NULL, 1), -1, "rejects NULL");
+    mock_hid_write_fail_call = mock_hid_write_calls + 1;
+    frames[0].rgb[0][1] = 1;
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, frames, 3), -1, "write error");
+    mock_hid_write_fail_call = 0;
+    qc2s_close(ctx);
+}
+
+/* A frame whose time passed while the one before was sent is skipped */
+static void test_submit_frames_skips_late_ones(void)
+{
+    struct qc2s_timed_frame frames[5];
+    qc2s_ctx *ctx;
+    int f;
+
+    memset(frames, 0, sizeof(frames));
+    for (f = 0; f < 5; f++) {
+        memset(frames[f].rgb, f + 1, sizeof(frames[f].rgb));
+        frames[f].duration_ms = 5;
+    }
+
+    mock_hid_reset();
+    mock_hid_write_delay_us = 3000; /* a frame takes 24 ms */
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for late frames");
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, frames, 5), 2,
+                  "the first and the last");
+    assert_group_packet_rgb(mock_hid_packets[mock_hid_packet_count - 1],
+                            QC2S_GROUP_COUNT - 1, 5, 5, 5);
+    mock_hid_write_delay_us = 0;
+    qc2s_close(ctx);
+}
+
+static void test_only_changed_groups_are_sent(void)
+{
+    qc2s_ctx *ctx;
+    int g, lower = QC2S_GROUP_COUNT - QC2S_UPPER_GROUPS;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for delta");
+    ASSERT_EQ_INT(qc2s_set_frame(ctx, 1, 2, 3, 4, 5, 6), 0, "first frame");
+    ASSERT_EQ_INT(mock_hid_write_calls, 8, "first frame sends everything");
+
+    ASSERT_EQ_INT(qc2s_set_frame(ctx, 1, 2, 3, 4, 5, 6), 0, "same frame");
+    ASSERT_EQ_INT(mock_hid_write_calls, 8, "same frame sends nothing");
+
+    ASSERT_EQ_INT(qc2s_set_frame(ctx, 1, 2, 3, 7, 8, 9), 0, "lower changed");
+    ASSERT_EQ_INT(mock_hid_write_calls, 8 + 1 + lower,
+                  "start + the lower groups");
+    ASSERT_EQ_INT(mock_hid_packets[8][1], QC2S_SUB_START, "start first");
+    ASSERT_EQ_INT(mock_hid_packets[8][2], lower,
+                  "start counts the changed groups");
+    for (g = 0; g < lower; g++) {
+        assert_group_packet_rgb(mock_hid_packets[9 + g],
+                                (uint8_t)(QC2S_UPPER_GROUPS + g), 7, 8, 9);
+    }
+
+    /* A failed frame leaves the device's colors unknown */
+    mock_hid_write_fail_call = mock_hid_write_calls + 2;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 1, 1), -1, "write error");
+    mock_hid_write_fail_call = 0;
+    mock_hid_write_calls = 0;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 1, 1), 0, "retry");
+    ASSERT_EQ_INT(mock_hid_write_calls, 1 + QC2S_GROUP_COUNT,
+                  "retry sends every group");
+
+    qc2s_close(ctx);
+}
+
+static void test_keepalive_resends_the_frame(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for keepalive");
+    qc2s_set_keepalive(ctx, 1);
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "first frame");
+    usleep(2000);
+    mock_hid_write_calls = 0;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "same frame");
+    ASSERT_EQ_INT(mock_hid_write_calls, 1 + QC2S_GROUP_COUNT,
+                  "sent again once the keepalive is due");
+
+    qc2s_set_keepalive(ctx, 0);
+    usleep(2000);
+    mock_hid_write_calls = 0;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "same frame again");
+    ASSERT_EQ_INT(mock_hid_write_calls, 0, "no keepalive, nothing sent");
+
+    qc2s_close(ctx);
+}
+
+/* Returns the time spent */
+static long long elapsed_us(const struct timespec *since)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000000LL +
+           (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+static void wait_completed(qc2s_ctx *ctx, uint64_t seq)
+{
+    int i;
+
+    for (i = 0; i < 2000 && qc2s_completed_seq(ctx) < seq; i++)
+        usleep(1000);
+}
+
+static void test_writer_coalesces_frames(void)
+{
+    uint8_t rgb[QC2S_GROUP_COUNT][3];
+    struct timespec start;
+    qc2s_ctx *ctx;
+    uint64_t seq;
+    int i, g;
+
+    mock_hid_reset();
+    mock_hid_write_delay_us = 5000;
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for the writer");
+    ASSERT_EQ_INT(qc2s_post_groups(ctx, NULL), 0, "no writer yet");
+    ASSERT_EQ_INT(qc2s_start_writer(ctx), 0, "writer started");
+    ASSERT_EQ_INT(qc2s_completed_seq(ctx), 0, "nothing sent yet");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 1; i <= 10; i++)
+        ASSERT_EQ_INT(qc2s_set_color(ctx, (uint8_t)i, 0, 0), 0, "posted");
+    ASSERT_TRUE(elapsed_us(&start) < 5000, "posting doesn't wait for I/O");
+
+    memset(rgb, 0x42, sizeof(rgb));
+    seq = qc2s_post_groups(ctx, (const uint8_t (*)[3])rgb);
+    ASSERT_EQ_INT(seq, 11, "frames numbered in order");
+    wait_completed(ctx, seq);
+    ASSERT_EQ_INT(qc2s_completed_seq(ctx), seq, "the newest frame sent");
+    ASSERT_TRUE(mock_hid_write_calls <= 8 + 1 + QC2S_GROUP_COUNT,
+                "frames between coalesced");
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        assert_group_packet_rgb(
+            mock_hid_packets[mock_hid_packet_count - QC2S_GROUP_COUNT + g],
+            (uint8_t)g, 0x42, 0x42, 0x42);
+    }
+
+    qc2s_close(ctx);
+    ASSERT_EQ_INT(mock_hid_close_calls, 1, "closed after the writer");
+}
+
+static void test_writer_failure_is_reported(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for writer failure");
+    ASSERT_EQ_INT(qc2s_start_writer(ctx), 0, "writer started");
+    mock_hid_write_fail_call = 1;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "posted");
+    usleep(50000); /* the writer fails the init */
+    mock_hid_write_fail_call = mock_hid_write_calls + 1; /* and its retry */
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), -1,
+                  "a failed write shows at the next post");
+    ASSERT_EQ_INT(qc2s_completed_seq(ctx), 0, "nothing completed");
+    qc2s_close(ctx);
+}
+
+static void test_writer_recovers_without_keepalive(void)
+{
+    qc2s_ctx *ctx;
+    uint64_t seq;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for writer recovery");
+    qc2s_set_keepalive(ctx, 0);
+    ASSERT_EQ_INT(qc2s_start_writer(ctx), 0, "writer started");
+    mock_hid_write_fail_call = 1;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "posted");
+    usleep(20000); /* the writer fails the init */
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 4, 5, 6), -1, "the failure shows");
+    ASSERT_EQ_INT(qc2s_completed_seq(ctx), 0, "nothing completed");
+    /* Nothing else is posted and there is no keepalive: the retry alone
+       gets the newest frame through */
+    usleep(QC2S_RETRY_MS * 3 * 1000);
+    seq = qc2s_completed_seq(ctx);
+    ASSERT_EQ_INT(seq, 2, "the frame posted during the failure went");
+    ASSERT_EQ_INT(mock_hid_packets[mock_hid_packet_count - 1]
+                                  [QC2S_RGB_OFFSET], 4, "with its colors");
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 7, 8, 9), 0, "posts work again");
+    qc2s_close(ctx);
+}
+
+struct submit_args {
+    qc2s_ctx *ctx;
+    struct qc2s_timed_frame frames[2];
+    int sent;
+};
+
+static void *submit_thread(void *data)
+{
+    struct submit_args *a = data;
+
+    a->sent = qc2s_submit_frames(a->ctx, a->frames, 2);
+    return NULL;
+}
+
+/* While a frame is held, the device is free for the other calls */
+static void test_submit_frames_release_the_device(void)
+{
+    uint8_t report[QC2S_PACKET_SIZE];
+    struct submit_args args;
+    struct timespec start;
+    pthread_t submit;
+
+    memset(&args, 0, sizeof(args));
+    memset(args.frames[0].rgb, 1, sizeof(args.frames[0].rgb));
+    memset(args.frames[1].rgb, 2, sizeof(args.frames[1].rgb));
+    args.frames[0].duration_ms = args.frames[1].duration_ms = 100;
+    memset(report, 0, sizeof(report));
+    report[0] = QC2S_CMD_INIT;
+
+    mock_hid_reset();
+    args.ctx = qc2s_open();
+    ASSERT_TRUE(args.ctx != NULL, "open for a held batch");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&submit, NULL, submit_thread, &args);
+    usleep(20000);
+    ASSERT_EQ_INT(qc2s_send_report(args.ctx, report, 0), 0,
+                  "report while the first frame is held");
+    ASSERT_TRUE(elapsed_us(&start) < 50000, "without waiting for the batch");
+    pthread_join(submit, NULL);
+    ASSERT_EQ_INT(args.sent, 2, "both frames sent");
+    ASSERT_TRUE(elapsed_us(&start) >= 200000, "each frame held its time");
+    qc2s_close(args.ctx);
+}
+
+static void test_submit_frames_through_the_writer(void)
+{
+    struct qc2s_timed_frame frames[3];
+    struct qc2s_health health;
+    qc2s_ctx *ctx;
+    int f, g;
+
+    memset(frames, 0, sizeof(frames));
+    for (f = 0; f < 3; f++) {
+        memset(frames[f].rgb, f + 1, sizeof(frames[f].rgb));
+        frames[f].duration_ms = 1;
+    }
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for a batch to the writer");
+    ASSERT_EQ_INT(qc2s_start_writer(ctx), 0, "writer started");
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, frames, 3), 3, "every frame posted");
+    wait_completed(ctx, 3);
+    ASSERT_EQ_INT(qc2s_completed_seq(ctx), 3, "the writer sent the last");
+    for (g = 0; g < QC2S_GROUP_COUNT; g++) {
+        assert_group_packet_rgb(
+            mock_hid_packets[mock_hid_packet_count - QC2S_GROUP_COUNT + g],
+            (uint8_t)g, 3, 3, 3);
+    }
+
+    mock_hid_write_fail_call = mock_hid_write_calls + 1;
+    frames[2].rgb[0][0] = 9;
+    qc2s_submit_frames(ctx, frames + 2, 1);
+    for (f = 0; f < 2000; f++) { /* the writer fails it */
+        qc2s_get_health(ctx, &health);
+        if (health.failures)
+            break;
+        usleep(1000);
+    }
+    mock_hid_write_fail_call = mock_hid_write_calls + 1; /* and its retry */
+    ASSERT_EQ_INT(qc2s_submit_frames(ctx, frames, 3), -1,
+                  "a failed write shows at the next batch");
+    mock_hid_write_fail_call = 0;
+    qc2s_close(ctx);
+}
+
 static void test_set_color_write_error(void)
 {
     qc2s_ctx *ctx;
@@ -129,6 +654,7 @@ static void test_connectivity_check(void)
     mock_hid_reset();
     ctx = qc2s_open();
     ASSERT_TRUE(ctx != NULL, "open for connectivity");
+    qc2s_set_probe_idle(ctx, 0);
 
     mock_hid_read_result = 0;
     ASSERT_EQ_INT(qc2s_is_connected(ctx), 1, "connected when report roundtrip succeeds");
@@ -143,13 +669,94 @@ static void test_connectivity_check(void)
     qc2s_close(ctx);
 }
 
+/* The probe's INIT leaves the colors unknown, as the frames' own does */
+static void test_probe_resends_the_frame(void)
+{
+    qc2s_ctx *ctx;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for a probe between frames");
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "first frame");
+    qc2s_set_probe_idle(ctx, 0);
+    mock_hid_write_calls = 0;
+    ASSERT_EQ_INT(qc2s_is_connected(ctx), 1, "probed");
+    ASSERT_EQ_INT(mock_hid_write_calls, 1, "with an init");
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "same frame");
+    ASSERT_EQ_INT(mock_hid_write_calls, 1 + 1 + QC2S_GROUP_COUNT,
+                  "sent whole after the probe, without another init");
+    qc2s_close(ctx);
+}
+
+static void test_health_from_the_frames(void)
+{
+    struct qc2s_health health;
+    qc2s_ctx *ctx;
+    int writes;
+
+    mock_hid_reset();
+    ctx = qc2s_open();
+    ASSERT_TRUE(ctx != NULL, "open for health");
+    qc2s_get_health(ctx, &health);
+    ASSERT_EQ_INT(health.idle_ms, -1, "nothing sent yet");
+
+    mock_hid_read_result = QC2S_PACKET_SIZE;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 1, 2, 3), 0, "frame sent");
+    writes = mock_hid_write_calls;
+    ASSERT_EQ_INT(qc2s_is_connected(ctx), 1, "the frame went through");
+    ASSERT_EQ_INT(mock_hid_write_calls, writes, "not probed after a frame");
+    qc2s_get_health(ctx, &health);
+    ASSERT_TRUE(health.idle_ms >= 0 && health.idle_ms < 1000,
+                "last report just now");
+    ASSERT_EQ_INT(health.failures, 0, "no failures");
+    ASSERT_TRUE(health.ack_latency_us >= 0 &&
+                health.ack_latency_us < QC2S_ACK_TIMEOUT * 1000,
+                "ack latency");
+
+    mock_hid_write_fail_call = mock_hid_write_calls + 1;
+    ASSERT_EQ_INT(qc2s_set_color(ctx, 4, 5, 6), -1, "frame failed");
+    writes = mock_hid_write_calls;
+    ASSERT_EQ_INT(qc2s_is_connected(ctx), 0, "the frame failed");
+    ASSERT_EQ_INT(mock_hid_write_calls, writes, "not probed after a frame");
+    qc2s_get_health(ctx, &health);
+    ASSERT_EQ_INT(health.failures, 1, "a failure");
+
+    /* Idle past the window, a probe tells */
+    qc2s_set_probe_idle(ctx, 1);
+    usleep(2000);
+    mock_hid_write_fail_call = 0;
+    ASSERT_EQ_INT(qc2s_is_connected(ctx), 1, "probed");
+    ASSERT_EQ_INT(mock_hid_write_calls, writes + 1, "one probe report");
+    ASSERT_EQ_INT(mock_hid_packets[writes][0], QC2S_CMD_INIT,
+                  "the probe is init");
+    qc2s_close(ctx);
+}
+
 int main(void)
 {
     test_open_close_refcount();
     test_set_color_packet_sequence();
     test_set_frame_uses_upper_and_lower_colors();
+    test_set_groups_uses_each_color();
+    test_set_leds_fills_each_slot();
+    test_effect_frames_are_sent();
+    test_submit_frames_in_order();
+    test_submit_frames_skips_late_ones();
+    test_only_changed_groups_are_sent();
+    test_keepalive_resends_the_frame();
+    test_writer_coalesces_frames();
+    test_writer_failure_is_reported();
+    test_writer_recovers_without_keepalive();
+    test_submit_frames_release_the_device();
+    test_submit_frames_through_the_writer();
     test_set_color_write_error();
     test_connectivity_check();
+    test_probe_resends_the_frame();
+    test_health_from_the_frames();
+    test_open_prefers_primary_interface();
+    test_open_falls_back_in_pass_order();
+    test_reopen_skips_enumeration();
+    test_reopen_checks_serial();
 
     if (tests_failed) {
         fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
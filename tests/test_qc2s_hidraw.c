@@ -0,0 +1,288 @@
+/* Unit tests for the hidraw transport of QuadCast 2S.
+ * Build: make test (Linux)
+ * The node is one end of a socketpair, the test plays the microphone on
+ * the other one; libusb is tests/mock_libusb.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "../modules/transport.h"
+#include "../modules/qc2s_hidraw.h"
+#include "mock_libusb_control.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+static int fds[2]; /* the node & the microphone */
+static struct ring_frame frame;
+
+static void setup(struct micro *m)
+{
+    int i;
+    if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+        perror("socketpair");
+        exit(1);
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    memset(m, 0, sizeof(*m));
+    m->caps = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    m->hidraw = fds[0];
+    for(i = 0; i < QC2S_GROUP_COUNT; i++)
+        frame.rgb[i][0] = (byte_t)(0x10+i);
+}
+
+static void teardown(struct micro *m)
+{
+    m->caps->transport->close(m);
+    close(fds[1]);
+}
+
+/* As the display loop does: the acks are read as they come, ms at most */
+static void read_acks(struct micro *m, int ms)
+{
+    struct pollfd pfd = { fds[0], POLLIN, 0 };
+    while(m->unacked && poll(&pfd, 1, ms) > 0)
+        qc2s_hidraw_acks(m);
+}
+
+/* Returns the length of the write the microphone got, 0 if none */
+static int receive(byte_t *buf, int size)
+{
+    ssize_t len = recv(fds[1], buf, size, 0);
+    return len < 0 ? 0 : (int)len;
+}
+
+static void test_reports_of_a_tick_go_at_once(void)
+{
+    struct micro m;
+    byte_t buf[8*QC2S_PACKET_SIZE];
+    unsigned long step;
+
+    setup(&m);
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 0, 50), frame_sent,
+              "first tick sent");
+    ASSERT_EQ(receive(buf, sizeof(buf)), 3*QC2S_PACKET_SIZE,
+              "init, start & group 0 in one write");
+    ASSERT_EQ(buf[0], QC2S_CMD_INIT, "init first");
+    ASSERT_EQ(buf[QC2S_PACKET_SIZE+1], QC2S_SUB_START, "then start");
+    ASSERT_EQ(buf[2*QC2S_PACKET_SIZE+1], QC2S_SUB_DATA, "then group 0");
+    ASSERT_EQ(buf[2*QC2S_PACKET_SIZE+QC2S_RGB_OFFSET], 0x10,
+              "group 0 color");
+    ASSERT_EQ(receive(buf, sizeof(buf)), 0, "nothing else");
+    ASSERT_EQ(m.init_sent, 1, "init sent");
+
+    for(step = 1; step < QC2S_GROUP_COUNT; step++) {
+        micro_show(&m, NULL, &frame, step, 50);
+        ASSERT_EQ(receive(buf, sizeof(buf)), QC2S_PACKET_SIZE,
+                  "a group per tick");
+        ASSERT_EQ(buf[2], step, "groups in order");
+        ASSERT_EQ(buf[QC2S_RGB_OFFSET], 0x10+step, "group color");
+    }
+
+    for(step = 0; step < QC2S_GROUP_COUNT; step++) {
+        micro_show(&m, NULL, &frame, QC2S_GROUP_COUNT+step, 50);
+        ASSERT_EQ(receive(buf, sizeof(buf)), 0, "the same frame again");
+    }
+    teardown(&m);
+}
+
+static void test_only_changed_groups_are_written(void)
+{
+    struct micro m;
+    struct ring_frame next = frame;
+    byte_t buf[8*QC2S_PACKET_SIZE];
+    unsigned long step;
+    int writes = 0, len;
+
+    setup(&m);
+    for(step = 0; step < QC2S_GROUP_COUNT; step++) {
+        micro_show(&m, NULL, &frame, step, 50);
+        receive(buf, sizeof(buf));
+    }
+    next.rgb[3][0] = 0x80;
+    for(step = 0; step < QC2S_GROUP_COUNT; step++) {
+        ASSERT_EQ(micro_show(&m, NULL, &next, QC2S_GROUP_COUNT+step, 50),
+                  frame_sent, "tick of the next frame");
+        len = receive(buf, sizeof(buf));
+        if(len == 0)
+            continue;
+        writes++;
+        ASSERT_EQ(step, 3, "at the tick of the changed group");
+        ASSERT_EQ(len, 2*QC2S_PACKET_SIZE, "start & the group");
+        ASSERT_EQ(buf[1], QC2S_SUB_START, "no init again");
+        ASSERT_EQ(buf[2], 1, "start has the one group");
+        ASSERT_EQ(buf[QC2S_PACKET_SIZE+2], 3, "the changed group");
+        ASSERT_EQ(buf[QC2S_PACKET_SIZE+QC2S_RGB_OFFSET], 0x80,
+                  "its new color");
+    }
+    ASSERT_EQ(writes, 1, "a write for the frame");
+    teardown(&m);
+}
+
+/* Plays the firmware: every report of a write gets its ack */
+static void *ack_reports(void *data)
+{
+    byte_t buf[8*QC2S_PACKET_SIZE];
+    struct pollfd pfd = { fds[1], POLLIN, 0 };
+    ssize_t len;
+    int i;
+    (void)data;
+    while(poll(&pfd, 1, -1) > 0 &&
+          (len = recv(fds[1], buf, sizeof(buf), 0)) > 0)
+        for(i = 0; i+QC2S_PACKET_SIZE <= len; i += QC2S_PACKET_SIZE)
+            send(fds[1], buf+i, QC2S_PACKET_SIZE, 0);
+    return NULL;
+}
+
+static void test_acks_pace_the_groups(void)
+{
+    struct micro m;
+    struct ring_frame f = frame;
+    pthread_t th;
+    unsigned long step, failed = 0;
+    int i;
+
+    setup(&m);
+    ASSERT_EQ(micro_period(&m), QC2S_GROUP_PERIOD, "slow at first");
+    pthread_create(&th, NULL, ack_reports, NULL);
+    for(step = 0; step < 10*QC2S_GROUP_COUNT; step++) {
+        if(step % QC2S_GROUP_COUNT == 0) /* every group changes */
+            for(i = 0; i < QC2S_GROUP_COUNT; i++)
+                f.rgb[i][1] = (byte_t)step;
+        if(micro_show(&m, NULL, &f, step, 50) != frame_sent)
+            failed++;
+        read_acks(&m, 50);
+    }
+    ASSERT_EQ(failed, 0, "every group sent");
+    ASSERT_EQ(m.pace.acked, 10*QC2S_GROUP_COUNT, "every group acked");
+    ASSERT_EQ(m.pace.missed, 0, "none missed");
+    ASSERT_EQ(micro_period(&m), QC2S_PACE_MIN_MS,
+              "as fast as the acks allow");
+    m.caps->transport->close(&m); /* the microphone sees it go */
+    pthread_join(th, NULL);
+    close(fds[1]);
+}
+
+static void test_acks_are_not_waited_for(void)
+{
+    struct micro m;
+    long long start;
+
+    setup(&m);
+    start = frame_clock_now_ns();
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 0, 50), frame_sent,
+              "sent without acks");
+    ASSERT_TRUE(frame_clock_now_ns() - start < 25*NSEC_PER_MSEC,
+                "returns before the timeout");
+    ASSERT_EQ(m.unacked, 3, "the acks of the write awaited");
+    ASSERT_EQ(m.pace.acked + m.pace.missed, 0, "nothing told yet");
+    teardown(&m);
+}
+
+static void test_missing_acks_slow_down(void)
+{
+    struct micro m;
+    byte_t buf[8*QC2S_PACKET_SIZE];
+    int i;
+
+    setup(&m);
+    m.pace.floor_ns = QC2S_PACE_MIN_MS*NSEC_PER_MSEC;
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 0, 5), frame_sent, "first tick");
+    receive(buf, sizeof(buf));
+    usleep(10000);
+    for(i = 0; i < 3; i++)
+        ASSERT_EQ(send(fds[1], buf+i*QC2S_PACKET_SIZE, QC2S_PACKET_SIZE, 0),
+                  QC2S_PACKET_SIZE, "late ack");
+    read_acks(&m, 50);
+    ASSERT_EQ(m.pace.missed, 1, "acks past the timeout missed");
+    ASSERT_EQ(micro_period(&m), 2*QC2S_PACE_MIN_MS, "backs off");
+
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 1, 5), frame_sent, "second tick");
+    ASSERT_EQ(m.pace.missed, 1, "its acks are awaited");
+    receive(buf, sizeof(buf));
+    micro_show(&m, NULL, &frame, 2, 5);
+    ASSERT_EQ(m.pace.missed, 2, "missed at the next tick without them");
+    ASSERT_EQ(m.unacked, 1, "the new write's awaited");
+    teardown(&m);
+}
+
+static void test_failed_write(void)
+{
+    struct micro m;
+
+    setup(&m);
+    close(fds[1]);
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 0, 50), frame_failed,
+              "write to a closed node fails");
+    ASSERT_EQ(m.init_sent, 0, "init is sent again");
+    m.caps->transport->close(&m);
+    ASSERT_EQ(m.hidraw, -1, "closed");
+    ASSERT_TRUE(fcntl(fds[0], F_GETFD) < 0, "node closed");
+}
+
+/* No node here: libusb takes over the microphone */
+static void test_libusb_without_a_node(void)
+{
+    struct micro m;
+
+    mock_usb_reset();
+    memset(&m, 0, sizeof(m));
+    m.caps = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    strcpy(m.where, "255-9.9.9");
+    ASSERT_EQ(m.caps->transport->open(&m, NULL, NULL), 0, "opened");
+    ASSERT_EQ(m.hidraw, -1, "no node");
+    ASSERT_TRUE(m.handle != NULL, "libusb handle");
+    ASSERT_EQ(m.ep_out, QC2S_INTR_EP_OUT, "default endpoint");
+    ASSERT_EQ(micro_show(&m, NULL, &frame, 0, 50), frame_sent,
+              "sent through libusb");
+    ASSERT_EQ(mock_usb_packet_count, 3, "a transfer per report");
+    ASSERT_EQ(mock_usb_packet_eps[0], QC2S_INTR_EP_OUT, "interrupt OUT");
+    m.caps->transport->close(&m);
+    ASSERT_TRUE(m.handle == NULL, "libusb closed");
+    ASSERT_EQ(mock_usb_close_calls, 1, "handle closed once");
+}
+
+int main(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+    test_reports_of_a_tick_go_at_once();
+    test_only_changed_groups_are_written();
+    test_acks_pace_the_groups();
+    test_acks_are_not_waited_for();
+    test_missing_acks_slow_down();
+    test_failed_write();
+    test_libusb_without_a_node();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d hidraw transport tests passed\n", tests_run);
+    return 0;
+}
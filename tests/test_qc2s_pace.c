@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+#include "../modules/qc2s_pace.h"
+
+#define MS 1000000LL
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if (!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while (0)
+
+#define ASSERT_EQ_INT(a, b, msg) do { \
+    tests_run++; \
+    if ((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %d want %d)\n", \
+                __FILE__, __LINE__, msg, (int)(a), (int)(b)); \
+        tests_failed++; \
+    } \
+} while (0)
+
+static void test_zeroed_starts_slow(void)
+{
+    struct qc2s_pace p;
+
+    memset(&p, 0, sizeof(p));
+    ASSERT_EQ_INT(qc2s_pace_period_ms(&p), QC2S_PACE_START_MS,
+                  "nothing known yet");
+}
+
+static void test_fast_acks_lower_the_floor(void)
+{
+    struct qc2s_pace p;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    qc2s_pace_update(&p, 1 * MS, 1);
+    ASSERT_TRUE(qc2s_pace_period_ms(&p) < QC2S_PACE_START_MS,
+                "one ack lowers it");
+    ASSERT_TRUE(qc2s_pace_period_ms(&p) > 30, "but slowly");
+    for (i = 0; i < 100; i++)
+        qc2s_pace_update(&p, 1 * MS, 1);
+    ASSERT_EQ_INT(qc2s_pace_period_ms(&p), QC2S_PACE_MIN_MS,
+                  "no faster than the minimum");
+    ASSERT_EQ_INT(p.acked, 101, "acks counted");
+}
+
+static void test_floor_keeps_a_margin(void)
+{
+    struct qc2s_pace p;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    for (i = 0; i < 200; i++)
+        qc2s_pace_update(&p, 20 * MS, 1);
+    ASSERT_EQ_INT(qc2s_pace_period_ms(&p), 25, "a quarter over the acks");
+}
+
+static void test_slow_acks_raise_it_at_once(void)
+{
+    struct qc2s_pace p;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    for (i = 0; i < 100; i++)
+        qc2s_pace_update(&p, 1 * MS, 1);
+    qc2s_pace_update(&p, 300 * MS, 1);
+    ASSERT_TRUE(qc2s_pace_period_ms(&p) >= 40, "a late ack slows it down");
+}
+
+static void test_missed_ack_backs_off(void)
+{
+    struct qc2s_pace p;
+    int i;
+
+    memset(&p, 0, sizeof(p));
+    for (i = 0; i < 100; i++)
+        qc2s_pace_update(&p, 1 * MS, 1);
+    qc2s_pace_update(&p, 0, 0);
+    ASSERT_EQ_INT(qc2s_pace_period_ms(&p), 2 * QC2S_PACE_MIN_MS,
+                  "a miss doubles it");
+    qc2s_pace_update(&p, 0, 0);
+    qc2s_pace_update(&p, 0, 0);
+    ASSERT_EQ_INT(qc2s_pace_period_ms(&p), QC2S_PACE_START_MS,
+                  "up to the start");
+    ASSERT_EQ_INT(p.missed, 3, "misses counted");
+}
+
+int main(void)
+{
+    test_zeroed_starts_slow();
+    test_fast_acks_lower_the_floor();
+    test_floor_keeps_a_margin();
+    test_slow_acks_raise_it_at_once();
+    test_missed_ack_backs_off();
+
+    if (tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+
+    printf("All %d pacing tests passed\n", tests_run);
+    return 0;
+}
@@ -0,0 +1,294 @@
+/* Unit tests for the table of models and the frames they are sent.
+ * Build: make test
+ * The transports are mocks: see mock_transport.c.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "mock_transport.h"
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+#define ASSERT_TRUE(cond, msg) do { \
+    tests_run++; \
+    if(!(cond)) { \
+        fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, msg); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#define ASSERT_EQ(a, b, msg) do { \
+    tests_run++; \
+    if((a) != (b)) { \
+        fprintf(stderr, "FAIL %s:%d: %s (got %lld, want %lld)\n", \
+                __FILE__, __LINE__, msg, (long long)(a), (long long)(b)); \
+        tests_failed++; \
+    } \
+} while(0)
+
+#ifdef __linux__
+#define QC2S_TRANSPORT (&qc2s_hidraw_transport)
+#else
+#define QC2S_TRANSPORT (&qc2s_usb_transport)
+#endif
+
+static const byte_t upper_rgb[3] = { 0xff, 0, 0 };
+static const byte_t lower_rgb[3] = { 0, 0, 0xff };
+
+static void make_command(byte_t *colcommand, const byte_t *upper,
+                         const byte_t *lower)
+{
+    memset(colcommand, 0, 2*BYTE_STEP);
+    colcommand[0] = RGB_CODE;
+    memcpy(colcommand+1, upper, 3);
+    colcommand[BYTE_STEP] = RGB_CODE;
+    memcpy(colcommand+BYTE_STEP+1, lower, 3);
+}
+
+static void make_micro(struct micro *m, unsigned short vid,
+                       unsigned short pid)
+{
+    memset(m, 0, sizeof(*m));
+    m->caps = find_caps(vid, pid);
+    mock_transport_reset();
+}
+
+static void test_find_caps(void)
+{
+    const struct micro_caps *c;
+
+    c = find_caps(DEV_VID_NA, DEV_PID_NA1);
+    ASSERT_TRUE(c != NULL, "QuadCast S is known");
+    if(c) {
+        ASSERT_EQ(c->format, report_command, "QuadCast S takes commands");
+        ASSERT_EQ(c->groups, 1, "QuadCast S frame is one report");
+        ASSERT_EQ(c->period, FRAME_PERIOD, "QuadCast S period");
+        ASSERT_TRUE(c->transport == &qc1_transport, "QuadCast S transport");
+    }
+    c = find_caps(DEV_VID_EU, DEV_PID_DUOCAST);
+    ASSERT_TRUE(c && !strcmp(c->name, "DuoCast"), "DuoCast is known");
+    ASSERT_TRUE(c && c->transport == &qc1_transport, "DuoCast transport");
+
+    /* The same PID stands for another model on the NA VID */
+    c = find_caps(DEV_VID_NA, DEV_PID_NA3);
+    ASSERT_TRUE(c && c->format == report_command, "0951:02b5 is QuadCast S");
+    c = find_caps(DEV_VID_EU, DEV_PID_NA3);
+    ASSERT_TRUE(c != NULL, "QuadCast 2S is known");
+    if(c) {
+        ASSERT_EQ(c->format, report_groups, "QuadCast 2S takes groups");
+        ASSERT_EQ(c->groups, QC2S_GROUP_COUNT, "QuadCast 2S groups");
+        ASSERT_EQ(c->period, QC2S_GROUP_PERIOD, "QuadCast 2S period");
+        ASSERT_TRUE(c->transport == QC2S_TRANSPORT,
+                    "QuadCast 2S transport");
+    }
+
+    ASSERT_TRUE(find_caps(0x1234, 0x5678) == NULL, "unknown device");
+    ASSERT_TRUE(find_caps(DEV_VID_NA, DEV_PID_EU1) == NULL,
+                "EU PID on the NA VID");
+}
+
+static void test_qc1_whole_frames(void)
+{
+    struct micro m;
+    struct ring_frame f;
+    byte_t colcommand[2*BYTE_STEP];
+    unsigned long step;
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_EU1);
+    make_command(colcommand, upper_rgb, lower_rgb);
+    for(step = 0; step < 3; step++)
+        ASSERT_EQ(micro_show(&m, colcommand, NULL, step, 50), frame_sent,
+                  "command sent");
+    ASSERT_EQ(mock_send_count, 3, "a frame every tick");
+    ASSERT_EQ(mock_sends[2].group, 0, "QuadCast S has one group");
+    ASSERT_TRUE(mock_sends[2].command == colcommand,
+                "the command is sent as it is");
+
+    memset(&f, 0, sizeof(f));
+    ring_frame_set_parts(&f, lower_rgb, upper_rgb);
+    ASSERT_EQ(micro_show(&m, NULL, &f, 3, 50), frame_sent, "frame sent");
+    ASSERT_TRUE(mock_sends[3].command == NULL, "no command for a frame");
+    ASSERT_TRUE(!memcmp(mock_sends[3].frame.rgb, f.rgb, sizeof(f.rgb)),
+                "the frame is sent");
+}
+
+static void test_qc2s_first_frame(void)
+{
+    struct micro m;
+    byte_t colcommand[2*BYTE_STEP];
+    unsigned long step;
+    int group;
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_NA3);
+    make_command(colcommand, upper_rgb, lower_rgb);
+    for(step = 0; step < QC2S_GROUP_COUNT; step++)
+        ASSERT_EQ(micro_show(&m, step ? NULL : colcommand, NULL, step, 50),
+                  frame_sent, "group sent");
+    ASSERT_EQ(mock_report_count, QC2S_GROUP_COUNT+2,
+              "init, start & a report per group");
+    ASSERT_EQ(mock_reports[0][0], QC2S_CMD_INIT, "init first");
+    ASSERT_EQ(mock_reports[1][0], QC2S_CMD_COLOR, "then start");
+    ASSERT_EQ(mock_reports[1][1], QC2S_SUB_START, "start report");
+    ASSERT_EQ(mock_reports[1][2], QC2S_GROUP_COUNT, "start has the count");
+    for(group = 0; group < QC2S_GROUP_COUNT; group++) {
+        ASSERT_EQ(mock_reports[group+2][1], QC2S_SUB_DATA, "data report");
+        ASSERT_EQ(mock_reports[group+2][2], group, "groups in order");
+        ASSERT_TRUE(!memcmp(mock_reports[group+2]+QC2S_RGB_OFFSET,
+                            group < QC2S_UPPER_GROUPS ? upper_rgb : lower_rgb, 3),
+                    "group color of its part");
+    }
+
+    /* The same frame again sends nothing */
+    for(step = 0; step < QC2S_GROUP_COUNT; step++)
+        ASSERT_EQ(micro_show(&m, step ? NULL : colcommand, NULL,
+                             QC2S_GROUP_COUNT+step, 50),
+                  frame_sent, "unchanged group");
+    ASSERT_EQ(mock_report_count, QC2S_GROUP_COUNT+2, "nothing sent");
+}
+
+static void test_qc2s_only_changed_groups(void)
+{
+    struct micro m;
+    byte_t colcommand[2*BYTE_STEP];
+    byte_t other_rgb[3] = { 0x01, 0x02, 0x03 };
+    unsigned long step;
+    int group, lower = QC2S_GROUP_COUNT - QC2S_UPPER_GROUPS;
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_NA3);
+    make_command(colcommand, upper_rgb, lower_rgb);
+    for(step = 0; step < QC2S_GROUP_COUNT; step++)
+        micro_show(&m, step ? NULL : colcommand, NULL, step, 50);
+    mock_transport_reset();
+
+    /* The next frame starts without init and has only the lower groups */
+    make_command(colcommand, upper_rgb, other_rgb);
+    for(step = 0; step < QC2S_GROUP_COUNT; step++)
+        micro_show(&m, step ? NULL : colcommand, NULL,
+                   QC2S_GROUP_COUNT+step, 50);
+    ASSERT_EQ(mock_report_count, lower+1, "start & the lower groups");
+    ASSERT_EQ(mock_reports[0][1], QC2S_SUB_START, "start again");
+    ASSERT_EQ(mock_reports[0][2], lower, "start has the changed ones");
+    for(group = 0; group < lower; group++) {
+        ASSERT_EQ(mock_reports[group+1][2], QC2S_UPPER_GROUPS+group,
+                  "the lower groups in order");
+        ASSERT_TRUE(!memcmp(mock_reports[group+1]+QC2S_RGB_OFFSET,
+                            other_rgb, 3), "the new color");
+    }
+
+    /* Whole frames again once the keepalive is due */
+    mock_transport_reset();
+    m.keepalive = 1;
+    usleep(2000);
+    for(step = 0; step < QC2S_GROUP_COUNT; step++)
+        micro_show(&m, step ? NULL : colcommand, NULL,
+                   2*QC2S_GROUP_COUNT+step, 50);
+    ASSERT_EQ(mock_report_count, QC2S_GROUP_COUNT+1, "keepalive frame");
+    ASSERT_EQ(mock_reports[0][2], QC2S_GROUP_COUNT, "start has them all");
+}
+
+/* Frames given in the middle of one being sent don't tear it */
+static void test_qc2s_colors_taken_at_start(void)
+{
+    struct micro m;
+    struct ring_frame first, second;
+    unsigned long step;
+    int i;
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_NA3);
+    memset(&first, 0, sizeof(first));
+    memset(&second, 0, sizeof(second));
+    for(i = 0; i < QC2S_GROUP_COUNT; i++) {
+        first.rgb[i][0] = (byte_t)(i+1);
+        second.rgb[i][2] = 0x80;
+    }
+    micro_show(&m, NULL, &first, 0, 50);
+    for(step = 1; step < QC2S_GROUP_COUNT; step++)
+        micro_show(&m, NULL, &second, step, 50);
+    for(i = 0; i < QC2S_GROUP_COUNT; i++)
+        ASSERT_TRUE(!memcmp(mock_reports[i+2]+QC2S_RGB_OFFSET, first.rgb[i],
+                            3), "colors of the first frame");
+
+    micro_show(&m, NULL, &second, QC2S_GROUP_COUNT, 50);
+    ASSERT_TRUE(!memcmp(mock_reports[QC2S_GROUP_COUNT+3]+QC2S_RGB_OFFSET,
+                        second.rgb[0], 3), "the next frame takes new ones");
+}
+
+static void test_qc2s_failed_init_is_sent_again(void)
+{
+    struct micro m;
+    byte_t colcommand[2*BYTE_STEP];
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_NA3);
+    make_command(colcommand, upper_rgb, lower_rgb);
+    mock_report_fail_at = 0;
+    ASSERT_EQ(micro_show(&m, colcommand, NULL, 0, 50), frame_failed,
+              "failed init fails the group");
+    ASSERT_EQ(m.init_sent, 0, "init not sent");
+    ASSERT_EQ(micro_show(&m, colcommand, NULL, 0, 50), frame_sent,
+              "the frame starts over");
+    ASSERT_EQ(m.init_sent, 1, "init sent");
+    ASSERT_EQ(mock_reports[0][0], QC2S_CMD_INIT, "init again");
+}
+
+/* Frames of the animation hand out the reports built when it loaded */
+static void test_qc2s_reports_of_the_animation(void)
+{
+    struct micro m;
+    struct frame_reports r;
+    datpack anim[1];
+    byte_t outside[2*BYTE_STEP];
+    unsigned long step;
+    int group;
+
+    make_micro(&m, DEV_VID_EU, DEV_PID_NA3);
+    memset(anim, 0, sizeof(anim));
+    make_command(anim[0], upper_rgb, lower_rgb);
+    make_command(anim[0]+2*BYTE_STEP, lower_rgb, upper_rgb);
+    make_command(anim[0]+4*BYTE_STEP, upper_rgb, lower_rgb);
+    ASSERT_EQ(frame_reports_build(&r, anim, 3), 0, "reports built");
+    ASSERT_EQ(r.cache.distinct, 2, "the third command is the first");
+    m.reports = &r;
+
+    micro_show(&m, anim[0]+2*BYTE_STEP, NULL, 0, 50);
+    ASSERT_TRUE(m.cached == qc2s_cache_reports(&r.cache, 1),
+                "reports of the command");
+    for(step = 1; step < QC2S_GROUP_COUNT; step++)
+        micro_show(&m, NULL, NULL, step, 50);
+    ASSERT_EQ(mock_report_count, QC2S_GROUP_COUNT+2, "the whole frame");
+    for(group = 0; group < QC2S_GROUP_COUNT; group++)
+        ASSERT_TRUE(!memcmp(mock_reports[group+2],
+                            m.cached + group*QC2S_PACKET_SIZE,
+                            QC2S_PACKET_SIZE), "the cached reports sent");
+    ASSERT_TRUE(!memcmp(mock_reports[2]+QC2S_RGB_OFFSET, lower_rgb, 3),
+                "the colors of the command");
+
+    make_command(outside, upper_rgb, upper_rgb);
+    micro_show(&m, outside, NULL, QC2S_GROUP_COUNT, 50);
+    ASSERT_TRUE(m.cached == NULL, "other commands are encoded");
+    ASSERT_TRUE(!memcmp(mock_reports[QC2S_GROUP_COUNT+3]+QC2S_RGB_OFFSET,
+                        upper_rgb, 3), "and sent all the same");
+    micro_show(&m, anim[0]+6*BYTE_STEP, NULL, 2*QC2S_GROUP_COUNT, 50);
+    ASSERT_TRUE(m.cached == NULL, "nor past the last command");
+    frame_reports_free(&r);
+}
+
+int main(void)
+{
+    test_find_caps();
+    test_qc1_whole_frames();
+    test_qc2s_first_frame();
+    test_qc2s_only_changed_groups();
+    test_qc2s_colors_taken_at_start();
+    test_qc2s_failed_init_is_sent_again();
+    test_qc2s_reports_of_the_animation();
+
+    if(tests_failed) {
+        fprintf(stderr, "\n%d/%d tests FAILED\n", tests_failed, tests_run);
+        return 1;
+    }
+    printf("All %d transport tests passed\n", tests_run);
+    return 0;
+}